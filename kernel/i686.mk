@@ -19,4 +19,5 @@ OBJ += \
 	arch/i686/interrupts.o \
 	arch/i686/registers.o \
 	arch/i686/start.o \
-	arch/i686/syscall.o
+	arch/i686/syscall.o \
+	arch/i686/trampoline.o
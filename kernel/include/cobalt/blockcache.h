@@ -0,0 +1,38 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/blockcache.h
+ * Block cache statistics.
+ */
+
+#ifndef _COBALT_BLOCKCACHE_H
+#define _COBALT_BLOCKCACHE_H
+
+#include <stdint.h>
+#include <cobalt/devctl.h>
+
+#define BLOCKCACHE_GET_STATS _DEVCTL(_IOCTL_PTR, 9)
+
+struct blockcache_stats {
+    uint64_t bcs_hits;
+    uint64_t bcs_misses;
+    uint64_t bcs_evictions;
+    uint64_t bcs_readahead; /* Additional blocks read together with a miss. */
+    uint64_t bcs_writebacks; /* Blocks that were written back. */
+    uint64_t bcs_cached; /* Blocks that are currently cached. */
+    uint64_t bcs_dirty; /* Cached blocks that need to be written back. */
+};
+
+#endif
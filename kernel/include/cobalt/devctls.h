@@ -39,5 +39,6 @@
 /* _IOCTL_PTR 3 - 6 are used in <cobalt/display.h>. */
 #define TIOCGPATH _DEVCTL(_IOCTL_PTR, 7) /* (char*) */
 #define TIOCSWINSZ _DEVCTL(_IOCTL_PTR, 8) /* (const struct winsize*) */
+/* _IOCTL_PTR 9 is used in <cobalt/blockcache.h>. */
 
 #endif
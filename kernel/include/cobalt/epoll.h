@@ -0,0 +1,58 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/epoll.h
+ * Event polling.
+ */
+
+#ifndef _COBALT_EPOLL_H
+#define _COBALT_EPOLL_H
+
+#include <cobalt/poll.h>
+
+#define EPOLL_CLOEXEC (1 << 0)
+#define EPOLL_CLOFORK (1 << 1)
+
+#define _EPOLL_FLAGS (EPOLL_CLOEXEC | EPOLL_CLOFORK)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLLIN POLLIN
+#define EPOLLRDNORM POLLRDNORM
+#define EPOLLRDBAND POLLRDBAND
+#define EPOLLPRI POLLPRI
+#define EPOLLOUT POLLOUT
+#define EPOLLWRNORM POLLWRNORM
+#define EPOLLWRBAND POLLWRBAND
+#define EPOLLERR POLLERR
+#define EPOLLHUP POLLHUP
+#define EPOLLONESHOT (1U << 30)
+#define EPOLLET (1U << 31)
+
+typedef union epoll_data {
+    void* ptr;
+    int fd;
+    __UINT32_TYPE__ u32;
+    __UINT64_TYPE__ u64;
+} epoll_data_t;
+
+struct epoll_event {
+    __UINT32_TYPE__ events;
+    epoll_data_t data;
+};
+
+#endif
@@ -23,9 +23,21 @@
 #include <cobalt/mman.h>
 #include <cobalt/kernel/kthread.h>
 #include <cobalt/kernel/memorysegment.h>
+#include <cobalt/kernel/refcount.h>
 
 #define PROT_WRITE_COMBINING (1 << 17)
 
+#ifdef __x86_64__
+// All physical memory is mapped into the kernel at this address.
+#  define DIRECT_MAP 0xFFFF800000000000
+#  define DIRECT_MAP_SIZE 0x8000000000
+#  define LARGE_PAGE_ORDER 9
+#  define LARGE_PAGE_SIZE ((size_t) PAGESIZE << LARGE_PAGE_ORDER)
+#  define LARGE_PAGE_MISALIGN (LARGE_PAGE_SIZE - 1)
+#endif
+
+class Vnode;
+
 class AddressSpace : public ConstructorMayFail {
 public:
     AddressSpace();
@@ -33,25 +45,56 @@ public:
     void activate();
     AddressSpace* fork();
     paddr_t getPhysicalAddress(vaddr_t virtualAddress);
+    bool handlePageFault(vaddr_t virtualAddress, bool present, bool write);
     vaddr_t mapAt(vaddr_t virtualAddress, paddr_t physicalAddress,
             int protection);
+    // Returns a kernel address for a page frame. The mapping must be released
+    // with unmapFrame.
+    vaddr_t mapFrame(paddr_t physicalAddress);
+    vaddr_t mapFile(const Reference<Vnode>& vnode, size_t firstPage,
+            size_t size, int protection, bool shared);
     vaddr_t mapFromOtherAddressSpace(AddressSpace* sourceSpace,
             vaddr_t sourceVirtualAddress, size_t size, int protection);
     vaddr_t mapMemory(size_t size, int protection);
     vaddr_t mapMemory(vaddr_t virtualAddress, size_t size, int protection);
     vaddr_t mapPhysical(paddr_t physicalAddress, size_t size, int protection);
+    vaddr_t mapPhysicalPages(const paddr_t* physicalAddresses, size_t pages,
+            int protection);
     vaddr_t mapUnaligned(paddr_t physicalAddress, size_t size, int protection,
             vaddr_t& mapping, size_t& mapSize);
+    void unmapFrame(vaddr_t virtualAddress);
     void unmapMemory(vaddr_t virtualAddress, size_t size);
     void unmapPhysical(vaddr_t firstVirtualAddress, size_t size);
 private:
+    paddr_t allocateLazyPage(vaddr_t virtualAddress, MemorySegment* segment);
+    MemorySegment* findSegment(vaddr_t virtualAddress);
     bool isActive();
+    bool mapFilePage(vaddr_t virtualAddress, MemorySegment* segment);
+#ifdef __x86_64__
+    bool canMapLargePage(vaddr_t virtualAddress);
+    void mapLargePage(vaddr_t virtualAddress, paddr_t physicalAddress,
+            int protection);
+    bool unmapLargePage(vaddr_t virtualAddress);
+#endif
     vaddr_t mapMemoryInternal(vaddr_t virtualAddress, size_t size,
             int protection);
     void unmap(vaddr_t virtualAddress);
+private:
+    // File mappings whose pages are loaded on first access. The pages of
+    // shared mappings are written back on munmap.
+    struct FileMapping {
+        vaddr_t address;
+        size_t size;
+        size_t firstPage;
+        bool shared;
+        Reference<Vnode> vnode;
+        FileMapping* next;
+    };
+    FileMapping* findFileMapping(vaddr_t virtualAddress);
 public:
     MemorySegment* firstSegment;
 private:
+    FileMapping* fileMappings;
     AddressSpace* prev;
     AddressSpace* next;
     kthread_mutex_t mutex;
@@ -63,6 +106,10 @@ private:
 #endif
 public:
     static void initialize();
+    static void initializePat();
+#ifdef __x86_64__
+    static void addToDirectMap(paddr_t physicalAddress, uint64_t size);
+#endif
     static bool patSupported;
 private:
     static AddressSpace* activeAddressSpace;
@@ -29,32 +29,53 @@ void initialize(uint8_t bus, uint8_t device, uint8_t function);
 
 class AhciDevice : public BlockCacheDevice {
 public:
-    AhciDevice(vaddr_t portRegisters, paddr_t portMemPhys, vaddr_t portMemVirt);
+    AhciDevice(vaddr_t portRegisters, paddr_t portMemPhys, vaddr_t portMemVirt,
+            unsigned int commandSlots, bool ncqSupported);
     bool identify();
     off_t lseek(off_t offset, int whence) override;
     void onIrq(const InterruptContext* context, uint32_t interruptStatus);
     short poll() override;
-    int sync(int flags) override;
 protected:
     bool readUncached(void* buffer, size_t size, off_t offset, int flags)
             override;
+    int syncUncached(int flags) override;
     bool writeUncached(const void* buffer, size_t size, off_t offset, int flags)
             override;
 private:
-    bool finishDmaTransfer();
+    // A request consists of one or more commands that the requesting thread
+    // waits for.
+    struct Request {
+        Thread* thread;
+        unsigned int remaining;
+        uint32_t error;
+    };
+
+    unsigned int allocateSlot(bool queued);
+    void completeCommands(uint32_t slots, uint32_t error);
     uint32_t readRegister(size_t offset);
-    bool sendDmaCommand(uint8_t command, paddr_t physicalAddress, size_t size,
-            bool write, uint64_t lba, uint16_t blockCount);
+    void restartPort();
+    size_t sendCommand(uint8_t command, vaddr_t buffer, size_t size,
+            bool write, uint64_t lba, Request* request);
+    void transfer(vaddr_t buffer, size_t size, uint64_t lba, bool write,
+            Request* request);
+    void waitForRequest(Request* request);
     void writeRegister(size_t offset, uint32_t value);
 private:
     vaddr_t portRegisters;
     paddr_t portMemPhys;
     vaddr_t portMemVirt;
-    uint32_t error;
+    paddr_t commandTablesPhys[2];
+    vaddr_t commandTablesVirt[2];
     uint64_t sectors;
     uint64_t sectorSize;
-    bool awaitingInterrupt;
-    bool dmaInProgress;
+    // The following members are protected by disabling interrupts.
+    uint32_t slotMask;
+    uint32_t busySlots;
+    uint32_t issuedSlots;
+    uint32_t queuedSlots;
+    bool ncq;
+    Request* requests[32];
+    kthread_waiter* slotWaiters;
 };
 
 #endif
@@ -29,4 +29,9 @@
 #  define KERNEL_VIRTUAL 0xFFFFFFFF80000000
 #endif
 
+// Low memory where application processors start executing. The first page
+// holds the trampoline code and the others its temporary page tables.
+#define SMP_TRAMPOLINE 0x8000
+#define SMP_TRAMPOLINE_PAGES 4
+
 #endif
@@ -59,10 +59,10 @@ public:
             uint64_t sectorSize, bool lba48Supported);
     off_t lseek(off_t offset, int whence) override;
     short poll() override;
-    int sync(int flags) override;
 protected:
     bool readUncached(void* buffer, size_t size, off_t offset, int flags)
             override;
+    int syncUncached(int flags) override;
     bool writeUncached(const void* buffer, size_t size, off_t offset, int flags)
             override;
 private:
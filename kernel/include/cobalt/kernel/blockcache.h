@@ -20,8 +20,10 @@
 #ifndef KERNEL_BLOCKCACHE_H
 #define KERNEL_BLOCKCACHE_H
 
+#include <cobalt/blockcache.h>
 #include <cobalt/kernel/cache.h>
 #include <cobalt/kernel/hashtable.h>
+#include <cobalt/kernel/slab.h>
 #include <cobalt/kernel/vnode.h>
 #include <cobalt/kernel/worker.h>
 
@@ -29,39 +31,69 @@ class BlockCacheDevice : public Vnode, public CacheController {
 protected:
     BlockCacheDevice(mode_t mode, dev_t dev);
 public:
+    int devctl(int command, void* restrict data, size_t size,
+            int* restrict info) override;
+    void flushDirtyBlocks();
     void freeUnusedBlocks();
     bool isSeekable() override;
     ssize_t pread(void* buffer, size_t size, off_t offset, int flags) override;
     ssize_t pwrite(const void* buffer, size_t size, off_t offset, int flags)
             override;
     paddr_t reclaimCache() override;
+    int sync(int flags) override;
 protected:
     virtual bool readUncached(void* buffer, size_t size, off_t offset,
             int flags) = 0;
+    virtual int syncUncached(int flags) = 0;
     virtual bool writeUncached(const void* buffer, size_t size, off_t offset,
             int flags) = 0;
 private:
-    struct Block {
+    struct Block : public SlabAllocated<Block> {
         Block(vaddr_t address, uint64_t blockNumber);
 
         vaddr_t address;
         uint64_t blockNumber;
+        bool dirty;
+        bool referenced;
         Block* nextInHashTable;
-        Block* prevAccessed;
-        Block* nextAccessed;
+        Block* prevInClock;
+        Block* nextInClock;
+        Block* prevDirty;
+        Block* nextDirty;
         Block* nextFree;
 
         uint64_t hashKey() { return blockNumber; }
     };
+    // The hash table is resized as the cache grows.
     HashTable<Block, uint64_t> blocks;
-    Block* blockBuffer[10000];
+    Block* initialBuffer[1024];
     kthread_mutex_t cacheMutex;
     Block* freeList;
-    Block* leastRecentlyUsed;
-    Block* mostRecentlyUsed;
     WorkerJob workerJob;
+    // The following members are protected by the cache mutex.
+    // Blocks are replaced using the CLOCK algorithm: Cached blocks form a ring
+    // and a hit only sets the referenced flag of the block.
+    Block* clockHand;
+    size_t numBlocks;
+    struct blockcache_stats cacheStats;
+    Block* firstDirty;
+    size_t dirtyBlocks;
+    bool flushScheduled;
+    bool writeError;
+    WorkerJob flushJob;
+    // The frames of the blocks that are currently being transferred.
+    paddr_t ioFrames[64];
+    // The following members are protected by the vnode mutex.
+    uint64_t nextReadBlock;
+    size_t readaheadBlocks;
 private:
-    void useBlock(Block* block);
+    Block* addBlocks(uint64_t blockNumber, size_t count, bool read,
+            int flags);
+    void setClean(Block* block);
+    void setDirty(Block* block);
+    bool transferBlocks(uint64_t blockNumber, size_t count, bool write,
+            int flags);
+    void writeDirtyBlocks(int flags);
 };
 
 #endif
@@ -29,8 +29,15 @@ public:
     void initialize(char* buffer, size_t size);
     size_t bytesAvailable();
     size_t spaceAvailable();
+    size_t peek(void* buf, size_t size);
     size_t read(void* buf, size_t size);
     size_t write(const void* buf, size_t size);
+    // Direct access to the buffer memory. These return the next contiguous
+    // region and the caller then reports how much of it was used.
+    const char* readRegion(size_t* size);
+    void consume(size_t size);
+    char* writeRegion(size_t* size);
+    void produce(size_t size);
 private:
     char* buffer;
     size_t bufferSize;
@@ -20,8 +20,19 @@
 #ifndef KERNEL_CLOCK_H
 #define KERNEL_CLOCK_H
 
+#include <stdint.h>
 #include <time.h>
 
+// A timer that can raise the timer interrupt at an arbitrary time. If such a
+// timer is available there is no periodic timer interrupt.
+class EventTimer {
+public:
+    // Returns the number of nanoseconds since the timer was initialized.
+    virtual uint64_t getTime() = 0;
+    virtual void setTimeout(uint64_t nanoseconds) = 0;
+    virtual ~EventTimer() {}
+};
+
 class Clock {
 public:
     Clock();
@@ -29,11 +40,15 @@ public:
     int getTime(struct timespec* result);
     int nanosleep(int flags, const struct timespec* requested,
             struct timespec* remaining);
+    uint64_t nanosecondsUntil(struct timespec time);
     int setTime(struct timespec* newValue);
     void tick(unsigned long nanoseconds);
 public:
     static Clock* get(clockid_t clockid);
+    static void onSchedule(bool user);
     static void onTick(bool user, unsigned long nanoseconds);
+    static void setEventTimer(EventTimer* timer);
+    static void setTimeout(uint64_t nanoseconds);
 private:
     struct timespec value;
 };
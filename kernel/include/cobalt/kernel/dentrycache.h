@@ -0,0 +1,43 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/dentrycache.h
+ * Directory entry cache.
+ */
+
+#ifndef KERNEL_DENTRYCACHE_H
+#define KERNEL_DENTRYCACHE_H
+
+#include <sys/types.h>
+
+class Vnode;
+
+// Caches the results of looking up names in directories. Entries are keyed by
+// the device and inode number of the directory. An entry with inode number 0
+// records that the name does not exist. Filesystems that keep all their vnodes
+// in memory can also store a pointer to the vnode. That pointer stays valid
+// because the filesystem removes the entry when the name is unlinked. The
+// directory must be locked while its entries are added or looked up.
+namespace DentryCache {
+void add(dev_t dev, ino_t directory, const char* name, size_t length,
+        ino_t ino, Vnode* vnode = nullptr);
+bool lookup(dev_t dev, ino_t directory, const char* name, size_t length,
+        ino_t* ino, Vnode** vnode = nullptr);
+void remove(dev_t dev, ino_t directory, const char* name, size_t length);
+void removeDevice(dev_t dev);
+void removeDirectory(dev_t dev, ino_t directory);
+}
+
+#endif
@@ -29,6 +29,8 @@ public:
     ~DirectoryVnode();
     Reference<Vnode> getChildNode(const char* name) override;
     Reference<Vnode> getChildNode(const char* path, size_t length) override;
+    void getChildNodes(const char* const* names, size_t count,
+            Reference<Vnode>* results, int* errors) override;
     size_t getDirectoryEntries(void** buffer, int flags) override;
     int link(const char* name, const Reference<Vnode>& vnode) override;
     off_t lseek(off_t offset, int whence) override;
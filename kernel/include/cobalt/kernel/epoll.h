@@ -0,0 +1,58 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/epoll.h
+ * Event polling.
+ */
+
+#ifndef KERNEL_EPOLL_H
+#define KERNEL_EPOLL_H
+
+#include <cobalt/epoll.h>
+#include <cobalt/kernel/pollqueue.h>
+#include <cobalt/kernel/vnode.h>
+
+class EpollItem;
+class FileDescription;
+
+// An epoll instance keeps a list of the watched files that might be ready so
+// that epoll_wait does not need to poll all of them.
+class Epoll : public Vnode {
+public:
+    Epoll();
+    ~Epoll();
+    int ctl(int op, int fd, const Reference<FileDescription>& descr,
+            const struct epoll_event* event);
+    static Epoll* get(const Reference<Vnode>& vnode);
+    PollQueue* getPollQueue() override;
+    short poll() override;
+    int wait(struct epoll_event* events, int maxEvents,
+            const struct timespec* endTime);
+    static void removeDescription(FileDescription* descr);
+private:
+    void addReady(EpollItem* item);
+    int collectEvents(struct epoll_event* events, int maxEvents);
+    void removeReady(EpollItem* item);
+    bool watches(Epoll* epoll, size_t depth);
+private:
+    EpollItem* firstItem;
+    EpollItem* firstReady;
+    EpollItem* lastReady;
+    size_t readyCount;
+    PollQueue pollQueue;
+    friend class EpollItem;
+};
+
+#endif
@@ -23,6 +23,8 @@
 #include <cobalt/kernel/endian.h>
 #include <cobalt/kernel/filesystem.h>
 #include <cobalt/kernel/hashtable.h>
+#include <cobalt/kernel/pagecache.h>
+#include <cobalt/kernel/slab.h>
 
 struct SuperBlock {
     little_uint32_t s_inodes_count;
@@ -201,14 +203,79 @@ struct DirectoryEntry {
     char name[];
 };
 
+// Hashed directories store an index in the first block after the . and ..
+// entries.
+struct DxRootInfo {
+    little_uint32_t reserved_zero;
+    little_uint8_t hash_version;
+    little_uint8_t info_length;
+    little_uint8_t indirect_levels;
+    little_uint8_t unused_flags;
+};
+
+// The hash of the first entry of each index node is replaced by the count and
+// limit of entries in the node.
+struct DxEntry {
+    little_uint32_t hash;
+    little_uint32_t block;
+};
+
+struct DxCountLimit {
+    little_uint16_t limit;
+    little_uint16_t count;
+};
+
+#define DX_HASH_LEGACY 0
+#define DX_HASH_HALF_MD4 1
+#define DX_HASH_TEA 2
+#define DX_HASH_LEGACY_UNSIGNED 3
+#define DX_HASH_HALF_MD4_UNSIGNED 4
+#define DX_HASH_TEA_UNSIGNED 5
+
+#define SUPERBLOCK_UNSIGNED_HASH 0x2
+
+struct ExtentHeader {
+    little_uint16_t eh_magic;
+    little_uint16_t eh_entries;
+    little_uint16_t eh_max;
+    little_uint16_t eh_depth;
+    little_uint32_t eh_generation;
+};
+
+struct ExtentIndex {
+    little_uint32_t ei_block;
+    little_uint32_t ei_leaf_lo;
+    little_uint16_t ei_leaf_hi;
+    little_uint16_t ei_unused;
+};
+
+struct Extent {
+    little_uint32_t ee_block;
+    little_uint16_t ee_len;
+    little_uint16_t ee_start_hi;
+    little_uint32_t ee_start_lo;
+};
+
+#define EXTENT_MAGIC 0xF30A
+#define EXTENT_MAX_DEPTH 5
+// Extents longer than this are uninitialized and read as zeros.
+#define EXTENT_MAX_INIT_LENGTH 32768
+
+#define INODE_INDEX_FL 0x1000
+#define INODE_EXTENTS_FL 0x80000
+
+#define COMPAT_DIR_INDEX 0x20
+
 #define INCOMPAT_FILETYPE 0x2
+#define INCOMPAT_EXTENTS 0x40
 #define INCOMPAT_64BIT 0x80
 
 #define RO_COMPAT_SPARSE_SUPER 0x1
 #define RO_COMPAT_LARGE_FILE 0x2
 #define RO_COMPAT_EXTRA_ISIZE 0x40
 
-#define SUPPORTED_INCOMPAT_FEATURES (INCOMPAT_FILETYPE | INCOMPAT_64BIT)
+#define SUPPORTED_INCOMPAT_FEATURES \
+        (INCOMPAT_FILETYPE | INCOMPAT_EXTENTS | INCOMPAT_64BIT)
 #define SUPPORTED_RO_FEATURES \
         (RO_COMPAT_SPARSE_SUPER | RO_COMPAT_LARGE_FILE | RO_COMPAT_EXTRA_ISIZE)
 
@@ -216,6 +283,16 @@ struct DirectoryEntry {
 
 class Ext234Vnode;
 
+// A run of logical blocks of an inode that are stored in contiguous physical
+// blocks. A physical block number of 0 means that the run is a hole.
+struct BlockRun {
+    uint64_t logical;
+    uint64_t physical;
+    uint64_t length;
+};
+
+struct ExtentPathNode;
+
 class Ext234Fs : public FileSystem {
 public:
     Ext234Fs(const Reference<Vnode>& device, const SuperBlock* superBlock,
@@ -232,36 +309,61 @@ public:
     Reference<Vnode> getRootDir() override;
     Reference<Ext234Vnode> getVnode(ino_t ino);
     Reference<Ext234Vnode> getVnodeIfOpen(ino_t ino);
+    bool hashName(const char* name, size_t length, uint8_t hashVersion,
+            uint32_t* hash);
+    bool hasCompatFeature(uint32_t feature);
     bool hasIncompatFeature(uint32_t feature);
     bool onUnmount() override;
     bool readInodeData(const Inode* inode, off_t offset, void* buffer,
-            size_t size);
-    bool resizeInode(ino_t ino, Inode* inode, off_t newSize);
+            size_t size, BlockRun* run);
+    bool resizeInode(ino_t ino, Inode* inode, off_t newSize, BlockRun* run);
     void setTime(struct timespec* ts, little_uint32_t* time,
             little_uint32_t* extraTime);
     int sync(int flags);
     bool writeInode(const Inode* inode, uint64_t inodeAddress);
-    bool writeInodeData(const Inode* inode, off_t offset, const void* buffer,
-            size_t size);
+    bool writeInodeData(ino_t ino, Inode* inode, off_t offset,
+            const void* buffer, size_t size, BlockRun* run);
 private:
     uint64_t allocateBlock(uint64_t blockGroup);
     uint64_t allocateBlockInGroup(uint64_t blockGroup,
             BlockGroupDescriptor* bg, uint32_t freeBlocks);
+    bool allocateExtentRange(uint64_t blockGroup, Inode* inode,
+            uint64_t block, uint64_t count);
+    uint64_t allocateIndirectBlock(uint64_t blockGroup, Inode* inode);
     ino_t allocateInode(uint64_t blockGroup, bool dir);
+    bool allocateInodeBlocks(ino_t ino, Inode* inode, uint64_t block,
+            uint64_t count);
     ino_t allocateInodeInGroup(uint64_t blockGroup,
             BlockGroupDescriptor* bg, uint32_t freeInodes, bool dir);
+    bool appendExtent(uint64_t blockGroup, Inode* inode, uint64_t logical,
+            uint64_t physical, uint64_t length);
     bool deallocateBlock(uint64_t blockNumber);
+    bool decreaseExtentBlockCount(Inode* inode, uint64_t newBlockCount);
     bool decreaseInodeBlockCount(Inode* inode, uint64_t oldBlockCount,
             uint64_t newBlockCount);
+    void freeExtentPath(ExtentPathNode* path, int levels);
     uint64_t getBlockCount(uint64_t fileSize);
-    uint64_t getInodeBlockAddress(const Inode* inode, uint64_t block);
+    bool getExtentRun(const Inode* inode, uint64_t block, BlockRun* run);
+    bool getIndirectRun(const Inode* inode, uint64_t block, BlockRun* run);
+    bool getInodeBlockRun(const Inode* inode, uint64_t block, BlockRun* run);
+    bool growExtentTree(uint64_t blockGroup, Inode* inode);
     bool hasReadOnlyFeature(uint32_t feature);
+    bool increaseExtentBlockCount(ino_t ino, Inode* inode,
+            uint64_t oldBlockCount, uint64_t newBlockCount);
     bool increaseInodeBlockCount(ino_t ino, Inode* inode,
             uint64_t oldBlockCount, uint64_t newBlockCount);
+    bool insertExtent(uint64_t blockGroup, Inode* inode, uint64_t logical,
+            uint64_t physical, uint64_t length, bool unwritten);
+    int loadExtentPath(Inode* inode, ExtentPathNode* path, uint64_t block);
     bool read(void* buffer, size_t size, off_t offset);
     bool readBlockGroupDesc(uint64_t blockGroup, BlockGroupDescriptor* bg);
     bool readInode(uint64_t ino, Inode* inode, uint64_t& inodeAddress);
+    bool setIndirectBlock(uint64_t blockGroup, Inode* inode, uint64_t block,
+            little_uint32_t blockNumber);
+    bool splitExtentNode(uint64_t blockGroup, Inode* inode,
+            ExtentPathNode* parent, ExtentPathNode* node);
     bool write(const void* buffer, size_t size, off_t offset);
+    bool writeExtentNode(const ExtentPathNode* node);
     bool writeSuperBlock();
 public:
     uint64_t blockSize;
@@ -283,7 +385,7 @@ private:
     kthread_mutex_t vnodesMutex;
 };
 
-class Ext234Vnode : public Vnode {
+class Ext234Vnode : public Vnode, public SlabAllocated<Ext234Vnode> {
 public:
     Ext234Vnode(Ext234Fs* fs, ino_t ino, const Inode* inode,
             uint64_t inodeAddress);
@@ -293,13 +395,17 @@ public:
     int ftruncate(off_t length) override;
     Reference<Vnode> getChildNode(const char* name) override;
     Reference<Vnode> getChildNode(const char* path, size_t length) override;
-    size_t getDirectoryEntries(void** buffer, int flags) override;
+    void getChildNodes(const char* const* names, size_t count,
+            Reference<Vnode>* results, int* errors) override;
     char* getLinkTarget() override;
+    paddr_t getMappedPage(size_t index, bool writable) override;
     ino_t hashKey() { return stats.st_ino; }
     bool isSeekable() override;
     int link(const char* name, const Reference<Vnode>& vnode) override;
     off_t lseek(off_t offset, int whence) override;
     int mkdir(const char* name, mode_t mode) override;
+    vaddr_t mmap(AddressSpace* addressSpace, size_t size, int protection,
+            int flags, off_t offset) override;
     int mount(FileSystem* filesystem) override;
     void onLink() override;
     bool onUnlink(bool force) override;
@@ -309,6 +415,8 @@ public:
     ssize_t pread(void* buffer, size_t size, off_t offset, int flags) override;
     ssize_t pwrite(const void* buffer, size_t size, off_t offset, int flags)
             override;
+    ssize_t readDirectoryEntries(void* buffer, size_t size, off_t* offset,
+            int flags) override;
     ssize_t readlink(char* buffer, size_t size) override;
     void removeReference() const override;
     int rename(const Reference<Vnode>& oldDirectory, const char* oldName,
@@ -326,21 +434,31 @@ private:
             unsigned char dt);
     uint64_t findDirectoryEntry(const char* name, size_t nameLength,
             DirectoryEntry* de);
+    int findIndexedEntry(const char* name, size_t nameLength, char* block,
+            uint64_t* offset);
     Reference<Vnode> getChildNodeUnlocked(const char* path, size_t length);
     bool isAncestor(const Reference<Vnode>& vnode);
     int linkUnlocked(const char* name, size_t nameLength,
             const Reference<Vnode>& vnode);
+    ssize_t matchDirectoryBlock(const char* block, const char* const* names,
+            size_t count, Reference<Vnode>* results, int* errors);
+    bool readPage(size_t index);
+    int searchDirectoryBlock(const char* block, const char* name,
+            size_t nameLength, size_t* offset);
     int unlinkUnlocked(const char* name, int flags);
     bool updateParent(const Reference<Ext234Vnode>& parent);
+    bool writeBackPages();
     void writeTimestamps();
 public:
     Ext234Vnode* nextInHashTable;
 private:
+    BlockRun blockRun;
     Ext234Fs* filesystem;
     Inode inode;
     uint64_t inodeAddress;
     bool inodeModified;
     FileSystem* mounted;
+    PageCache pageCache;
 };
 
 #endif
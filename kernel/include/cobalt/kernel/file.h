@@ -20,21 +20,29 @@
 #ifndef KERNEL_FILE_H
 #define KERNEL_FILE_H
 
+#include <cobalt/kernel/pagecache.h>
 #include <cobalt/kernel/vnode.h>
 
 class FileVnode : public Vnode, public ConstructorMayFail {
 public:
     FileVnode(const void* data, size_t size, mode_t mode, dev_t dev);
-    ~FileVnode();
+    // Uses the frames at the page aligned physicalAddress for the complete
+    // pages of the file instead of copying them. Only the last partial page
+    // is copied from data.
+    FileVnode(const void* data, paddr_t physicalAddress, size_t size,
+            mode_t mode, dev_t dev);
     int ftruncate(off_t length) override;
+    paddr_t getMappedPage(size_t index, bool writable) override;
     bool isSeekable() override;
     off_t lseek(off_t offset, int whence) override;
+    vaddr_t mmap(AddressSpace* addressSpace, size_t size, int protection,
+            int flags, off_t offset) override;
     short poll() override;
     ssize_t pread(void* buffer, size_t size, off_t offset, int flags) override;
     ssize_t pwrite(const void* buffer, size_t size, off_t offset, int flags)
             override;
-public:
-    char* data;
+private:
+    PageCache pageCache;
 };
 
 #endif
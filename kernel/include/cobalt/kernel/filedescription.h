@@ -20,9 +20,13 @@
 #ifndef KERNEL_FILEDESCRIPTION_H
 #define KERNEL_FILEDESCRIPTION_H
 
+#include <cobalt/kernel/slab.h>
 #include <cobalt/kernel/vnode.h>
 
-class FileDescription : public ReferenceCounted {
+class EpollItem;
+
+class FileDescription : public ReferenceCounted,
+        public SlabAllocated<FileDescription> {
 public:
     FileDescription(const Reference<Vnode>& vnode, int flags);
     ~FileDescription();
@@ -33,17 +37,29 @@ public:
     int fcntl(int cmd, int param);
     ssize_t getdents(void* buffer, size_t size, int flags);
     off_t lseek(off_t offset, int whence);
+    vaddr_t mmap(AddressSpace* addressSpace, size_t size, int protection,
+            int flags, off_t offset);
     Reference<FileDescription> openat(const char* path, int flags,
             mode_t mode);
     ssize_t read(void* buffer, size_t size);
+    ssize_t splice(const Reference<FileDescription>& out, off_t* inOffset,
+            off_t* outOffset, size_t size, int flags);
     int tcgetattr(struct termios* result);
     int tcsetattr(int flags, const struct termios* termio);
+    ssize_t tee(const Reference<FileDescription>& out, size_t size,
+            int flags);
     ssize_t write(const void* buffer, size_t size);
+private:
+    ssize_t copy(const Reference<FileDescription>& out, off_t* inOffset,
+            off_t* outOffset, size_t size, int flags);
+    void seekDents();
 public:
     Reference<Vnode> vnode;
+    EpollItem* epollItems;
 private:
     kthread_mutex_t mutex;
     void* dents;
+    size_t dentsPosition;
     size_t dentsSize;
     off_t offset;
     int fileFlags;
@@ -0,0 +1,37 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/futex.h
+ * Futexes.
+ */
+
+#ifndef KERNEL_FUTEX_H
+#define KERNEL_FUTEX_H
+
+#include <time.h>
+#include <cobalt/kernel/kernel.h>
+
+// Threads wait on a user address until another thread of the same process
+// wakes them.
+namespace Futex {
+// Sleeps if *address equals value. Returns 0 when woken up, or EAGAIN,
+// ETIMEDOUT or EINTR.
+int wait(const int* address, int value, const struct timespec* endTime);
+// Wakes up to count threads that are waiting on the address. Returns the
+// number of threads woken up.
+int wake(const int* address, int count);
+}
+
+#endif
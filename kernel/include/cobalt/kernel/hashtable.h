@@ -42,6 +42,10 @@ public:
         table[hash] = object;
     }
 
+    size_t getCapacity() {
+        return capacity;
+    }
+
     T* get(TKey key) {
         size_t hash = key % capacity;
 
@@ -73,6 +77,27 @@ public:
             obj = next;
         }
     }
+
+    // Moves all objects into a new buffer and returns the old buffer, which
+    // can then be freed by the caller.
+    T** resize(size_t newCapacity, T* buffer[]) {
+        memset(buffer, 0, newCapacity * sizeof(T*));
+        for (size_t i = 0; i < capacity; i++) {
+            T* obj = table[i];
+            while (obj) {
+                T* next = obj->nextInHashTable;
+                size_t hash = obj->hashKey() % newCapacity;
+                obj->nextInHashTable = buffer[hash];
+                buffer[hash] = obj;
+                obj = next;
+            }
+        }
+
+        T** oldTable = table;
+        table = buffer;
+        capacity = newCapacity;
+        return oldTable;
+    }
 private:
     T** table;
     size_t capacity;
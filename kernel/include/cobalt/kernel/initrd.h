@@ -24,7 +24,11 @@
 #include <cobalt/kernel/kernel.h>
 
 namespace Initrd {
-Reference<DirectoryVnode> loadInitrd(vaddr_t initrd);
+// Loads the tar archive that is mapped at initrd and located at the physical
+// addresses from start to end. The frames of the archive are either used by
+// the loaded files or freed.
+Reference<DirectoryVnode> loadInitrd(vaddr_t initrd, paddr_t start,
+        paddr_t end);
 }
 
 #endif
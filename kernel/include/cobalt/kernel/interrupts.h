@@ -92,11 +92,14 @@ extern int timerIrq;
 
 void addIrqHandler(int irq, IrqHandler* handler);
 int allocateIrq();
+bool areEnabled();
 void disable();
 void enable();
+void enableApic();
 void initApic();
 void initIoApic(paddr_t baseAddress, int interruptBase);
 void initPic();
+void sendIpi(uint8_t destination, uint32_t command);
 }
 
 #endif
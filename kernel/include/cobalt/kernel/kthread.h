@@ -22,21 +22,29 @@
 
 #include <cobalt/kernel/clock.h>
 
-typedef bool kthread_mutex_t;
-#define KTHREAD_MUTEX_INITIALIZER false
+class Thread;
 
-struct kthread_cond_waiter {
-    kthread_cond_waiter* prev;
-    kthread_cond_waiter* next;
+struct kthread_waiter {
+    kthread_waiter* prev;
+    kthread_waiter* next;
+    Thread* thread;
     bool blocked;
 };
 
+// The waiter lists of mutexes and condition variables are protected by
+// disabling interrupts.
 typedef struct {
-    kthread_mutex_t mutex;
-    kthread_cond_waiter* first;
-    kthread_cond_waiter* last;
+    bool locked;
+    kthread_waiter* first;
+    kthread_waiter* last;
+} kthread_mutex_t;
+#define KTHREAD_MUTEX_INITIALIZER { false, nullptr, nullptr }
+
+typedef struct {
+    kthread_waiter* first;
+    kthread_waiter* last;
 } kthread_cond_t;
-#define KTHREAD_COND_INITIALIZER { KTHREAD_MUTEX_INITIALIZER, nullptr, nullptr }
+#define KTHREAD_COND_INITIALIZER { nullptr, nullptr }
 
 int kthread_cond_broadcast(kthread_cond_t* cond);
 int kthread_cond_sigclockwait(kthread_cond_t* cond, kthread_mutex_t* mutex,
@@ -23,6 +23,8 @@
 #include <cobalt/kernel/kernel.h>
 
 #define SEG_NOUNMAP (1 << 16)
+#define SEG_SHARED (1 << 18)
+#define SEG_FILE (1 << 19)
 
 class MemorySegment {
 public:
@@ -49,6 +51,7 @@ private:
             int flags);
     static MemorySegment* findFreeSegment(MemorySegment* firstSegment,
             size_t size);
+    static void freeSegment(MemorySegment* segment);
     static bool verifySegmentList();
 };
 
@@ -21,6 +21,7 @@
 #define KERNEL_MOUSE_H
 
 #include <cobalt/mouse.h>
+#include <cobalt/kernel/pollqueue.h>
 #include <cobalt/kernel/vnode.h>
 
 class AbsoluteMouseDriver {
@@ -36,6 +37,7 @@ public:
     void addPacket(mouse_data data);
     int devctl(int command, void* restrict data, size_t size,
             int* restrict info) override;
+    PollQueue* getPollQueue() override;
     short poll() override;
     ssize_t read(void* buffer, size_t size, int flags) override;
 private:
@@ -43,6 +45,7 @@ private:
     size_t readIndex;
     size_t available;
     kthread_cond_t readCond;
+    PollQueue pollQueue;
 };
 
 extern Reference<MouseDevice> mouseDevice;
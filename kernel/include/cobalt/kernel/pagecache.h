@@ -0,0 +1,59 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/pagecache.h
+ * Page cache.
+ */
+
+#ifndef KERNEL_PAGECACHE_H
+#define KERNEL_PAGECACHE_H
+
+#include <sys/types.h>
+#include <cobalt/kernel/kernel.h>
+
+// The pages of a file. The frames of the cache are mapped directly into
+// address spaces by mmap. The cache does not do any locking, the owner must
+// serialize all accesses.
+class PageCache {
+public:
+    PageCache();
+    ~PageCache();
+    // Makes an existing frame the page at index. The cache takes over the
+    // reference to the frame.
+    bool adoptPage(size_t index, paddr_t physicalAddress);
+    void dropPage(size_t index);
+    paddr_t getPage(size_t index);
+    vaddr_t mapPage(size_t index);
+    bool needsWriteback(size_t index);
+    bool read(size_t index, size_t offset, void* buffer, size_t size);
+    // Adds an unreserved reference to the frame of a page for a memory
+    // mapping and returns the frame. Writable is set for shared writable
+    // mappings.
+    paddr_t referencePage(size_t index, bool writable);
+    void setClean(size_t index);
+    void setMappedWritable(size_t index);
+    void truncate(off_t size);
+    void unmapPage(vaddr_t address);
+    bool write(size_t index, size_t offset, const void* buffer, size_t size,
+            bool allocate);
+public:
+    size_t pageCount;
+private:
+    bool grow(size_t index);
+private:
+    paddr_t* pages;
+};
+
+#endif
@@ -22,14 +22,36 @@
 
 #include <cobalt/kernel/multiboot2.h>
 
+// The largest block that allocateContiguous can allocate is 4 MiB.
+#define MAX_CONTIGUOUS_ORDER 10
+
 namespace PhysicalMemory {
+// Adds a reference to a frame that is already in use. Unless reserved is false
+// the caller must have reserved a frame for the new reference. pushPageFrame
+// drops a reference and only frees the frame once the last reference is gone.
+bool addFrameReference(paddr_t physicalAddress, bool reserved = true);
+// Allocates 2^order physically contiguous frames that are aligned to their
+// size and lie below maxAddress.
+paddr_t allocateContiguous(size_t order, paddr_t maxAddress = UINTPTR_MAX);
+void freeContiguous(paddr_t physicalAddress, size_t order);
 void initialize(const multiboot_info* multiboot);
+bool isFrameShared(paddr_t physicalAddress);
 paddr_t popPageFrame();
 paddr_t popPageFrame32();
 paddr_t popReserved();
+// Allocates 2^order contiguous frames that are aligned to their size from the
+// reserved frames. Returns 0 without using up the reservations if there is no
+// such block.
+paddr_t popReservedContiguous(size_t order);
 void pushPageFrame(paddr_t physicalAddress);
+// Turns an unreserved reference into a reserved one using a frame that the
+// caller has reserved.
+void reserveFrameReference(paddr_t physicalAddress);
 bool reserveFrames(size_t frames);
 void unreserveFrames(size_t frames);
+// Drops a reference to a shared frame and returns a new frame in its place.
+// Returns 0 if the frame is not shared.
+paddr_t unshareFrame(paddr_t physicalAddress);
 }
 
 #endif
@@ -21,6 +21,7 @@
 #define KERNEL_PIPE_H
 
 #include <cobalt/kernel/circularbuffer.h>
+#include <cobalt/kernel/pollqueue.h>
 #include <cobalt/kernel/vnode.h>
 
 class PipeVnode : public Vnode, public ConstructorMayFail {
@@ -33,10 +34,17 @@ private:
     class WriteEnd;
 public:
     PipeVnode(Reference<Vnode>& readPipe, Reference<Vnode>& writePipe);
+    ssize_t peek(void* buffer, size_t size, int flags) override;
     short poll() override;
     ssize_t read(void* buffer, size_t size, int flags) override;
+    ssize_t spliceFromFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
+    ssize_t spliceToFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
     ssize_t write(const void* buffer, size_t size, int flags) override;
     virtual ~PipeVnode();
+private:
+    int waitForData(int flags);
 private:
     Vnode* readEnd;
     Vnode* writeEnd;
@@ -44,6 +52,7 @@ private:
     CircularBuffer circularBuffer;
     kthread_cond_t readCond;
     kthread_cond_t writeCond;
+    PollQueue pollQueue;
 };
 
 #endif
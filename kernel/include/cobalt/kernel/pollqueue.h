@@ -0,0 +1,73 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/pollqueue.h
+ * Poll wait queues.
+ */
+
+#ifndef KERNEL_POLLQUEUE_H
+#define KERNEL_POLLQUEUE_H
+
+#include <cobalt/kernel/kernel.h>
+
+class PollQueue;
+class Thread;
+
+// A registration in a poll queue. onEvent is called with interrupts disabled,
+// so it must not block.
+class PollEntry {
+public:
+    virtual ~PollEntry() = default;
+    virtual void onEvent() = 0;
+private:
+    PollQueue* queue;
+    PollEntry* prev;
+    PollEntry* next;
+    friend class PollQueue;
+};
+
+// Vnodes notify their poll queue whenever the result of poll() might have
+// changed. The queue is protected by disabling interrupts.
+class PollQueue {
+public:
+    PollQueue();
+    ~PollQueue();
+    void add(PollEntry* entry);
+    void notify();
+    static void remove(PollEntry* entry);
+private:
+    PollEntry* first;
+    PollEntry* last;
+};
+
+// A thread that sleeps until any of the queues it is registered in is
+// notified.
+class PollWaiter {
+public:
+    class Entry : public PollEntry {
+    public:
+        void onEvent() override;
+    public:
+        PollWaiter* waiter;
+    };
+public:
+    PollWaiter();
+    int wait(const struct timespec* endTime);
+private:
+    Thread* thread;
+    bool notified;
+};
+
+#endif
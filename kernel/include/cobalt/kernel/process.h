@@ -23,6 +23,7 @@
 #include <sys/types.h>
 #include <cobalt/exit.h>
 #include <cobalt/fork.h>
+#include <cobalt/wait.h>
 #include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/dynarray.h>
 #include <cobalt/kernel/filedescription.h>
@@ -51,18 +52,20 @@ public:
             char* const envp[]);
     int fcntl(int fd, int cmd, int param);
     Reference<FileDescription> getFd(int fd);
+    int getGroupPriority();
     pid_t getParentPid();
     bool isParentOf(Process* process);
     Thread* newThread(int flags, regfork_t* registers, bool start = true);
     void raiseSignal(siginfo_t siginfo);
     void raiseSignalForGroup(siginfo_t siginfo);
     Process* regfork(int flags, regfork_t* registers);
+    void setGroupPriority(int value);
     int setpgid(pid_t pgid);
     pid_t setsid();
     void terminate();
     void terminateBySignal(siginfo_t siginfo);
     mode_t umask(const mode_t* newMask = nullptr);
-    Process* waitpid(pid_t pid, int flags);
+    int waitid(idtype_t idtype, id_t id, siginfo_t* info, int flags);
 private:
     void removeFromGroup();
 public:
@@ -89,8 +92,15 @@ public:
     struct sigaction sigactions[NSIG];
 
     bool ownsDisplay;
+
+    // The scheduler reads these without locking.
+    int nice;
+    int schedulingPolicy;
+    int schedulingPriority;
 private:
     struct timespec alarmTime;
+    Process* nextAlarm;
+    Process* prevAlarm;
     DynamicArray<FdTableEntry, int> fdTable;
     vaddr_t sigreturn;
     bool terminated;
@@ -102,6 +112,11 @@ private:
     Process* prevChild;
     Process* nextChild;
 
+    // Children change their terminated state while holding the
+    // childWaitMutex of their parent, waiting parents sleep on childWaitCond.
+    kthread_mutex_t childWaitMutex;
+    kthread_cond_t childWaitCond;
+
     kthread_mutex_t fileMaskMutex;
     mode_t fileMask;
 
@@ -113,9 +128,12 @@ private:
     Process* parent;
 public:
     static bool addProcess(Process* process);
+    static uint64_t checkAlarms();
     static Process* current() { return Thread::current()->process; }
     static Process* get(pid_t pid);
     static Process* getGroup(pid_t pgid);
+    static int getUserPriority(uid_t uid, int* priority);
+    static int setUserPriority(uid_t uid, int value);
     static Process* initProcess;
 private:
     static int copyArguments(char* const argv[], char* const envp[],
@@ -123,6 +141,7 @@ private:
     static uintptr_t loadELF(const Reference<Vnode>& vnode,
             AddressSpace* newAddressSpace, vaddr_t& tlsbase,
             vaddr_t& userStack);
+    static void raiseAlarms(void*);
 };
 
 #endif
@@ -0,0 +1,76 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/kernel/slab.h
+ * Object caches.
+ */
+
+#ifndef KERNEL_SLAB_H
+#define KERNEL_SLAB_H
+
+#include <assert.h>
+#include <cobalt/kernel/kthread.h>
+
+// An object cache hands out objects of a single size from page sized slabs.
+// Freed objects stay in their slab and are reused by later allocations
+// without going through the general heap.
+class ObjectCache {
+public:
+    constexpr ObjectCache(size_t size, size_t alignment)
+            : objectSize(ALIGNUP(size < sizeof(void*) ? sizeof(void*) : size,
+            alignment)), alignment(alignment) {}
+    void* allocate();
+    void free(void* object);
+private:
+    struct Slab;
+    Slab* allocateSlab();
+    void insertSlab(Slab* slab);
+    void removeSlab(Slab* slab);
+private:
+    size_t objectSize;
+    size_t alignment;
+    size_t nextColor = 0;
+    Slab* partialSlabs = nullptr;
+    kthread_mutex_t mutex = KTHREAD_MUTEX_INITIALIZER;
+public:
+    static size_t allocatedBytes;
+    static size_t slabBytes;
+};
+
+// Classes that inherit from SlabAllocated are allocated from an object cache
+// of their own. The new macro from kernel.h must not expand in the operator
+// declarations.
+#pragma push_macro("new")
+#undef new
+template <typename T>
+class SlabAllocated {
+public:
+    static void* operator new(size_t size) {
+        assert(size == sizeof(T));
+        return objectCache.allocate();
+    }
+
+    static void operator delete(void* object) {
+        objectCache.free(object);
+    }
+private:
+    static ObjectCache objectCache;
+};
+#pragma pop_macro("new")
+
+template <typename T>
+ObjectCache SlabAllocated<T>::objectCache(sizeof(T), alignof(T));
+
+#endif
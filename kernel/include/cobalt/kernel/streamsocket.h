@@ -22,6 +22,7 @@
 
 #include <cobalt/un.h>
 #include <cobalt/kernel/circularbuffer.h>
+#include <cobalt/kernel/pollqueue.h>
 #include <cobalt/kernel/socket.h>
 
 class StreamSocket : public Socket, public ConstructorMayFail {
@@ -40,16 +41,25 @@ public:
             override;
     int connect(const struct sockaddr* address, socklen_t length, int flags)
             override;
+    PollQueue* getPollQueue() override;
     int listen(int backlog) override;
     short poll() override;
     ssize_t read(void* buffer, size_t size, int flags) override;
+    ssize_t spliceFromFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
+    ssize_t spliceToFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
     ssize_t write(const void* buffer, size_t size, int flags) override;
 private:
     bool addConnection(const Reference<StreamSocket>& socket);
+    int waitForConnection(int flags);
+    int waitForData(int flags);
+    bool waitForSpace(int flags);
 private:
     kthread_mutex_t socketMutex;
     kthread_cond_t acceptCond;
     kthread_cond_t connectCond;
+    PollQueue pollQueue;
     struct sockaddr_un boundAddress;
     bool isConnected;
     bool isConnecting;
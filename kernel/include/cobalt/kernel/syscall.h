@@ -26,13 +26,18 @@
 #include <cobalt/exit.h>
 #include <cobalt/fork.h>
 #include <cobalt/poll.h>
+#include <cobalt/statmany.h>
 #include <cobalt/syscall.h>
 #include <cobalt/timespec.h>
+#include <cobalt/wait.h>
 #include <cobalt/kernel/kernel.h>
 
+struct epoll_event;
 struct fchownatParams;
 struct meminfo;
 struct __mmapRequest;
+struct sched_param;
+struct spliceParams;
 struct stat;
 
 namespace Syscall {
@@ -50,6 +55,10 @@ int connect(int fd, const struct sockaddr* address, socklen_t length);
 int devctl(int fd, int command, void* restrict data, size_t size,
         int* restrict info);
 int dup3(int fd1, int fd2, int flags);
+int epoll_create1(int flags);
+int epoll_ctl(int fd, int op, int targetFd, const struct epoll_event* event);
+int epoll_pwait(int fd, struct epoll_event* events, int maxEvents,
+        const struct timespec* timeout, const sigset_t* sigmask);
 int execve(const char* path, char* const argv[], char* const envp[]);
 NORETURN void exit_thread(const struct exit_thread* data);
 int fchdir(int);
@@ -64,14 +73,19 @@ int fssync(int fd, int flags);
 int fstat(int fd, struct stat* result);
 int fstatat(int fd, const char* restrict path, struct stat* restrict result,
         int flags);
+int fstatat_many(int fd, struct fstatat_entry* entries, size_t count,
+        unsigned int mask, int flags);
 int ftruncate(int fd, off_t length);
+int futex(int* address, int op, int value, const struct timespec* timeout);
 int futimens(int fd, const struct timespec ts[2]);
 ssize_t getdents(int fd, void* buffer, size_t size, int flags);
 int getentropy(void* buffer, size_t size);
 pid_t getpid();
 pid_t getppid();
 pid_t getpgid(pid_t pid);
+int getpriority(int which, id_t who, int* priority);
 int getrusagens(int who, struct rusagens* usage);
+int getscheduler(pid_t pid, struct sched_param* param);
 int isatty(int fd);
 int kill(pid_t pid, int signal);
 int linkat(int oldFd, const char* oldPath, int newFd, const char* newPath,
@@ -79,6 +93,7 @@ int linkat(int oldFd, const char* oldPath, int newFd, const char* newPath,
 int listen(int fd, int backlog);
 off_t lseek(int fd, off_t offset, int whence);
 void meminfo(struct meminfo*);
+void meminfo2(struct meminfo*, size_t size);
 int mkdirat(int fd, const char* path, mode_t mode);
 void* mmap(__mmapRequest* request);
 int mount(const char* filename, const char* mountPath, const char* filesystem,
@@ -93,7 +108,10 @@ ssize_t readlinkat(int fd, const char* restrict path, char* restrict buffer,
         size_t size);
 int renameat(int oldFd, const char* oldPath, int newFd, const char* newPath);
 pid_t regfork(int flags, regfork_t* registers);
+ssize_t sendfile(int outFd, int inFd, off_t* offset, size_t count);
 int setpgid(pid_t pid, pid_t pgid);
+int setpriority(int which, id_t who, int value);
+int setscheduler(pid_t pid, int policy, const struct sched_param* param);
 pid_t setsid();
 int sigaction(int signal, const struct sigaction* restrict action,
         struct sigaction* restrict old);
@@ -101,13 +119,16 @@ int sigprocmask(int how, const sigset_t* restrict set, sigset_t* restrict old);
 int sigtimedwait(const sigset_t* set, siginfo_t* info,
         const struct timespec* timeout);
 int socket(int domain, int type, int protocol);
+ssize_t splice(const struct spliceParams* params);
 int symlinkat(const char* targetPath, int fd, const char* linkPath);
 int tcgetattr(int fd, struct termios* result);
 int tcsetattr(int fd, int flags, const struct termios* termio);
+ssize_t tee(int fdIn, int fdOut, size_t size, unsigned int flags);
 mode_t umask(mode_t newMask);
 int unlinkat(int fd, const char* path, int flags);
 int unmount(const char* mountPath);
 int utimensat(int fd, const char* path, const struct timespec ts[2], int flags);
+int waitid(idtype_t idtype, id_t id, siginfo_t* info, int flags);
 pid_t waitpid(pid_t pid, int* status, int flags);
 ssize_t write(int fd, const void* buffer, size_t size);
 
@@ -23,6 +23,7 @@
 #include <cobalt/termios.h>
 #include <cobalt/winsize.h>
 #include <cobalt/kernel/keyboard.h>
+#include <cobalt/kernel/pollqueue.h>
 #include <cobalt/kernel/vnode.h>
 
 #define TERMINAL_BUFFER_SIZE 4096
@@ -33,6 +34,7 @@ public:
     int devctl(int command, void* restrict data, size_t size,
             int* restrict info) override;
     void exitSession();
+    PollQueue* getPollQueue() override;
     void hangup();
     int isatty() override;
     short poll() override;
@@ -58,6 +60,7 @@ private:
 protected:
     struct termios termio;
     bool hungup;
+    PollQueue pollQueue;
     pid_t sid;
 private:
     pid_t foregroundGroup;
@@ -25,19 +25,22 @@
 #include <cobalt/kernel/interrupts.h>
 #include <cobalt/kernel/kernel.h>
 #include <cobalt/kernel/kthread.h>
+#include <cobalt/kernel/slab.h>
 
 class Process;
 
-struct PendingSignal {
+struct PendingSignal : public SlabAllocated<PendingSignal> {
     siginfo_t siginfo;
     PendingSignal* next;
 };
 
-class Thread {
+class Thread : public SlabAllocated<Thread> {
 public:
     Thread(Process* process);
     ~Thread();
+    void addRuntime(unsigned long nanoseconds);
     InterruptContext* handleSignal(InterruptContext* context);
+    void interrupt();
     void raiseSignal(siginfo_t siginfo);
     int sigtimedwait(const sigset_t* set, siginfo_t* info,
             const struct timespec* timeout);
@@ -45,8 +48,8 @@ public:
     void updateContext(vaddr_t newKernelStack, InterruptContext* newContext,
             const __fpu_t* newFpuEnv);
     void updatePendingSignals();
+    void wakeUp();
 private:
-    void checkSigalarm(bool scheduling);
     void raiseSignalUnlocked(siginfo_t siginfo);
 public:
     Clock cpuClock;
@@ -54,26 +57,36 @@ public:
     __fpu_t fpuEnv;
     Process* process;
     sigset_t returnSignalMask;
+    uint64_t runtime;
     sigset_t signalMask;
     pid_t tid;
     uintptr_t tlsBase;
 private:
+    bool blocked;
     bool contextChanged;
     int errorNumber;
+    bool interruptible;
     InterruptContext* interruptContext;
     vaddr_t kernelStack;
     Thread* next;
+    Thread* nextTimed;
     PendingSignal* pendingSignals;
     Thread* prev;
+    Thread* prevTimed;
     kthread_mutex_t signalMutex;
     kthread_cond_t signalCond;
+    unsigned long timeSlice;
+    Clock* wakeupClock;
+    struct timespec wakeupTime;
 public:
     static void addThread(Thread* thread);
+    static void block(bool interruptible, Clock* clock,
+            const struct timespec* endTime);
     static Thread* current() { return _current; }
     static Thread* idleThread;
     static void initializeIdleThread();
     static void removeThread(Thread* thread);
-    static InterruptContext* schedule(InterruptContext* context);
+    static InterruptContext* schedule(InterruptContext* context, bool yield);
 private:
     static Thread* _current;
 };
@@ -26,7 +26,9 @@
 #include <cobalt/kernel/kthread.h>
 #include <cobalt/kernel/refcount.h>
 
+class AddressSpace;
 class FileSystem;
+class PollQueue;
 
 class Vnode : public ReferenceCounted {
 public:
@@ -43,30 +45,59 @@ public:
     virtual int ftruncate(off_t length);
     virtual Reference<Vnode> getChildNode(const char* path);
     virtual Reference<Vnode> getChildNode(const char* path, size_t length);
+    // Looks up several names in the directory. For each name either the vnode
+    // or an errno value is stored.
+    virtual void getChildNodes(const char* const* names, size_t count,
+            Reference<Vnode>* results, int* errors);
+    // Returns a snapshot of all entries of the directory. This is used for
+    // vnodes that do not implement readDirectoryEntries.
     virtual size_t getDirectoryEntries(void** buffer, int flags);
     virtual char* getLinkTarget();
+    // Returns the frame of a page of the file for a memory mapping that is
+    // accessed for the first time. The caller receives an unreserved reference
+    // to the frame. Writable is set for shared writable mappings.
+    virtual paddr_t getMappedPage(size_t index, bool writable);
+    // Returns the queue that is notified when the result of poll() changes.
+    // Vnodes without a queue always return the same poll result.
+    virtual PollQueue* getPollQueue();
     virtual int isatty();
     virtual bool isSeekable();
     virtual int link(const char* name, const Reference<Vnode>& vnode);
     virtual int listen(int backlog);
     virtual off_t lseek(off_t offset, int whence);
     virtual int mkdir(const char* name, mode_t mode);
+    virtual vaddr_t mmap(AddressSpace* addressSpace, size_t size,
+            int protection, int flags, off_t offset);
     virtual int mount(FileSystem* filesystem);
     virtual void onLink();
     virtual bool onUnlink(bool force);
     virtual Reference<Vnode> open(const char* name, int flags, mode_t mode);
     virtual long pathconf(int name);
+    virtual ssize_t peek(void* buffer, size_t size, int flags);
     virtual short poll();
     virtual ssize_t pread(void* buffer, size_t size, off_t offset, int flags);
     virtual ssize_t pwrite(const void* buffer, size_t size, off_t offset,
                 int flags);
     virtual ssize_t read(void* buffer, size_t size, int flags);
+    // Reads the directory entries starting at the given offset and advances
+    // the offset past the entries returned. Fails with ENOTSUP if the offset
+    // cannot be resumed from.
+    virtual ssize_t readDirectoryEntries(void* buffer, size_t size,
+            off_t* offset, int flags);
     virtual ssize_t readlink(char* buffer, size_t size);
     virtual int rename(const Reference<Vnode>& oldDirectory,
             const char* oldName, const char* newName);
     virtual Reference<Vnode> resolve();
+    // Moves data between this vnode and a seekable file without copying it
+    // through an intermediate buffer.
+    virtual ssize_t spliceFromFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags);
+    virtual ssize_t spliceToFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags);
     virtual int stat(struct stat* result);
     struct stat stat();
+    // Fills in only the fields selected by a mask of STAT_* flags.
+    virtual int statFields(struct stat* result, unsigned int mask);
     virtual int symlink(const char* linkTarget, const char* name);
     virtual int sync(int flags);
     virtual int tcgetattr(struct termios* result);
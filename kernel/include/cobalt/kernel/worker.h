@@ -20,15 +20,19 @@
 #ifndef KERNEL_WORKER_H
 #define KERNEL_WORKER_H
 
+#include <time.h>
 #include <cobalt/kernel/kernel.h>
 
 struct WorkerJob {
     void (*func)(void*);
     void* context;
     struct WorkerJob* next;
+    // The CLOCK_MONOTONIC time at which a delayed job is run.
+    struct timespec time;
 };
 
 namespace WorkerThread {
+void addDelayedJob(WorkerJob* job, struct timespec time);
 void addJob(WorkerJob* job);
 void initialize();
 }
@@ -23,6 +23,7 @@
 #define FILESIZEBITS 64
 #define _GETENTROPY_MAX 256
 #define _NSIG_MAX 65
+#define NZERO 20
 #define PAGESIZE 0x1000
 #define PAGE_SIZE PAGESIZE
 #define PIPE_BUF 4096
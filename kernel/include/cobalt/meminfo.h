@@ -20,11 +20,15 @@
 #ifndef _COBALT_MEMINFO_H
 #define _COBALT_MEMINFO_H
 
+/* Fields are only ever appended to this struct. Programs built before a field
+   was added pass a smaller size and do not receive it. */
 struct meminfo {
     __SIZE_TYPE__ mem_total;
     __SIZE_TYPE__ mem_free;
     __SIZE_TYPE__ mem_available;
-    __SIZE_TYPE__ __reserved;
+    __SIZE_TYPE__ mem_committed;
+    __SIZE_TYPE__ mem_slab;
+    __SIZE_TYPE__ mem_slab_allocated;
 };
 
 #endif
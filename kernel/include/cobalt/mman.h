@@ -29,6 +29,7 @@
 
 #define MAP_PRIVATE (1 << 0)
 #define MAP_ANONYMOUS (1 << 1)
+#define MAP_SHARED (1 << 2)
 
 #define MAP_FAILED ((void*) 0)
 
@@ -23,4 +23,8 @@
 #define RUSAGE_SELF 0
 #define RUSAGE_CHILDREN 1
 
+#define PRIO_PROCESS 0
+#define PRIO_PGRP 1
+#define PRIO_USER 2
+
 #endif
@@ -0,0 +1,41 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/include/cobalt/statmany.h
+ * Information about multiple files.
+ */
+
+#ifndef _COBALT_STATMANY_H
+#define _COBALT_STATMANY_H
+
+#include <cobalt/stat.h>
+
+/* Fields filled in by fstatat_many. Other fields are left unchanged. */
+#define STAT_MODE (1 << 0)
+#define STAT_INO (1 << 1) /* st_dev and st_ino */
+#define STAT_NLINK (1 << 2)
+#define STAT_OWNER (1 << 3) /* st_uid and st_gid */
+#define STAT_RDEV (1 << 4)
+#define STAT_SIZE (1 << 5) /* st_size, st_blksize and st_blocks */
+#define STAT_TIMES (1 << 6)
+#define STAT_ALL 0x7F
+
+struct fstatat_entry {
+    const char* name;
+    int error;
+    struct stat stat;
+};
+
+#endif
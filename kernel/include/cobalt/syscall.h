@@ -84,7 +84,21 @@
 #define SYSCALL_FCHOWN 61
 #define SYSCALL_SETSID 62
 #define SYSCALL_GETPPID 63
+#define SYSCALL_GETPRIORITY 64
+#define SYSCALL_SETPRIORITY 65
+#define SYSCALL_GETSCHEDULER 66
+#define SYSCALL_SETSCHEDULER 67
+#define SYSCALL_EPOLL_CREATE1 68
+#define SYSCALL_EPOLL_CTL 69
+#define SYSCALL_EPOLL_PWAIT 70
+#define SYSCALL_SENDFILE 71
+#define SYSCALL_SPLICE 72
+#define SYSCALL_TEE 73
+#define SYSCALL_FUTEX 74
+#define SYSCALL_WAITID 75
+#define SYSCALL_FSTATAT_MANY 76
+#define SYSCALL_MEMINFO2 77
 
-#define NUM_SYSCALLS 64
+#define NUM_SYSCALLS 78
 
 #endif
@@ -22,14 +22,29 @@
 
 #define WNOHANG (1 << 0)
 #define WUNTRACED (1 << 1)
+#define WCONTINUED (1 << 2)
+#define WEXITED (1 << 3)
+#define WNOWAIT (1 << 4)
+#define WSTOPPED WUNTRACED
+
+typedef enum {
+    P_ALL,
+    P_PID,
+    P_PGID
+} idtype_t;
 
 #define _WEXITED 0
 #define _WSIGNALED 1
+#define _WSTOPPED 2
+#define _WCONTINUED 3
 #define _WSTATUS(reason, si_status) ((reason) << 24 | ((si_status) & 0xFF))
 
 #define WEXITSTATUS(status) ((status) & 0xFF)
 #define WIFEXITED(status) (((status) >> 24 & 0xFF) == _WEXITED)
 #define WIFSIGNALED(status) (((status) >> 24 & 0xFF) == _WSIGNALED)
 #define WTERMSIG(status) ((status) & 0xFF)
+#define WIFSTOPPED(status) (((status) >> 24 & 0xFF) == _WSTOPPED)
+#define WSTOPSIG(status) ((status) & 0xFF)
+#define WIFCONTINUED(status) (((status) >> 24 & 0xFF) == _WCONTINUED)
 
 #endif
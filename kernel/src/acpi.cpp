@@ -25,6 +25,7 @@
 #include <cobalt/kernel/log.h>
 #include <cobalt/kernel/multiboot2.h>
 #include <cobalt/kernel/panic.h>
+#include <cobalt/kernel/smp.h>
 
 struct Rsdp {
     char signature[8];
@@ -63,6 +64,15 @@ struct MadtEntryHeader {
     uint8_t length;
 } PACKED;
 
+struct MadtLocalApic {
+    MadtEntryHeader header;
+    uint8_t processorId;
+    uint8_t apicId;
+    uint32_t flags;
+} PACKED;
+
+#define MADT_LOCAL_APIC_ENABLED (1 << 0)
+
 struct MadtIoApic {
     MadtEntryHeader header;
     uint8_t ioApicId;
@@ -219,6 +229,13 @@ static void scanMadt(paddr_t address, size_t length) {
     while (p < (uintptr_t) madt + madt->header.length) {
         const MadtEntryHeader* header = (const MadtEntryHeader*) p;
 
+        if (header->type == 0) {
+            const MadtLocalApic* entry = (const MadtLocalApic*) header;
+            if (entry->flags & MADT_LOCAL_APIC_ENABLED) {
+                Smp::addProcessor(entry->apicId);
+            }
+        }
+
         if (header->type == 1) {
             const MadtIoApic* entry = (const MadtIoApic*) header;
             Interrupts::initIoApic(entry->ioApicAddress,
@@ -17,9 +17,12 @@
  * Address space class.
  */
 
+#include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/physicalmemory.h>
+#include <cobalt/kernel/vnode.h>
 
 #define PAGE_PRESENT (1 << 0)
 #define PAGE_WRITABLE (1 << 1)
@@ -36,44 +39,297 @@ bool AddressSpace::isActive() {
 
 static kthread_mutex_t forkMutex = KTHREAD_MUTEX_INITIALIZER;
 
+// Anonymous memory reserves a frame for every page. File mappings only need
+// reserved frames for copy-on-write, so only private writable ones have them.
+static bool hasReservedFrames(int flags) {
+    return !(flags & SEG_FILE) ||
+            (!(flags & SEG_SHARED) && flags & PROT_WRITE);
+}
+
 AddressSpace* AddressSpace::fork() {
     AutoLock lock(&forkMutex);
 
     AddressSpace* result = new AddressSpace();
     if (!result) return nullptr;
+
+    AutoLock lock2(&mutex);
+
     MemorySegment* segment = firstSegment->next;
     while (segment) {
         if (!(segment->flags & SEG_NOUNMAP)) {
-            // Copy the segment
-            size_t size = segment->size;
-            if (!result->mapMemory(segment->address, size, segment->flags)) {
-                delete result;
-                return nullptr;
+            if (!MemorySegment::addSegment(result->firstSegment,
+                    segment->address, segment->size, segment->flags)) {
+                goto fail;
             }
 
-            vaddr_t source = kernelSpace->mapFromOtherAddressSpace(this,
-                    segment->address, size, PROT_READ);
-            if (!source) {
-                delete result;
-                return nullptr;
+            // Each shared reference needs a reserved frame so that a later
+            // copy-on-write fault cannot fail. Pages that have not been
+            // allocated yet keep their reservation in the new address space.
+            size_t pages = segment->size / PAGESIZE;
+            bool reserved = hasReservedFrames(segment->flags);
+            if (reserved && !PhysicalMemory::reserveFrames(pages)) goto fail;
+
+            // Share the frames with the new address space. Unless this is a
+            // shared mapping, make them read-only in both address spaces.
+            bool copyOnWrite = !(segment->flags & SEG_SHARED);
+            int protection = copyOnWrite ? segment->flags & ~PROT_WRITE :
+                    segment->flags;
+            for (size_t i = 0; i < pages; i++) {
+                vaddr_t address = segment->address + i * PAGESIZE;
+                paddr_t physicalAddress = getPhysicalAddress(address);
+                if (!physicalAddress) continue;
+
+                if (!PhysicalMemory::addFrameReference(physicalAddress,
+                        reserved)) {
+                    if (reserved) PhysicalMemory::unreserveFrames(pages - i);
+                    goto fail;
+                }
+
+                if (!result->mapAt(address, physicalAddress, protection)) {
+                    PhysicalMemory::pushPageFrame(physicalAddress);
+                    if (reserved) {
+                        PhysicalMemory::unreserveFrames(pages - i - 1);
+                    }
+                    goto fail;
+                }
+
+                if (copyOnWrite && segment->flags & PROT_WRITE) {
+                    mapAt(address, physicalAddress, protection);
+                }
             }
+        }
+        segment = segment->next;
+    }
 
-            vaddr_t dest = kernelSpace->mapFromOtherAddressSpace(result,
-                    segment->address, size, PROT_WRITE);
-            if (!dest) {
-                kernelSpace->unmapPhysical(source, size);
-                delete result;
-                return nullptr;
-            }
+    {
+        // Keep the order of the mappings because newer mappings take
+        // precedence where they overlap older ones.
+        FileMapping** link = &result->fileMappings;
+        for (FileMapping* mapping = fileMappings; mapping;
+                mapping = mapping->next) {
+            FileMapping* newMapping = new FileMapping(*mapping);
+            if (!newMapping) goto fail;
+            newMapping->next = nullptr;
+            *link = newMapping;
+            link = &newMapping->next;
+        }
+    }
+
+    return result;
 
-            memcpy((void*) dest, (const void*) source, size);
-            kernelSpace->unmapPhysical(source, size);
-            kernelSpace->unmapPhysical(dest, size);
+fail:
+    delete result;
+    return nullptr;
+}
+
+AddressSpace::FileMapping* AddressSpace::findFileMapping(
+        vaddr_t virtualAddress) {
+    // The list starts with the newest mapping, which replaces any older ones
+    // at the same address.
+    for (FileMapping* mapping = fileMappings; mapping;
+            mapping = mapping->next) {
+        if (virtualAddress >= mapping->address &&
+                virtualAddress - mapping->address < mapping->size) {
+            return mapping;
         }
+    }
+    return nullptr;
+}
+
+MemorySegment* AddressSpace::findSegment(vaddr_t virtualAddress) {
+    MemorySegment* segment = firstSegment;
+    while (segment && segment->address + segment->size <= virtualAddress) {
         segment = segment->next;
     }
+    if (!segment || segment->address > virtualAddress) return nullptr;
+    return segment;
+}
 
-    return result;
+bool AddressSpace::handlePageFault(vaddr_t virtualAddress, bool present,
+        bool write) {
+    assert(isActive());
+    virtualAddress &= ~PAGE_MISALIGN;
+
+    AutoLock lock(&mutex);
+    MemorySegment* segment = findSegment(virtualAddress);
+    if (!segment || segment->flags & SEG_NOUNMAP ||
+            !(segment->flags & (PROT_READ | PROT_WRITE | PROT_EXEC))) {
+        return false;
+    }
+    if (write && !(segment->flags & PROT_WRITE)) return false;
+
+    paddr_t physicalAddress = getPhysicalAddress(virtualAddress);
+    if (!physicalAddress && !(segment->flags & SEG_FILE)) {
+        // The page is accessed for the first time.
+        return allocateLazyPage(virtualAddress, segment);
+    }
+
+    if (!physicalAddress) {
+        if (!mapFilePage(virtualAddress, segment)) return false;
+        if (!write) return true;
+
+        // Private pages are mapped read-only, so a write needs to copy the
+        // page. The mapping might have changed while the file was read.
+        segment = findSegment(virtualAddress);
+        physicalAddress = getPhysicalAddress(virtualAddress);
+        if (!segment || !physicalAddress) return true;
+        if (!(segment->flags & PROT_WRITE)) return false;
+        if (segment->flags & SEG_SHARED) return true;
+    } else if (!present) {
+        // Another thread might have already resolved the fault.
+        return true;
+    }
+
+    // Only write accesses to copy-on-write pages can be resolved.
+    if (!write || segment->flags & SEG_SHARED) return false;
+
+    // Map the mapping area first so that mapping the new frame cannot fail
+    // after we have given up our reference to the old one.
+    if (!kernelSpace->mapAt(mappingArea, physicalAddress, PROT_READ)) {
+        return false;
+    }
+
+    paddr_t newFrame = PhysicalMemory::unshareFrame(physicalAddress);
+    if (newFrame) {
+        // The frame is still shared, so we need to copy it.
+        kernelSpace->mapAt(mappingArea, newFrame, PROT_WRITE);
+        memcpy((void*) mappingArea, (const void*) virtualAddress, PAGESIZE);
+        physicalAddress = newFrame;
+    }
+    kernelSpace->unmap(mappingArea);
+
+    // If the frame was not shared anymore we are its only user and can just
+    // make it writable again.
+    return mapAt(virtualAddress, physicalAddress, segment->flags);
+}
+
+paddr_t AddressSpace::allocateLazyPage(vaddr_t virtualAddress,
+        MemorySegment* segment) {
+    int protection = segment->flags;
+
+#ifdef __x86_64__
+    // Back the whole 2 MiB block with a large page if it lies completely in
+    // the segment and none of its pages have been accessed yet. The reserved
+    // frames of all these pages are used for it. One additional frame is
+    // reserved so that the large page can be split again later.
+    vaddr_t largePage = virtualAddress & ~LARGE_PAGE_MISALIGN;
+    if (this != kernelSpace && isActive() && largePage >= segment->address &&
+            largePage + LARGE_PAGE_SIZE <= segment->address + segment->size &&
+            canMapLargePage(largePage) && PhysicalMemory::reserveFrames(1)) {
+        paddr_t physicalAddress =
+                PhysicalMemory::popReservedContiguous(LARGE_PAGE_ORDER);
+        if (physicalAddress) {
+            memset((void*) kernelSpace->mapFrame(physicalAddress), 0,
+                    LARGE_PAGE_SIZE);
+            mapLargePage(largePage, physicalAddress, protection);
+            return physicalAddress + (virtualAddress - largePage);
+        }
+        PhysicalMemory::unreserveFrames(1);
+    }
+#endif
+
+    // Make sure that the page tables exist so that nothing can fail after we
+    // have taken the reserved frame.
+    if (!mapAt(virtualAddress, 0, PROT_NONE)) return 0;
+    if (!kernelSpace->mapAt(mappingArea, 0, PROT_NONE)) return 0;
+
+    paddr_t physicalAddress = PhysicalMemory::popReserved();
+    kernelSpace->mapAt(mappingArea, physicalAddress, PROT_WRITE);
+    memset((void*) mappingArea, 0, PAGESIZE);
+    kernelSpace->unmap(mappingArea);
+
+    mapAt(virtualAddress, physicalAddress, protection);
+    return physicalAddress;
+}
+
+vaddr_t AddressSpace::mapFile(const Reference<Vnode>& vnode,
+        size_t firstPage, size_t size, int protection, bool shared) {
+    FileMapping* fileMapping = new FileMapping();
+    if (!fileMapping) {
+        errno = ENOMEM;
+        return 0;
+    }
+    fileMapping->size = size;
+    fileMapping->firstPage = firstPage;
+    fileMapping->shared = shared;
+    fileMapping->vnode = vnode;
+
+    AutoLock lock(&mutex);
+    int flags = protection | SEG_FILE;
+    if (shared) flags |= SEG_SHARED;
+    vaddr_t virtualAddress = MemorySegment::findAndAddNewSegment(firstSegment,
+            size, flags);
+    if (!virtualAddress) {
+        delete fileMapping;
+        errno = ENOMEM;
+        return 0;
+    }
+
+    // The pages are mapped by handlePageFault when they are first accessed.
+    // Only pages of private writable mappings can be copied on write and need
+    // a reserved frame for that.
+    if (hasReservedFrames(flags) &&
+            !PhysicalMemory::reserveFrames(size / PAGESIZE)) {
+        MemorySegment::removeSegment(firstSegment, virtualAddress, size);
+        delete fileMapping;
+        errno = ENOMEM;
+        return 0;
+    }
+
+    fileMapping->address = virtualAddress;
+    fileMapping->next = fileMappings;
+    fileMappings = fileMapping;
+    return virtualAddress;
+}
+
+bool AddressSpace::mapFilePage(vaddr_t virtualAddress,
+        MemorySegment* segment) {
+    FileMapping* mapping = findFileMapping(virtualAddress);
+    if (!mapping) return false;
+
+    Reference<Vnode> vnode = mapping->vnode;
+    size_t index = mapping->firstPage +
+            (virtualAddress - mapping->address) / PAGESIZE;
+    int flags = segment->flags;
+    bool shared = flags & SEG_SHARED;
+
+    // The mutex is unlocked while the page is read because the vnode might
+    // be locked by a thread that is faulting on its user buffer.
+    kthread_mutex_unlock(&mutex);
+    paddr_t physicalAddress = vnode->getMappedPage(index,
+            shared && flags & PROT_WRITE);
+    if (!physicalAddress) {
+        vnode = nullptr;
+        kthread_mutex_lock(&mutex);
+        return false;
+    }
+    kthread_mutex_lock(&mutex);
+
+    // The page might have been unmapped, remapped or mapped by another
+    // thread in the meantime. The access then simply faults again.
+    segment = findSegment(virtualAddress);
+    mapping = findFileMapping(virtualAddress);
+    bool valid = segment && segment->flags == flags && mapping &&
+            mapping->vnode == vnode && mapping->firstPage +
+            (virtualAddress - mapping->address) / PAGESIZE == index &&
+            !getPhysicalAddress(virtualAddress);
+
+    // Private mappings are mapped read-only so that writes are copy-on-write.
+    int protection = shared ? flags : flags & ~PROT_WRITE;
+    if (valid && mapAt(virtualAddress, physicalAddress, protection)) {
+        if (hasReservedFrames(flags)) {
+            PhysicalMemory::reserveFrameReference(physicalAddress);
+        }
+        return true;
+    }
+
+    // Drop the references without holding the mutex because the vnode might
+    // not be mapped anymore. If the mapping has changed the fault is retried.
+    kthread_mutex_unlock(&mutex);
+    PhysicalMemory::pushPageFrame(physicalAddress);
+    vnode = nullptr;
+    kthread_mutex_lock(&mutex);
+    return !valid;
 }
 
 vaddr_t AddressSpace::mapFromOtherAddressSpace(AddressSpace* sourceSpace,
@@ -85,9 +341,17 @@ vaddr_t AddressSpace::mapFromOtherAddressSpace(AddressSpace* sourceSpace,
     if (!destination) return 0;
 
     for (size_t i = 0 ; i < size; i += PAGESIZE) {
+        vaddr_t sourceAddress = sourceVirtualAddress + i;
         kthread_mutex_lock(&sourceSpace->mutex);
         paddr_t physicalAddress =
-                sourceSpace->getPhysicalAddress(sourceVirtualAddress + i);
+                sourceSpace->getPhysicalAddress(sourceAddress);
+        if (!physicalAddress && sourceSpace != kernelSpace) {
+            MemorySegment* segment = sourceSpace->findSegment(sourceAddress);
+            if (segment && !(segment->flags & (SEG_NOUNMAP | SEG_FILE))) {
+                physicalAddress = sourceSpace->allocateLazyPage(sourceAddress,
+                        segment);
+            }
+        }
         kthread_mutex_unlock(&sourceSpace->mutex);
         kthread_mutex_lock(&mutex);
         if (!mapAt(destination + i, physicalAddress, protection)) {
@@ -113,6 +377,10 @@ vaddr_t AddressSpace::mapMemoryInternal(vaddr_t virtualAddress, size_t size,
         return 0;
     }
 
+    // User memory is allocated on first access. The reserved frames are kept
+    // until then so that the page fault cannot fail.
+    if (this != kernelSpace) return virtualAddress;
+
     for (size_t i = 0; i < pages; i++) {
         paddr_t physicalAddress = PhysicalMemory::popReserved();
         if (unlikely(!mapAt(virtualAddress + i * PAGESIZE, physicalAddress,
@@ -178,6 +446,29 @@ vaddr_t AddressSpace::mapPhysical(paddr_t physicalAddress, size_t size,
     return virtualAddress;
 }
 
+vaddr_t AddressSpace::mapPhysicalPages(const paddr_t* physicalAddresses,
+        size_t pages, int protection) {
+    // Maps possibly discontiguous physical pages to contiguous virtual memory.
+    AutoLock lock(&mutex);
+
+    size_t size = pages * PAGESIZE;
+    vaddr_t virtualAddress = MemorySegment::findAndAddNewSegment(firstSegment,
+            size, protection);
+    if (!virtualAddress) return 0;
+    for (size_t i = 0; i < pages; i++) {
+        if (!mapAt(virtualAddress + i * PAGESIZE, physicalAddresses[i],
+                protection)) {
+            for (size_t j = 0; j < i; j++) {
+                unmap(virtualAddress + j * PAGESIZE);
+            }
+            MemorySegment::removeSegment(firstSegment, virtualAddress, size);
+            return 0;
+        }
+    }
+
+    return virtualAddress;
+}
+
 vaddr_t AddressSpace::mapUnaligned(paddr_t physicalAddress, size_t size,
         int protection, vaddr_t& mapping, size_t& mapSize) {
     paddr_t physAligned = physicalAddress & ~PAGE_MISALIGN;
@@ -194,20 +485,107 @@ void AddressSpace::unmap(vaddr_t virtualAddress) {
 }
 
 void AddressSpace::unmapMemory(vaddr_t virtualAddress, size_t size) {
-    AutoLock lock(&mutex);
+    kthread_mutex_lock(&mutex);
 
+    MemorySegment* segment = firstSegment;
     for (size_t i = 0; i < size; i += PAGESIZE) {
-        paddr_t physicalAddress = getPhysicalAddress(virtualAddress + i);
-        unmap(virtualAddress + i);
+        vaddr_t address = virtualAddress + i;
+        paddr_t physicalAddress = getPhysicalAddress(address);
 
-        // Unlock the mutex because PhysicalMemory::pushPageFrame may need to
-        // map pages.
-        kthread_mutex_unlock(&mutex);
+        if (this == kernelSpace) {
+            if (!physicalAddress) continue;
+            unmap(address);
+
+            // Unlock the mutex because PhysicalMemory::pushPageFrame may need
+            // to map pages.
+            kthread_mutex_unlock(&mutex);
+            PhysicalMemory::pushPageFrame(physicalAddress);
+            kthread_mutex_lock(&mutex);
+            continue;
+        }
+
+        while (segment && segment->address + segment->size <= address) {
+            segment = segment->next;
+        }
+        if (!segment || segment->address > address ||
+                segment->flags & SEG_NOUNMAP) {
+            continue;
+        }
+
+        if (!physicalAddress) {
+            // The page was never accessed, so only its reservation is freed.
+            if (hasReservedFrames(segment->flags)) {
+                PhysicalMemory::unreserveFrames(1);
+            }
+            continue;
+        }
+
+#ifdef __x86_64__
+        if (!(address & LARGE_PAGE_MISALIGN) &&
+                size - i >= LARGE_PAGE_SIZE && unmapLargePage(address)) {
+            for (size_t j = 0; j < LARGE_PAGE_SIZE; j += PAGESIZE) {
+                PhysicalMemory::pushPageFrame(physicalAddress + j);
+            }
+            // Drop the reservation for splitting the large page.
+            PhysicalMemory::unreserveFrames(1);
+            i += LARGE_PAGE_SIZE - PAGESIZE;
+            continue;
+        }
+#endif
+
+        unmap(address);
         PhysicalMemory::pushPageFrame(physicalAddress);
-        kthread_mutex_lock(&mutex);
     }
 
     MemorySegment::removeSegment(firstSegment, virtualAddress, size);
+
+    // Collect the file mappings in the range so that the pages of shared
+    // mappings can be written back after the mutex has been unlocked.
+    FileMapping* writeback = nullptr;
+    FileMapping** link = &fileMappings;
+    vaddr_t endAddress = virtualAddress + size;
+    while (*link) {
+        FileMapping* mapping = *link;
+        vaddr_t mappingEnd = mapping->address + mapping->size;
+        if (mapping->address >= endAddress || mappingEnd <= virtualAddress) {
+            link = &mapping->next;
+            continue;
+        }
+
+        if (mapping->address >= virtualAddress && mappingEnd <= endAddress) {
+            *link = mapping->next;
+            mapping->next = writeback;
+            writeback = mapping;
+            continue;
+        }
+
+        // The mapping is only partially unmapped. If the remaining part is
+        // not contiguous the mapping is kept as a whole.
+        if (mapping->address >= virtualAddress) {
+            mapping->firstPage += (endAddress - mapping->address) / PAGESIZE;
+            mapping->size = mappingEnd - endAddress;
+            mapping->address = endAddress;
+        } else if (mappingEnd <= endAddress) {
+            mapping->size = virtualAddress - mapping->address;
+        }
+
+        FileMapping* partial = mapping->shared ? new FileMapping() : nullptr;
+        if (partial) {
+            partial->shared = true;
+            partial->vnode = mapping->vnode;
+            partial->next = writeback;
+            writeback = partial;
+        }
+        link = &mapping->next;
+    }
+    kthread_mutex_unlock(&mutex);
+
+    while (writeback) {
+        FileMapping* next = writeback->next;
+        if (writeback->shared) writeback->vnode->sync(0);
+        delete writeback;
+        writeback = next;
+    }
 }
 
 void AddressSpace::unmapPhysical(vaddr_t virtualAddress, size_t size) {
@@ -19,7 +19,6 @@
 
 #include <assert.h>
 #include <errno.h>
-#include <sched.h>
 #include <stdio.h>
 #include <string.h>
 #include <cobalt/poll.h>
@@ -31,6 +30,7 @@
 #include <cobalt/kernel/partition.h>
 #include <cobalt/kernel/pci.h>
 #include <cobalt/kernel/physicalmemory.h>
+#include <cobalt/kernel/thread.h>
 
 #define REGISTER_CAP 0x00 // HBA Capabilities
 #define REGISTER_GHC 0x04 // Global Host Control
@@ -50,11 +50,14 @@
 #define REGISTER_PxSIG 0x24 // Port Signature
 #define REGISTER_PxSSTS 0x28 // Port Serial ATA Status
 #define REGISTER_PxSERR 0x30 // Port Serial ATA Error
+#define REGISTER_PxSACT 0x34 // Port Serial ATA Active
 #define REGISTER_PxCI 0x38 // Port Command Issue
 
 #define GHC_IE (1 << 1) // Interrupt Enable
 #define GHC_AE (1U << 31) // AHCI Enable
 
+#define CAP_NCS(cap) ((((cap) >> 8) & 0x1F) + 1) // Number of Command Slots
+#define CAP_SNCQ (1 << 30) // Supports Native Command Queuing
 #define CAP_S64A (1U << 31) // Supports 64-bit addressing
 
 #define CAP2_BOH (1 << 0) // BIOS/OS Handoff
@@ -84,9 +87,19 @@
 
 #define COMMAND_READ_DMA_EXT 0x25
 #define COMMAND_WRITE_DMA_EXT 0x35
+#define COMMAND_READ_FPDMA_QUEUED 0x60
+#define COMMAND_WRITE_FPDMA_QUEUED 0x61
 #define COMMAND_FLUSH_CACHE 0xE7
 #define COMMAND_IDENTIFY_DEVICE 0xEC
 
+// Each command table contains up to 8 PRDT entries. The tables of all 32
+// command slots are stored in two pages.
+#define PRDT_ENTRIES 8
+#define COMMAND_TABLE_SIZE 0x100
+#define TABLES_PER_PAGE (PAGESIZE / COMMAND_TABLE_SIZE)
+#define MAX_PRDT_BYTES (4 * 1024 * 1024)
+#define MAX_COMMAND_BYTES (16 * 1024 * 1024)
+
 static size_t numAhciDevices = 0;
 static void onAhciIrq(void* user, const InterruptContext* context);
 
@@ -147,6 +160,7 @@ AhciController::AhciController(vaddr_t hbaMapped, unsigned int irq)
     ghc &= ~GHC_IE;
     writeRegister(REGISTER_GHC, ghc);
 
+    uint32_t cap = readRegister(REGISTER_CAP);
     uint32_t pi = readRegister(REGISTER_PI);
     for (size_t i = 0; i < 32; i++) {
         if (!(pi & (1U << i))) continue;
@@ -205,7 +219,8 @@ AhciController::AhciController(vaddr_t hbaMapped, unsigned int irq)
                 if (sig == PxSIG_ATA) {
                     // An ATA device was detected. Try to initialize it.
                     ports[i] = xnew AhciDevice(hbaMapped + portOffset,
-                            portMemPhys, portMemVirt);
+                            portMemPhys, portMemVirt, CAP_NCS(cap),
+                            cap & CAP_SNCQ);
                 }
             }
         }
@@ -260,33 +275,89 @@ void AhciController::writeRegister(size_t offset, uint32_t value) {
 }
 
 AhciDevice::AhciDevice(vaddr_t portRegisters, paddr_t portMemPhys,
-        vaddr_t portMemVirt) : BlockCacheDevice(0644, DevFS::dev) {
+        vaddr_t portMemVirt, unsigned int commandSlots, bool ncqSupported)
+        : BlockCacheDevice(0644, DevFS::dev) {
     this->portRegisters = portRegisters;
     this->portMemPhys = portMemPhys;
     this->portMemVirt = portMemVirt;
 
-    awaitingInterrupt = false;
-    dmaInProgress = false;
-    error = 0;
+    commandTablesPhys[0] = 0;
+    commandTablesPhys[1] = 0;
+    commandTablesVirt[0] = 0;
+    commandTablesVirt[1] = 0;
+    slotMask = commandSlots == 32 ? 0xFFFFFFFF : (1U << commandSlots) - 1;
+    busySlots = 0;
+    issuedSlots = 0;
+    queuedSlots = 0;
+    ncq = ncqSupported;
+    for (size_t i = 0; i < 32; i++) {
+        requests[i] = nullptr;
+    }
+    slotWaiters = nullptr;
 }
 
-bool AhciDevice::finishDmaTransfer() {
-    if (!dmaInProgress) return true;
+unsigned int AhciDevice::allocateSlot(bool queued) {
+    // This function needs to be called with interrupts disabled. Queued and
+    // non-queued commands cannot be outstanding at the same time.
+    while (true) {
+        uint32_t freeSlots = ~busySlots & slotMask;
+        if (freeSlots && (!ncq || busySlots == 0 ||
+                (queued && busySlots == queuedSlots))) {
+            unsigned int slot = __builtin_ctz(freeSlots);
+            busySlots |= 1U << slot;
+            if (queued) {
+                queuedSlots |= 1U << slot;
+            }
+            return slot;
+        }
+
+        kthread_waiter waiter;
+        waiter.thread = Thread::current();
+        waiter.blocked = true;
+        waiter.next = slotWaiters;
+        slotWaiters = &waiter;
 
-    while (awaitingInterrupt) {
-        sched_yield();
+        while (waiter.blocked) {
+            Thread::block(false, nullptr, nullptr);
+        }
     }
+}
 
-    dmaInProgress = false;
-    if (error) {
-        Log::printf("AHCI error 0x%X\n", error);
-        error = 0;
-        return false;
+void AhciDevice::completeCommands(uint32_t slots, uint32_t error) {
+    for (size_t i = 0; i < 32; i++) {
+        if (!(slots & (1U << i))) continue;
+
+        Request* request = requests[i];
+        requests[i] = nullptr;
+        request->error |= error;
+        if (--request->remaining == 0) {
+            request->thread->wakeUp();
+        }
+    }
+
+    busySlots &= ~slots;
+    issuedSlots &= ~slots;
+    queuedSlots &= ~slots;
+
+    // Let all threads that are waiting for a slot try again.
+    while (slotWaiters) {
+        kthread_waiter* waiter = slotWaiters;
+        slotWaiters = waiter->next;
+        waiter->blocked = false;
+        waiter->thread->wakeUp();
     }
-    return true;
 }
 
 bool AhciDevice::identify() {
+    for (size_t i = 0; i < 2; i++) {
+        commandTablesPhys[i] = PhysicalMemory::popPageFrame();
+        if (!commandTablesPhys[i]) return false;
+        commandTablesVirt[i] = kernelSpace->mapPhysical(commandTablesPhys[i],
+                PAGESIZE, PROT_READ | PROT_WRITE);
+        if (!commandTablesVirt[i]) return false;
+        memset((void*) commandTablesVirt[i], 0, PAGESIZE);
+    }
+
     // Start the DMA engine.
     uint32_t cmd = readRegister(REGISTER_PxCMD);
     cmd |= PxCMD_ST;
@@ -299,11 +370,13 @@ bool AhciDevice::identify() {
 
     vaddr_t virt = kernelSpace->mapMemory(PAGESIZE, PROT_READ);
     if (!virt) return false;
-    paddr_t phys = kernelSpace->getPhysicalAddress(virt);
 
     // Ask the device to identify itself.
-    if (!sendDmaCommand(COMMAND_IDENTIFY_DEVICE, phys, 512, false, 0, 0) ||
-            !finishDmaTransfer()) {
+    Request request = { Thread::current(), 0, 0 };
+    sendCommand(COMMAND_IDENTIFY_DEVICE, virt, 512, false, 0, &request);
+    waitForRequest(&request);
+    if (request.error) {
+        Log::printf("AHCI error 0x%X\n", request.error);
         kernelSpace->unmapMemory(virt, PAGESIZE);
         return false;
     }
@@ -331,6 +404,17 @@ bool AhciDevice::identify() {
             stats.st_blksize = 2 * (data[117] | (data[118] << 16));
         }
     }
+
+    // Use native command queuing if both the controller and the device
+    // support it.
+    if (ncq && (data[76] & (1 << 8))) {
+        unsigned int queueDepth = (data[75] & 0x1F) + 1;
+        if (queueDepth < 32) {
+            slotMask &= (1U << queueDepth) - 1;
+        }
+    } else {
+        ncq = false;
+    }
     kernelSpace->unmapMemory(virt, PAGESIZE);
 
     if (__builtin_mul_overflow(sectors, stats.st_blksize, &stats.st_size)) {
@@ -371,12 +455,19 @@ off_t AhciDevice::lseek(off_t offset, int whence) {
 void AhciDevice::onIrq(const InterruptContext* /*context*/,
         uint32_t interruptStatus) {
     if (interruptStatus & PORT_INTERRUPT_ERROR) {
-        error = interruptStatus & PORT_INTERRUPT_ERROR;
+        // The port stops processing commands after an error. Fail all issued
+        // commands and restart the port.
+        restartPort();
+        completeCommands(issuedSlots, interruptStatus & PORT_INTERRUPT_ERROR);
+        return;
     }
 
-    uint32_t commandIssue = readRegister(REGISTER_PxCI);
-    if (!commandIssue) {
-        awaitingInterrupt = false;
+    // Queued commands remain active until the device has completed them.
+    uint32_t outstanding = readRegister(REGISTER_PxCI) |
+            readRegister(REGISTER_PxSACT);
+    uint32_t completed = issuedSlots & ~outstanding;
+    if (completed) {
+        completeCommands(completed, 0);
     }
 }
 
@@ -388,54 +479,92 @@ bool AhciDevice::readUncached(void* buffer, size_t size, off_t offset,
         int /*flags*/) {
     assert(offset % stats.st_blksize == 0);
     assert(size % stats.st_blksize == 0);
-    assert(size <= PAGESIZE);
     assert(offset < stats.st_size);
 
-    size_t sectors = size / stats.st_blksize;
     uint64_t lba = offset / stats.st_blksize;
+    Request request = { Thread::current(), 0, 0 };
+    transfer((vaddr_t) buffer, size, lba, false, &request);
+    waitForRequest(&request);
 
-    vaddr_t virt = (vaddr_t) buffer;
-    vaddr_t aligned = virt & ~PAGE_MISALIGN;
-    paddr_t phys = kernelSpace->getPhysicalAddress(aligned);
-    phys += virt - aligned;
-    if (!sendDmaCommand(COMMAND_READ_DMA_EXT, phys, size, false,
-            lba, sectors)) {
+    if (request.error) {
+        Log::printf("AHCI error 0x%X\n", request.error);
+        errno = EIO;
         return false;
     }
-    if (!finishDmaTransfer()) return false;
-
     return true;
 }
 
-int AhciDevice::sync(int /*flags*/) {
-    if (!sendDmaCommand(COMMAND_FLUSH_CACHE, 0, 0, false, 0, 0) ||
-            !finishDmaTransfer()) {
+void AhciDevice::restartPort() {
+    uint32_t cmd = readRegister(REGISTER_PxCMD);
+    cmd &= ~PxCMD_ST;
+    writeRegister(REGISTER_PxCMD, cmd);
+    while (cmd & PxCMD_CR) {
+        cmd = readRegister(REGISTER_PxCMD);
+    }
+
+    writeRegister(REGISTER_PxSERR, readRegister(REGISTER_PxSERR));
+    writeRegister(REGISTER_PxIS, readRegister(REGISTER_PxIS));
+
+    cmd |= PxCMD_ST;
+    writeRegister(REGISTER_PxCMD, cmd);
+}
+
+int AhciDevice::syncUncached(int /*flags*/) {
+    Request request = { Thread::current(), 0, 0 };
+    sendCommand(COMMAND_FLUSH_CACHE, 0, 0, false, 0, &request);
+    waitForRequest(&request);
+
+    if (request.error) {
+        Log::printf("AHCI error 0x%X\n", request.error);
         errno = EIO;
         return -1;
     }
     return 0;
 }
 
+void AhciDevice::transfer(vaddr_t buffer, size_t size, uint64_t lba,
+        bool write, Request* request) {
+    // Large transfers are split into multiple commands that are all sent
+    // before waiting for any of them.
+    uint8_t command;
+    if (ncq) {
+        command = write ? COMMAND_WRITE_FPDMA_QUEUED :
+                COMMAND_READ_FPDMA_QUEUED;
+    } else {
+        command = write ? COMMAND_WRITE_DMA_EXT : COMMAND_READ_DMA_EXT;
+    }
+
+    while (size > 0) {
+        size_t commandSize = size;
+        if (commandSize > MAX_COMMAND_BYTES) {
+            commandSize = MAX_COMMAND_BYTES;
+        }
+        size_t sent = sendCommand(command, buffer, commandSize, write, lba,
+                request);
+        buffer += sent;
+        size -= sent;
+        lba += sent / stats.st_blksize;
+    }
+}
+
 bool AhciDevice::writeUncached(const void* buffer, size_t size, off_t offset,
         int /*flags*/) {
     assert(offset % stats.st_blksize == 0);
     assert(size % stats.st_blksize == 0);
-    assert(size <= PAGESIZE);
     assert(offset < stats.st_size);
 
-    size_t sectors = size / stats.st_blksize;
+    // The block cache might reuse the memory as soon as this function
+    // returns, so the write needs to complete first.
     uint64_t lba = offset / stats.st_blksize;
+    Request request = { Thread::current(), 0, 0 };
+    transfer((vaddr_t) buffer, size, lba, true, &request);
+    waitForRequest(&request);
 
-    vaddr_t virt = (vaddr_t) buffer;
-    vaddr_t aligned = virt & ~PAGE_MISALIGN;
-    paddr_t phys = kernelSpace->getPhysicalAddress(aligned);
-    phys += virt - aligned;
-    if (!sendDmaCommand(COMMAND_WRITE_DMA_EXT, phys, size, true, lba,
-            sectors)) {
+    if (request.error) {
+        Log::printf("AHCI error 0x%X\n", request.error);
         errno = EIO;
         return false;
     }
-
     return true;
 }
 
@@ -479,17 +608,68 @@ struct CommandTable {
     char padding[44];
     char acmd[16];
     char reserved[48];
-    PrdtEntry entry;
+    PrdtEntry entries[PRDT_ENTRIES];
 };
 
-bool AhciDevice::sendDmaCommand(uint8_t command, paddr_t physicalAddress,
-        size_t size, bool write, uint64_t lba, uint16_t blockCount) {
-    if (!finishDmaTransfer()) return false;
+static_assert(sizeof(CommandTable) <= COMMAND_TABLE_SIZE);
+
+size_t AhciDevice::sendCommand(uint8_t command, vaddr_t buffer, size_t size,
+        bool write, uint64_t lba, Request* request) {
+    // Sends a single command and returns the number of bytes that it
+    // transfers, which might be less than size when the PRDT is full.
+    bool queued = command == COMMAND_READ_FPDMA_QUEUED ||
+            command == COMMAND_WRITE_FPDMA_QUEUED;
+
+    Interrupts::disable();
+    unsigned int slot = allocateSlot(queued);
+    Interrupts::enable();
+
+    CommandHeader* header = (CommandHeader*) (portMemVirt +
+            slot * sizeof(CommandHeader));
+    CommandTable* table = (CommandTable*) (commandTablesVirt[slot /
+            TABLES_PER_PAGE] + slot % TABLES_PER_PAGE * COMMAND_TABLE_SIZE);
+    uint64_t tablePhys = commandTablesPhys[slot / TABLES_PER_PAGE] +
+            slot % TABLES_PER_PAGE * COMMAND_TABLE_SIZE;
+
+    // Fill the PRDT with the physical pages of the buffer. Physically
+    // contiguous pages are merged into a single entry.
+    size_t entries = 0;
+    size_t transferred = 0;
+    while (transferred < size) {
+        vaddr_t virt = buffer + transferred;
+        vaddr_t aligned = virt & ~PAGE_MISALIGN;
+        paddr_t phys = kernelSpace->getPhysicalAddress(aligned) +
+                (virt - aligned);
+        size_t length = PAGESIZE - (virt - aligned);
+        if (length > size - transferred) {
+            length = size - transferred;
+        }
 
-    CommandHeader* header = (CommandHeader*) portMemVirt;
-    CommandTable* table = (CommandTable*) (portMemVirt + 0x500);
+        if (entries > 0) {
+            PrdtEntry* last = &table->entries[entries - 1];
+            uint64_t lastEnd = ((uint64_t) last->dbau << 32 | last->dba) +
+                    last->byteCount + 1;
+            if (lastEnd == phys &&
+                    last->byteCount + 1 + length <= MAX_PRDT_BYTES) {
+                last->byteCount += length;
+                transferred += length;
+                continue;
+            }
+        }
+
+        if (entries == PRDT_ENTRIES) break;
+        PrdtEntry* prdt = &table->entries[entries++];
+        prdt->dba = phys & 0xFFFFFFFF;
+        prdt->dbau = (uint64_t) phys >> 32;
+        prdt->reserved = 0;
+        prdt->byteCount = length - 1;
+        transferred += length;
+    }
+
+    uint16_t blockCount = transferred / stats.st_blksize;
 
     CommandFis* cfis = &table->cfis;
+    memset(cfis, 0, sizeof(CommandFis));
     cfis->type = FIS_TYPE_REG_H2D;
     cfis->flags = 0x80;
     cfis->command = command;
@@ -499,33 +679,37 @@ bool AhciDevice::sendDmaCommand(uint8_t command, paddr_t physicalAddress,
     cfis->lba3 = (lba >> 24) & 0xFF;
     cfis->lba4 = (lba >> 32) & 0xFF;
     cfis->lba5 = (lba >> 40) & 0xFF;
-    cfis->count = blockCount;
     cfis->device = 0x40;
-
-    if (size > 0) {
-        PrdtEntry* prdt = &table->entry;
-        prdt->dba = physicalAddress & 0xFFFFFFFF;
-        prdt->dbau = (uint64_t) physicalAddress >> 32;
-        prdt->reserved = 0;
-        prdt->byteCount = size - 1;
+    if (queued) {
+        // Queued commands pass the block count in the features register and
+        // the tag in the count register.
+        cfis->featuresLow = blockCount & 0xFF;
+        cfis->featuresHigh = blockCount >> 8;
+        cfis->count = slot << 3;
+    } else {
+        cfis->count = blockCount;
     }
 
     header->flags = 5;
     if (write) {
         header->flags |= (1 << 6);
     }
-    header->prdtl = size ? 1 : 0;
+    header->prdtl = entries;
     header->prdbc = 0;
-    uint64_t tablePhys = portMemPhys + 0x500;
     header->ctba = tablePhys & 0xFFFFFFFF;
     header->ctbau = tablePhys >> 32;
 
-    awaitingInterrupt = true;
-    dmaInProgress = true;
-    error = false;
+    Interrupts::disable();
+    requests[slot] = request;
+    request->remaining++;
+    issuedSlots |= 1U << slot;
+    if (queued) {
+        writeRegister(REGISTER_PxSACT, 1U << slot);
+    }
+    writeRegister(REGISTER_PxCI, 1U << slot);
+    Interrupts::enable();
 
-    writeRegister(REGISTER_PxCI, 1);
-    return true;
+    return transferred;
 }
 
 uint32_t AhciDevice::readRegister(size_t offset) {
@@ -533,6 +717,14 @@ uint32_t AhciDevice::readRegister(size_t offset) {
     return *reg;
 }
 
+void AhciDevice::waitForRequest(Request* request) {
+    Interrupts::disable();
+    while (request->remaining) {
+        Thread::block(false, nullptr, nullptr);
+    }
+    Interrupts::enable();
+}
+
 void AhciDevice::writeRegister(size_t offset, uint32_t value) {
     volatile uint32_t* reg = (volatile uint32_t*) (portRegisters + offset);
     *reg = value;
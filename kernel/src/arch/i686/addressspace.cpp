@@ -73,6 +73,8 @@ static inline int protectionToFlags(int protection) {
 }
 
 AddressSpace::AddressSpace() {
+    fileMappings = nullptr;
+
     if (this == kernelSpace) {
         pageDir = (paddr_t) &kernelPageDirectory;
         mappingArea = (vaddr_t) _kernelMappingArea;
@@ -180,7 +182,12 @@ void AddressSpace::initialize() {
     uint32_t edx;
     asm("cpuid" : "+a"(eax), "=d"(edx) :: "ebx", "ecx");
     patSupported = edx & (1 << 16);
+    initializePat();
+}
 
+void AddressSpace::initializePat() {
+    // The PAT is per processor, so this is also called on each application
+    // processor.
     if (patSupported) {
         uint32_t patLow;
         uint32_t patHigh;
@@ -308,3 +315,12 @@ vaddr_t AddressSpace::mapAt(
 
     return virtualAddress;
 }
+
+vaddr_t AddressSpace::mapFrame(paddr_t physicalAddress) {
+    assert(this == kernelSpace);
+    return mapPhysical(physicalAddress, PAGESIZE, PROT_READ | PROT_WRITE);
+}
+
+void AddressSpace::unmapFrame(vaddr_t virtualAddress) {
+    unmapPhysical(virtualAddress, PAGESIZE);
+}
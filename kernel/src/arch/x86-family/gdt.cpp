@@ -18,7 +18,9 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <cobalt/kernel/process.h>
+#include <cobalt/kernel/smp.h>
 
 struct gdt_entry {
     uint16_t limit_low;
@@ -185,6 +187,43 @@ void setKernelStack(uintptr_t stack) {
 #endif
 }
 
+#define GDT_ENTRIES (sizeof(gdt) / sizeof(gdt_entry))
+
+struct ProcessorTables {
+    gdt_entry entries[GDT_ENTRIES];
+    tss_entry tss;
+};
+
+void* Smp::createProcessorGdt(uintptr_t kernelStack) {
+    ProcessorTables* tables = new ProcessorTables;
+    if (!tables) return nullptr;
+
+    memcpy(tables->entries, gdt, sizeof(gdt));
+    memset(&tables->tss, 0, sizeof(tss_entry));
+#ifdef __i386__
+    tables->tss.ss0 = 0x10;
+    tables->tss.esp0 = kernelStack;
+#elif __x86_64__
+    tables->tss.rsp0_low = kernelStack & 0xFFFFFFFF;
+    tables->tss.rsp0_high = kernelStack >> 32;
+#endif
+
+    // The TSS descriptor in the copy is marked busy because the bootstrap
+    // processor has loaded it.
+    uintptr_t base = (uintptr_t) &tables->tss;
+    gdt_entry* tssEntry = &tables->entries[5];
+    tssEntry->base_low = base & 0xFFFF;
+    tssEntry->base_middle = (base >> 16) & 0xFF;
+    tssEntry->base_high = (base >> 24) & 0xFF;
+    tssEntry->access = 0x89;
+#ifdef __x86_64__
+    tables->entries[6].limit_low = (base >> 32) & 0xFFFF;
+    tables->entries[6].base_low = (base >> 48) & 0xFFFF;
+#endif
+
+    return tables->entries;
+}
+
 #ifdef __i386__
 uintptr_t getTlsBase() {
     return gdt[6].base_low | (gdt[6].base_middle << 16) |
@@ -23,6 +23,7 @@
 #include <cobalt/kernel/console.h>
 #include <cobalt/kernel/panic.h>
 #include <cobalt/kernel/portio.h>
+#include <cobalt/kernel/process.h>
 #include <cobalt/kernel/registers.h>
 #include <cobalt/kernel/signal.h>
 #include <cobalt/kernel/thread.h>
@@ -55,6 +56,9 @@
 #define EX_SIMD_FLOATING_POINT_EXCEPTION 19
 #define EX_VIRTUALIZATION_EXCEPTION 20
 
+#define PAGE_FAULT_PRESENT (1 << 0)
+#define PAGE_FAULT_WRITE (1 << 1)
+
 class IoApic {
 public:
     IoApic(paddr_t baseAddress, int interruptBase);
@@ -147,6 +151,11 @@ void Interrupts::initApic() {
             (volatile uint32_t*) (apicMapped + 0x20);
     apicId = *apicIdRegister >> 24;
 
+    enableApic();
+}
+
+void Interrupts::enableApic() {
+    // Each processor has its own local APIC that needs to be enabled.
     volatile uint32_t* spuriousInterruptVector =
             (volatile uint32_t*) (apicMapped + 0xF0);
     *spuriousInterruptVector = 0x1FF;
@@ -180,6 +189,28 @@ void Interrupts::initPic() {
     outb(PIC2_DATA, 0xFF);
 }
 
+void Interrupts::sendIpi(uint8_t destination, uint32_t command) {
+    volatile uint32_t* commandLow = (volatile uint32_t*) (apicMapped + 0x300);
+    volatile uint32_t* commandHigh =
+            (volatile uint32_t*) (apicMapped + 0x310);
+
+    bool interruptsEnabled = areEnabled();
+    disable();
+    // Wait until the previous IPI has been delivered.
+    while (*commandLow & (1 << 12)) {
+        asm volatile ("pause");
+    }
+    *commandHigh = destination << 24;
+    *commandLow = command;
+    if (interruptsEnabled) enable();
+}
+
+bool Interrupts::areEnabled() {
+    uintptr_t flags;
+    asm volatile ("pushf; pop %0" : "=r"(flags));
+    return flags & 0x200;
+}
+
 void Interrupts::disable() {
     asm volatile ("cli");
 }
@@ -261,9 +292,26 @@ static bool handleUserspaceException(const InterruptContext* context) {
     return true;
 }
 
+static bool handlePageFault(const InterruptContext* context) {
+    vaddr_t address;
+    asm ("mov %%cr2, %0" : "=r"(address));
+
+    // Page faults can also happen in the kernel when it accesses user memory.
+    Thread* thread = Thread::current();
+    if (!thread) return false;
+    AddressSpace* addressSpace = thread->process->addressSpace;
+    if (addressSpace == kernelSpace) return false;
+
+    return addressSpace->handlePageFault(address,
+            context->error & PAGE_FAULT_PRESENT,
+            context->error & PAGE_FAULT_WRITE);
+}
+
 extern "C" InterruptContext* handleInterrupt(InterruptContext* context) {
     InterruptContext* newContext = context;
-    if (context->interrupt <= 31 && context->cs != 0x8) {
+    if (context->interrupt == EX_PAGE_FAULT && handlePageFault(context)) {
+        // The page fault was resolved.
+    } else if (context->interrupt <= 31 && context->cs != 0x8) {
         if (!handleUserspaceException(context)) goto handleKernelException;
     } else if (context->interrupt <= 31) { // CPU Exception
 handleKernelException:
@@ -279,9 +327,12 @@ handleKernelException:
             handler = handler->next;
         }
 
-        if (irq == Interrupts::timerIrq) {
+        // When the cpu is idle there might not be any timer interrupts, so
+        // any interrupt that might have woken up a thread needs to schedule.
+        if (irq == Interrupts::timerIrq ||
+                Thread::current() == Thread::idleThread) {
             console->display->update();
-            newContext = Thread::schedule(context);
+            newContext = Thread::schedule(context, false);
         }
 
         // Send End of Interrupt
@@ -296,7 +347,7 @@ handleKernelException:
             outb(PIC1_COMMAND, PIC_EOI);
         }
     } else if (context->interrupt == 0x31) {
-        newContext = Thread::schedule(context);
+        newContext = Thread::schedule(context, true);
     } else if (context->interrupt == 0x32) {
         newContext = Signal::sigreturn(context);
     }
@@ -0,0 +1,197 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/arch/x86-family/smp.cpp
+ * Application processor startup.
+ */
+
+#include <string.h>
+#include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/arch.h>
+#include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/interrupts.h>
+#include <cobalt/kernel/log.h>
+#include <cobalt/kernel/panic.h>
+#include <cobalt/kernel/smp.h>
+
+#define IPI_INIT 0x4500
+#define IPI_STARTUP 0x4600
+
+#define PAGE_PRESENT (1 << 0)
+#define PAGE_WRITABLE (1 << 1)
+#define PAGE_LARGE (1 << 7)
+
+#define MAX_PROCESSORS 256
+
+struct Processor {
+    uint8_t apicId;
+    bool started;
+};
+
+struct GdtDescriptor {
+    uint16_t size;
+    uintptr_t base;
+} PACKED;
+
+extern "C" {
+extern symbol_t trampolineBegin;
+extern symbol_t trampolineEnd;
+extern symbol_t trampolineGdtr;
+extern symbol_t trampolineProcessor;
+extern symbol_t trampolineStack;
+#ifdef __i386__
+extern symbol_t kernelPageDirectory;
+#elif defined(__x86_64__)
+extern symbol_t kernelPml4;
+#endif
+extern uint16_t gdt_size;
+}
+
+static Processor processors[MAX_PROCESSORS];
+static size_t numApplicationProcessors;
+
+void Smp::addProcessor(uint8_t apicId) {
+    if (apicId == Interrupts::apicId) return;
+    if (numApplicationProcessors >= MAX_PROCESSORS) return;
+    processors[numApplicationProcessors].apicId = apicId;
+    processors[numApplicationProcessors].started = false;
+    numApplicationProcessors++;
+}
+
+// Application processors jump here from the trampoline once they are running
+// in the kernel address space with their own GDT, TSS and stack.
+extern "C" void startApplicationProcessor(Processor* processor) {
+    AddressSpace::initializePat();
+    Interrupts::enableApic();
+    __atomic_store_n(&processor->started, true, __ATOMIC_RELEASE);
+    // The processor halts after returning. The scheduler still relies on
+    // disabling interrupts for mutual exclusion, so threads cannot run on
+    // application processors yet.
+}
+
+static void delay(long nanoseconds) {
+    Clock* clock = Clock::get(CLOCK_MONOTONIC);
+    struct timespec now;
+    clock->getTime(&now);
+    struct timespec end = timespecPlus(now, { 0, nanoseconds });
+    while (timespecLess(now, end)) {
+        asm volatile ("pause");
+        clock->getTime(&now);
+    }
+}
+
+static bool hasStarted(Processor* processor) {
+    return __atomic_load_n(&processor->started, __ATOMIC_ACQUIRE);
+}
+
+static void createPageTables(vaddr_t trampoline) {
+    // The temporary page tables identity map the trampoline and share the
+    // kernel half of the kernel address space.
+#ifdef __i386__
+    uint32_t* pageDir = (uint32_t*) (trampoline + PAGESIZE);
+    uint32_t* pageTable = (uint32_t*) (trampoline + 2 * PAGESIZE);
+    memset(pageDir, 0, 2 * PAGESIZE);
+    pageDir[0] = (SMP_TRAMPOLINE + 2 * PAGESIZE) | PAGE_PRESENT |
+            PAGE_WRITABLE;
+    pageTable[SMP_TRAMPOLINE / PAGESIZE] = SMP_TRAMPOLINE | PAGE_PRESENT |
+            PAGE_WRITABLE;
+
+    const uint32_t* kernelPageDir = (const uint32_t*)
+            kernelSpace->mapPhysical((paddr_t) &kernelPageDirectory, PAGESIZE,
+            PROT_READ);
+    if (!kernelPageDir) PANIC("Failed to map the kernel page directory");
+    memcpy(pageDir + 768, kernelPageDir + 768, 256 * sizeof(uint32_t));
+    kernelSpace->unmapPhysical((vaddr_t) kernelPageDir, PAGESIZE);
+#elif defined(__x86_64__)
+    uint64_t* pml4 = (uint64_t*) (trampoline + PAGESIZE);
+    uint64_t* pdpt = (uint64_t*) (trampoline + 2 * PAGESIZE);
+    uint64_t* pageDir = (uint64_t*) (trampoline + 3 * PAGESIZE);
+    memset(pml4, 0, 3 * PAGESIZE);
+    pml4[0] = (SMP_TRAMPOLINE + 2 * PAGESIZE) | PAGE_PRESENT | PAGE_WRITABLE;
+    pdpt[0] = (SMP_TRAMPOLINE + 3 * PAGESIZE) | PAGE_PRESENT | PAGE_WRITABLE;
+    pageDir[0] = PAGE_PRESENT | PAGE_WRITABLE | PAGE_LARGE;
+
+    const uint64_t* kernelPml4Mapped = (const uint64_t*)
+            kernelSpace->mapPhysical((paddr_t) &kernelPml4, PAGESIZE,
+            PROT_READ);
+    if (!kernelPml4Mapped) PANIC("Failed to map the kernel PML4");
+    memcpy(pml4 + 256, kernelPml4Mapped + 256, 256 * sizeof(uint64_t));
+    kernelSpace->unmapPhysical((vaddr_t) kernelPml4Mapped, PAGESIZE);
+#endif
+}
+
+static bool startProcessor(Processor* processor, vaddr_t trampoline) {
+    vaddr_t stack = kernelSpace->mapMemory(PAGESIZE, PROT_READ | PROT_WRITE);
+    if (!stack) return false;
+    void* gdt = Smp::createProcessorGdt(stack + PAGESIZE);
+    if (!gdt) {
+        kernelSpace->unmapMemory(stack, PAGESIZE);
+        return false;
+    }
+
+    vaddr_t begin = (vaddr_t) &trampolineBegin;
+    GdtDescriptor* gdtr = (GdtDescriptor*) (trampoline +
+            (vaddr_t) &trampolineGdtr - begin);
+    gdtr->size = gdt_size;
+    gdtr->base = (uintptr_t) gdt;
+    *(uintptr_t*) (trampoline + (vaddr_t) &trampolineStack - begin) =
+            stack + PAGESIZE;
+    *(Processor**) (trampoline + (vaddr_t) &trampolineProcessor - begin) =
+            processor;
+
+    Interrupts::sendIpi(processor->apicId, IPI_INIT);
+    delay(10000000);
+    for (int i = 0; i < 2 && !hasStarted(processor); i++) {
+        Interrupts::sendIpi(processor->apicId,
+                IPI_STARTUP | (SMP_TRAMPOLINE / PAGESIZE));
+        delay(200000);
+    }
+
+    // Give the processor some time to get through the trampoline.
+    for (int i = 0; i < 100 && !hasStarted(processor); i++) {
+        delay(1000000);
+    }
+
+    // The stack and GDT are leaked on failure because the processor might
+    // still start using them later.
+    return hasStarted(processor);
+}
+
+void Smp::startApplicationProcessors() {
+    if (numApplicationProcessors == 0) return;
+
+    vaddr_t trampoline = kernelSpace->mapPhysical(SMP_TRAMPOLINE,
+            SMP_TRAMPOLINE_PAGES * PAGESIZE, PROT_READ | PROT_WRITE);
+    if (!trampoline) PANIC("Failed to map the SMP trampoline");
+
+    memcpy((void*) trampoline, &trampolineBegin,
+            (vaddr_t) &trampolineEnd - (vaddr_t) &trampolineBegin);
+    createPageTables(trampoline);
+
+    size_t started = 0;
+    for (size_t i = 0; i < numApplicationProcessors; i++) {
+        if (!startProcessor(&processors[i], trampoline)) {
+            // The trampoline cannot be reused while a processor that did not
+            // respond might still enter it.
+            Log::printf("Processor with APIC ID %u did not start\n",
+                    processors[i].apicId);
+            break;
+        }
+        started++;
+    }
+
+    kernelSpace->unmapPhysical(trampoline, SMP_TRAMPOLINE_PAGES * PAGESIZE);
+    Log::printf("Started %zu application processors\n", started);
+}
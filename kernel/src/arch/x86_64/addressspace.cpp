@@ -20,6 +20,7 @@
 #include <assert.h>
 #include <string.h>
 #include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/panic.h>
 #include <cobalt/kernel/physicalmemory.h>
 
 #define RECURSIVE_MAPPING 0xFFFFFF0000000000
@@ -35,6 +36,7 @@
 #define PAGE_WRITABLE (1 << 1)
 #define PAGE_USER (1 << 2)
 #define PAGE_WRITE_COMBINING (1 << 7)
+#define PAGE_LARGE (1 << 7)
 #define PAGE_NO_EXECUTE (1UL << 63)
 #define PAGE_FLAGS 0xFFF0000000000FFF
 
@@ -55,15 +57,17 @@ static char _kernelMappingArea[PAGESIZE] ALIGNED(PAGESIZE);
 // they are needed before memory allocations are possible.
 static MemorySegment segments[] = {
     MemorySegment(0, 0xFFFF800000000000, PROT_NONE, nullptr, &segments[1]),
-    MemorySegment(RECURSIVE_MAPPING, -RECURSIVE_MAPPING, PROT_READ | PROT_WRITE,
+    MemorySegment(DIRECT_MAP, DIRECT_MAP_SIZE, PROT_READ | PROT_WRITE,
             &segments[0], &segments[2]),
+    MemorySegment(RECURSIVE_MAPPING, -RECURSIVE_MAPPING, PROT_READ | PROT_WRITE,
+            &segments[1], &segments[3]),
     MemorySegment((vaddr_t) &kernelVirtualBegin, (vaddr_t) &kernelExecEnd -
-            (vaddr_t) &kernelVirtualBegin, PROT_EXEC, &segments[1],
-            &segments[3]),
+            (vaddr_t) &kernelVirtualBegin, PROT_EXEC, &segments[2],
+            &segments[4]),
     MemorySegment((vaddr_t) &kernelExecEnd, (vaddr_t) &kernelReadOnlyEnd -
-            (vaddr_t) &kernelExecEnd, PROT_READ, &segments[2], &segments[4]),
+            (vaddr_t) &kernelExecEnd, PROT_READ, &segments[3], &segments[5]),
     MemorySegment((vaddr_t) &kernelReadOnlyEnd, (vaddr_t) &kernelVirtualEnd -
-            (vaddr_t) &kernelReadOnlyEnd, PROT_READ | PROT_WRITE, &segments[3],
+            (vaddr_t) &kernelReadOnlyEnd, PROT_READ | PROT_WRITE, &segments[4],
             nullptr),
 };
 
@@ -98,6 +102,8 @@ static inline uintptr_t protectionToFlags(int protection) {
 }
 
 AddressSpace::AddressSpace() {
+    fileMappings = nullptr;
+
     if (this == kernelSpace) {
         pml4 = (paddr_t) &kernelPml4;
         mappingArea = (vaddr_t) _kernelMappingArea;
@@ -177,7 +183,7 @@ AddressSpace::~AddressSpace() {
                         kernelSpace->mapAt(mappingArea, pd, PROT_READ);
                         for (size_t k = 0; k < 512; k++) {
                             paddr_t pt = mapped[k] & ~PAGE_MISALIGN;
-                            if (pt) {
+                            if (pt && !(mapped[k] & PAGE_LARGE)) {
                                 PhysicalMemory::pushPageFrame(pt);
                             }
                         }
@@ -223,6 +229,12 @@ void AddressSpace::initialize() {
     uint32_t edx;
     asm("cpuid" : "+a"(eax), "=d"(edx) :: "ebx", "ecx");
     patSupported = edx & (1 << 16);
+    initializePat();
+}
+
+void AddressSpace::initializePat() {
+    // The PAT is per processor, so this is also called on each application
+    // processor.
     if (patSupported) {
         uint32_t patLow;
         uint32_t patHigh;
@@ -250,6 +262,10 @@ paddr_t AddressSpace::getPhysicalAddress(vaddr_t virtualAddress) {
         uintptr_t* pageDir = (uintptr_t*) RECURSIVE_PAGEDIR(index.pml4Index,
                 index.pdptIndex);
         if (!pageDir[index.pdIndex]) return 0;
+        if (pageDir[index.pdIndex] & PAGE_LARGE) {
+            return (pageDir[index.pdIndex] & ~PAGE_FLAGS) +
+                    (virtualAddress & LARGE_PAGE_MISALIGN);
+        }
         uintptr_t* pageTable = (uintptr_t*) RECURSIVE_PAGETABLE(index.pml4Index,
                 index.pdptIndex, index.pdIndex);
         return pageTable[index.ptIndex] & ~PAGE_FLAGS;
@@ -271,6 +287,10 @@ paddr_t AddressSpace::getPhysicalAddress(vaddr_t virtualAddress) {
         uintptr_t pdEntry = pageDirectory[index.pdIndex];
         kernelSpace->unmap(mappingArea);
         if (!pdEntry) return 0;
+        if (pdEntry & PAGE_LARGE) {
+            return (pdEntry & ~PAGE_FLAGS) +
+                    (virtualAddress & LARGE_PAGE_MISALIGN);
+        }
 
         uintptr_t* pageTable = (uintptr_t*) kernelSpace->mapAt(mappingArea,
                 pdEntry & ~PAGE_FLAGS, PROT_READ);
@@ -383,6 +403,31 @@ vaddr_t AddressSpace::mapAt(vaddr_t virtualAddress, paddr_t physicalAddress,
                     PROT_READ | PROT_WRITE);
         }
         memset(pageTable, 0, PAGESIZE);
+    } else if (pageDir[index.pdIndex] & PAGE_LARGE) {
+        // Split the large page so that a single page of it can be changed.
+        // Large pages in user space keep a reserved frame for this.
+        paddr_t ptPhys = this == kernelSpace ? PhysicalMemory::popPageFrame() :
+                PhysicalMemory::popReserved();
+        if (!ptPhys) goto fail;
+        uintptr_t ptFlags = PAGE_PRESENT | PAGE_WRITABLE;
+        if (this != kernelSpace) ptFlags |= PAGE_USER;
+
+        uintptr_t largePage = pageDir[index.pdIndex];
+        pageDir[index.pdIndex] = ptPhys | ptFlags;
+        if (isActive()) {
+            asm ("invlpg (%0)" :: "r"(RECURSIVE_PAGETABLE(index.pml4Index,
+                    index.pdptIndex, index.pdIndex)));
+        } else {
+            kernelSpace->unmap(mappingArea);
+            pageTable = (uintptr_t*) kernelSpace->mapAt(mappingArea, ptPhys,
+                    PROT_READ | PROT_WRITE);
+        }
+
+        paddr_t base = largePage & ~PAGE_FLAGS;
+        uintptr_t pageFlags = largePage & PAGE_FLAGS & ~PAGE_LARGE;
+        for (size_t i = 0; i < 512; i++) {
+            pageTable[i] = (base + i * PAGESIZE) | pageFlags;
+        }
     } else if (!isActive()) {
         paddr_t ptPhys = pageDir[index.pdIndex] & ~PAGE_FLAGS;
         kernelSpace->unmap(mappingArea);
@@ -406,3 +451,129 @@ fail:
     }
     return 0;
 }
+
+void AddressSpace::addToDirectMap(paddr_t physicalAddress, uint64_t size) {
+    if (physicalAddress >= DIRECT_MAP_SIZE) return;
+    paddr_t end = size < DIRECT_MAP_SIZE - physicalAddress ?
+            physicalAddress + size : DIRECT_MAP_SIZE;
+    physicalAddress = ALIGNUP(physicalAddress, PAGESIZE);
+    end &= ~PAGE_MISALIGN;
+
+    // Use large pages wherever the memory covers a whole aligned 2 MiB block.
+    while (physicalAddress < end) {
+        vaddr_t virtualAddress = DIRECT_MAP + physicalAddress;
+        if (!(physicalAddress & LARGE_PAGE_MISALIGN) &&
+                end - physicalAddress >= LARGE_PAGE_SIZE &&
+                kernelSpace->canMapLargePage(virtualAddress)) {
+            kernelSpace->mapLargePage(virtualAddress, physicalAddress,
+                    PROT_READ | PROT_WRITE);
+            physicalAddress += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        if (!kernelSpace->mapAt(virtualAddress, physicalAddress,
+                PROT_READ | PROT_WRITE)) {
+            PANIC("Failed to create the direct map");
+        }
+        physicalAddress += PAGESIZE;
+    }
+}
+
+bool AddressSpace::canMapLargePage(vaddr_t virtualAddress) {
+    assert(isActive());
+    assert(!(virtualAddress & LARGE_PAGE_MISALIGN));
+    PageIndex index = addressToIndex(virtualAddress);
+
+    uintptr_t* pml4 = (uintptr_t*) RECURSIVE_PML4();
+    uintptr_t* pdpt = (uintptr_t*) RECURSIVE_PDPT(index.pml4Index);
+    uintptr_t* pageDir = (uintptr_t*) RECURSIVE_PAGEDIR(index.pml4Index,
+            index.pdptIndex);
+    if (pml4[index.pml4Index] && pdpt[index.pdptIndex] &&
+            pageDir[index.pdIndex]) {
+        if (pageDir[index.pdIndex] & PAGE_LARGE) return false;
+
+        // The page table is replaced by the large page, so it must be empty.
+        uintptr_t* pageTable = (uintptr_t*) RECURSIVE_PAGETABLE(
+                index.pml4Index, index.pdptIndex, index.pdIndex);
+        for (size_t i = 0; i < 512; i++) {
+            if (pageTable[i]) return false;
+        }
+        return true;
+    }
+
+    // Create the missing paging structures so that mapLargePage cannot fail.
+    return mapAt(virtualAddress, 0, PROT_NONE);
+}
+
+void AddressSpace::mapLargePage(vaddr_t virtualAddress,
+        paddr_t physicalAddress, int protection) {
+    assert(isActive());
+    assert(!(physicalAddress & LARGE_PAGE_MISALIGN));
+    assert(!(protection & PROT_WRITE_COMBINING));
+    PageIndex index = addressToIndex(virtualAddress);
+
+    uintptr_t flags = protectionToFlags(protection) | PAGE_LARGE;
+    if (this != kernelSpace) {
+        flags |= PAGE_USER;
+    }
+
+    uintptr_t* pageDir = (uintptr_t*) RECURSIVE_PAGEDIR(index.pml4Index,
+            index.pdptIndex);
+    paddr_t pageTable = pageDir[index.pdIndex] & ~PAGE_FLAGS;
+    pageDir[index.pdIndex] = physicalAddress | flags;
+    asm ("invlpg (%0)" :: "r"(RECURSIVE_PAGETABLE(index.pml4Index,
+            index.pdptIndex, index.pdIndex)));
+    PhysicalMemory::pushPageFrame(pageTable);
+}
+
+bool AddressSpace::unmapLargePage(vaddr_t virtualAddress) {
+    PageIndex index = addressToIndex(virtualAddress);
+
+    if (isActive()) {
+        uintptr_t* pml4 = (uintptr_t*) RECURSIVE_PML4();
+        if (!pml4[index.pml4Index]) return false;
+        uintptr_t* pdpt = (uintptr_t*) RECURSIVE_PDPT(index.pml4Index);
+        if (!pdpt[index.pdptIndex]) return false;
+        uintptr_t* pageDir = (uintptr_t*) RECURSIVE_PAGEDIR(index.pml4Index,
+                index.pdptIndex);
+        if (!(pageDir[index.pdIndex] & PAGE_LARGE)) return false;
+
+        pageDir[index.pdIndex] = 0;
+        asm ("invlpg (%0)" :: "r"(virtualAddress));
+        return true;
+    }
+
+    uintptr_t* table = (uintptr_t*) kernelSpace->mapAt(mappingArea, pml4,
+            PROT_READ | PROT_WRITE);
+    uintptr_t entry = table[index.pml4Index];
+    if (entry) {
+        table = (uintptr_t*) kernelSpace->mapAt(mappingArea,
+                entry & ~PAGE_FLAGS, PROT_READ | PROT_WRITE);
+        entry = table[index.pdptIndex];
+    }
+    if (entry) {
+        table = (uintptr_t*) kernelSpace->mapAt(mappingArea,
+                entry & ~PAGE_FLAGS, PROT_READ | PROT_WRITE);
+        entry = table[index.pdIndex];
+    }
+
+    bool large = entry & PAGE_LARGE;
+    if (large) {
+        table[index.pdIndex] = 0;
+    }
+    kernelSpace->unmap(mappingArea);
+    return large;
+}
+
+vaddr_t AddressSpace::mapFrame(paddr_t physicalAddress) {
+    assert(this == kernelSpace);
+    assert(physicalAddress < DIRECT_MAP_SIZE);
+    return DIRECT_MAP + physicalAddress;
+}
+
+void AddressSpace::unmapFrame(vaddr_t virtualAddress) {
+    // Frames are accessed through the direct map, so there is nothing to do.
+    assert(virtualAddress >= DIRECT_MAP &&
+            virtualAddress < DIRECT_MAP + DIRECT_MAP_SIZE);
+    (void) virtualAddress;
+}
@@ -67,6 +67,11 @@
 #define BUSMASTER_STATUS_ERROR (1 << 1)
 #define BUSMASTER_STATUS_INTERRUPT (1 << 2)
 
+// A single PRD can transfer up to 64 KiB if it does not cross a 64 KiB
+// boundary, so the DMA region is allocated as an aligned 64 KiB block.
+#define DMA_REGION_ORDER 4
+#define DMA_REGION_SIZE (PAGESIZE << DMA_REGION_ORDER)
+
 static size_t numAtaDevices = 0;
 static void onAtaIrq(void* user, const InterruptContext* context);
 
@@ -168,10 +173,11 @@ AtaChannel::AtaChannel(uint16_t iobase, uint16_t ctrlbase,
     this->prdPhys = prdPhys;
     this->prdVirt = prdVirt;
 
-    dmaRegion = PhysicalMemory::popPageFrame32();
+    dmaRegion = PhysicalMemory::allocateContiguous(DMA_REGION_ORDER,
+            0xFFFFFFFF);
     if (!dmaRegion) PANIC("Failed to allocate DMA region");
 
-    dmaMapped = kernelSpace->mapPhysical(dmaRegion, PAGESIZE,
+    dmaMapped = kernelSpace->mapPhysical(dmaRegion, DMA_REGION_SIZE,
             PROT_READ | PROT_WRITE);
     if (!dmaMapped) PANIC("Failed to map DMA region");
 
@@ -301,7 +307,8 @@ bool AtaChannel::readSectors(char* buffer, size_t sectorCount, uint64_t lba,
 
     uint32_t* prd = (uint32_t*) prdVirt;
     prd[0] = dmaRegion;
-    prd[1] = (sectorCount * sectorSize) | (1U << 31);
+    // A byte count of 0 means 64 KiB.
+    prd[1] = ((sectorCount * sectorSize) & 0xFFFF) | (1U << 31);
     outl(busmasterBase + REGISTER_BUSMASTER_PRDT, prdPhys);
 
     outb(busmasterBase + REGISTER_BUSMASTER_STATUS,
@@ -360,7 +367,8 @@ bool AtaChannel::writeSectors(const char* buffer, size_t sectorCount,
 
     uint32_t* prd = (uint32_t*) prdVirt;
     prd[0] = dmaRegion;
-    prd[1] = (sectorCount * sectorSize) | (1U << 31);
+    // A byte count of 0 means 64 KiB.
+    prd[1] = ((sectorCount * sectorSize) & 0xFFFF) | (1U << 31);
     outl(busmasterBase + REGISTER_BUSMASTER_PRDT, prdPhys);
 
     outb(busmasterBase + REGISTER_BUSMASTER_STATUS,
@@ -426,42 +434,54 @@ bool AtaDevice::readUncached(void* buffer, size_t size, off_t offset,
 
     assert(offset % sectorSize == 0);
     assert(size % sectorSize == 0);
-    assert(size <= PAGESIZE);
     assert(offset < stats.st_size);
 
-    size_t sectors = size / sectorSize;
-    uint64_t lba = offset / sectorSize;
-    if (!channel->readSectors(buf, sectors, lba, secondary, sectorSize)) {
-        errno = EIO;
-        return false;
+    while (size > 0) {
+        size_t transferSize = size < DMA_REGION_SIZE ? size : DMA_REGION_SIZE;
+        size_t sectors = transferSize / sectorSize;
+        uint64_t lba = offset / sectorSize;
+        if (!channel->readSectors(buf, sectors, lba, secondary, sectorSize)) {
+            errno = EIO;
+            return false;
+        }
+
+        buf += transferSize;
+        offset += transferSize;
+        size -= transferSize;
     }
 
     return true;
 }
 
+int AtaDevice::syncUncached(int /*flags*/) {
+    if (!channel->flushCache(secondary)) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
 bool AtaDevice::writeUncached(const void* buffer, size_t size, off_t offset,
         int /*flags*/) {
     const char* buf = (const char*) buffer;
 
     assert(offset % sectorSize == 0);
     assert(size % sectorSize == 0);
-    assert(size <= PAGESIZE);
     assert(offset < stats.st_size);
 
-    size_t sectors = size / sectorSize;
-    uint64_t lba = offset / sectorSize;
-    if (!channel->writeSectors(buf, sectors, lba, secondary, sectorSize)) {
-        errno = EIO;
-        return false;
+    while (size > 0) {
+        size_t transferSize = size < DMA_REGION_SIZE ? size : DMA_REGION_SIZE;
+        size_t sectors = transferSize / sectorSize;
+        uint64_t lba = offset / sectorSize;
+        if (!channel->writeSectors(buf, sectors, lba, secondary, sectorSize)) {
+            errno = EIO;
+            return false;
+        }
+
+        buf += transferSize;
+        offset += transferSize;
+        size -= transferSize;
     }
 
     return true;
 }
-
-int AtaDevice::sync(int /*flags*/) {
-    if (!channel->flushCache(secondary)) {
-        errno = EIO;
-        return -1;
-    }
-    return 0;
-}
@@ -18,52 +18,266 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
+#include <cobalt/oflags.h>
 #include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/blockcache.h>
+#include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/interrupts.h>
 
+#define MAX_IO_BLOCKS (sizeof(ioFrames) / sizeof(ioFrames[0]))
+// The readahead window starts at this many blocks and is doubled for each
+// sequential cache miss until it reaches MAX_IO_BLOCKS.
+#define READAHEAD_MIN 4
+// Dirty blocks are written back after this delay. Writers flush the cache
+// themselves when there are too many dirty blocks.
+#define FLUSH_DELAY 1 // seconds
+#define DIRTY_LIMIT 1024
+
 static void worker(void* device) {
     BlockCacheDevice* dev = (BlockCacheDevice*) device;
     dev->freeUnusedBlocks();
 }
 
+static void flusher(void* device) {
+    BlockCacheDevice* dev = (BlockCacheDevice*) device;
+    dev->flushDirtyBlocks();
+}
+
 BlockCacheDevice::BlockCacheDevice(mode_t mode, dev_t dev)
         : Vnode(mode | S_IFBLK, dev),
-        blocks(sizeof(blockBuffer) / sizeof(blockBuffer[0]), blockBuffer) {
+        blocks(sizeof(initialBuffer) / sizeof(initialBuffer[0]),
+        initialBuffer) {
     cacheMutex = KTHREAD_MUTEX_INITIALIZER;
     freeList = nullptr;
-    leastRecentlyUsed = nullptr;
-    mostRecentlyUsed = nullptr;
     workerJob.func = worker;
     workerJob.context = this;
+    clockHand = nullptr;
+    numBlocks = 0;
+    cacheStats = {};
+    firstDirty = nullptr;
+    dirtyBlocks = 0;
+    flushScheduled = false;
+    writeError = false;
+    flushJob.func = flusher;
+    flushJob.context = this;
+    nextReadBlock = 0;
+    readaheadBlocks = 0;
+}
+
+BlockCacheDevice::Block* BlockCacheDevice::addBlocks(uint64_t blockNumber,
+        size_t count, bool read, int flags) {
+    // Adds up to count blocks starting at blockNumber to the cache and returns
+    // the first one. The range ends early at blocks that are already cached.
+    // This function must be called with the cache mutex held, but releases it
+    // while allocating memory.
+    uint64_t deviceBlocks = ALIGNUP(stats.st_size, PAGESIZE) / PAGESIZE;
+    if (count > deviceBlocks - blockNumber) {
+        count = deviceBlocks - blockNumber;
+    }
+    if (count > MAX_IO_BLOCKS) {
+        count = MAX_IO_BLOCKS;
+    }
+    for (size_t i = 1; i < count; i++) {
+        if (blocks.get(blockNumber + i)) {
+            count = i;
+            break;
+        }
+    }
+
+    kthread_mutex_unlock(&cacheMutex);
+
+    Block* first = nullptr;
+    Block* last = nullptr;
+    size_t allocated = 0;
+    while (allocated < count) {
+        paddr_t physicalAddress = allocateCache();
+        if (!physicalAddress) break;
+        vaddr_t address = kernelSpace->mapFrame(physicalAddress);
+        if (!address) {
+            returnCache(physicalAddress);
+            break;
+        }
+        Block* block = new Block(address, blockNumber + allocated);
+        if (!block) {
+            kernelSpace->unmapFrame(address);
+            returnCache(physicalAddress);
+            break;
+        }
+
+        block->nextFree = nullptr;
+        if (last) {
+            last->nextFree = block;
+        } else {
+            first = block;
+        }
+        last = block;
+        allocated++;
+    }
+
+    kthread_mutex_lock(&cacheMutex);
+
+    if (!first) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    if (read) {
+        size_t i = 0;
+        for (Block* block = first; block; block = block->nextFree) {
+            ioFrames[i++] = kernelSpace->getPhysicalAddress(block->address);
+        }
+
+        if (!transferBlocks(blockNumber, allocated, false, flags)) {
+            while (first) {
+                Block* next = first->nextFree;
+                paddr_t physicalAddress =
+                        kernelSpace->getPhysicalAddress(first->address);
+                kernelSpace->unmapFrame(first->address);
+                returnCache(physicalAddress);
+                delete first;
+                first = next;
+            }
+            return nullptr;
+        }
+    }
+
+    for (Block* block = first; block; block = block->nextFree) {
+        blocks.add(block);
+
+        // Insert the block behind the clock hand so that it is the last block
+        // to be considered for replacement.
+        if (clockHand) {
+            block->nextInClock = clockHand;
+            block->prevInClock = clockHand->prevInClock;
+            clockHand->prevInClock->nextInClock = block;
+            clockHand->prevInClock = block;
+        } else {
+            block->nextInClock = block;
+            block->prevInClock = block;
+            clockHand = block;
+        }
+        numBlocks++;
+    }
+    if (read) {
+        cacheStats.bcs_readahead += allocated - 1;
+    }
+
+    // Keep the chains of the hash table short.
+    if (numBlocks > blocks.getCapacity()) {
+        size_t newCapacity = 2 * blocks.getCapacity();
+        Block** buffer = (Block**) reallocarray(nullptr, newCapacity,
+                sizeof(Block*));
+        if (buffer) {
+            Block** oldBuffer = blocks.resize(newCapacity, buffer);
+            if (oldBuffer != initialBuffer) {
+                free(oldBuffer);
+            }
+        }
+    }
+
+    return first;
+}
+
+int BlockCacheDevice::devctl(int command, void* restrict data, size_t size,
+        int* restrict info) {
+    switch (command) {
+    case BLOCKCACHE_GET_STATS: {
+        if (size != 0 && size != sizeof(struct blockcache_stats)) {
+            *info = -1;
+            return EINVAL;
+        }
+
+        AutoLock lock(&cacheMutex);
+        struct blockcache_stats* result = (struct blockcache_stats*) data;
+        *result = cacheStats;
+        result->bcs_cached = numBlocks;
+        result->bcs_dirty = dirtyBlocks;
+        *info = 0;
+        return 0;
+    } break;
+    default:
+        *info = -1;
+        return EINVAL;
+    }
+}
+
+void BlockCacheDevice::flushDirtyBlocks() {
+    AutoLock lock(&cacheMutex);
+    flushScheduled = false;
+    writeDirtyBlocks(0);
 }
 
 bool BlockCacheDevice::isSeekable() {
     return true;
 }
 
-void BlockCacheDevice::useBlock(Block* block) {
-    // Remove the block from its current location.
-    if (block->prevAccessed) {
-        block->prevAccessed->nextAccessed = block->nextAccessed;
-    } else if (block == leastRecentlyUsed) {
-        leastRecentlyUsed = block->nextAccessed;
+void BlockCacheDevice::setClean(Block* block) {
+    if (!block->dirty) return;
+
+    block->dirty = false;
+    if (block->prevDirty) {
+        block->prevDirty->nextDirty = block->nextDirty;
+    } else {
+        firstDirty = block->nextDirty;
+    }
+    if (block->nextDirty) {
+        block->nextDirty->prevDirty = block->prevDirty;
+    }
+    dirtyBlocks--;
+}
+
+void BlockCacheDevice::setDirty(Block* block) {
+    if (block->dirty) return;
+
+    block->dirty = true;
+    block->prevDirty = nullptr;
+    block->nextDirty = firstDirty;
+    if (firstDirty) {
+        firstDirty->prevDirty = block;
+    }
+    firstDirty = block;
+    dirtyBlocks++;
+
+    if (!flushScheduled) {
+        struct timespec time;
+        Clock::get(CLOCK_MONOTONIC)->getTime(&time);
+        time.tv_sec += FLUSH_DELAY;
+
+        Interrupts::disable();
+        WorkerThread::addDelayedJob(&flushJob, time);
+        Interrupts::enable();
+        flushScheduled = true;
+    }
+}
+
+bool BlockCacheDevice::transferBlocks(uint64_t blockNumber, size_t count,
+        bool write, int flags) {
+    // Transfers the blocks whose frames are in ioFrames. The frames are mapped
+    // contiguously so that the device can transfer them with one request.
+    off_t offset = blockNumber * PAGESIZE;
+    size_t size = count * PAGESIZE;
+    if (unlikely(offset + (off_t) size > stats.st_size)) {
+        // The device ends before the end of the page.
+        size = stats.st_size - offset;
     }
-    if (block->nextAccessed) {
-        block->nextAccessed->prevAccessed = block->prevAccessed;
-    } else if (block == mostRecentlyUsed) {
-        mostRecentlyUsed = block->prevAccessed;
+
+    vaddr_t window = kernelSpace->mapPhysicalPages(ioFrames, count,
+            PROT_READ | PROT_WRITE);
+    if (!window) {
+        errno = ENOMEM;
+        return false;
     }
 
-    // Add the block as the most recently used.
-    block->prevAccessed = mostRecentlyUsed;
-    if (mostRecentlyUsed) {
-        mostRecentlyUsed->nextAccessed = block;
+    bool result;
+    if (write) {
+        result = writeUncached((const void*) window, size, offset, flags);
     } else {
-        leastRecentlyUsed = block;
+        result = readUncached((void*) window, size, offset, flags);
     }
-    mostRecentlyUsed = block;
-    block->nextAccessed = nullptr;
+
+    kernelSpace->unmapPhysical(window, count * PAGESIZE);
+    return result;
 }
 
 ssize_t BlockCacheDevice::pread(void* buffer, size_t size, off_t offset,
@@ -81,67 +295,45 @@ ssize_t BlockCacheDevice::pread(void* buffer, size_t size, off_t offset,
         size = stats.st_size - offset;
     }
 
-    kthread_mutex_lock(&cacheMutex);
-    Block* allocatedBlock = nullptr;
+    AutoLock cacheLock(&cacheMutex);
     ssize_t bytesRead = 0;
     char* buf = (char*) buffer;
 
     while (size > 0) {
         uint64_t blockNumber = offset / PAGESIZE;
-        off_t blockOffset = blockNumber * PAGESIZE;
+
+        if (blockNumber != nextReadBlock && blockNumber + 1 != nextReadBlock) {
+            // Random accesses do not benefit from readahead.
+            readaheadBlocks = 0;
+        }
 
         Block* block = blocks.get(blockNumber);
-        if (!block) {
-            if (!allocatedBlock) {
-                kthread_mutex_unlock(&cacheMutex);
-
-                paddr_t physicalAddress = allocateCache();
-                if (!physicalAddress) {
-                    if (bytesRead) return bytesRead;
-                    errno = ENOMEM;
-                    return -1;
-                }
-                vaddr_t address = kernelSpace->mapPhysical(physicalAddress,
-                        PAGESIZE, PROT_READ | PROT_WRITE);
-                if (!address) {
-                    returnCache(physicalAddress);
-                    if (bytesRead) return bytesRead;
-                    errno = ENOMEM;
-                    return -1;
+        if (block) {
+            cacheStats.bcs_hits++;
+        } else {
+            cacheStats.bcs_misses++;
+            size_t count = ALIGNUP((offset & PAGE_MISALIGN) + size,
+                    PAGESIZE) / PAGESIZE;
+            if (blockNumber == nextReadBlock) {
+                if (readaheadBlocks == 0) {
+                    readaheadBlocks = READAHEAD_MIN;
+                } else if (readaheadBlocks < MAX_IO_BLOCKS) {
+                    readaheadBlocks *= 2;
                 }
-                allocatedBlock = new Block(address, blockNumber);
-                if (!allocatedBlock) {
-                    kernelSpace->unmapPhysical(address, PAGESIZE);
-                    returnCache(physicalAddress);
-                    if (bytesRead) return bytesRead;
-                    return -1;
+                if (count < readaheadBlocks) {
+                    count = readaheadBlocks;
                 }
-
-                kthread_mutex_lock(&cacheMutex);
             }
 
-            block = blocks.get(blockNumber);
-
+            block = addBlocks(blockNumber, count, true, flags);
             if (!block) {
-                size_t readSize = PAGESIZE;
-                if (unlikely(blockOffset + PAGESIZE > stats.st_size)) {
-                    // The device ends before the end of the page.
-                    readSize = stats.st_size - blockOffset;
-                }
-
-                if (!readUncached((void*) allocatedBlock->address, readSize,
-                        blockOffset, flags)) {
-                    if (!bytesRead) bytesRead = -1;
-                    break;
-                }
-
-                block = allocatedBlock;
-                allocatedBlock = nullptr;
-                blocks.add(block);
+                if (!bytesRead) bytesRead = -1;
+                break;
             }
         }
 
-        useBlock(block);
+        block->referenced = true;
+        nextReadBlock = blockNumber + 1;
 
         size_t readSize = PAGESIZE - (offset & PAGE_MISALIGN);
         if (readSize > size) readSize = size;
@@ -153,16 +345,6 @@ ssize_t BlockCacheDevice::pread(void* buffer, size_t size, off_t offset,
         size -= readSize;
     }
 
-    kthread_mutex_unlock(&cacheMutex);
-
-    if (allocatedBlock) {
-        paddr_t physicalAddress = kernelSpace->getPhysicalAddress(
-                allocatedBlock->address);
-        kernelSpace->unmapPhysical(allocatedBlock->address, PAGESIZE);
-        returnCache(physicalAddress);
-        delete allocatedBlock;
-    }
-
     return bytesRead;
 }
 
@@ -184,8 +366,7 @@ ssize_t BlockCacheDevice::pwrite(const void* buffer, size_t size, off_t offset,
         size = stats.st_size - offset;
     }
 
-    kthread_mutex_lock(&cacheMutex);
-    Block* allocatedBlock = nullptr;
+    AutoLock cacheLock(&cacheMutex);
     ssize_t bytesWritten = 0;
     const char* buf = (const char*) buffer;
 
@@ -194,90 +375,41 @@ ssize_t BlockCacheDevice::pwrite(const void* buffer, size_t size, off_t offset,
         off_t blockOffset = blockNumber * PAGESIZE;
 
         Block* block = blocks.get(blockNumber);
-        if (!block) {
-            if (!allocatedBlock) {
-                kthread_mutex_unlock(&cacheMutex);
-
-                paddr_t physicalAddress = allocateCache();
-                if (!physicalAddress) {
-                    if (bytesWritten) return bytesWritten;
-                    errno = ENOMEM;
-                    return -1;
-                }
-                vaddr_t address = kernelSpace->mapPhysical(physicalAddress,
-                        PAGESIZE, PROT_READ | PROT_WRITE);
-                if (!address) {
-                    returnCache(physicalAddress);
-                    if (bytesWritten) return bytesWritten;
-                    errno = ENOMEM;
-                    return -1;
-                }
-                allocatedBlock = new Block(address, blockNumber);
-                if (!allocatedBlock) {
-                    kernelSpace->unmapPhysical(address, PAGESIZE);
-                    returnCache(physicalAddress);
-                    if (bytesWritten) return bytesWritten;
-                    return -1;
-                }
-
-                kthread_mutex_lock(&cacheMutex);
-            }
-
-            block = blocks.get(blockNumber);
-
+        if (block) {
+            cacheStats.bcs_hits++;
+        } else {
+            cacheStats.bcs_misses++;
+            // Only read the block from the device if we are not overwriting
+            // it completely.
+            bool read = offset != blockOffset || size < PAGESIZE;
+            block = addBlocks(blockNumber, 1, read, flags);
             if (!block) {
-                // Only read the block from the device if we are not overwriting
-                // it completely.
-                if (offset != blockOffset || size < PAGESIZE) {
-                    size_t readSize = PAGESIZE;
-                    if (unlikely(blockOffset + PAGESIZE > stats.st_size)) {
-                        // The device ends before the end of the page.
-                        readSize = stats.st_size - blockOffset;
-                    }
-
-                    if (!readUncached((void*) allocatedBlock->address, readSize,
-                            blockOffset, flags)) {
-                        if (!bytesWritten) bytesWritten = -1;
-                        break;
-                    }
-                }
-
-                block = allocatedBlock;
-                allocatedBlock = nullptr;
-                blocks.add(block);
+                if (!bytesWritten) bytesWritten = -1;
+                break;
             }
         }
 
-        useBlock(block);
+        block->referenced = true;
 
         size_t writeSize = PAGESIZE - (offset & PAGE_MISALIGN);
         if (writeSize > size) writeSize = size;
 
         memcpy((char*) block->address + (offset & PAGE_MISALIGN),
                 buf + bytesWritten, writeSize);
-
-        off_t writeOffset = offset & ~(stats.st_blksize - 1);
-        size_t writeLength = ALIGNUP(writeSize, stats.st_blksize);
-
-        if (!writeUncached((char*) block->address + (writeOffset &
-                PAGE_MISALIGN), writeLength, writeOffset, flags)) {
-            if (bytesWritten == 0) return -1;
-            return bytesWritten;
-        }
+        setDirty(block);
 
         offset += writeSize;
         bytesWritten += writeSize;
         size -= writeSize;
     }
 
-    kthread_mutex_unlock(&cacheMutex);
-
-    if (allocatedBlock) {
-        paddr_t physicalAddress = kernelSpace->getPhysicalAddress(
-                allocatedBlock->address);
-        kernelSpace->unmapPhysical(allocatedBlock->address, PAGESIZE);
-        returnCache(physicalAddress);
-        delete allocatedBlock;
+    if (flags & O_SYNC || dirtyBlocks >= DIRTY_LIMIT) {
+        writeDirtyBlocks(flags);
+        if (flags & O_SYNC && writeError) {
+            writeError = false;
+            errno = EIO;
+            return -1;
+        }
     }
 
     return bytesWritten;
@@ -290,7 +422,7 @@ void BlockCacheDevice::freeUnusedBlocks() {
     kthread_mutex_unlock(&cacheMutex);
 
     while (block) {
-        kernelSpace->unmapPhysical(block->address, PAGESIZE);
+        kernelSpace->unmapFrame(block->address);
         Block* nextBlock = block->nextFree;
         delete block;
         block = nextBlock;
@@ -298,19 +430,41 @@ void BlockCacheDevice::freeUnusedBlocks() {
 }
 
 paddr_t BlockCacheDevice::reclaimCache() {
-    AutoLock lock(&cacheMutex);
-
-    Block* block = leastRecentlyUsed;
-    if (!block) return 0;
+    // The cache mutex might already be held by a thread that is copying to
+    // user memory and has page faulted. Waiting for it here could deadlock.
+    if (kthread_mutex_trylock(&cacheMutex) != 0) return 0;
+
+    // Advance the clock hand until it finds a block that has not been
+    // referenced since the hand last passed it. Dirty blocks cannot be
+    // reclaimed before they have been written back.
+    Block* block = nullptr;
+    for (size_t i = 0; i < 2 * numBlocks; i++) {
+        Block* candidate = clockHand;
+        clockHand = candidate->nextInClock;
+        if (candidate->dirty) continue;
+        if (candidate->referenced) {
+            candidate->referenced = false;
+            continue;
+        }
+        block = candidate;
+        break;
+    }
+    if (!block) {
+        kthread_mutex_unlock(&cacheMutex);
+        return 0;
+    }
 
-    leastRecentlyUsed = block->nextAccessed;
-    if (leastRecentlyUsed) {
-        leastRecentlyUsed->prevAccessed = nullptr;
+    if (--numBlocks == 0) {
+        clockHand = nullptr;
     } else {
-        mostRecentlyUsed = nullptr;
+        if (clockHand == block) {
+            clockHand = block->nextInClock;
+        }
+        block->prevInClock->nextInClock = block->nextInClock;
+        block->nextInClock->prevInClock = block->prevInClock;
     }
-
     blocks.remove(block->blockNumber);
+    cacheStats.bcs_evictions++;
 
     block->nextFree = freeList;
     freeList = block;
@@ -321,14 +475,62 @@ paddr_t BlockCacheDevice::reclaimCache() {
     }
 
     paddr_t physicalAddress = kernelSpace->getPhysicalAddress(block->address);
+    kthread_mutex_unlock(&cacheMutex);
     // We cannot unmap the block yet because the PMM is locked. This will be
     // handled by the worker thread.
     return physicalAddress;
 }
 
+int BlockCacheDevice::sync(int flags) {
+    kthread_mutex_lock(&cacheMutex);
+    writeDirtyBlocks(flags);
+    bool error = writeError;
+    writeError = false;
+    kthread_mutex_unlock(&cacheMutex);
+
+    if (syncUncached(flags) < 0) return -1;
+    if (error) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+void BlockCacheDevice::writeDirtyBlocks(int flags) {
+    // Adjacent dirty blocks are written back together. This function must be
+    // called with the cache mutex held.
+    while (firstDirty) {
+        uint64_t blockNumber = firstDirty->blockNumber;
+        for (size_t i = 1; i < MAX_IO_BLOCKS && blockNumber > 0; i++) {
+            Block* previous = blocks.get(blockNumber - 1);
+            if (!previous || !previous->dirty) break;
+            blockNumber--;
+        }
+
+        size_t count = 0;
+        while (count < MAX_IO_BLOCKS) {
+            Block* block = blocks.get(blockNumber + count);
+            if (!block || !block->dirty) break;
+            ioFrames[count++] = kernelSpace->getPhysicalAddress(block->address);
+            setClean(block);
+        }
+        cacheStats.bcs_writebacks += count;
+
+        // Blocks that could not be written are lost. The error is reported by
+        // the next sync.
+        if (!transferBlocks(blockNumber, count, true, flags)) {
+            writeError = true;
+        }
+    }
+}
+
 BlockCacheDevice::Block::Block(vaddr_t address, uint64_t blockNumber) {
     this->address = address;
     this->blockNumber = blockNumber;
-    prevAccessed = nullptr;
-    nextAccessed = nullptr;
+    dirty = false;
+    referenced = false;
+    prevInClock = nullptr;
+    nextInClock = nullptr;
+    prevDirty = nullptr;
+    nextDirty = nullptr;
 }
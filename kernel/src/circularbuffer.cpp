@@ -43,6 +43,30 @@ size_t CircularBuffer::spaceAvailable() {
     return bufferSize - bytesStored;
 }
 
+void CircularBuffer::consume(size_t size) {
+    readPosition = (readPosition + size) % bufferSize;
+    bytesStored -= size;
+}
+
+size_t CircularBuffer::peek(void* buf, size_t size) {
+    size_t position = readPosition;
+    size_t bytesRead = 0;
+    while (bytesRead < bytesStored && bytesRead < size) {
+        size_t count = bufferSize - position;
+        if (count > size - bytesRead) count = size - bytesRead;
+        if (count > bytesStored - bytesRead) count = bytesStored - bytesRead;
+
+        memcpy((char*) buf + bytesRead, buffer + position, count);
+        position = (position + count) % bufferSize;
+        bytesRead += count;
+    }
+    return bytesRead;
+}
+
+void CircularBuffer::produce(size_t size) {
+    bytesStored += size;
+}
+
 size_t CircularBuffer::read(void* buf, size_t size) {
     size_t bytesRead = 0;
     while (bytesStored > 0 && bytesRead < size) {
@@ -58,6 +82,12 @@ size_t CircularBuffer::read(void* buf, size_t size) {
     return bytesRead;
 }
 
+const char* CircularBuffer::readRegion(size_t* size) {
+    *size = bufferSize - readPosition;
+    if (*size > bytesStored) *size = bytesStored;
+    return buffer + readPosition;
+}
+
 size_t CircularBuffer::write(const void* buf, size_t size) {
     size_t written = 0;
     while (spaceAvailable() > 0 && written < size) {
@@ -72,3 +102,10 @@ size_t CircularBuffer::write(const void* buf, size_t size) {
     }
     return written;
 }
+
+char* CircularBuffer::writeRegion(size_t* size) {
+    size_t writeIndex = (readPosition + bytesStored) % bufferSize;
+    *size = bufferSize - writeIndex;
+    if (*size > spaceAvailable()) *size = spaceAvailable();
+    return buffer + writeIndex;
+}
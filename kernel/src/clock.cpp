@@ -18,7 +18,6 @@
  */
 
 #include <errno.h>
-#include <sched.h>
 #include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/process.h>
 #include <cobalt/kernel/signal.h>
@@ -26,6 +25,21 @@
 static Clock monotonicClock;
 static Clock realtimeClock;
 
+static EventTimer* eventTimer;
+// The event timer time at which the clocks were last updated.
+static uint64_t lastUpdate;
+// The event timer time up to which CPU time has been accounted.
+static uint64_t lastSchedule;
+
+static void updateClocks() {
+    // This function needs to be called with interrupts disabled.
+    uint64_t now = eventTimer->getTime();
+    unsigned long nanoseconds = now - lastUpdate;
+    lastUpdate = now;
+    monotonicClock.tick(nanoseconds);
+    realtimeClock.tick(nanoseconds);
+}
+
 struct timespec timespecPlus(struct timespec ts1, struct timespec ts2) {
     struct timespec result;
     result.tv_sec = ts1.tv_sec + ts2.tv_sec;
@@ -78,6 +92,17 @@ Clock* Clock::get(clockid_t clockid) {
 }
 
 int Clock::getTime(struct timespec* result) {
+    if (eventTimer && (this == &monotonicClock || this == &realtimeClock)) {
+        // Without a periodic timer interrupt the clocks need to be updated
+        // whenever they are read.
+        bool interruptsEnabled = Interrupts::areEnabled();
+        Interrupts::disable();
+        updateClocks();
+        *result = value;
+        if (interruptsEnabled) Interrupts::enable();
+        return 0;
+    }
+
     *result = value;
     return 0;
 }
@@ -88,18 +113,23 @@ int Clock::nanosleep(int flags, const struct timespec* requested,
         return errno = EINVAL;
     }
 
+    struct timespec now;
+    getTime(&now);
     struct timespec abstime;
     if (flags & TIMER_ABSTIME) {
         abstime = *requested;
     } else {
-        abstime = timespecPlus(value, *requested);
+        abstime = timespecPlus(now, *requested);
     }
 
-    while (timespecLess(value, abstime) && !Signal::isPending()) {
-        sched_yield();
+    Interrupts::disable();
+    while (timespecLess(now, abstime) && !Signal::isPending()) {
+        Thread::block(true, this, &abstime);
+        getTime(&now);
     }
+    Interrupts::enable();
 
-    struct timespec diff = timespecMinus(abstime, value);
+    struct timespec diff = timespecMinus(abstime, now);
     if (diff.tv_sec > 0 || (diff.tv_sec == 0 && diff.tv_nsec > 0)) {
         if (remaining) *remaining = diff;
         return errno = EINTR;
@@ -108,23 +138,37 @@ int Clock::nanosleep(int flags, const struct timespec* requested,
     return 0;
 }
 
+uint64_t Clock::nanosecondsUntil(struct timespec time) {
+    if (this != &monotonicClock && this != &realtimeClock) {
+        // CPU time clocks only advance while a thread is running, so we
+        // cannot know when they will reach the given time.
+        return UINT64_MAX;
+    }
+
+    struct timespec now;
+    getTime(&now);
+    if (!timespecLess(now, time)) return 0;
+    struct timespec diff = timespecMinus(time, now);
+    if ((uint64_t) diff.tv_sec >= UINT64_MAX / 1000000000) return UINT64_MAX;
+    return diff.tv_sec * 1000000000ULL + diff.tv_nsec;
+}
+
 int Clock::setTime(struct timespec* newValue) {
     value = *newValue;
     return 0;
 }
 
 void Clock::tick(unsigned long nanoseconds) {
-    value.tv_nsec += nanoseconds;
+    value.tv_sec += nanoseconds / 1000000000L;
+    value.tv_nsec += nanoseconds % 1000000000L;
 
-    while (value.tv_nsec >= 1000000000L) {
+    if (value.tv_nsec >= 1000000000L) {
         value.tv_sec++;
         value.tv_nsec -= 1000000000L;
     }
 }
 
-void Clock::onTick(bool user, unsigned long nanoseconds) {
-    monotonicClock.tick(nanoseconds);
-    realtimeClock.tick(nanoseconds);
+static void accountCpuTime(bool user, unsigned long nanoseconds) {
     Process::current()->cpuClock.tick(nanoseconds);
     if (user) {
         Process::current()->userCpuClock.tick(nanoseconds);
@@ -132,4 +176,35 @@ void Clock::onTick(bool user, unsigned long nanoseconds) {
         Process::current()->systemCpuClock.tick(nanoseconds);
     }
     Thread::current()->cpuClock.tick(nanoseconds);
+    Thread::current()->addRuntime(nanoseconds);
+}
+
+void Clock::onSchedule(bool user) {
+    // This function needs to be called with interrupts disabled.
+    if (!eventTimer) return;
+
+    // Account the time since the last scheduling to the current thread. With
+    // a periodic timer this is done by onTick instead.
+    updateClocks();
+    accountCpuTime(user, lastUpdate - lastSchedule);
+    lastSchedule = lastUpdate;
+}
+
+void Clock::onTick(bool user, unsigned long nanoseconds) {
+    monotonicClock.tick(nanoseconds);
+    realtimeClock.tick(nanoseconds);
+    accountCpuTime(user, nanoseconds);
+}
+
+void Clock::setEventTimer(EventTimer* timer) {
+    lastUpdate = timer->getTime();
+    lastSchedule = lastUpdate;
+    eventTimer = timer;
+}
+
+void Clock::setTimeout(uint64_t nanoseconds) {
+    // This function needs to be called with interrupts disabled.
+    if (eventTimer) {
+        eventTimer->setTimeout(nanoseconds);
+    }
 }
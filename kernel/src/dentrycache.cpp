@@ -0,0 +1,192 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/dentrycache.cpp
+ * Directory entry cache.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <cobalt/kernel/dentrycache.h>
+#include <cobalt/kernel/kthread.h>
+
+#define BUCKET_COUNT 1024
+#define MAX_ENTRIES 8192
+#define MAX_NAME_LENGTH 255
+
+namespace {
+struct Entry {
+    Entry* nextInBucket;
+    // Entries are kept in least recently used order for eviction.
+    Entry* prev;
+    Entry* next;
+    dev_t dev;
+    ino_t directory;
+    ino_t ino;
+    Vnode* vnode;
+    size_t nameLength;
+    char name[];
+};
+}
+
+static Entry* buckets[BUCKET_COUNT];
+static Entry* firstEntry;
+static Entry* lastEntry;
+static size_t entryCount;
+static kthread_mutex_t mutex = KTHREAD_MUTEX_INITIALIZER;
+
+static size_t hashName(dev_t dev, ino_t directory, const char* name,
+        size_t length) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) name[i]) * 16777619U;
+    }
+    hash ^= (uint32_t) (directory ^ (uint64_t) directory >> 32) * 2654435761U;
+    hash ^= (uint32_t) dev;
+    return hash % BUCKET_COUNT;
+}
+
+static Entry* findEntry(size_t hash, dev_t dev, ino_t directory,
+        const char* name, size_t length) {
+    for (Entry* entry = buckets[hash]; entry; entry = entry->nextInBucket) {
+        if (entry->dev == dev && entry->directory == directory &&
+                entry->nameLength == length &&
+                memcmp(entry->name, name, length) == 0) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+static void unlinkFromList(Entry* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        firstEntry = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        lastEntry = entry->prev;
+    }
+}
+
+static void insertIntoList(Entry* entry) {
+    entry->prev = nullptr;
+    entry->next = firstEntry;
+    if (firstEntry) {
+        firstEntry->prev = entry;
+    } else {
+        lastEntry = entry;
+    }
+    firstEntry = entry;
+}
+
+static void removeEntry(Entry* entry) {
+    size_t hash = hashName(entry->dev, entry->directory, entry->name,
+            entry->nameLength);
+    Entry** link = &buckets[hash];
+    while (*link != entry) {
+        link = &(*link)->nextInBucket;
+    }
+    *link = entry->nextInBucket;
+
+    unlinkFromList(entry);
+    entryCount--;
+    free(entry);
+}
+
+void DentryCache::add(dev_t dev, ino_t directory, const char* name,
+        size_t length, ino_t ino, Vnode* vnode /*= nullptr*/) {
+    if (length > MAX_NAME_LENGTH) return;
+
+    AutoLock lock(&mutex);
+    size_t hash = hashName(dev, directory, name, length);
+    Entry* entry = findEntry(hash, dev, directory, name, length);
+    if (entry) {
+        unlinkFromList(entry);
+    } else {
+        if (entryCount >= MAX_ENTRIES) {
+            removeEntry(lastEntry);
+        }
+
+        // The cache is only an optimization, so allocation failures are
+        // ignored.
+        entry = (Entry*) malloc(sizeof(Entry) + length);
+        if (!entry) return;
+        entry->nextInBucket = buckets[hash];
+        buckets[hash] = entry;
+        entry->dev = dev;
+        entry->directory = directory;
+        entry->nameLength = length;
+        memcpy(entry->name, name, length);
+        entryCount++;
+    }
+
+    entry->ino = ino;
+    entry->vnode = vnode;
+    insertIntoList(entry);
+}
+
+bool DentryCache::lookup(dev_t dev, ino_t directory, const char* name,
+        size_t length, ino_t* ino, Vnode** vnode /*= nullptr*/) {
+    AutoLock lock(&mutex);
+    size_t hash = hashName(dev, directory, name, length);
+    Entry* entry = findEntry(hash, dev, directory, name, length);
+    if (!entry) return false;
+
+    unlinkFromList(entry);
+    insertIntoList(entry);
+    *ino = entry->ino;
+    if (vnode) {
+        *vnode = entry->vnode;
+    }
+    return true;
+}
+
+void DentryCache::remove(dev_t dev, ino_t directory, const char* name,
+        size_t length) {
+    AutoLock lock(&mutex);
+    size_t hash = hashName(dev, directory, name, length);
+    Entry* entry = findEntry(hash, dev, directory, name, length);
+    if (entry) {
+        removeEntry(entry);
+    }
+}
+
+void DentryCache::removeDevice(dev_t dev) {
+    AutoLock lock(&mutex);
+    Entry* entry = firstEntry;
+    while (entry) {
+        Entry* next = entry->next;
+        if (entry->dev == dev) {
+            removeEntry(entry);
+        }
+        entry = next;
+    }
+}
+
+void DentryCache::removeDirectory(dev_t dev, ino_t directory) {
+    AutoLock lock(&mutex);
+    Entry* entry = firstEntry;
+    while (entry) {
+        Entry* next = entry->next;
+        if (entry->dev == dev && entry->directory == directory) {
+            removeEntry(entry);
+        }
+        entry = next;
+    }
+}
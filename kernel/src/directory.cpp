@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <cobalt/fcntl.h>
 #include <cobalt/seek.h>
+#include <cobalt/kernel/dentrycache.h>
 #include <cobalt/kernel/directory.h>
 #include <cobalt/kernel/file.h>
 #include <cobalt/kernel/filesystem.h>
@@ -42,6 +43,7 @@ DirectoryVnode::DirectoryVnode(const Reference<DirectoryVnode>& parent,
 }
 
 DirectoryVnode::~DirectoryVnode() {
+    DentryCache::removeDirectory(stats.st_dev, stats.st_ino);
     free(childNodes);
     free(fileNames);
     stats.st_nlink -= parent ? 1 : 2;
@@ -82,6 +84,8 @@ int DirectoryVnode::linkUnlocked(const char* name, size_t length,
     // is uninitialized so we cannot call operator=.
     new (&childNodes[childCount]) Reference<Vnode>(vnode);
     childCount++;
+    DentryCache::add(stats.st_dev, stats.st_ino, name, length,
+            vnode->stats.st_ino, (Vnode*) vnode);
 
     vnode->onLink();
     if (S_ISDIR(vnode->stats.st_mode)) {
@@ -101,6 +105,54 @@ Reference<Vnode> DirectoryVnode::getChildNode(const char* name, size_t length) {
     return getChildNodeUnlocked(name, length);
 }
 
+void DirectoryVnode::getChildNodes(const char* const* names, size_t count,
+        Reference<Vnode>* results, int* errors) {
+    AutoLock lock(&mutex);
+
+    // Names that are not in the dentry cache are matched against the children
+    // in a single pass. Until then their error is set to -1.
+    size_t remaining = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(names[i]);
+        ino_t ino;
+        Vnode* vnode;
+        if (strcmp(names[i], ".") == 0 || strcmp(names[i], "..") == 0) {
+            results[i] = getChildNodeUnlocked(names[i], length);
+            errors[i] = 0;
+        } else if (DentryCache::lookup(stats.st_dev, stats.st_ino, names[i],
+                length, &ino, &vnode)) {
+            results[i] = ino ? vnode : nullptr;
+            errors[i] = ino ? 0 : ENOENT;
+        } else {
+            results[i] = nullptr;
+            errors[i] = -1;
+            remaining++;
+        }
+    }
+
+    for (size_t i = 0; remaining > 0 && i < childCount; i++) {
+        for (size_t j = 0; j < count; j++) {
+            if (errors[j] != -1 || strcmp(names[j], fileNames[i]) != 0) {
+                continue;
+            }
+            DentryCache::add(stats.st_dev, stats.st_ino, names[j],
+                    strlen(names[j]), childNodes[i]->stats.st_ino,
+                    (Vnode*) childNodes[i]);
+            results[j] = childNodes[i];
+            errors[j] = 0;
+            remaining--;
+        }
+    }
+
+    for (size_t i = 0; remaining > 0 && i < count; i++) {
+        if (errors[i] != -1) continue;
+        DentryCache::add(stats.st_dev, stats.st_ino, names[i],
+                strlen(names[i]), 0);
+        errors[i] = ENOENT;
+        remaining--;
+    }
+}
+
 Reference<Vnode> DirectoryVnode::getChildNodeUnlocked(const char* name,
         size_t length) {
     if (length == 1 && strncmp(name, ".", 1) == 0) {
@@ -109,13 +161,25 @@ Reference<Vnode> DirectoryVnode::getChildNodeUnlocked(const char* name,
         return parent ? parent : this;
     }
 
+    ino_t ino;
+    Vnode* vnode;
+    if (DentryCache::lookup(stats.st_dev, stats.st_ino, name, length, &ino,
+            &vnode)) {
+        if (ino) return vnode;
+        errno = ENOENT;
+        return nullptr;
+    }
+
     for (size_t i = 0; i < childCount; i++) {
         if (strncmp(name, fileNames[i], length) == 0 &&
                 fileNames[i][length] == '\0') {
+            DentryCache::add(stats.st_dev, stats.st_ino, name, length,
+                    childNodes[i]->stats.st_ino, (Vnode*) childNodes[i]);
             return childNodes[i];
         }
     }
 
+    DentryCache::add(stats.st_dev, stats.st_ino, name, length, 0);
     errno = ENOENT;
     return nullptr;
 }
@@ -402,6 +466,7 @@ int DirectoryVnode::unlinkUnlocked(const char* name, int flags) {
                 stats.st_nlink--;
             }
 
+            DentryCache::remove(stats.st_dev, stats.st_ino, name, nameLength);
             free(fileNames[i]);
             if (i != childCount - 1) {
                 childNodes[i] = childNodes[childCount - 1];
@@ -0,0 +1,355 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/epoll.cpp
+ * Event polling.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cobalt/kernel/epoll.h>
+#include <cobalt/kernel/filedescription.h>
+#include <cobalt/kernel/interrupts.h>
+
+// Nested epoll instances cannot be deeper than this.
+#define MAX_NESTING 4
+
+class EpollItem : public PollEntry {
+public:
+    void onEvent() override;
+    void unlink();
+public:
+    Epoll* epoll;
+    FileDescription* descr;
+    Reference<Vnode> vnode;
+    int fd;
+    struct epoll_event event;
+    bool enabled;
+    bool ready;
+    bool registered;
+    // The interest list of the epoll instance.
+    EpollItem* prevItem;
+    EpollItem* nextItem;
+    // All items for the same file description.
+    EpollItem* prevInDescr;
+    EpollItem* nextInDescr;
+    EpollItem* prevReady;
+    EpollItem* nextReady;
+};
+
+// The interest lists and the item lists of file descriptions are protected
+// by this mutex. The ready lists are protected by disabling interrupts because
+// they are changed when the poll queues are notified.
+static kthread_mutex_t epollMutex = KTHREAD_MUTEX_INITIALIZER;
+
+static const char epollDevice = 0;
+#define EPOLL_DEV ((dev_t) &epollDevice)
+
+Epoll::Epoll() : Vnode(S_IRUSR | S_IWUSR, EPOLL_DEV) {
+    firstItem = nullptr;
+    firstReady = nullptr;
+    lastReady = nullptr;
+    readyCount = 0;
+}
+
+Epoll::~Epoll() {
+    EpollItem* items = nullptr;
+
+    kthread_mutex_lock(&epollMutex);
+    while (firstItem) {
+        EpollItem* item = firstItem;
+        item->unlink();
+        item->nextItem = items;
+        items = item;
+    }
+    kthread_mutex_unlock(&epollMutex);
+
+    // Dropping the vnode references might destroy other epoll instances, so
+    // this cannot be done while the mutex is locked.
+    while (items) {
+        EpollItem* next = items->nextItem;
+        delete items;
+        items = next;
+    }
+}
+
+// Must be called with interrupts disabled.
+void Epoll::addReady(EpollItem* item) {
+    item->ready = true;
+    item->prevReady = lastReady;
+    item->nextReady = nullptr;
+    if (lastReady) {
+        lastReady->nextReady = item;
+    } else {
+        firstReady = item;
+    }
+    lastReady = item;
+    readyCount++;
+}
+
+int Epoll::collectEvents(struct epoll_event* events, int maxEvents) {
+    AutoLock lock(&epollMutex);
+
+    // Items that are still ready are appended to the list again, so only the
+    // items that were on the list at the beginning are looked at.
+    size_t remaining = readyCount;
+    int count = 0;
+    while (remaining > 0 && count < maxEvents) {
+        remaining--;
+        Interrupts::disable();
+        EpollItem* item = firstReady;
+        if (item) {
+            removeReady(item);
+        }
+        Interrupts::enable();
+        if (!item) break;
+        if (!item->enabled) continue;
+
+        short revents = item->vnode->poll() &
+                (item->event.events | POLLERR | POLLHUP);
+        if (!revents) continue;
+
+        events[count].events = revents;
+        events[count].data = item->event.data;
+        count++;
+
+        if (item->event.events & EPOLLONESHOT) {
+            item->enabled = false;
+        } else if (!(item->event.events & EPOLLET)) {
+            Interrupts::disable();
+            if (!item->ready) {
+                addReady(item);
+            }
+            Interrupts::enable();
+        }
+    }
+
+    return count;
+}
+
+int Epoll::ctl(int op, int fd, const Reference<FileDescription>& descr,
+        const struct epoll_event* event) {
+    if (descr->vnode == this) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    kthread_mutex_lock(&epollMutex);
+    EpollItem* item = descr->epollItems;
+    while (item && (item->epoll != this || item->fd != fd)) {
+        item = item->nextInDescr;
+    }
+
+    if (op == EPOLL_CTL_ADD) {
+        if (item) {
+            kthread_mutex_unlock(&epollMutex);
+            errno = EEXIST;
+            return -1;
+        }
+
+        Epoll* nested = get(descr->vnode);
+        if (nested && nested->watches(this, 1)) {
+            kthread_mutex_unlock(&epollMutex);
+            errno = ELOOP;
+            return -1;
+        }
+
+        item = new EpollItem();
+        if (!item) {
+            kthread_mutex_unlock(&epollMutex);
+            return -1;
+        }
+        item->epoll = this;
+        item->descr = (FileDescription*) descr;
+        item->vnode = descr->vnode;
+        item->fd = fd;
+        item->event = *event;
+        item->enabled = true;
+        item->ready = false;
+
+        item->prevItem = nullptr;
+        item->nextItem = firstItem;
+        if (firstItem) {
+            firstItem->prevItem = item;
+        }
+        firstItem = item;
+
+        item->prevInDescr = nullptr;
+        item->nextInDescr = descr->epollItems;
+        if (descr->epollItems) {
+            descr->epollItems->prevInDescr = item;
+        }
+        descr->epollItems = item;
+
+        PollQueue* queue = item->vnode->getPollQueue();
+        item->registered = queue;
+        if (queue) {
+            queue->add(item);
+        }
+    } else if (op == EPOLL_CTL_MOD) {
+        if (!item) {
+            kthread_mutex_unlock(&epollMutex);
+            errno = ENOENT;
+            return -1;
+        }
+        item->event = *event;
+        item->enabled = true;
+    } else if (op == EPOLL_CTL_DEL) {
+        if (!item) {
+            kthread_mutex_unlock(&epollMutex);
+            errno = ENOENT;
+            return -1;
+        }
+        item->unlink();
+        kthread_mutex_unlock(&epollMutex);
+        delete item;
+        return 0;
+    } else {
+        kthread_mutex_unlock(&epollMutex);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The file might already be ready.
+    Interrupts::disable();
+    item->onEvent();
+    Interrupts::enable();
+    kthread_mutex_unlock(&epollMutex);
+    return 0;
+}
+
+Epoll* Epoll::get(const Reference<Vnode>& vnode) {
+    if (vnode->stats.st_dev != EPOLL_DEV) return nullptr;
+    return (Epoll*) (Vnode*) vnode;
+}
+
+PollQueue* Epoll::getPollQueue() {
+    return &pollQueue;
+}
+
+short Epoll::poll() {
+    // Items on the ready list have not necessarily been polled yet, so this
+    // might report readiness although epoll_wait would not return any events.
+    return firstReady ? POLLIN | POLLRDNORM : 0;
+}
+
+void Epoll::removeDescription(FileDescription* descr) {
+    EpollItem* items = nullptr;
+
+    kthread_mutex_lock(&epollMutex);
+    while (descr->epollItems) {
+        EpollItem* item = descr->epollItems;
+        item->unlink();
+        item->nextItem = items;
+        items = item;
+    }
+    kthread_mutex_unlock(&epollMutex);
+
+    while (items) {
+        EpollItem* next = items->nextItem;
+        delete items;
+        items = next;
+    }
+}
+
+// Must be called with interrupts disabled.
+void Epoll::removeReady(EpollItem* item) {
+    if (item->prevReady) {
+        item->prevReady->nextReady = item->nextReady;
+    } else {
+        firstReady = item->nextReady;
+    }
+    if (item->nextReady) {
+        item->nextReady->prevReady = item->prevReady;
+    } else {
+        lastReady = item->prevReady;
+    }
+    item->ready = false;
+    readyCount--;
+}
+
+int Epoll::wait(struct epoll_event* events, int maxEvents,
+        const struct timespec* endTime) {
+    PollWaiter waiter;
+    PollWaiter::Entry entry;
+    entry.waiter = &waiter;
+    pollQueue.add(&entry);
+
+    int result;
+    while (!(result = collectEvents(events, maxEvents))) {
+        int error = waiter.wait(endTime);
+        if (error == ETIMEDOUT) break;
+        if (error == EINTR) {
+            result = -1;
+            break;
+        }
+    }
+
+    PollQueue::remove(&entry);
+    if (result < 0) {
+        errno = EINTR;
+    }
+    return result;
+}
+
+// Returns whether the given epoll instance can be reached from this one.
+// Nesting that is too deep is treated like a loop.
+bool Epoll::watches(Epoll* epoll, size_t depth) {
+    if (this == epoll || depth > MAX_NESTING) return true;
+
+    for (EpollItem* item = firstItem; item; item = item->nextItem) {
+        Epoll* nested = get(item->vnode);
+        if (nested && nested->watches(epoll, depth + 1)) return true;
+    }
+    return false;
+}
+
+void EpollItem::onEvent() {
+    if (!enabled || ready) return;
+    epoll->addReady(this);
+    epoll->pollQueue.notify();
+}
+
+void EpollItem::unlink() {
+    if (registered) {
+        PollQueue::remove(this);
+    }
+
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    if (ready) {
+        epoll->removeReady(this);
+    }
+    if (interruptsEnabled) Interrupts::enable();
+
+    if (prevItem) {
+        prevItem->nextItem = nextItem;
+    } else {
+        epoll->firstItem = nextItem;
+    }
+    if (nextItem) {
+        nextItem->prevItem = prevItem;
+    }
+
+    if (prevInDescr) {
+        prevInDescr->nextInDescr = nextInDescr;
+    } else {
+        descr->epollItems = nextInDescr;
+    }
+    if (nextInDescr) {
+        nextInDescr->prevInDescr = prevInDescr;
+    }
+}
@@ -0,0 +1,732 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/ext234extent.cpp
+ * ext4 extent trees.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <cobalt/kernel/ext234fs.h>
+
+// The root of the tree is stored in i_block and has space for 4 entries.
+#define ROOT_ENTRIES \
+        ((sizeof(((Inode*) 0)->i_block) - sizeof(ExtentHeader)) / \
+        sizeof(Extent))
+#define BLOCK_ENTRIES ((blockSize - sizeof(ExtentHeader)) / sizeof(Extent))
+
+// A node on the path from the root to a leaf. The root has block number 0
+// and points into the inode. For index nodes, index is the entry that leads to
+// the next node on the path.
+struct ExtentPathNode {
+    uint64_t blockNumber;
+    char* data;
+    size_t index;
+};
+
+static ExtentHeader* getHeader(const void* node) {
+    return (ExtentHeader*) node;
+}
+
+static Extent* getExtents(const void* node) {
+    return (Extent*) ((char*) node + sizeof(ExtentHeader));
+}
+
+static ExtentIndex* getIndexes(const void* node) {
+    return (ExtentIndex*) ((char*) node + sizeof(ExtentHeader));
+}
+
+static uint64_t extentStart(const Extent* extent) {
+    return extent->ee_start_lo | (uint64_t) extent->ee_start_hi << 32;
+}
+
+static uint32_t extentLength(const Extent* extent) {
+    uint32_t length = extent->ee_len;
+    if (length > EXTENT_MAX_INIT_LENGTH) {
+        length -= EXTENT_MAX_INIT_LENGTH;
+    }
+    return length;
+}
+
+static uint64_t indexLeaf(const ExtentIndex* index) {
+    return index->ei_leaf_lo | (uint64_t) index->ei_leaf_hi << 32;
+}
+
+static bool isValidNode(const ExtentHeader* header, size_t maxEntries) {
+    return header->eh_magic == EXTENT_MAGIC &&
+            header->eh_entries <= header->eh_max &&
+            header->eh_max <= maxEntries &&
+            header->eh_depth <= EXTENT_MAX_DEPTH;
+}
+
+// Allocates blocks for a range of logical blocks that is either a hole or part
+// of a single unwritten extent. An unwritten extent is split so that only the
+// range becomes initialized. The contents of the blocks are not cleared.
+bool Ext234Fs::allocateExtentRange(uint64_t blockGroup, Inode* inode,
+        uint64_t block, uint64_t count) {
+    ExtentPathNode path[EXTENT_MAX_DEPTH + 1];
+    int levels = loadExtentPath(inode, path, block);
+    if (levels < 0) return false;
+
+    ExtentPathNode* leaf = &path[levels - 1];
+    ExtentHeader* header = getHeader(leaf->data);
+    Extent* extent = nullptr;
+    if (header->eh_depth == 0) {
+        Extent* extents = getExtents(leaf->data);
+        for (size_t i = 0; i < header->eh_entries; i++) {
+            if (extents[i].ee_block <= block &&
+                    block < extents[i].ee_block + extentLength(&extents[i])) {
+                extent = &extents[i];
+                break;
+            }
+        }
+    }
+
+    if (extent) {
+        if (extent->ee_len <= EXTENT_MAX_INIT_LENGTH) {
+            // The blocks are already initialized.
+            freeExtentPath(path, levels);
+            return true;
+        }
+
+        uint64_t first = extent->ee_block;
+        uint64_t end = first + extentLength(extent);
+        uint64_t start = extentStart(extent);
+        if (count > end - block) count = end - block;
+
+        // Shrink the extent to the part before the range. If the range starts
+        // at the extent, the extent becomes the initialized range instead.
+        if (block == first) {
+            extent->ee_len = count;
+        } else {
+            extent->ee_len = block - first + EXTENT_MAX_INIT_LENGTH;
+        }
+        bool success = writeExtentNode(leaf);
+        freeExtentPath(path, levels);
+        if (!success) return false;
+
+        if (block != first && !insertExtent(blockGroup, inode, block,
+                start + block - first, count, false)) {
+            return false;
+        }
+        if (block + count < end && !insertExtent(blockGroup, inode,
+                block + count, start + block + count - first,
+                end - block - count, true)) {
+            return false;
+        }
+        return true;
+    }
+    freeExtentPath(path, levels);
+
+    // Fill the hole with runs of contiguous blocks.
+    uint64_t runStart = 0;
+    uint64_t runLength = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t blockNumber = allocateBlock(blockGroup);
+        if (!blockNumber) goto fail;
+        inode->i_blocks = inode->i_blocks + blockSize / 512;
+
+        if (runLength && (blockNumber != runStart + runLength ||
+                runLength == EXTENT_MAX_INIT_LENGTH)) {
+            if (!insertExtent(blockGroup, inode, block + i - runLength,
+                    runStart, runLength, false)) {
+                deallocateBlock(blockNumber);
+                inode->i_blocks = inode->i_blocks - blockSize / 512;
+                goto fail;
+            }
+            runLength = 0;
+        }
+
+        if (!runLength) {
+            runStart = blockNumber;
+        }
+        runLength++;
+    }
+
+    if (runLength && !insertExtent(blockGroup, inode, block + count -
+            runLength, runStart, runLength, false)) {
+        goto fail;
+    }
+    return true;
+
+fail:
+    // The blocks of the current run are not part of the tree yet.
+    for (uint64_t i = 0; i < runLength; i++) {
+        deallocateBlock(runStart + i);
+        inode->i_blocks = inode->i_blocks - blockSize / 512;
+    }
+    return false;
+}
+
+bool Ext234Fs::appendExtent(uint64_t blockGroup, Inode* inode,
+        uint64_t logical, uint64_t physical, uint64_t length) {
+    ExtentPathNode path[EXTENT_MAX_DEPTH + 1];
+    int levels = loadExtentPath(inode, path, UINT64_MAX);
+    if (levels < 0) return false;
+
+    ExtentPathNode* leaf = &path[levels - 1];
+    ExtentHeader* header = getHeader(leaf->data);
+    if (levels == 1 && header->eh_entries == 0) {
+        header->eh_depth = 0;
+    }
+
+    if (header->eh_depth == 0 && header->eh_entries > 0) {
+        // Extend the last extent if the new blocks follow it directly.
+        Extent* last = &getExtents(leaf->data)[header->eh_entries - 1];
+        uint32_t lastLength = last->ee_len;
+        if (lastLength + length <= EXTENT_MAX_INIT_LENGTH &&
+                last->ee_block + lastLength == logical &&
+                extentStart(last) + lastLength == physical) {
+            last->ee_len = lastLength + length;
+            bool success = writeExtentNode(leaf);
+            freeExtentPath(path, levels);
+            return success;
+        }
+    }
+
+    if (header->eh_depth == 0 && header->eh_entries < header->eh_max) {
+        Extent* extent = &getExtents(leaf->data)[header->eh_entries];
+        extent->ee_block = logical;
+        extent->ee_len = length;
+        extent->ee_start_lo = physical & 0xFFFFFFFF;
+        extent->ee_start_hi = physical >> 32;
+        header->eh_entries = header->eh_entries + 1;
+        bool success = writeExtentNode(leaf);
+        freeExtentPath(path, levels);
+        return success;
+    }
+
+    // The leaf is full, find the deepest index node that still has space.
+    int level = levels - 2;
+    while (level >= 0 && getHeader(path[level].data)->eh_entries >=
+            getHeader(path[level].data)->eh_max) {
+        level--;
+    }
+
+    if (level < 0) {
+        freeExtentPath(path, levels);
+        if (!growExtentTree(blockGroup, inode)) return false;
+        return appendExtent(blockGroup, inode, logical, physical, length);
+    }
+
+    // Create a new branch below that node that ends in a leaf containing the
+    // new extent.
+    uint64_t newBlocks[EXTENT_MAX_DEPTH];
+    size_t newBlockCount = 0;
+    char* buffer = new char[blockSize];
+    if (!buffer) {
+        freeExtentPath(path, levels);
+        return false;
+    }
+
+    uint64_t child = 0;
+    for (int i = levels - 1; i > level; i--) {
+        uint64_t blockNumber = allocateBlock(blockGroup);
+        if (!blockNumber) goto fail;
+        newBlocks[newBlockCount++] = blockNumber;
+
+        memset(buffer, 0, blockSize);
+        ExtentHeader* newHeader = getHeader(buffer);
+        newHeader->eh_magic = EXTENT_MAGIC;
+        newHeader->eh_entries = 1;
+        newHeader->eh_max = BLOCK_ENTRIES;
+        newHeader->eh_depth = levels - 1 - i;
+
+        if (i == levels - 1) {
+            Extent* extent = getExtents(buffer);
+            extent->ee_block = logical;
+            extent->ee_len = length;
+            extent->ee_start_lo = physical & 0xFFFFFFFF;
+            extent->ee_start_hi = physical >> 32;
+        } else {
+            ExtentIndex* index = getIndexes(buffer);
+            index->ei_block = logical;
+            index->ei_leaf_lo = child & 0xFFFFFFFF;
+            index->ei_leaf_hi = child >> 32;
+        }
+
+        if (!write(buffer, blockSize, blockNumber * blockSize)) goto fail;
+        child = blockNumber;
+    }
+
+    {
+        ExtentHeader* parent = getHeader(path[level].data);
+        ExtentIndex* index = &getIndexes(path[level].data)[parent->eh_entries];
+        index->ei_block = logical;
+        index->ei_leaf_lo = child & 0xFFFFFFFF;
+        index->ei_leaf_hi = child >> 32;
+        index->ei_unused = 0;
+        parent->eh_entries = parent->eh_entries + 1;
+        if (!writeExtentNode(&path[level])) {
+            parent->eh_entries = parent->eh_entries - 1;
+            goto fail;
+        }
+    }
+
+    inode->i_blocks = inode->i_blocks + newBlockCount * (blockSize / 512);
+    delete[] buffer;
+    freeExtentPath(path, levels);
+    return true;
+
+fail:
+    for (size_t i = 0; i < newBlockCount; i++) {
+        deallocateBlock(newBlocks[i]);
+    }
+    delete[] buffer;
+    freeExtentPath(path, levels);
+    return false;
+}
+
+bool Ext234Fs::decreaseExtentBlockCount(Inode* inode,
+        uint64_t newBlockCount) {
+    while (true) {
+        ExtentPathNode path[EXTENT_MAX_DEPTH + 1];
+        int levels = loadExtentPath(inode, path, UINT64_MAX);
+        if (levels < 0) return false;
+
+        ExtentPathNode* node = &path[levels - 1];
+        ExtentHeader* header = getHeader(node->data);
+
+        if (header->eh_entries == 0) {
+            if (levels == 1) {
+                // The tree is empty.
+                header->eh_depth = 0;
+                return true;
+            }
+
+            // Remove the empty node from its parent.
+            if (!deallocateBlock(node->blockNumber)) {
+                freeExtentPath(path, levels);
+                return false;
+            }
+            inode->i_blocks = inode->i_blocks - blockSize / 512;
+            ExtentHeader* parent = getHeader(path[levels - 2].data);
+            parent->eh_entries = parent->eh_entries - 1;
+            bool success = writeExtentNode(&path[levels - 2]);
+            freeExtentPath(path, levels);
+            if (!success) return false;
+            continue;
+        }
+
+        Extent* extent = &getExtents(node->data)[header->eh_entries - 1];
+        uint64_t first = extent->ee_block;
+        uint32_t length = extentLength(extent);
+        if (first + length <= newBlockCount) {
+            freeExtentPath(path, levels);
+            return true;
+        }
+
+        uint64_t keep = first >= newBlockCount ? 0 : newBlockCount - first;
+        uint64_t start = extentStart(extent);
+        for (uint64_t i = keep; i < length; i++) {
+            if (!deallocateBlock(start + i)) {
+                freeExtentPath(path, levels);
+                return false;
+            }
+            inode->i_blocks = inode->i_blocks - blockSize / 512;
+        }
+
+        if (keep == 0) {
+            header->eh_entries = header->eh_entries - 1;
+        } else if (extent->ee_len > EXTENT_MAX_INIT_LENGTH) {
+            extent->ee_len = keep + EXTENT_MAX_INIT_LENGTH;
+        } else {
+            extent->ee_len = keep;
+        }
+
+        bool success = writeExtentNode(node);
+        freeExtentPath(path, levels);
+        if (!success) return false;
+    }
+}
+
+void Ext234Fs::freeExtentPath(ExtentPathNode* path, int levels) {
+    for (int i = 1; i < levels; i++) {
+        delete[] path[i].data;
+    }
+}
+
+bool Ext234Fs::getExtentRun(const Inode* inode, uint64_t block,
+        BlockRun* run) {
+    // Logical block numbers in extents are 32 bit.
+    uint64_t end = (uint64_t) UINT32_MAX + 1;
+    run->logical = block;
+    run->physical = 0;
+    run->length = 1;
+    if (block >= end) return true;
+
+    char* buffer = nullptr;
+    const void* node = inode->i_block;
+    size_t maxEntries = ROOT_ENTRIES;
+    ExtentHeader* header = getHeader(node);
+    if (!isValidNode(header, maxEntries)) goto corrupt;
+
+    while (header->eh_depth > 0) {
+        ExtentIndex* indexes = getIndexes(node);
+        size_t entries = header->eh_entries;
+
+        // Find the last index that starts at or before the block.
+        size_t i = 0;
+        while (i + 1 < entries && indexes[i + 1].ei_block <= block) i++;
+        if (entries == 0 || indexes[i].ei_block > block) {
+            if (entries && indexes[0].ei_block < end) {
+                end = indexes[0].ei_block;
+            }
+            run->length = end - block;
+            delete[] buffer;
+            return true;
+        }
+        if (i + 1 < entries && indexes[i + 1].ei_block < end) {
+            end = indexes[i + 1].ei_block;
+        }
+
+        if (!buffer) {
+            buffer = new char[blockSize];
+            if (!buffer) return false;
+        }
+        uint16_t depth = header->eh_depth;
+        if (!read(buffer, blockSize, indexLeaf(&indexes[i]) * blockSize)) {
+            delete[] buffer;
+            return false;
+        }
+
+        node = buffer;
+        maxEntries = BLOCK_ENTRIES;
+        header = getHeader(node);
+        if (!isValidNode(header, maxEntries) ||
+                header->eh_depth != depth - 1) {
+            goto corrupt;
+        }
+    }
+
+    {
+        Extent* extents = getExtents(node);
+        run->length = end - block;
+        for (size_t i = 0; i < header->eh_entries; i++) {
+            uint64_t first = extents[i].ee_block;
+            if (first > block) {
+                if (first < end) {
+                    run->length = first - block;
+                }
+                break;
+            }
+
+            uint32_t length = extentLength(&extents[i]);
+            if (block < first + length) {
+                run->length = first + length - block;
+                // Uninitialized extents read as zeros like holes.
+                if (extents[i].ee_len <= EXTENT_MAX_INIT_LENGTH) {
+                    run->physical = extentStart(&extents[i]) + block - first;
+                }
+                break;
+            }
+        }
+    }
+
+    delete[] buffer;
+    if (run->length == 0) {
+        errno = EIO;
+        return false;
+    }
+    return true;
+
+corrupt:
+    delete[] buffer;
+    errno = EIO;
+    return false;
+}
+
+// Moves the root of the extent tree into a new block so that the root has
+// space for more entries.
+bool Ext234Fs::growExtentTree(uint64_t blockGroup, Inode* inode) {
+    ExtentHeader* root = getHeader(inode->i_block);
+    if (root->eh_depth >= EXTENT_MAX_DEPTH) {
+        errno = EFBIG;
+        return false;
+    }
+
+    uint64_t blockNumber = allocateBlock(blockGroup);
+    if (!blockNumber) return false;
+    char* buffer = new char[blockSize];
+    if (!buffer) {
+        deallocateBlock(blockNumber);
+        return false;
+    }
+
+    memset(buffer, 0, blockSize);
+    memcpy(buffer, inode->i_block, sizeof(inode->i_block));
+    getHeader(buffer)->eh_max = BLOCK_ENTRIES;
+    bool success = write(buffer, blockSize, blockNumber * blockSize);
+    delete[] buffer;
+    if (!success) {
+        deallocateBlock(blockNumber);
+        return false;
+    }
+
+    uint32_t firstBlock = root->eh_depth == 0 ?
+            getExtents(root)[0].ee_block : getIndexes(root)[0].ei_block;
+    root->eh_depth = root->eh_depth + 1;
+    root->eh_entries = 1;
+    ExtentIndex* index = getIndexes(root);
+    index->ei_block = firstBlock;
+    index->ei_leaf_lo = blockNumber & 0xFFFFFFFF;
+    index->ei_leaf_hi = blockNumber >> 32;
+    index->ei_unused = 0;
+    inode->i_blocks = inode->i_blocks + blockSize / 512;
+    return true;
+}
+
+bool Ext234Fs::increaseExtentBlockCount(ino_t ino, Inode* inode,
+        uint64_t oldBlockCount, uint64_t newBlockCount) {
+    uint64_t blockGroup = getBlockGroup(ino);
+
+    // Blocks are collected into runs of contiguous blocks that are added to
+    // the tree as a single extent.
+    uint64_t runStart = 0;
+    uint64_t runLength = 0;
+    uint64_t currentBlockCount = oldBlockCount;
+    while (currentBlockCount < newBlockCount) {
+        uint64_t blockNumber = allocateBlock(blockGroup);
+        if (!blockNumber) goto fail;
+        inode->i_blocks = inode->i_blocks + blockSize / 512;
+
+        if (runLength && (blockNumber != runStart + runLength ||
+                runLength == EXTENT_MAX_INIT_LENGTH)) {
+            if (!appendExtent(blockGroup, inode, currentBlockCount - runLength,
+                    runStart, runLength)) {
+                deallocateBlock(blockNumber);
+                inode->i_blocks = inode->i_blocks - blockSize / 512;
+                goto fail;
+            }
+            runLength = 0;
+        }
+
+        if (!runLength) {
+            runStart = blockNumber;
+        }
+        runLength++;
+        currentBlockCount++;
+    }
+
+    if (runLength && !appendExtent(blockGroup, inode,
+            currentBlockCount - runLength, runStart, runLength)) {
+        goto fail;
+    }
+    return true;
+
+fail:
+    // The blocks of the current run are not part of the tree yet.
+    for (uint64_t i = 0; i < runLength; i++) {
+        deallocateBlock(runStart + i);
+        inode->i_blocks = inode->i_blocks - blockSize / 512;
+    }
+    decreaseExtentBlockCount(inode, oldBlockCount);
+    return false;
+}
+
+// Inserts an extent at the position given by its logical block. Full nodes on
+// the path are split until the leaf has space for the extent.
+bool Ext234Fs::insertExtent(uint64_t blockGroup, Inode* inode,
+        uint64_t logical, uint64_t physical, uint64_t length, bool unwritten) {
+    while (true) {
+        ExtentPathNode path[EXTENT_MAX_DEPTH + 1];
+        int levels = loadExtentPath(inode, path, logical);
+        if (levels < 0) return false;
+
+        ExtentPathNode* leaf = &path[levels - 1];
+        ExtentHeader* header = getHeader(leaf->data);
+        if (levels == 1 && header->eh_entries == 0) {
+            header->eh_depth = 0;
+        }
+        if (header->eh_depth != 0) {
+            freeExtentPath(path, levels);
+            errno = EIO;
+            return false;
+        }
+
+        if (header->eh_entries < header->eh_max) {
+            Extent* extents = getExtents(leaf->data);
+            size_t i = 0;
+            while (i < header->eh_entries && extents[i].ee_block < logical) {
+                i++;
+            }
+
+            // Extend the previous extent if the new blocks follow it directly.
+            if (!unwritten && i > 0) {
+                Extent* previous = &extents[i - 1];
+                uint32_t previousLength = previous->ee_len;
+                if (previousLength + length <= EXTENT_MAX_INIT_LENGTH &&
+                        previous->ee_block + previousLength == logical &&
+                        extentStart(previous) + previousLength == physical) {
+                    previous->ee_len = previousLength + length;
+                    bool success = writeExtentNode(leaf);
+                    freeExtentPath(path, levels);
+                    return success;
+                }
+            }
+
+            memmove(&extents[i + 1], &extents[i],
+                    (header->eh_entries - i) * sizeof(Extent));
+            extents[i].ee_block = logical;
+            extents[i].ee_len = unwritten ?
+                    length + EXTENT_MAX_INIT_LENGTH : length;
+            extents[i].ee_start_lo = physical & 0xFFFFFFFF;
+            extents[i].ee_start_hi = physical >> 32;
+            header->eh_entries = header->eh_entries + 1;
+            bool success = writeExtentNode(leaf);
+
+            // An index must not start after the first block of its subtree.
+            bool first = i == 0;
+            for (int level = levels - 2; success && first && level >= 0;
+                    level--) {
+                ExtentIndex* index =
+                        &getIndexes(path[level].data)[path[level].index];
+                if (index->ei_block <= logical) break;
+                index->ei_block = logical;
+                success = writeExtentNode(&path[level]);
+                first = path[level].index == 0;
+            }
+
+            freeExtentPath(path, levels);
+            return success;
+        }
+
+        // Split the node below the deepest node on the path that still has
+        // space and try again.
+        int level = levels - 2;
+        while (level >= 0 && getHeader(path[level].data)->eh_entries >=
+                getHeader(path[level].data)->eh_max) {
+            level--;
+        }
+
+        bool success;
+        if (level < 0) {
+            freeExtentPath(path, levels);
+            success = growExtentTree(blockGroup, inode);
+        } else {
+            success = splitExtentNode(blockGroup, inode, &path[level],
+                    &path[level + 1]);
+            freeExtentPath(path, levels);
+        }
+        if (!success) return false;
+    }
+}
+
+// Loads the path of the extent tree that leads to the leaf that contains the
+// block or that the block would be inserted into. Returns the number of nodes
+// in the path. The path ends early at a node without entries.
+int Ext234Fs::loadExtentPath(Inode* inode, ExtentPathNode* path,
+        uint64_t block) {
+    path[0].blockNumber = 0;
+    path[0].data = (char*) inode->i_block;
+    path[0].index = 0;
+    size_t maxEntries = ROOT_ENTRIES;
+    int levels = 1;
+
+    while (true) {
+        ExtentHeader* header = getHeader(path[levels - 1].data);
+        if (!isValidNode(header, maxEntries) || (levels > 1 &&
+                header->eh_depth !=
+                getHeader(path[levels - 2].data)->eh_depth - 1)) {
+            freeExtentPath(path, levels);
+            errno = EIO;
+            return -1;
+        }
+        if (header->eh_depth == 0 || header->eh_entries == 0) return levels;
+
+        ExtentIndex* indexes = getIndexes(path[levels - 1].data);
+        size_t i = 0;
+        while (i + 1 < header->eh_entries && indexes[i + 1].ei_block <= block) {
+            i++;
+        }
+        path[levels - 1].index = i;
+
+        char* buffer = new char[blockSize];
+        if (!buffer) {
+            freeExtentPath(path, levels);
+            return -1;
+        }
+        path[levels].blockNumber = indexLeaf(&indexes[i]);
+        path[levels].data = buffer;
+        path[levels].index = 0;
+        levels++;
+
+        if (!read(buffer, blockSize, path[levels - 1].blockNumber *
+                blockSize)) {
+            freeExtentPath(path, levels);
+            return -1;
+        }
+        maxEntries = BLOCK_ENTRIES;
+    }
+}
+
+// Moves the upper half of the entries of a full node into a new node that is
+// added to the parent after it. The parent must have space for another entry.
+bool Ext234Fs::splitExtentNode(uint64_t blockGroup, Inode* inode,
+        ExtentPathNode* parent, ExtentPathNode* node) {
+    uint64_t blockNumber = allocateBlock(blockGroup);
+    if (!blockNumber) return false;
+    char* buffer = new char[blockSize];
+    if (!buffer) {
+        deallocateBlock(blockNumber);
+        return false;
+    }
+
+    // Extents and indexes have the same size.
+    ExtentHeader* header = getHeader(node->data);
+    size_t keep = header->eh_entries / 2;
+    size_t move = header->eh_entries - keep;
+    memset(buffer, 0, blockSize);
+    ExtentHeader* newHeader = getHeader(buffer);
+    newHeader->eh_magic = EXTENT_MAGIC;
+    newHeader->eh_entries = move;
+    newHeader->eh_max = BLOCK_ENTRIES;
+    newHeader->eh_depth = header->eh_depth;
+    memcpy(getExtents(buffer), &getExtents(node->data)[keep],
+            move * sizeof(Extent));
+    uint32_t firstBlock = header->eh_depth == 0 ?
+            getExtents(buffer)[0].ee_block : getIndexes(buffer)[0].ei_block;
+
+    bool success = write(buffer, blockSize, blockNumber * blockSize);
+    delete[] buffer;
+    if (!success) {
+        deallocateBlock(blockNumber);
+        return false;
+    }
+
+    // The new node is linked before the old node is shrunk so that no entry
+    // becomes unreachable if a write fails.
+    ExtentHeader* parentHeader = getHeader(parent->data);
+    ExtentIndex* indexes = getIndexes(parent->data);
+    size_t i = parent->index + 1;
+    memmove(&indexes[i + 1], &indexes[i],
+            (parentHeader->eh_entries - i) * sizeof(ExtentIndex));
+    indexes[i].ei_block = firstBlock;
+    indexes[i].ei_leaf_lo = blockNumber & 0xFFFFFFFF;
+    indexes[i].ei_leaf_hi = blockNumber >> 32;
+    indexes[i].ei_unused = 0;
+    parentHeader->eh_entries = parentHeader->eh_entries + 1;
+    inode->i_blocks = inode->i_blocks + blockSize / 512;
+    if (!writeExtentNode(parent)) return false;
+
+    header->eh_entries = keep;
+    return writeExtentNode(node);
+}
+
+bool Ext234Fs::writeExtentNode(const ExtentPathNode* node) {
+    // The root is written together with the inode.
+    if (node->blockNumber == 0) return true;
+    return write(node->data, blockSize, node->blockNumber * blockSize);
+}
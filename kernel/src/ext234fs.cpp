@@ -22,14 +22,13 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <cobalt/fs.h>
+#include <cobalt/kernel/dentrycache.h>
 #include <cobalt/kernel/ext234.h>
 #include <cobalt/kernel/ext234fs.h>
 
 // This implements mostly ext2 with a hint of ext4. Any filesystem formatted for
 // ext2 or ext3 should be supported unless special options were used during
-// filesystem creation.
-// TODO: We need to implement extent trees in order to properly use all ext4
-// 64bit features.
+// filesystem creation. Files on ext4 may use extent trees.
 
 #define ffs(x) __builtin_ffs(x)
 #define min(x, y) ((x) < (y) ? (x) : (y))
@@ -195,6 +194,48 @@ uint64_t Ext234Fs::allocateBlockInGroup(uint64_t blockGroup,
     return 0;
 }
 
+// Allocates a zero-filled block for block pointers.
+uint64_t Ext234Fs::allocateIndirectBlock(uint64_t blockGroup, Inode* inode) {
+    uint64_t blockNumber = allocateBlock(blockGroup);
+    if (!blockNumber) return 0;
+    char* buffer = new char[blockSize];
+    if (!buffer) {
+        deallocateBlock(blockNumber);
+        return 0;
+    }
+
+    memset(buffer, 0, blockSize);
+    bool success = write(buffer, blockSize, blockNumber * blockSize);
+    delete[] buffer;
+    if (!success) {
+        deallocateBlock(blockNumber);
+        return 0;
+    }
+    inode->i_blocks = inode->i_blocks + blockSize / 512;
+    return blockNumber;
+}
+
+// Allocates blocks for a range of logical blocks that is a hole or part of an
+// unwritten extent. The contents of the blocks are not cleared.
+bool Ext234Fs::allocateInodeBlocks(ino_t ino, Inode* inode, uint64_t block,
+        uint64_t count) {
+    uint64_t blockGroup = getBlockGroup(ino);
+    if (inode->i_flags & INODE_EXTENTS_FL) {
+        return allocateExtentRange(blockGroup, inode, block, count);
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t blockNumber = allocateBlock(blockGroup);
+        if (!blockNumber) return false;
+        if (!setIndirectBlock(blockGroup, inode, block + i, blockNumber)) {
+            deallocateBlock(blockNumber);
+            return false;
+        }
+        inode->i_blocks = inode->i_blocks + blockSize / 512;
+    }
+    return true;
+}
+
 ino_t Ext234Fs::allocateInode(uint64_t blockGroup, bool dir) {
     AutoLock lock(&inodesMutex);
 
@@ -291,6 +332,14 @@ ino_t Ext234Fs::createInode(uint64_t blockGroup, mode_t mode) {
     if (!ino) return 0;
     Inode inode = {};
     inode.i_mode = mode;
+    if (hasIncompatFeature(INCOMPAT_EXTENTS) &&
+            (S_ISREG(mode) || S_ISDIR(mode))) {
+        inode.i_flags = INODE_EXTENTS_FL;
+        ExtentHeader* header = (ExtentHeader*) inode.i_block;
+        header->eh_magic = EXTENT_MAGIC;
+        header->eh_max = (sizeof(inode.i_block) - sizeof(ExtentHeader)) /
+                sizeof(Extent);
+    }
     blockGroup = getBlockGroup(ino);
 
     BlockGroupDescriptor bg;
@@ -520,22 +569,50 @@ uint64_t Ext234Fs::getBlockGroup(ino_t ino) {
     return (ino - 1) / superBlock.s_inodes_per_group;
 }
 
-uint64_t Ext234Fs::getInodeBlockAddress(const Inode* inode, uint64_t block) {
+// Returns the number of pointers at the start of the array that point to
+// contiguous blocks or that are all holes.
+static uint64_t countRun(const little_uint32_t* pointers, size_t count) {
+    uint32_t first = pointers[0];
+    size_t length = 1;
+    while (length < count) {
+        uint32_t next = pointers[length];
+        if (first ? next != first + length : next != 0) break;
+        length++;
+    }
+    return length;
+}
+
+bool Ext234Fs::getIndirectRun(const Inode* inode, uint64_t block,
+        BlockRun* run) {
     size_t indirectBlockPointers = blockSize / 4;
     size_t doublyIndirectPointers = indirectBlockPointers *
             indirectBlockPointers;
 
+    run->logical = block;
+    run->physical = 0;
+
+    if (block < 12) {
+        run->physical = inode->i_block[block];
+        run->length = countRun(&inode->i_block[block], 12 - block);
+        return true;
+    }
+
     little_uint32_t blockNum;
 
     if (block >= 12 + indirectBlockPointers + doublyIndirectPointers) {
         blockNum = inode->i_block[14];
         block -= 12 + indirectBlockPointers + doublyIndirectPointers;
+        if (!blockNum) {
+            run->length = indirectBlockPointers * doublyIndirectPointers -
+                    block;
+            return true;
+        }
 
         size_t index = block / doublyIndirectPointers;
         block = block % doublyIndirectPointers;
 
         uint64_t address = blockNum * blockSize + index * 4;
-        if (!read(&blockNum, sizeof(blockNum), address)) return -1;
+        if (!read(&blockNum, sizeof(blockNum), address)) return false;
 
         goto doublyIndirect;
     } else if (block >= 12 + indirectBlockPointers) {
@@ -543,25 +620,57 @@ uint64_t Ext234Fs::getInodeBlockAddress(const Inode* inode, uint64_t block) {
         block -= 12 + indirectBlockPointers;
 
 doublyIndirect:
+        if (!blockNum) {
+            run->length = doublyIndirectPointers - block;
+            return true;
+        }
+
         size_t index = block / indirectBlockPointers;
         block = block % indirectBlockPointers;
 
         uint64_t address = blockNum * blockSize + index * 4;
-        if (!read(&blockNum, sizeof(blockNum), address)) return -1;
+        if (!read(&blockNum, sizeof(blockNum), address)) return false;
 
         goto indirect;
-    } else if (block >= 12) {
+    } else {
         block -= 12;
         blockNum = inode->i_block[12];
 
 indirect:
+        if (!blockNum) {
+            run->length = indirectBlockPointers - block;
+            return true;
+        }
+
+        // Read the following pointers as well to find the end of the run.
+        little_uint32_t pointers[128];
+        size_t count = min(indirectBlockPointers - block, 128);
         uint64_t address = blockNum * blockSize + block * 4;
-        if (!read(&blockNum, sizeof(blockNum), address)) return -1;
+        if (!read(pointers, count * 4, address)) return false;
+
+        run->physical = pointers[0];
+        run->length = countRun(pointers, count);
+        return true;
+    }
+}
 
-        return blockNum * blockSize;
+bool Ext234Fs::getInodeBlockRun(const Inode* inode, uint64_t block,
+        BlockRun* run) {
+    if (block >= run->logical && block - run->logical < run->length) {
+        return true;
+    }
+
+    bool success;
+    if (inode->i_flags & INODE_EXTENTS_FL) {
+        success = getExtentRun(inode, block, run);
     } else {
-        return inode->i_block[block] * blockSize;
+        success = getIndirectRun(inode, block, run);
+    }
+
+    if (!success) {
+        run->length = 0;
     }
+    return success;
 }
 
 struct timespec Ext234Fs::getInodeATime(const Inode* inode) {
@@ -654,6 +763,11 @@ Reference<Ext234Vnode> Ext234Fs::getVnodeIfOpen(ino_t ino) {
     return vnode;
 }
 
+bool Ext234Fs::hasCompatFeature(uint32_t feature) {
+    if (superBlock.s_rev_level == 0) return false;
+    return (superBlock.s_feature_compat & feature) == feature;
+}
+
 bool Ext234Fs::hasIncompatFeature(uint32_t feature) {
     if (superBlock.s_rev_level == 0) return false;
     return (superBlock.s_feature_incompat & feature) == feature;
@@ -666,120 +780,17 @@ bool Ext234Fs::hasReadOnlyFeature(uint32_t feature) {
 
 bool Ext234Fs::increaseInodeBlockCount(ino_t ino, Inode* inode,
         uint64_t oldBlockCount, uint64_t newBlockCount) {
-    size_t indirectBlockPointers = blockSize / 4;
-    size_t doublyIndirectPointers = indirectBlockPointers *
-            indirectBlockPointers;
-
     uint64_t blockGroup = getBlockGroup(ino);
 
     uint64_t currentBlockCount = oldBlockCount;
     while (currentBlockCount < newBlockCount) {
-        uint64_t block = currentBlockCount;
-        little_uint32_t blockNumber = allocateBlock(blockGroup);
+        uint64_t blockNumber = allocateBlock(blockGroup);
         if (!blockNumber) goto fail;
-
-        little_uint32_t blockNum;
-
-        if (block >= 12 + indirectBlockPointers + doublyIndirectPointers) {
-            if (!inode->i_block[14]) {
-                inode->i_block[14] = allocateBlock(blockGroup);
-                if (!inode->i_block[14]) goto fail;
-                char* buffer = new char[blockSize];
-                if (!buffer) goto fail;
-                memset(buffer, 0, blockSize);
-                if (!write(buffer, blockSize, inode->i_block[14] * blockSize)) {
-                    delete[] buffer;
-                    goto fail;
-                }
-                delete[] buffer;
-            }
-
-            blockNum = inode->i_block[14];
-            block -= 12 + indirectBlockPointers + doublyIndirectPointers;
-
-            size_t index = block / doublyIndirectPointers;
-            block = block % doublyIndirectPointers;
-
-            uint64_t address = blockNum * blockSize + index * 4;
-            if (!read(&blockNum, sizeof(blockNum), address)) goto fail;
-
-            if (!blockNum) {
-                blockNum = allocateBlock(blockGroup);
-                if (!blockNum) goto fail;
-                char* buffer = new char[blockSize];
-                if (!buffer) goto fail;
-                memset(buffer, 0, blockSize);
-                if (!write(buffer, blockSize, blockNum * blockSize) ||
-                        !write(&blockNum, sizeof(blockNum), address)) {
-                    delete[] buffer;
-                    goto fail;
-                }
-                delete[] buffer;
-            }
-
-            goto doublyIndirect;
-        } else if (block >= 12 + indirectBlockPointers) {
-            if (!inode->i_block[13]) {
-                inode->i_block[13] = allocateBlock(blockGroup);
-                if (!inode->i_block[13]) goto fail;
-                char* buffer = new char[blockSize];
-                if (!buffer) goto fail;
-                memset(buffer, 0, blockSize);
-                if (!write(buffer, blockSize, inode->i_block[13] * blockSize)) {
-                    delete[] buffer;
-                    goto fail;
-                }
-                delete[] buffer;
-            }
-
-            blockNum = inode->i_block[13];
-            block -= 12 + indirectBlockPointers;
-
-doublyIndirect:
-            size_t index = block / indirectBlockPointers;
-            block = block % indirectBlockPointers;
-
-            uint64_t address = blockNum * blockSize + index * 4;
-            if (!read(&blockNum, sizeof(blockNum), address)) goto fail;
-
-            if (!blockNum) {
-                blockNum = allocateBlock(blockGroup);
-                if (!blockNum) goto fail;
-                char* buffer = new char[blockSize];
-                if (!buffer) goto fail;
-                memset(buffer, 0, blockSize);
-                if (!write(buffer, blockSize, blockNum * blockSize) ||
-                        !write(&blockNum, sizeof(blockNum), address)) {
-                    delete[] buffer;
-                    goto fail;
-                }
-                delete[] buffer;
-            }
-
-            goto indirect;
-        } else if (block >= 12) {
-            if (!inode->i_block[12]) {
-                inode->i_block[12] = allocateBlock(blockGroup);
-                if (!inode->i_block[12]) goto fail;
-                char* buffer = new char[blockSize];
-                if (!buffer) goto fail;
-                memset(buffer, 0, blockSize);
-                if (!write(buffer, blockSize, inode->i_block[12] * blockSize)) {
-                    delete[] buffer;
-                    goto fail;
-                }
-                delete[] buffer;
-            }
-
-            block -= 12;
-            blockNum = inode->i_block[12];
-indirect:
-            uint64_t address = blockNum * blockSize + block * 4;
-            if (!write(&blockNumber, sizeof(blockNumber), address)) goto fail;
-        } else {
-            inode->i_block[block] = blockNumber;
+        if (!setIndirectBlock(blockGroup, inode, currentBlockCount,
+                blockNumber)) {
+            deallocateBlock(blockNumber);
+            goto fail;
         }
-
         currentBlockCount++;
     }
 
@@ -810,6 +821,7 @@ bool Ext234Fs::onUnmount() {
     }
 
     device->sync(0);
+    DentryCache::removeDevice(dev);
     return true;
 }
 
@@ -843,19 +855,25 @@ bool Ext234Fs::readInode(uint64_t ino, Inode* inode, uint64_t& inodeAddress) {
 }
 
 bool Ext234Fs::readInodeData(const Inode* inode, off_t offset, void* buffer,
-        size_t size) {
+        size_t size, BlockRun* run) {
     char* buf = (char*) buffer;
 
     while (size > 0) {
         uint64_t block = offset / blockSize;
         uint64_t misalign = offset % blockSize;
-        size_t readSize = blockSize - misalign;
-        if (readSize > size) readSize = size;
+        if (!getInodeBlockRun(inode, block, run)) return false;
 
-        uint64_t address = getInodeBlockAddress(inode, block);
-        if (address == (uint64_t) -1 ||
-                !read(buf, readSize, address + misalign)) {
-            return false;
+        // Read the remaining part of the run at once.
+        uint64_t runSize = (run->logical + run->length - block) * blockSize -
+                misalign;
+        size_t readSize = min(runSize, size);
+
+        if (run->physical) {
+            uint64_t address = (run->physical + block - run->logical) *
+                    blockSize + misalign;
+            if (!read(buf, readSize, address)) return false;
+        } else {
+            memset(buf, 0, readSize);
         }
 
         size -= readSize;
@@ -866,23 +884,39 @@ bool Ext234Fs::readInodeData(const Inode* inode, off_t offset, void* buffer,
     return true;
 }
 
-bool Ext234Fs::resizeInode(ino_t ino, Inode* inode, off_t newSize) {
+bool Ext234Fs::resizeInode(ino_t ino, Inode* inode, off_t newSize,
+        BlockRun* run) {
     uint64_t oldSize = getInodeSize(inode);
     uint64_t oldBlockCount = ALIGNUP(oldSize, blockSize) / blockSize;
     uint64_t newBlockCount = ALIGNUP(newSize, blockSize) / blockSize;
+    bool extents = inode->i_flags & INODE_EXTENTS_FL;
+
+    // The block mapping changes so the cached run is no longer valid.
+    run->length = 0;
 
     if (oldBlockCount > newBlockCount) {
-        if (!decreaseInodeBlockCount(inode, oldBlockCount, newBlockCount)) {
+        if (extents) {
+            if (!decreaseExtentBlockCount(inode, newBlockCount)) return false;
+        } else if (!decreaseInodeBlockCount(inode, oldBlockCount,
+                newBlockCount)) {
             return false;
         }
     } else if (oldBlockCount < newBlockCount) {
-        if (!increaseInodeBlockCount(ino, inode, oldBlockCount,
+        if (extents) {
+            if (!increaseExtentBlockCount(ino, inode, oldBlockCount,
+                    newBlockCount)) {
+                return false;
+            }
+        } else if (!increaseInodeBlockCount(ino, inode, oldBlockCount,
                 newBlockCount)) {
             return false;
         }
     }
 
-    inode->i_blocks = getBlockCount(newSize) * (blockSize / 512);
+    // The extent functions keep track of the blocks used by the tree.
+    if (!extents) {
+        inode->i_blocks = getBlockCount(newSize) * (blockSize / 512);
+    }
     inode->i_size = newSize;
     if (hasReadOnlyFeature(RO_COMPAT_LARGE_FILE)) {
         inode->i_size_high = newSize >> 32;
@@ -891,6 +925,82 @@ bool Ext234Fs::resizeInode(ino_t ino, Inode* inode, off_t newSize) {
     return true;
 }
 
+// Stores the physical block number of a logical block of an inode that does
+// not use extents. Missing indirect blocks are allocated.
+bool Ext234Fs::setIndirectBlock(uint64_t blockGroup, Inode* inode,
+        uint64_t block, little_uint32_t blockNumber) {
+    size_t indirectBlockPointers = blockSize / 4;
+    size_t doublyIndirectPointers = indirectBlockPointers *
+            indirectBlockPointers;
+
+    little_uint32_t blockNum;
+
+    if (block >= 12 + indirectBlockPointers + doublyIndirectPointers) {
+        if (!inode->i_block[14]) {
+            inode->i_block[14] = allocateIndirectBlock(blockGroup, inode);
+            if (!inode->i_block[14]) return false;
+        }
+
+        blockNum = inode->i_block[14];
+        block -= 12 + indirectBlockPointers + doublyIndirectPointers;
+
+        size_t index = block / doublyIndirectPointers;
+        block = block % doublyIndirectPointers;
+
+        uint64_t address = blockNum * blockSize + index * 4;
+        if (!read(&blockNum, sizeof(blockNum), address)) return false;
+
+        if (!blockNum) {
+            blockNum = allocateIndirectBlock(blockGroup, inode);
+            if (!blockNum ||
+                    !write(&blockNum, sizeof(blockNum), address)) {
+                return false;
+            }
+        }
+
+        goto doublyIndirect;
+    } else if (block >= 12 + indirectBlockPointers) {
+        if (!inode->i_block[13]) {
+            inode->i_block[13] = allocateIndirectBlock(blockGroup, inode);
+            if (!inode->i_block[13]) return false;
+        }
+
+        blockNum = inode->i_block[13];
+        block -= 12 + indirectBlockPointers;
+
+doublyIndirect:
+        size_t index = block / indirectBlockPointers;
+        block = block % indirectBlockPointers;
+
+        uint64_t address = blockNum * blockSize + index * 4;
+        if (!read(&blockNum, sizeof(blockNum), address)) return false;
+
+        if (!blockNum) {
+            blockNum = allocateIndirectBlock(blockGroup, inode);
+            if (!blockNum ||
+                    !write(&blockNum, sizeof(blockNum), address)) {
+                return false;
+            }
+        }
+
+        goto indirect;
+    } else if (block >= 12) {
+        if (!inode->i_block[12]) {
+            inode->i_block[12] = allocateIndirectBlock(blockGroup, inode);
+            if (!inode->i_block[12]) return false;
+        }
+
+        block -= 12;
+        blockNum = inode->i_block[12];
+indirect:
+        uint64_t address = blockNum * blockSize + block * 4;
+        return write(&blockNumber, sizeof(blockNumber), address);
+    } else {
+        inode->i_block[block] = blockNumber;
+        return true;
+    }
+}
+
 void Ext234Fs::setTime(struct timespec* ts, little_uint32_t* time,
         little_uint32_t* extraTime) {
     if (ts->tv_sec < -0x80000000LL) {
@@ -941,21 +1051,51 @@ bool Ext234Fs::writeInode(const Inode* inode, uint64_t inodeAddress) {
     return write(inode, size, inodeAddress);
 }
 
-bool Ext234Fs::writeInodeData(const Inode* inode, off_t offset,
-        const void* buffer, size_t size) {
+bool Ext234Fs::writeInodeData(ino_t ino, Inode* inode, off_t offset,
+        const void* buffer, size_t size, BlockRun* run) {
     char* buf = (char*) buffer;
 
     while (size > 0) {
         uint64_t block = offset / blockSize;
         uint64_t misalign = offset % blockSize;
-        size_t writeSize = blockSize - misalign;
-        if (writeSize > size) writeSize = size;
-
-        uint64_t address = getInodeBlockAddress(inode, block);
-        if (address == (uint64_t) -1 ||
-                !write(buf, writeSize, address + misalign)) {
-            return false;
+        if (!getInodeBlockRun(inode, block, run)) return false;
+
+        uint64_t runSize = (run->logical + run->length - block) * blockSize -
+                misalign;
+        size_t writeSize = min(runSize, size);
+
+        if (!run->physical) {
+            // Allocate the blocks of the hole or unwritten extent that are
+            // written to. The parts of them that are not written are cleared.
+            uint64_t count = ALIGNUP(misalign + writeSize, blockSize) /
+                    blockSize;
+            bool clearFirst = misalign != 0;
+            bool clearLast = (misalign + writeSize) % blockSize != 0 &&
+                    (count > 1 || !clearFirst);
+
+            bool success = allocateInodeBlocks(ino, inode, block, count);
+            run->length = 0;
+            if (success && (clearFirst || clearLast)) {
+                char* zeros = new char[blockSize];
+                if (!zeros) return false;
+                memset(zeros, 0, blockSize);
+                if (clearFirst) {
+                    success = writeInodeData(ino, inode, block * blockSize,
+                            zeros, blockSize, run);
+                }
+                if (success && clearLast) {
+                    success = writeInodeData(ino, inode,
+                            (block + count - 1) * blockSize, zeros, blockSize,
+                            run);
+                }
+                delete[] zeros;
+            }
+            if (!success) return false;
+            continue;
         }
+        uint64_t address = (run->physical + block - run->logical) *
+                blockSize + misalign;
+        if (!write(buf, writeSize, address)) return false;
 
         size -= writeSize;
         offset += writeSize;
@@ -0,0 +1,322 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/ext234htree.cpp
+ * Hashed directory lookup.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <cobalt/kernel/ext234fs.h>
+
+// These hash functions must match the ones used by Linux.
+
+#define ROTATE_LEFT(x, n) ((x) << (n) | (x) >> (32 - (n)))
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define ROUND(f, a, b, c, d, x, s) \
+        (a += f(b, c, d) + (x), a = ROTATE_LEFT(a, s))
+#define K1 0
+#define K2 0x5A827999
+#define K3 0x6ED9EBA1
+
+static void halfMd4Transform(uint32_t buffer[4], const uint32_t in[8]) {
+    uint32_t a = buffer[0];
+    uint32_t b = buffer[1];
+    uint32_t c = buffer[2];
+    uint32_t d = buffer[3];
+
+    ROUND(F, a, b, c, d, in[0] + K1, 3);
+    ROUND(F, d, a, b, c, in[1] + K1, 7);
+    ROUND(F, c, d, a, b, in[2] + K1, 11);
+    ROUND(F, b, c, d, a, in[3] + K1, 19);
+    ROUND(F, a, b, c, d, in[4] + K1, 3);
+    ROUND(F, d, a, b, c, in[5] + K1, 7);
+    ROUND(F, c, d, a, b, in[6] + K1, 11);
+    ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+    ROUND(G, a, b, c, d, in[1] + K2, 3);
+    ROUND(G, d, a, b, c, in[3] + K2, 5);
+    ROUND(G, c, d, a, b, in[5] + K2, 9);
+    ROUND(G, b, c, d, a, in[7] + K2, 13);
+    ROUND(G, a, b, c, d, in[0] + K2, 3);
+    ROUND(G, d, a, b, c, in[2] + K2, 5);
+    ROUND(G, c, d, a, b, in[4] + K2, 9);
+    ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+    ROUND(H, a, b, c, d, in[3] + K3, 3);
+    ROUND(H, d, a, b, c, in[7] + K3, 9);
+    ROUND(H, c, d, a, b, in[2] + K3, 11);
+    ROUND(H, b, c, d, a, in[6] + K3, 15);
+    ROUND(H, a, b, c, d, in[1] + K3, 3);
+    ROUND(H, d, a, b, c, in[5] + K3, 9);
+    ROUND(H, c, d, a, b, in[0] + K3, 11);
+    ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+    buffer[0] += a;
+    buffer[1] += b;
+    buffer[2] += c;
+    buffer[3] += d;
+}
+
+static void teaTransform(uint32_t buffer[4], const uint32_t in[4]) {
+    uint32_t sum = 0;
+    uint32_t b0 = buffer[0];
+    uint32_t b1 = buffer[1];
+
+    for (int i = 0; i < 16; i++) {
+        sum += 0x9E3779B9;
+        b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+        b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+    }
+
+    buffer[0] += b0;
+    buffer[1] += b1;
+}
+
+static uint32_t legacyHash(const char* name, size_t length, bool isUnsigned) {
+    uint32_t hash0 = 0x12A3FE2D;
+    uint32_t hash1 = 0x37ABE8F9;
+
+    for (size_t i = 0; i < length; i++) {
+        int c = isUnsigned ? (unsigned char) name[i] : (signed char) name[i];
+        uint32_t hash = hash1 + (hash0 ^ (uint32_t) (c * 7152373));
+        if (hash & 0x80000000) {
+            hash -= 0x7FFFFFFF;
+        }
+        hash1 = hash0;
+        hash0 = hash;
+    }
+
+    return hash0 << 1;
+}
+
+// Converts up to 4 * count bytes of the name into words that are padded with
+// the length of the name.
+static void nameToWords(const char* name, size_t length, uint32_t* words,
+        size_t count, bool isUnsigned) {
+    uint32_t padding = length | length << 8;
+    padding |= padding << 16;
+
+    uint32_t value = padding;
+    if (length > count * 4) {
+        length = count * 4;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        int c = isUnsigned ? (unsigned char) name[i] : (signed char) name[i];
+        value = c + (value << 8);
+        if (i % 4 == 3) {
+            *words++ = value;
+            value = padding;
+            count--;
+        }
+    }
+
+    if (count > 0) {
+        *words++ = value;
+        count--;
+    }
+    while (count > 0) {
+        *words++ = padding;
+        count--;
+    }
+}
+
+bool Ext234Fs::hashName(const char* name, size_t length, uint8_t hashVersion,
+        uint32_t* hash) {
+    if (hashVersion <= DX_HASH_TEA &&
+            superBlock.s_flags & SUPERBLOCK_UNSIGNED_HASH) {
+        hashVersion += DX_HASH_LEGACY_UNSIGNED;
+    }
+
+    uint32_t buffer[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+    for (size_t i = 0; i < 4; i++) {
+        if (superBlock.s_hash_seed[i] != 0) {
+            for (size_t j = 0; j < 4; j++) {
+                buffer[j] = superBlock.s_hash_seed[j];
+            }
+            break;
+        }
+    }
+
+    bool isUnsigned = hashVersion >= DX_HASH_LEGACY_UNSIGNED;
+    uint32_t words[8];
+    uint32_t result;
+
+    switch (hashVersion) {
+    case DX_HASH_LEGACY:
+    case DX_HASH_LEGACY_UNSIGNED:
+        result = legacyHash(name, length, isUnsigned);
+        break;
+    case DX_HASH_HALF_MD4:
+    case DX_HASH_HALF_MD4_UNSIGNED:
+        for (size_t i = 0; i < length; i += 32) {
+            nameToWords(name + i, length - i, words, 8, isUnsigned);
+            halfMd4Transform(buffer, words);
+        }
+        result = buffer[1];
+        break;
+    case DX_HASH_TEA:
+    case DX_HASH_TEA_UNSIGNED:
+        for (size_t i = 0; i < length; i += 16) {
+            nameToWords(name + i, length - i, words, 4, isUnsigned);
+            teaTransform(buffer, words);
+        }
+        result = buffer[0];
+        break;
+    default:
+        return false;
+    }
+
+    // The lowest bit is used to mark hash collisions in the index.
+    result &= ~1U;
+    if (result == 0xFFFFFFFE) {
+        result = 0xFFFFFFFC;
+    }
+    *hash = result;
+    return true;
+}
+
+// Returns the entries of an index node or null if the node is invalid.
+static const DxEntry* getIndexEntries(const char* node, size_t offset,
+        size_t blockSize, size_t* count) {
+    const DxCountLimit* countLimit = (const DxCountLimit*) (node + offset);
+    *count = countLimit->count;
+    if (*count == 0 || *count > countLimit->limit ||
+            countLimit->limit > (blockSize - offset) / sizeof(DxEntry)) {
+        return nullptr;
+    }
+    return (const DxEntry*) countLimit;
+}
+
+// Looks up a name using the index of a hashed directory. On success the leaf
+// block that contains the entry is left in the given buffer. Returns 1 if the
+// entry was found, 0 if it does not exist and -1 if the index is not usable.
+int Ext234Vnode::findIndexedEntry(const char* name, size_t nameLength,
+        char* block, uint64_t* offset) {
+    size_t blockSize = filesystem->blockSize;
+    if (!filesystem->readInodeData(&inode, 0, block, blockSize, &blockRun)) {
+        return -1;
+    }
+
+    // The root info follows the 12 byte . and .. entries.
+    const DxRootInfo* info = (const DxRootInfo*) (block + 24);
+    if (info->reserved_zero != 0 || info->info_length != 8 ||
+            info->indirect_levels > 1 || info->unused_flags & 1) {
+        return -1;
+    }
+
+    uint32_t hash;
+    if (!filesystem->hashName(name, nameLength, info->hash_version, &hash)) {
+        return -1;
+    }
+
+    size_t levels = info->indirect_levels + 1;
+    char* nodes = new char[levels * blockSize];
+    if (!nodes) return -1;
+    memcpy(nodes, block, blockSize);
+
+    const DxEntry* entries[2];
+    size_t counts[2];
+    size_t positions[2];
+    int result = -1;
+
+    // Descend to the leaf whose hash range contains the hash.
+    for (size_t level = 0; level < levels; level++) {
+        char* node = nodes + level * blockSize;
+        if (level > 0) {
+            uint64_t blockNum = entries[level - 1][positions[level - 1]].block &
+                    0x0FFFFFFF;
+            if (!filesystem->readInodeData(&inode, blockNum * blockSize, node,
+                    blockSize, &blockRun)) {
+                goto done;
+            }
+        }
+
+        // Index nodes below the root start with an empty directory entry.
+        entries[level] = getIndexEntries(node, level == 0 ? 32 : 8, blockSize,
+                &counts[level]);
+        if (!entries[level]) goto done;
+
+        size_t low = 1;
+        size_t high = counts[level];
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (entries[level][middle].hash > hash) {
+                high = middle;
+            } else {
+                low = middle + 1;
+            }
+        }
+        positions[level] = low - 1;
+    }
+
+    while (true) {
+        uint64_t blockNum = entries[levels - 1][positions[levels - 1]].block &
+                0x0FFFFFFF;
+        if (blockNum * blockSize >= (uint64_t) stats.st_size ||
+                !filesystem->readInodeData(&inode, blockNum * blockSize, block,
+                blockSize, &blockRun)) {
+            goto done;
+        }
+
+        size_t blockOffset;
+        int found = searchDirectoryBlock(block, name, nameLength,
+                &blockOffset);
+        if (found < 0) goto done;
+        if (found) {
+            *offset = blockNum * blockSize + blockOffset;
+            result = 1;
+            goto done;
+        }
+
+        // Names with the same hash can continue in the next leaf.
+        size_t level = levels;
+        while (level > 0 && positions[level - 1] + 1 >= counts[level - 1]) {
+            level--;
+        }
+        if (level == 0) {
+            result = 0;
+            goto done;
+        }
+
+        level--;
+        positions[level]++;
+        if ((entries[level][positions[level]].hash & ~1U) != hash) {
+            result = 0;
+            goto done;
+        }
+
+        for (level++; level < levels; level++) {
+            char* node = nodes + level * blockSize;
+            uint64_t nodeNum = entries[level - 1][positions[level - 1]].block &
+                    0x0FFFFFFF;
+            if (!filesystem->readInodeData(&inode, nodeNum * blockSize, node,
+                    blockSize, &blockRun)) {
+                goto done;
+            }
+            entries[level] = getIndexEntries(node, 8, blockSize,
+                    &counts[level]);
+            if (!entries[level]) goto done;
+            positions[level] = 0;
+        }
+    }
+
+done:
+    delete[] nodes;
+    return result;
+}
@@ -25,8 +25,11 @@
 #include <sys/stat.h>
 #include <cobalt/conf.h>
 #include <cobalt/fcntl.h>
+#include <cobalt/mman.h>
 #include <cobalt/poll.h>
 #include <cobalt/seek.h>
+#include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/dentrycache.h>
 #include <cobalt/kernel/ext234fs.h>
 
 static unsigned char typeToDT(uint8_t type) {
@@ -52,6 +55,7 @@ static uint8_t dtToType(unsigned char dt) {
 Ext234Vnode::Ext234Vnode(Ext234Fs* fs, ino_t ino, const Inode* inode,
         uint64_t inodeAddress) : Vnode(inode->i_mode, fs->dev), inode(*inode),
         inodeAddress(inodeAddress) {
+    blockRun = {};
     filesystem = fs;
     inodeModified = false;
     mounted = nullptr;
@@ -69,6 +73,10 @@ Ext234Vnode::Ext234Vnode(Ext234Fs* fs, ino_t ino, const Inode* inode,
 }
 
 Ext234Vnode::~Ext234Vnode() {
+    if (stats.st_nlink > 0 && !filesystem->readonly) {
+        writeBackPages();
+    }
+
     if (S_ISDIR(stats.st_mode) && stats.st_nlink == 1) {
         // Decrease count for the . entry.
         stats.st_nlink = 0;
@@ -79,7 +87,7 @@ Ext234Vnode::~Ext234Vnode() {
         struct timespec now;
         Clock::get(CLOCK_REALTIME)->getTime(&now);
         filesystem->setTime(&now, &inode.i_dtime, nullptr);
-        filesystem->resizeInode(stats.st_ino, &inode, 0);
+        filesystem->resizeInode(stats.st_ino, &inode, 0, &blockRun);
         inodeModified = true;
     }
 
@@ -97,12 +105,20 @@ bool Ext234Vnode::addChildNode(const char* name, size_t nameLength, ino_t ino,
         unsigned char dt) {
     size_t neededSize = ALIGNUP(sizeof(DirectoryEntry) + nameLength, 4);
 
+    if (inode.i_flags & INODE_INDEX_FL) {
+        // The index is not updated when adding entries, so the directory must
+        // be treated as unindexed from now on.
+        inode.i_flags = inode.i_flags & ~INODE_INDEX_FL;
+        inodeModified = true;
+    }
+    DentryCache::remove(stats.st_dev, stats.st_ino, name, nameLength);
+
     uint64_t blockNum = 0;
     while (blockNum * filesystem->blockSize < (uint64_t) stats.st_size) {
         char* block = new char[filesystem->blockSize];
         if (!block) return false;
         if (!filesystem->readInodeData(&inode, blockNum * filesystem->blockSize,
-                block, filesystem->blockSize)) {
+                block, filesystem->blockSize, &blockRun)) {
             delete[] block;
             return false;
         }
@@ -139,9 +155,9 @@ bool Ext234Vnode::addChildNode(const char* name, size_t nameLength, ino_t ino,
                 }
                 memcpy(entry->name, name, nameLength);
 
-                bool result = filesystem->writeInodeData(&inode,
-                        blockNum * filesystem->blockSize, block,
-                        filesystem->blockSize);
+                bool result = filesystem->writeInodeData(stats.st_ino,
+                        &inode, blockNum * filesystem->blockSize, block,
+                        filesystem->blockSize, &blockRun);
                 delete[] block;
                 return result;
             }
@@ -155,7 +171,7 @@ bool Ext234Vnode::addChildNode(const char* name, size_t nameLength, ino_t ino,
 
     // No free space for the new entry was found.
     if (!filesystem->resizeInode(stats.st_ino, &inode,
-            stats.st_size + filesystem->blockSize)) {
+            stats.st_size + filesystem->blockSize, &blockRun)) {
         return false;
     }
     stats.st_size += filesystem->blockSize;
@@ -178,8 +194,9 @@ bool Ext234Vnode::addChildNode(const char* name, size_t nameLength, ino_t ino,
     entry->inode = 0;
     entry->rec_len = filesystem->blockSize - neededSize;
 
-    if (!filesystem->writeInodeData(&inode, blockNum * filesystem->blockSize,
-            block, filesystem->blockSize)) {
+    if (!filesystem->writeInodeData(stats.st_ino, &inode,
+            blockNum * filesystem->blockSize, block, filesystem->blockSize,
+            &blockRun)) {
         delete[] block;
         return false;
     }
@@ -225,49 +242,50 @@ int Ext234Vnode::chown(uid_t uid, gid_t gid) {
 
 uint64_t Ext234Vnode::findDirectoryEntry(const char* name, size_t nameLength,
         DirectoryEntry* de) {
-    off_t bytesRead = 0;
-    uint64_t blockNum = 0;
     char* block = new char[filesystem->blockSize];
     if (!block) return -1;
 
-    while (bytesRead < stats.st_size) {
-        if (!filesystem->readInodeData(&inode, blockNum * filesystem->blockSize,
-                block, filesystem->blockSize)) {
-            delete[] block;
-            return -1;
-        }
-
-        size_t offset = 0;
-        while (offset < filesystem->blockSize) {
-            DirectoryEntry* entry = (DirectoryEntry*) (block + offset);
+    int found = -1;
+    uint64_t offset;
+    if (inode.i_flags & INODE_INDEX_FL &&
+            filesystem->hasCompatFeature(COMPAT_DIR_INDEX)) {
+        found = findIndexedEntry(name, nameLength, block, &offset);
+    }
 
-            if (entry->rec_len < 8) {
+    // Search all blocks if the directory does not have a usable index.
+    if (found < 0) {
+        found = 0;
+        uint64_t blockNum = 0;
+        while (!found &&
+                blockNum * filesystem->blockSize < (uint64_t) stats.st_size) {
+            if (!filesystem->readInodeData(&inode, blockNum *
+                    filesystem->blockSize, block, filesystem->blockSize,
+                    &blockRun)) {
                 delete[] block;
-                errno = EIO;
                 return -1;
             }
 
-            if (entry->inode == 0) {
-                offset += entry->rec_len;
-                continue;
-            }
-
-            if (entry->name_len == nameLength && memcmp(name, entry->name,
-                    nameLength) == 0) {
-                *de = *entry;
+            size_t blockOffset;
+            found = searchDirectoryBlock(block, name, nameLength,
+                    &blockOffset);
+            if (found < 0) {
                 delete[] block;
-                return blockNum * filesystem->blockSize + offset;
+                return -1;
             }
-
-            offset += entry->rec_len;
+            offset = blockNum * filesystem->blockSize + blockOffset;
+            blockNum++;
         }
+    }
 
-        bytesRead += filesystem->blockSize;
-        blockNum++;
+    if (!found) {
+        delete[] block;
+        errno = ENOENT;
+        return -1;
     }
 
+    *de = *(DirectoryEntry*) (block + offset % filesystem->blockSize);
     delete[] block;
-    return -1;
+    return offset;
 }
 
 int Ext234Vnode::ftruncate(off_t length) {
@@ -283,10 +301,11 @@ int Ext234Vnode::ftruncate(off_t length) {
     }
 
     off_t oldSize = stats.st_size;
-    if (!filesystem->resizeInode(stats.st_ino, &inode, length)) {
+    if (!filesystem->resizeInode(stats.st_ino, &inode, length, &blockRun)) {
         return -1;
     }
     stats.st_size = length;
+    pageCache.truncate(length < oldSize ? length : oldSize);
 
     while (length > oldSize) {
         char* buffer = new char[filesystem->blockSize];
@@ -294,7 +313,8 @@ int Ext234Vnode::ftruncate(off_t length) {
         memset(buffer, 0, filesystem->blockSize);
         size_t diff = length - oldSize;
         if (diff > filesystem->blockSize) diff = filesystem->blockSize;
-        if (!filesystem->writeInodeData(&inode, oldSize, buffer, diff)) {
+        if (!filesystem->writeInodeData(stats.st_ino, &inode, oldSize,
+                buffer, diff, &blockRun)) {
             delete[] buffer;
             return -1;
         }
@@ -315,138 +335,101 @@ Reference<Vnode> Ext234Vnode::getChildNode(const char* path, size_t length) {
     return getChildNodeUnlocked(path, length);
 }
 
-Reference<Vnode> Ext234Vnode::getChildNodeUnlocked(const char* path,
-        size_t length) {
-    if (!S_ISDIR(stats.st_mode)) {
-        errno = ENOTDIR;
-        return nullptr;
-    }
+void Ext234Vnode::getChildNodes(const char* const* names, size_t count,
+        Reference<Vnode>* results, int* errors) {
+    AutoLock lock(&mutex);
 
-    if (stats.st_ino == 2 && length == 2 && strncmp(path, "..", 2) == 0) {
-        return filesystem->mountPoint->getChildNode(path, length);
+    // Indexed directories are searched using the hash tree for each name.
+    // Otherwise names that are not in the dentry cache are looked up in a
+    // single pass over the directory. Until then their error is set to -1.
+    bool indexed = inode.i_flags & INODE_INDEX_FL &&
+            filesystem->hasCompatFeature(COMPAT_DIR_INDEX);
+    size_t remaining = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(names[i]);
+        ino_t ino;
+        if (!S_ISDIR(stats.st_mode) || indexed ||
+                (stats.st_ino == 2 && strcmp(names[i], "..") == 0)) {
+            results[i] = getChildNodeUnlocked(names[i], length);
+            errors[i] = results[i] ? 0 : errno;
+        } else if (DentryCache::lookup(stats.st_dev, stats.st_ino, names[i],
+                length, &ino)) {
+            results[i] = ino ? filesystem->getVnode(ino) : nullptr;
+            errors[i] = results[i] ? 0 : ino ? errno : ENOENT;
+        } else {
+            results[i] = nullptr;
+            errors[i] = -1;
+            remaining++;
+        }
     }
+    if (remaining == 0) return;
 
-    DirectoryEntry entry;
-    if (findDirectoryEntry(path, length, &entry) != (uint64_t) -1) {
-        return filesystem->getVnode(entry.inode);
+    int error = ENOENT;
+    char* block = new char[filesystem->blockSize];
+    if (!block) error = errno;
+    uint64_t blockNum = 0;
+    while (block && remaining > 0 &&
+            blockNum * filesystem->blockSize < (uint64_t) stats.st_size) {
+        if (!filesystem->readInodeData(&inode, blockNum *
+                filesystem->blockSize, block, filesystem->blockSize,
+                &blockRun)) {
+            error = errno;
+            break;
+        }
+
+        ssize_t found = matchDirectoryBlock(block, names, count, results,
+                errors);
+        if (found < 0) {
+            error = errno;
+            break;
+        }
+        remaining -= found;
+        blockNum++;
     }
+    delete[] block;
 
-    errno = ENOENT;
-    return nullptr;
+    for (size_t i = 0; remaining > 0 && i < count; i++) {
+        if (errors[i] != -1) continue;
+        if (error == ENOENT && stats.st_nlink > 0) {
+            DentryCache::add(stats.st_dev, stats.st_ino, names[i],
+                    strlen(names[i]), 0);
+        }
+        errors[i] = error;
+        remaining--;
+    }
 }
 
-size_t Ext234Vnode::getDirectoryEntries(void** buffer, int flags) {
-    AutoLock lock(&mutex);
-
+Reference<Vnode> Ext234Vnode::getChildNodeUnlocked(const char* path,
+        size_t length) {
     if (!S_ISDIR(stats.st_mode)) {
-        *buffer = nullptr;
         errno = ENOTDIR;
-        return 0;
+        return nullptr;
     }
 
-    // We do not know in advance how large the buffer needs to be, but the size
-    // on disk is a good estimate.
-    *buffer = malloc(stats.st_size);
-    if (!*buffer) return 0;
-    size_t allocatedSize = stats.st_size;
-
-    size_t bufferOffset = 0;
-    off_t bytesRead = 0;
-    size_t blockNum = 0;
-    while (bytesRead < stats.st_size) {
-        char* block = new char[filesystem->blockSize];
-        if (!block) {
-            free(*buffer);
-            *buffer = nullptr;
-            return 0;
-        }
-        if (!filesystem->readInodeData(&inode, blockNum * filesystem->blockSize,
-                block, filesystem->blockSize)) {
-            delete[] block;
-            free(*buffer);
-            *buffer = nullptr;
-            return 0;
-        }
-
-        size_t offset = 0;
-        while (offset < filesystem->blockSize) {
-            DirectoryEntry* entry = (DirectoryEntry*) (block + offset);
-
-            if (entry->rec_len < 8) {
-                delete[] block;
-                free(*buffer);
-                *buffer = nullptr;
-                errno = EIO;
-                return 0;
-            }
-
-            if (entry->inode == 0) {
-                offset += entry->rec_len;
-                continue;
-            }
-
-            reclen_t reclen = ALIGNUP(sizeof(posix_dent) + entry->name_len + 1,
-                    alignof(posix_dent));
-
-            if (bufferOffset + reclen > allocatedSize) {
-                allocatedSize = allocatedSize + ALIGNUP(reclen, 1024);
-                void* newBuffer = realloc(*buffer, allocatedSize);
-                if (!newBuffer) {
-                    delete[] block;
-                    free(*buffer);
-                    *buffer = nullptr;
-                    return 0;
-                }
-                *buffer = newBuffer;
-            }
-
-            posix_dent* dent = (posix_dent*) ((char*) *buffer + bufferOffset);
-            dent->d_ino = entry->inode;
-
-            // If another filesystem has been mounted at a directory we must
-            // give the inode number for that filesystem.
-            if (dent->d_ino != stats.st_ino) {
-                Reference<Ext234Vnode> vnode =
-                        filesystem->getVnodeIfOpen(entry->inode);
-                if (vnode && vnode->mounted) {
-                    Reference<Vnode> vnode2 = vnode->resolve();
-                    dent->d_ino = vnode2->stat().st_ino;
-                }
-            }
-
-            dent->d_reclen = reclen;
-
-            if (filesystem->hasIncompatFeature(INCOMPAT_FILETYPE)) {
-                dent->d_type = typeToDT(entry->file_type);
-            } else if (flags & DT_FORCE_TYPE) {
-                Reference<Vnode> vnode = filesystem->getVnode(entry->inode);
-                if (vnode) {
-                    dent->d_type = IFTODT(vnode->stat().st_mode);
-                } else {
-                    dent->d_type = DT_UNKNOWN;
-                }
-            } else {
-                dent->d_type = DT_UNKNOWN;
-            }
+    if (stats.st_ino == 2 && length == 2 && strncmp(path, "..", 2) == 0) {
+        return filesystem->mountPoint->getChildNode(path, length);
+    }
 
-            memcpy(&dent->d_name, entry->name, entry->name_len);
-            dent->d_name[entry->name_len] = '\0';
+    ino_t ino;
+    if (DentryCache::lookup(stats.st_dev, stats.st_ino, path, length, &ino)) {
+        if (ino) return filesystem->getVnode(ino);
+        errno = ENOENT;
+        return nullptr;
+    }
 
-            bufferOffset += dent->d_reclen;
-            offset += entry->rec_len;
+    DirectoryEntry entry;
+    if (findDirectoryEntry(path, length, &entry) != (uint64_t) -1) {
+        if (stats.st_nlink > 0) {
+            DentryCache::add(stats.st_dev, stats.st_ino, path, length,
+                    entry.inode);
         }
-
-        delete[] block;
-        bytesRead += filesystem->blockSize;
-        blockNum++;
+        return filesystem->getVnode(entry.inode);
     }
 
-    void* result = realloc(*buffer, bufferOffset);
-    if (result) {
-        *buffer = result;
+    if (errno == ENOENT && stats.st_nlink > 0) {
+        DentryCache::add(stats.st_dev, stats.st_ino, path, length, 0);
     }
-
-    return bufferOffset;
+    return nullptr;
 }
 
 char* Ext234Vnode::getLinkTarget() {
@@ -458,7 +441,8 @@ char* Ext234Vnode::getLinkTarget() {
     } else {
         char* result = (char*) malloc(stats.st_size);
         if (!result) return nullptr;
-        if (!filesystem->readInodeData(&inode, 0, result, stats.st_size)) {
+        if (!filesystem->readInodeData(&inode, 0, result, stats.st_size,
+                &blockRun)) {
             free(result);
             return nullptr;
         }
@@ -483,6 +467,12 @@ bool Ext234Vnode::isAncestor(const Reference<Vnode>& vnode) {
     return false;
 }
 
+paddr_t Ext234Vnode::getMappedPage(size_t index, bool writable) {
+    AutoLock lock(&mutex);
+    if (!readPage(index)) return 0;
+    return pageCache.referencePage(index, writable);
+}
+
 bool Ext234Vnode::isSeekable() {
     return S_ISREG(stats.st_mode);
 }
@@ -589,6 +579,26 @@ int Ext234Vnode::mkdir(const char* name, mode_t mode) {
     return 0;
 }
 
+vaddr_t Ext234Vnode::mmap(AddressSpace* addressSpace, size_t size,
+        int protection, int flags, off_t offset) {
+    AutoLock lock(&mutex);
+
+    if (!S_ISREG(stats.st_mode)) {
+        errno = ENODEV;
+        return 0;
+    }
+
+    if (flags & MAP_SHARED && protection & PROT_WRITE &&
+            filesystem->readonly) {
+        errno = EROFS;
+        return 0;
+    }
+
+    // The pages are read when they are accessed for the first time.
+    return addressSpace->mapFile(this, offset / PAGESIZE, size, protection,
+            flags & MAP_SHARED);
+}
+
 int Ext234Vnode::mount(FileSystem* filesystem) {
     AutoLock lock(&mutex);
 
@@ -626,7 +636,8 @@ bool Ext234Vnode::onUnlink(bool force) {
             char* block = new char[filesystem->blockSize];
             if (!block) return false;
             if (!filesystem->readInodeData(&inode, blockNum *
-                    filesystem->blockSize, block, filesystem->blockSize)) {
+                    filesystem->blockSize, block, filesystem->blockSize,
+                    &blockRun)) {
                 delete[] block;
                 return false;
             }
@@ -653,7 +664,7 @@ bool Ext234Vnode::onUnlink(bool force) {
         }
 
         if (count >= 3) return false;
-        filesystem->resizeInode(stats.st_ino, &inode, 0);
+        filesystem->resizeInode(stats.st_ino, &inode, 0, &blockRun);
         stats.st_nlink--;
     }
 
@@ -742,8 +753,34 @@ ssize_t Ext234Vnode::pread(void* buffer, size_t size, off_t offset,
         size = stats.st_size - offset;
     }
 
-    if (!filesystem->readInodeData(&inode, offset, buffer, size)) {
-        return -1;
+    if (pageCache.pageCount == 0) {
+        if (!filesystem->readInodeData(&inode, offset, buffer, size,
+                &blockRun)) {
+            return -1;
+        }
+        updateTimestamps(true, false, false);
+        return size;
+    }
+
+    char* buf = (char*) buffer;
+    size_t bytesRead = 0;
+    while (bytesRead < size) {
+        off_t position = offset + bytesRead;
+        size_t index = position / PAGESIZE;
+        size_t pageOffset = position % PAGESIZE;
+        size_t count = PAGESIZE - pageOffset;
+        if (count > size - bytesRead) count = size - bytesRead;
+
+        // Cached pages might have been modified through a shared mapping.
+        if (pageCache.getPage(index)) {
+            if (!pageCache.read(index, pageOffset, buf + bytesRead, count)) {
+                return -1;
+            }
+        } else if (!filesystem->readInodeData(&inode, position,
+                buf + bytesRead, count, &blockRun)) {
+            return -1;
+        }
+        bytesRead += count;
     }
 
     updateTimestamps(true, false, false);
@@ -780,18 +817,166 @@ ssize_t Ext234Vnode::pwrite(const void* buffer, size_t size, off_t offset,
     }
 
     if (newSize > stats.st_size) {
-        if (!filesystem->resizeInode(stats.st_ino, &inode, newSize)) {
+        if (!filesystem->resizeInode(stats.st_ino, &inode, newSize,
+                &blockRun)) {
             return -1;
         }
+        pageCache.truncate(stats.st_size);
         stats.st_size = newSize;
     }
 
-    if (!filesystem->writeInodeData(&inode, offset, buffer, size)) return -1;
+    // Update the pages that are cached so that they stay consistent with
+    // the file.
+    const char* buf = (const char*) buffer;
+    for (size_t written = 0; written < size && pageCache.pageCount > 0;) {
+        off_t position = offset + written;
+        size_t pageOffset = position % PAGESIZE;
+        size_t count = PAGESIZE - pageOffset;
+        if (count > size - written) count = size - written;
+
+        if (!pageCache.write(position / PAGESIZE, pageOffset, buf + written,
+                count, false)) {
+            return -1;
+        }
+        written += count;
+    }
+
+    if (!filesystem->writeInodeData(stats.st_ino, &inode, offset, buffer,
+            size, &blockRun)) {
+        return -1;
+    }
 
     updateTimestamps(false, true, true);
     return size;
 }
 
+bool Ext234Vnode::readPage(size_t index) {
+    if (pageCache.getPage(index)) return true;
+
+    vaddr_t address = pageCache.mapPage(index);
+    if (!address) return false;
+
+    // Pages beyond the end of the file are left zero-filled.
+    off_t offset = (off_t) index * PAGESIZE;
+    if (offset < stats.st_size) {
+        size_t size = PAGESIZE;
+        if (stats.st_size - offset < PAGESIZE) size = stats.st_size - offset;
+
+        if (!filesystem->readInodeData(&inode, offset, (void*) address,
+                size, &blockRun)) {
+            pageCache.unmapPage(address);
+            pageCache.dropPage(index);
+            return false;
+        }
+    }
+
+    pageCache.unmapPage(address);
+    return true;
+}
+
+ssize_t Ext234Vnode::readDirectoryEntries(void* buffer, size_t size,
+        off_t* offset, int flags) {
+    AutoLock lock(&mutex);
+
+    if (!S_ISDIR(stats.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+
+    // The offset is the byte offset of the next entry in the directory, so
+    // reading can continue where the last call stopped without rescanning
+    // the directory.
+    char* block = new char[filesystem->blockSize];
+    if (!block) return -1;
+
+    size_t bufferOffset = 0;
+    off_t position = *offset;
+    bool bufferFull = false;
+    bool error = false;
+    while (!bufferFull && position < stats.st_size) {
+        uint64_t blockNum = position / filesystem->blockSize;
+        size_t offsetInBlock = position % filesystem->blockSize;
+        if (!filesystem->readInodeData(&inode, blockNum * filesystem->blockSize,
+                block, filesystem->blockSize, &blockRun)) {
+            error = true;
+            break;
+        }
+
+        while (offsetInBlock < filesystem->blockSize) {
+            DirectoryEntry* entry = (DirectoryEntry*) (block + offsetInBlock);
+
+            if (entry->rec_len < 8 ||
+                    entry->rec_len > filesystem->blockSize - offsetInBlock) {
+                errno = EIO;
+                error = true;
+                break;
+            }
+
+            if (entry->inode != 0) {
+                reclen_t reclen = ALIGNUP(sizeof(posix_dent) +
+                        entry->name_len + 1, alignof(posix_dent));
+                if (bufferOffset + reclen > size) {
+                    bufferFull = true;
+                    break;
+                }
+
+                posix_dent* dent = (posix_dent*) ((char*) buffer +
+                        bufferOffset);
+                dent->d_ino = entry->inode;
+
+                // If another filesystem has been mounted at a directory we
+                // must give the inode number for that filesystem.
+                if (dent->d_ino != stats.st_ino) {
+                    Reference<Ext234Vnode> vnode =
+                            filesystem->getVnodeIfOpen(entry->inode);
+                    if (vnode && vnode->mounted) {
+                        Reference<Vnode> vnode2 = vnode->resolve();
+                        dent->d_ino = vnode2->stat().st_ino;
+                    }
+                }
+
+                dent->d_reclen = reclen;
+
+                if (filesystem->hasIncompatFeature(INCOMPAT_FILETYPE)) {
+                    dent->d_type = typeToDT(entry->file_type);
+                } else if (flags & DT_FORCE_TYPE) {
+                    Reference<Vnode> vnode =
+                            filesystem->getVnode(entry->inode);
+                    if (vnode) {
+                        dent->d_type = IFTODT(vnode->stat().st_mode);
+                    } else {
+                        dent->d_type = DT_UNKNOWN;
+                    }
+                } else {
+                    dent->d_type = DT_UNKNOWN;
+                }
+
+                memcpy(&dent->d_name, entry->name, entry->name_len);
+                dent->d_name[entry->name_len] = '\0';
+                bufferOffset += reclen;
+            }
+
+            offsetInBlock += entry->rec_len;
+            position = blockNum * filesystem->blockSize + offsetInBlock;
+        }
+
+        if (error) break;
+    }
+
+    delete[] block;
+
+    if (bufferOffset == 0) {
+        if (error) return -1;
+        if (bufferFull) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    *offset = position;
+    return bufferOffset;
+}
+
 ssize_t Ext234Vnode::readlink(char* buffer, size_t size) {
     if (!S_ISLNK(stats.st_mode)) {
         errno = EINVAL;
@@ -805,7 +990,7 @@ ssize_t Ext234Vnode::readlink(char* buffer, size_t size) {
     if (stats.st_size < 60) {
         memcpy(buffer, inode.i_block, size);
         buffer[size] = '\0';
-    } else if (!filesystem->readInodeData(&inode, 0, buffer, size)) {
+    } else if (!filesystem->readInodeData(&inode, 0, buffer, size, &blockRun)) {
         return -1;
     }
 
@@ -931,6 +1116,67 @@ Reference<Vnode> Ext234Vnode::resolve() {
     return this;
 }
 
+// Looks up the vnodes of all entries in the directory block whose names match
+// a name that has an error of -1. Returns the number of matched names or -1 on
+// error.
+ssize_t Ext234Vnode::matchDirectoryBlock(const char* block,
+        const char* const* names, size_t count, Reference<Vnode>* results,
+        int* errors) {
+    ssize_t found = 0;
+    size_t i = 0;
+    while (i < filesystem->blockSize) {
+        const DirectoryEntry* entry = (const DirectoryEntry*) (block + i);
+
+        if (entry->rec_len < 8) {
+            errno = EIO;
+            return -1;
+        }
+
+        for (size_t j = 0; entry->inode != 0 && j < count; j++) {
+            if (errors[j] != -1 || strlen(names[j]) != entry->name_len ||
+                    memcmp(names[j], entry->name, entry->name_len) != 0) {
+                continue;
+            }
+            if (stats.st_nlink > 0) {
+                DentryCache::add(stats.st_dev, stats.st_ino, names[j],
+                        entry->name_len, entry->inode);
+            }
+            results[j] = filesystem->getVnode(entry->inode);
+            errors[j] = results[j] ? 0 : errno;
+            found++;
+        }
+
+        i += entry->rec_len;
+    }
+
+    return found;
+}
+
+// Returns 1 and the offset of the entry within the block if the name was found
+// in the directory block, 0 if it was not found and -1 on error.
+int Ext234Vnode::searchDirectoryBlock(const char* block, const char* name,
+        size_t nameLength, size_t* offset) {
+    size_t i = 0;
+    while (i < filesystem->blockSize) {
+        const DirectoryEntry* entry = (const DirectoryEntry*) (block + i);
+
+        if (entry->rec_len < 8) {
+            errno = EIO;
+            return -1;
+        }
+
+        if (entry->inode != 0 && entry->name_len == nameLength &&
+                memcmp(name, entry->name, nameLength) == 0) {
+            *offset = i;
+            return 1;
+        }
+
+        i += entry->rec_len;
+    }
+
+    return 0;
+}
+
 int Ext234Vnode::symlink(const char* linkTarget, const char* name) {
     AutoLock lock(&mutex);
     if (filesystem->readonly) {
@@ -956,9 +1202,10 @@ int Ext234Vnode::symlink(const char* linkTarget, const char* name) {
         symlink->inode.i_size = length;
         memcpy(symlink->inode.i_block, linkTarget, length);
     } else {
-        if (!filesystem->resizeInode(ino, &symlink->inode, length) ||
-                !filesystem->writeInodeData(&symlink->inode, 0, linkTarget,
-                length)) {
+        if (!filesystem->resizeInode(ino, &symlink->inode, length,
+                &symlink->blockRun) ||
+                !filesystem->writeInodeData(ino, &symlink->inode, 0,
+                linkTarget, length, &symlink->blockRun)) {
             return -1;
         }
     }
@@ -969,6 +1216,8 @@ int Ext234Vnode::symlink(const char* linkTarget, const char* name) {
 int Ext234Vnode::sync(int flags) {
     AutoLock lock(&mutex);
 
+    if (!filesystem->readonly && !writeBackPages()) return -1;
+
     if (inodeModified) {
         if (!filesystem->writeInode(&inode, inodeAddress)) return -1;
         inodeModified = false;
@@ -1023,11 +1272,13 @@ int Ext234Vnode::unlinkUnlocked(const char* name, int flags) {
     if (S_ISDIR(mode)) {
         stats.st_nlink--;
         inode.i_links_count = stats.st_nlink;
+        DentryCache::removeDirectory(stats.st_dev, entry.inode);
     }
 
+    DentryCache::remove(stats.st_dev, stats.st_ino, name, nameLength);
     entry.inode = 0;
-    if (!filesystem->writeInodeData(&inode, offset, &entry,
-            sizeof(DirectoryEntry))) {
+    if (!filesystem->writeInodeData(stats.st_ino, &inode, offset, &entry,
+            sizeof(DirectoryEntry), &blockRun)) {
         return -1;
     }
 
@@ -1054,10 +1305,11 @@ bool Ext234Vnode::updateParent(const Reference<Ext234Vnode>& parent) {
     DirectoryEntry entry;
     uint64_t offset = findDirectoryEntry("..", 2, &entry);
     if (offset == (uint64_t) -1) return false;
+    DentryCache::remove(stats.st_dev, stats.st_ino, "..", 2);
     entry.inode = parent->stats.st_ino;
     inodeModified = true;
-    return filesystem->writeInodeData(&inode, offset, &entry,
-            sizeof(DirectoryEntry));
+    return filesystem->writeInodeData(stats.st_ino, &inode, offset, &entry,
+            sizeof(DirectoryEntry), &blockRun);
 }
 
 void Ext234Vnode::updateTimestamps(bool access, bool status,
@@ -1079,6 +1331,33 @@ int Ext234Vnode::utimens(struct timespec atime, struct timespec mtime) {
     return 0;
 }
 
+bool Ext234Vnode::writeBackPages() {
+    for (size_t i = 0; i < pageCache.pageCount; i++) {
+        if (!pageCache.needsWriteback(i)) continue;
+
+        // Data beyond the end of the file is not written back.
+        off_t offset = (off_t) i * PAGESIZE;
+        if (offset < stats.st_size) {
+            size_t size = PAGESIZE;
+            if (stats.st_size - offset < PAGESIZE) {
+                size = stats.st_size - offset;
+            }
+
+            vaddr_t address = pageCache.mapPage(i);
+            if (!address) return false;
+            bool success = filesystem->writeInodeData(stats.st_ino, &inode,
+                    offset, (const void*) address, size, &blockRun);
+            pageCache.unmapPage(address);
+            if (!success) return false;
+            // Writing into a hole changes the block mapping in the inode.
+            inodeModified = true;
+        }
+        pageCache.setClean(i);
+    }
+
+    return true;
+}
+
 void Ext234Vnode::writeTimestamps() {
     little_uint32_t* atimeExtra = nullptr;
     little_uint32_t* ctimeExtra = nullptr;
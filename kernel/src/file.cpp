@@ -22,21 +22,43 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <cobalt/mman.h>
 #include <cobalt/poll.h>
 #include <cobalt/seek.h>
 #include <cobalt/stat.h>
+#include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/file.h>
 
 FileVnode::FileVnode(const void* data, size_t size, mode_t mode, dev_t dev)
         : Vnode(S_IFREG | mode, dev) {
-    this->data = (char*) malloc(size);
-    if (!this->data) FAIL_CONSTRUCTOR;
-    memcpy(this->data, data, size);
+    const char* buffer = (const char*) data;
+    for (size_t i = 0; i < size; i += PAGESIZE) {
+        size_t copySize = size - i < PAGESIZE ? size - i : PAGESIZE;
+        if (!pageCache.write(i / PAGESIZE, 0, buffer + i, copySize, true)) {
+            FAIL_CONSTRUCTOR;
+        }
+    }
     stats.st_size = size;
 }
 
-FileVnode::~FileVnode() {
-    free(data);
+FileVnode::FileVnode(const void* data, paddr_t physicalAddress, size_t size,
+        mode_t mode, dev_t dev) : Vnode(S_IFREG | mode, dev) {
+    size_t fullPages = size / PAGESIZE;
+    for (size_t i = 0; i < fullPages; i++) {
+        if (!pageCache.adoptPage(i, physicalAddress + i * PAGESIZE)) {
+            FAIL_CONSTRUCTOR;
+        }
+    }
+
+    // The rest of the last frame belongs to something else and cannot be
+    // mapped into processes.
+    if (size % PAGESIZE) {
+        if (!pageCache.write(fullPages, 0, (const char*) data +
+                fullPages * PAGESIZE, size % PAGESIZE, true)) {
+            FAIL_CONSTRUCTOR;
+        }
+    }
+    stats.st_size = size;
 }
 
 int FileVnode::ftruncate(off_t length) {
@@ -50,22 +72,28 @@ int FileVnode::ftruncate(off_t length) {
     }
 
     AutoLock lock(&mutex);
-    void* newData = realloc(data, (size_t) length);
-    if (!newData) {
-        errno = ENOSPC;
-        return -1;
-    }
-    data = (char*) newData;
-
-    if (length > stats.st_size) {
-        memset(data + stats.st_size, '\0', length - stats.st_size);
-    }
+    // Pages that are not in the cache read as zeros, so we only need to
+    // remove the data beyond the new or the old end of the file.
+    pageCache.truncate(length < stats.st_size ? length : stats.st_size);
 
     stats.st_size = length;
     updateTimestamps(false, true, true);
     return 0;
 }
 
+paddr_t FileVnode::getMappedPage(size_t index, bool writable) {
+    AutoLock lock(&mutex);
+
+    // Holes in the file need a page before they can be mapped.
+    if (!pageCache.getPage(index)) {
+        vaddr_t address = pageCache.mapPage(index);
+        if (!address) return 0;
+        pageCache.unmapPage(address);
+    }
+
+    return pageCache.referencePage(index, writable);
+}
+
 bool FileVnode::isSeekable() {
     return true;
 }
@@ -92,6 +120,13 @@ off_t FileVnode::lseek(off_t offset, int whence) {
     return result;
 }
 
+vaddr_t FileVnode::mmap(AddressSpace* addressSpace, size_t size,
+        int protection, int flags, off_t offset) {
+    // The pages are created when they are accessed for the first time.
+    return addressSpace->mapFile(this, offset / PAGESIZE, size, protection,
+            flags & MAP_SHARED);
+}
+
 short FileVnode::poll() {
     return POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM;
 }
@@ -105,18 +140,29 @@ ssize_t FileVnode::pread(void* buffer, size_t size, off_t offset,
     if (size == 0) return 0;
 
     AutoLock lock(&mutex);
-    char* buf = (char*) buffer;
+    if (offset >= stats.st_size) return 0;
+    if ((uintmax_t) size > (uintmax_t) (stats.st_size - offset)) {
+        size = stats.st_size - offset;
+    }
 
-    for (size_t i = 0; i < size; i++) {
-        off_t j;
-        if (__builtin_add_overflow(offset, i, &j) || j >= stats.st_size) {
-            return i;
+    char* buf = (char*) buffer;
+    size_t bytesRead = 0;
+    while (bytesRead < size) {
+        off_t position = offset + bytesRead;
+        size_t pageOffset = position % PAGESIZE;
+        size_t count = PAGESIZE - pageOffset;
+        if (count > size - bytesRead) count = size - bytesRead;
+
+        if (!pageCache.read(position / PAGESIZE, pageOffset, buf + bytesRead,
+                count)) {
+            if (bytesRead == 0) return -1;
+            break;
         }
-        buf[i] = data[j];
+        bytesRead += count;
     }
 
     updateTimestamps(true, false, false);
-    return size;
+    return bytesRead;
 }
 
 ssize_t FileVnode::pwrite(const void* buffer, size_t size, off_t offset,
@@ -141,22 +187,32 @@ ssize_t FileVnode::pwrite(const void* buffer, size_t size, off_t offset,
     }
 
     if (newSize > stats.st_size) {
-        void* newData = realloc(data, (size_t) newSize);
-        if (!newData) {
-            errno = ENOSPC;
-            return -1;
-        }
-        data = (char*) newData;
+        // When writing after the old EOF, the gap needs to read as zeros.
+        pageCache.truncate(stats.st_size);
+    }
 
-        if (offset > stats.st_size) {
-            // When writing after the old EOF, fill the gap with zeros.
-            memset(data + stats.st_size, '\0', offset - stats.st_size);
+    const char* buf = (const char*) buffer;
+    size_t written = 0;
+    while (written < size) {
+        off_t position = offset + written;
+        size_t pageOffset = position % PAGESIZE;
+        size_t count = PAGESIZE - pageOffset;
+        if (count > size - written) count = size - written;
+
+        if (!pageCache.write(position / PAGESIZE, pageOffset, buf + written,
+                count, true)) {
+            if (written == 0) {
+                errno = ENOSPC;
+                return -1;
+            }
+            break;
         }
-
-        stats.st_size = newSize;
+        written += count;
     }
 
-    memcpy(data + offset, buffer, size);
+    if (offset + (off_t) written > stats.st_size) {
+        stats.st_size = offset + written;
+    }
     updateTimestamps(false, true, true);
-    return size;
+    return written;
 }
@@ -18,17 +18,21 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <cobalt/dent.h>
 #include <cobalt/fcntl.h>
+#include <cobalt/mman.h>
 #include <cobalt/seek.h>
 #include <cobalt/kernel/directory.h>
+#include <cobalt/kernel/epoll.h>
 #include <cobalt/kernel/file.h>
 #include <cobalt/kernel/filedescription.h>
 
 #define FILE_STATUS_FLAGS (O_APPEND | O_NONBLOCK | O_SYNC)
+#define COPY_BUFFER_SIZE (64 * 1024)
 
 FileDescription::FileDescription(const Reference<Vnode>& vnode, int flags)
         : vnode(vnode) {
@@ -36,10 +40,15 @@ FileDescription::FileDescription(const Reference<Vnode>& vnode, int flags)
     offset = 0;
     fileFlags = flags & (O_ACCMODE | FILE_STATUS_FLAGS);
     dents = nullptr;
+    dentsPosition = 0;
     dentsSize = 0;
+    epollItems = nullptr;
 }
 
 FileDescription::~FileDescription() {
+    if (epollItems) {
+        Epoll::removeDescription(this);
+    }
     free(dents);
 }
 
@@ -60,6 +69,80 @@ int FileDescription::connect(const struct sockaddr* address, socklen_t length) {
     return vnode->connect(address, length, fileFlags);
 }
 
+// Copies data through a kernel buffer for transfers that cannot use the buffer
+// of a pipe or socket directly.
+ssize_t FileDescription::copy(const Reference<FileDescription>& out,
+        off_t* inOffset, off_t* outOffset, size_t size, int flags) {
+    size_t bufferSize = size < COPY_BUFFER_SIZE ? size : COPY_BUFFER_SIZE;
+    char* buffer = (char*) malloc(bufferSize);
+    if (!buffer) return -1;
+
+    bool seekable = vnode->isSeekable();
+    size_t transferred = 0;
+    while (transferred < size) {
+        size_t count = size - transferred;
+        if (count > bufferSize) count = bufferSize;
+
+        ssize_t bytesRead;
+        if (inOffset) {
+            bytesRead = vnode->pread(buffer, count, *inOffset, fileFlags);
+        } else if (seekable) {
+            bytesRead = read(buffer, count);
+        } else {
+            bytesRead = vnode->read(buffer, count, fileFlags | flags);
+        }
+        if (bytesRead < 0) {
+            if (transferred) break;
+            free(buffer);
+            return -1;
+        }
+        if (bytesRead == 0) break;
+
+        // Data read from a pipe or socket cannot be given back, so it is
+        // written even if the output would block.
+        int writeFlags = out->fileFlags | flags;
+        if (!seekable) writeFlags &= ~O_NONBLOCK;
+
+        size_t written = 0;
+        while (written < (size_t) bytesRead) {
+            ssize_t result;
+            if (outOffset) {
+                result = out->vnode->pwrite(buffer + written,
+                        bytesRead - written, *outOffset, out->fileFlags);
+                if (result > 0) *outOffset += result;
+            } else if (out->vnode->isSeekable()) {
+                result = out->write(buffer + written, bytesRead - written);
+            } else {
+                result = out->vnode->write(buffer + written,
+                        bytesRead - written, writeFlags);
+            }
+            if (result <= 0) break;
+            written += result;
+        }
+
+        if (inOffset) {
+            *inOffset += written;
+        } else if (seekable && written < (size_t) bytesRead) {
+            // Data that could not be written is read again by the next call.
+            lseek(written - bytesRead, SEEK_CUR);
+        }
+        transferred += written;
+
+        if (written < (size_t) bytesRead) {
+            // Input from a pipe or socket that was not written is lost, so
+            // this is reported as an error and not as a short transfer.
+            if (transferred && seekable) break;
+            free(buffer);
+            return -1;
+        }
+        // Another read from a pipe or socket might block.
+        if (!seekable || (size_t) bytesRead < count) break;
+    }
+
+    free(buffer);
+    return transferred;
+}
+
 int FileDescription::fcntl(int cmd, int param) {
     AutoLock lock(&mutex);
 
@@ -82,24 +165,29 @@ ssize_t FileDescription::getdents(void* buffer, size_t size, int flags) {
     }
 
     AutoLock lock(&mutex);
+    if (size > SSIZE_MAX) size = SSIZE_MAX;
+
     if (!dents) {
+        ssize_t result = vnode->readDirectoryEntries(buffer, size, &offset,
+                flags);
+        if (result >= 0) {
+            vnode->updateTimestampsLocked(true, false, false);
+            return result;
+        }
+        if (errno != ENOTSUP) return -1;
+
+        // The vnode cannot resume reading at an offset, so we read a snapshot
+        // of the whole directory and keep a cursor into it.
         dentsSize = vnode->getDirectoryEntries(&dents, flags);
         if (!dents) return -1;
+        seekDents();
     }
 
-    size_t byteOffset = 0;
-    for (off_t i = 0; i < offset; i++) {
-        if (byteOffset + sizeof(struct posix_dent) > dentsSize) break;
-        posix_dent* dent = (posix_dent*) ((uintptr_t) dents + byteOffset);
-        byteOffset += dent->d_reclen;
-    }
-
-    void* copyBegin = (void*) ((uintptr_t) dents + byteOffset);
+    void* copyBegin = (void*) ((uintptr_t) dents + dentsPosition);
     // Determine the number of bytes to copy.
     size_t copySize = 0;
-    if (size > SSIZE_MAX) size = SSIZE_MAX;
     while (true) {
-        if (byteOffset + copySize + sizeof(struct posix_dent) > dentsSize) {
+        if (dentsPosition + copySize + sizeof(struct posix_dent) > dentsSize) {
             break;
         }
         posix_dent* dent = (posix_dent*) ((uintptr_t) copyBegin + copySize);
@@ -109,12 +197,13 @@ ssize_t FileDescription::getdents(void* buffer, size_t size, int flags) {
     }
 
     if (copySize == 0) {
-        if (byteOffset == dentsSize) return 0;
+        if (dentsPosition == dentsSize) return 0;
         errno = EINVAL;
         return -1;
     }
 
     memcpy(buffer, copyBegin, copySize);
+    dentsPosition += copySize;
     vnode->updateTimestampsLocked(true, false, false);
     return copySize;
 }
@@ -138,9 +227,34 @@ off_t FileDescription::lseek(off_t offset, int whence) {
     }
 
     this->offset = result;
+    if (dents) {
+        seekDents();
+    }
     return result;
 }
 
+vaddr_t FileDescription::mmap(AddressSpace* addressSpace, size_t size,
+        int protection, int flags, off_t offset) {
+    if (!(fileFlags & O_RDONLY) || (flags & MAP_SHARED &&
+            protection & PROT_WRITE && !(fileFlags & O_WRONLY))) {
+        errno = EACCES;
+        return 0;
+    }
+
+    if (offset < 0 || !PAGE_ALIGNED(offset)) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    // The page index of the end of the mapping needs to fit into a size_t.
+    if ((uintmax_t) offset > SIZE_MAX - size) {
+        errno = EOVERFLOW;
+        return 0;
+    }
+
+    return vnode->mmap(addressSpace, size, protection, flags, offset);
+}
+
 Reference<FileDescription> FileDescription::openat(const char* path, int flags,
         mode_t mode) {
     const char* name;
@@ -189,6 +303,71 @@ ssize_t FileDescription::read(void* buffer, size_t size) {
     return vnode->read(buffer, size, fileFlags);
 }
 
+// Finds the position in the directory snapshot that matches the offset.
+void FileDescription::seekDents() {
+    // The offset of a snapshot is the index of the entry. Finding it is only
+    // needed after seeking.
+    dentsPosition = 0;
+    for (off_t i = 0; i < offset; i++) {
+        if (dentsPosition + sizeof(struct posix_dent) > dentsSize) break;
+        posix_dent* dent = (posix_dent*) ((uintptr_t) dents + dentsPosition);
+        dentsPosition += dent->d_reclen;
+    }
+}
+
+// Transfers data to another file description. When one side is a pipe or
+// socket and the other side is a seekable file, the data is copied directly
+// between the file and the buffer of the pipe or socket.
+ssize_t FileDescription::splice(const Reference<FileDescription>& out,
+        off_t* inOffset, off_t* outOffset, size_t size, int flags) {
+    if ((inOffset && !vnode->isSeekable()) ||
+            (outOffset && !out->vnode->isSeekable())) {
+        errno = ESPIPE;
+        return -1;
+    }
+    if (size == 0) return 0;
+
+    mode_t inMode = vnode->stat().st_mode;
+    mode_t outMode = out->vnode->stat().st_mode;
+
+    if ((S_ISFIFO(inMode) || S_ISSOCK(inMode)) && out->vnode->isSeekable()) {
+        if (outOffset) {
+            ssize_t result = vnode->spliceToFile(out->vnode, *outOffset,
+                    out->fileFlags, size, fileFlags | flags);
+            if (result > 0) *outOffset += result;
+            return result;
+        }
+
+        AutoLock lock(&out->mutex);
+        ssize_t result = vnode->spliceToFile(out->vnode, out->offset,
+                out->fileFlags, size, fileFlags | flags);
+        if (result > 0) {
+            out->offset = out->fileFlags & O_APPEND ?
+                    out->vnode->stat().st_size : out->offset + result;
+        }
+        return result;
+    }
+
+    if ((S_ISFIFO(outMode) || S_ISSOCK(outMode)) && vnode->isSeekable()) {
+        if (inOffset) {
+            ssize_t result = out->vnode->spliceFromFile(vnode, *inOffset,
+                    fileFlags, size, out->fileFlags | flags);
+            if (result > 0) *inOffset += result;
+            return result;
+        }
+
+        AutoLock lock(&mutex);
+        ssize_t result = out->vnode->spliceFromFile(vnode, offset, fileFlags,
+                size, out->fileFlags | flags);
+        if (result > 0) {
+            offset += result;
+        }
+        return result;
+    }
+
+    return copy(out, inOffset, outOffset, size, flags);
+}
+
 int FileDescription::tcgetattr(struct termios* result) {
     return vnode->tcgetattr(result);
 }
@@ -197,6 +376,23 @@ int FileDescription::tcsetattr(int flags, const struct termios* termio) {
     return vnode->tcsetattr(flags, termio);
 }
 
+// Copies data from a pipe to another pipe without consuming it.
+ssize_t FileDescription::tee(const Reference<FileDescription>& out,
+        size_t size, int flags) {
+    if (size == 0) return 0;
+    if (size > PIPE_BUF) size = PIPE_BUF;
+    char* buffer = (char*) malloc(size);
+    if (!buffer) return -1;
+
+    ssize_t result = vnode->peek(buffer, size, fileFlags | flags);
+    if (result > 0) {
+        // Writes of at most PIPE_BUF bytes to a pipe are atomic.
+        result = out->vnode->write(buffer, result, out->fileFlags | flags);
+    }
+    free(buffer);
+    return result;
+}
+
 ssize_t FileDescription::write(const void* buffer, size_t size) {
     if (vnode->isSeekable()) {
         AutoLock lock(&mutex);
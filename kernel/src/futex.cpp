@@ -0,0 +1,115 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/futex.cpp
+ * Futexes.
+ */
+
+#include <errno.h>
+#include <cobalt/kernel/futex.h>
+#include <cobalt/kernel/pollqueue.h>
+#include <cobalt/kernel/process.h>
+
+#define FUTEX_BUCKETS 64
+
+namespace {
+class FutexEntry : public PollWaiter::Entry {
+public:
+    AddressSpace* addressSpace;
+    const int* address;
+    FutexEntry* prev;
+    FutexEntry* next;
+    bool queued;
+};
+}
+
+// Waiting threads are kept in a hash table keyed by address. Like poll queues
+// the table is protected by disabling interrupts.
+static FutexEntry* buckets[FUTEX_BUCKETS];
+
+static size_t hashAddress(const int* address) {
+    return ((uintptr_t) address / sizeof(int)) % FUTEX_BUCKETS;
+}
+
+static void removeEntry(FutexEntry* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        buckets[hashAddress(entry->address)] = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    entry->queued = false;
+}
+
+int Futex::wait(const int* address, int value,
+        const struct timespec* endTime) {
+    PollWaiter waiter;
+    FutexEntry entry;
+    entry.waiter = &waiter;
+    entry.addressSpace = Process::current()->addressSpace;
+    entry.address = address;
+    entry.prev = nullptr;
+    entry.queued = true;
+
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    size_t hash = hashAddress(address);
+    entry.next = buckets[hash];
+    if (entry.next) {
+        entry.next->prev = &entry;
+    }
+    buckets[hash] = &entry;
+    if (interruptsEnabled) Interrupts::enable();
+
+    // The value is checked after the entry was added so that a wake up after
+    // the value has been changed cannot be missed.
+    int result;
+    if (__atomic_load_n(address, __ATOMIC_SEQ_CST) != value) {
+        result = EAGAIN;
+    } else {
+        result = waiter.wait(endTime);
+    }
+
+    interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    if (entry.queued) {
+        removeEntry(&entry);
+    }
+    if (interruptsEnabled) Interrupts::enable();
+    return result;
+}
+
+int Futex::wake(const int* address, int count) {
+    AddressSpace* addressSpace = Process::current()->addressSpace;
+    int woken = 0;
+
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    FutexEntry* entry = buckets[hashAddress(address)];
+    while (entry && woken < count) {
+        FutexEntry* next = entry->next;
+        if (entry->address == address &&
+                entry->addressSpace == addressSpace) {
+            removeEntry(entry);
+            entry->onEvent();
+            woken++;
+        }
+        entry = next;
+    }
+    if (interruptsEnabled) Interrupts::enable();
+    return woken;
+}
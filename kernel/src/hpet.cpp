@@ -36,14 +36,79 @@
 #define TIMER_CONFIG_SUPPORTS_PERIODIC (1 << 4)
 #define TIMER_CONFIG_SUPPORTS_64BIT (1 << 5)
 #define TIMER_CONFIG_SET_ACCUMULATOR (1 << 6)
+#define TIMER_CONFIG_32BIT (1 << 8)
 #define TIMER_CONFIG_FSB (1 << 14)
 #define TIMER_CONFIG_SUPPORTS_FSB (1 << 15)
 
-static unsigned long nanoseconds;
+// The minimum number of counter ticks between now and the next interrupt.
+#define MIN_TIMEOUT_TICKS 16
+
+namespace {
+class HpetTimer : public EventTimer {
+public:
+    HpetTimer(vaddr_t registers, uint32_t period);
+    uint64_t getTime() override;
+    void setTimeout(uint64_t nanoseconds) override;
+private:
+    volatile uint32_t* comparator;
+    volatile uint32_t* counter;
+    uint32_t lastCounter;
+    // The period of the counter in femtoseconds.
+    uint32_t period;
+    uint64_t remainder;
+    uint64_t time;
+};
+}
+
 static IrqHandler handler;
 
-static void irqHandler(void*, const InterruptContext* context) {
-    Clock::onTick(context->cs != 0x8, nanoseconds);
+static void irqHandler(void*, const InterruptContext*) {
+    // The timer is reprogrammed when scheduling.
+}
+
+HpetTimer::HpetTimer(vaddr_t registers, uint32_t period) {
+    comparator = (volatile uint32_t*) (registers + 0x108);
+    counter = (volatile uint32_t*) (registers + 0xF0);
+    lastCounter = *counter;
+    this->period = period;
+    remainder = 0;
+    time = 0;
+}
+
+uint64_t HpetTimer::getTime() {
+    // We only use the lower 32 bits of the counter so that it can be read
+    // atomically. Wraparound is handled as long as this is called at least
+    // once per wraparound period, which is a few minutes long.
+    uint32_t value = *counter;
+    uint64_t femtoseconds = (uint64_t) (uint32_t) (value - lastCounter) *
+            period + remainder;
+    lastCounter = value;
+    time += femtoseconds / 1000000;
+    remainder = femtoseconds % 1000000;
+    return time;
+}
+
+void HpetTimer::setTimeout(uint64_t nanoseconds) {
+    // Limit the timeout so that the calculation does not overflow.
+    if (nanoseconds > 1000000000) {
+        nanoseconds = 1000000000;
+    }
+
+    uint64_t ticks = nanoseconds * 1000000 / period;
+    if (ticks < MIN_TIMEOUT_TICKS) {
+        ticks = MIN_TIMEOUT_TICKS;
+    }
+
+    while (true) {
+        uint32_t target = *counter + ticks;
+        *comparator = target;
+
+        // The interrupt is only raised when the counter reaches the
+        // comparator value, so we need to make sure that the counter did not
+        // already pass it.
+        if ((int32_t) (target - *counter) > 0) break;
+        ticks *= 2;
+    }
 }
 
 void Hpet::initialize(paddr_t baseAddress) {
@@ -56,28 +121,21 @@ void Hpet::initialize(paddr_t baseAddress) {
 
     uint32_t capabilites = *(volatile uint32_t*) mapped;
     bool legacyReplacementSupported = capabilites & HPET_CAP_LEGACY_REPLACEMENT;
-    bool has64Bit = capabilites & HPET_CAP_64BIT;
 
     volatile uint32_t* timer0ConfigReg = (volatile uint32_t*) (mapped + 0x100);
     uint32_t timer0Config = *timer0ConfigReg;
     bool fsbSupported = timer0Config & TIMER_CONFIG_SUPPORTS_FSB;
 
     uint32_t period = *(volatile uint32_t*) (mapped + 0x4);
-    uint64_t count = 1000000000000ULL / period;
-    nanoseconds = count * period / 1000000;
-    has64Bit = has64Bit && (timer0Config & TIMER_CONFIG_SUPPORTS_64BIT);
-    bool periodic = timer0Config & TIMER_CONFIG_SUPPORTS_PERIODIC;
-
-    if (!periodic) {
-        Log::printf("HPET does not support periodic mode\n");
-        kernelSpace->unmapPhysical(mapping, mapSize);
-        return;
-    }
 
-    timer0Config |= TIMER_CONFIG_SET_ACCUMULATOR;
-    timer0Config |= TIMER_CONFIG_PERIODIC;
+    // The timer is used in one-shot mode and only raises an interrupt when
+    // needed.
+    timer0Config &= ~TIMER_CONFIG_PERIODIC;
     timer0Config |= TIMER_CONFIG_ENABLED;
     timer0Config &= ~TIMER_CONFIG_LEVEL_TRIGGERED;
+    if (timer0Config & TIMER_CONFIG_SUPPORTS_64BIT) {
+        timer0Config |= TIMER_CONFIG_32BIT;
+    }
 
     volatile uint32_t* generalConfigReg = (volatile uint32_t*) (mapped + 0x10);
     uint32_t generalConfig = *generalConfigReg;
@@ -124,14 +182,6 @@ void Hpet::initialize(paddr_t baseAddress) {
     Log::printf("HPET is using IRQ%d\n", irq);
     *timer0ConfigReg = timer0Config;
 
-    volatile uint32_t* timer0ComparatorLow =
-            (volatile uint32_t*) (mapped + 0x108);
-    volatile uint32_t* timer0ComparatorHigh =
-            (volatile uint32_t*) (mapped + 0x10C);
-    *timer0ComparatorLow = count & 0xFFFFFFFF;
-    *timer0ConfigReg = timer0Config;
-    *timer0ComparatorHigh = count >> 32;
-
     volatile uint32_t* mainCounterLow = (volatile uint32_t*) (mapped + 0xF0);
     volatile uint32_t* mainCounterHigh = (volatile uint32_t*) (mapped + 0xF4);
     *mainCounterLow = 0;
@@ -141,8 +191,10 @@ void Hpet::initialize(paddr_t baseAddress) {
     Interrupts::addIrqHandler(irq, &handler);
     Interrupts::timerIrq = irq;
 
+    HpetTimer* timer = xnew HpetTimer(mapped, period);
+    Clock::setEventTimer(timer);
+
     generalConfig |= HPET_CONFIG_ENABLED;
     *generalConfigReg = generalConfig;
-
-    kernelSpace->unmapPhysical(mapping, mapSize);
+    timer->setTimeout(1000000);
 }
@@ -24,6 +24,7 @@
 #include <cobalt/kernel/file.h>
 #include <cobalt/kernel/initrd.h>
 #include <cobalt/kernel/panic.h>
+#include <cobalt/kernel/physicalmemory.h>
 #include <cobalt/kernel/symlink.h>
 
 struct TarHeader {
@@ -46,9 +47,19 @@ struct TarHeader {
     char padding[12];
 };
 
-Reference<DirectoryVnode> Initrd::loadInitrd(vaddr_t initrd) {
+static void freeFrames(paddr_t start, paddr_t end) {
+    for (paddr_t address = start; address < end; address += PAGESIZE) {
+        PhysicalMemory::pushPageFrame(address);
+    }
+}
+
+Reference<DirectoryVnode> Initrd::loadInitrd(vaddr_t initrd, paddr_t start,
+        paddr_t end) {
     Reference<DirectoryVnode> root = xnew DirectoryVnode(nullptr, 0755, 0);
     TarHeader* header = (TarHeader*) initrd;
+    // Frames below this address are no longer needed. The frames do not need
+    // to stay intact because we never read behind the current header.
+    paddr_t firstUnusedFrame = ALIGNUP(start, PAGESIZE);
 
     while (strcmp(header->magic, TMAGIC) == 0) {
         char* path;
@@ -84,8 +95,18 @@ Reference<DirectoryVnode> Initrd::loadInitrd(vaddr_t initrd) {
         mtime.tv_nsec = 0;
 
         if (header->typeflag == REGTYPE || header->typeflag == AREGTYPE) {
-            newFile = xnew FileVnode(header + 1, size, mode,
-                    directory->stats.st_dev);
+            paddr_t data = start + ((vaddr_t) (header + 1) - initrd);
+            if (data % PAGESIZE == 0 && size >= PAGESIZE) {
+                // Files whose contents happen to be page aligned can use the
+                // frames of the initrd directly.
+                newFile = xnew FileVnode(header + 1, data, size, mode,
+                        directory->stats.st_dev);
+                freeFrames(firstUnusedFrame, data);
+                firstUnusedFrame = data + size / PAGESIZE * PAGESIZE;
+            } else {
+                newFile = xnew FileVnode(header + 1, size, mode,
+                        directory->stats.st_dev);
+            }
             header += 1 + ALIGNUP(size, 512) / 512;
         } else if (header->typeflag == DIRTYPE) {
             newFile = xnew DirectoryVnode(directory, mode,
@@ -117,5 +138,6 @@ Reference<DirectoryVnode> Initrd::loadInitrd(vaddr_t initrd) {
         free(path2);
     }
 
+    freeFrames(firstUnusedFrame, end & ~PAGE_MISALIGN);
     return root;
 }
@@ -152,15 +152,10 @@ static Reference<DirectoryVnode> loadInitrd(const multiboot_info* multiboot) {
             vaddr_t initrd = kernelSpace->mapPhysical(moduleTag->mod_start,
                     size, PROT_READ);
             if (!initrd) PANIC("Failed to map initrd");
-            Reference<DirectoryVnode> root = Initrd::loadInitrd(initrd);
+            Reference<DirectoryVnode> root = Initrd::loadInitrd(initrd,
+                    moduleTag->mod_start, moduleTag->mod_end);
             kernelSpace->unmapPhysical(initrd, size);
 
-            paddr_t address = moduleTag->mod_start;
-            while (address < (moduleTag->mod_end & ~PAGE_MISALIGN)) {
-                PhysicalMemory::pushPageFrame(address);
-                address += PAGESIZE;
-            }
-
             if (root->childCount) return root;
         }
 
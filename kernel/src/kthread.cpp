@@ -21,43 +21,80 @@
 #include <sched.h>
 #include <cobalt/kernel/kthread.h>
 #include <cobalt/kernel/signal.h>
+#include <cobalt/kernel/thread.h>
+
+// Waiters live on the stack of the waiting thread. They are always removed
+// from the list before the waiting function returns, but GCC cannot see this
+// when the removal is done by the waking thread.
+#pragma GCC diagnostic push
+#if __GNUC__ >= 12
+#  pragma GCC diagnostic ignored "-Wdangling-pointer"
+#endif
+static void addWaiter(kthread_waiter** first, kthread_waiter** last,
+        kthread_waiter* waiter) {
+    waiter->prev = *last;
+    waiter->next = nullptr;
+    waiter->thread = Thread::current();
+    waiter->blocked = true;
+    if (*last) {
+        (*last)->next = waiter;
+    } else {
+        *first = waiter;
+    }
+    *last = waiter;
+}
+#pragma GCC diagnostic pop
+
+static void removeWaiter(kthread_waiter** first, kthread_waiter** last,
+        kthread_waiter* waiter) {
+    if (waiter->prev) {
+        waiter->prev->next = waiter->next;
+    } else {
+        *first = waiter->next;
+    }
+    if (waiter->next) {
+        waiter->next->prev = waiter->prev;
+    } else {
+        *last = waiter->prev;
+    }
+}
+
+static void wakeFirstWaiter(kthread_waiter** first, kthread_waiter** last) {
+    kthread_waiter* waiter = *first;
+    removeWaiter(first, last, waiter);
+    waiter->blocked = false;
+    waiter->thread->wakeUp();
+}
 
 int kthread_cond_broadcast(kthread_cond_t* cond) {
-    kthread_mutex_lock(&cond->mutex);
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
     while (cond->first) {
-        kthread_cond_waiter* waiter = cond->first;
-        cond->first = waiter->next;
-        __atomic_store_n(&waiter->blocked, false, __ATOMIC_RELEASE);
+        wakeFirstWaiter(&cond->first, &cond->last);
     }
-    cond->last = nullptr;
-
-    kthread_mutex_unlock(&cond->mutex);
+    if (interruptsEnabled) Interrupts::enable();
     return 0;
 }
 
 int kthread_cond_sigclockwait(kthread_cond_t* cond, kthread_mutex_t* mutex,
         clockid_t clock, const struct timespec* endTime) {
-    kthread_mutex_lock(&cond->mutex);
+    Clock* clockPtr = Clock::get(clock);
+
+    // Unlocking the mutex and adding the waiter needs to happen atomically so
+    // that no wakeup can be missed.
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
     kthread_mutex_unlock(mutex);
 
-    kthread_cond_waiter waiter;
-    waiter.prev = cond->last;
-    waiter.next = nullptr;
-    waiter.blocked = true;
-    if (cond->last) {
-        cond->last->next = &waiter;
-    } else {
-        cond->first = &waiter;
-    }
-    cond->last = &waiter;
-    kthread_mutex_unlock(&cond->mutex);
+    kthread_waiter waiter;
+    addWaiter(&cond->first, &cond->last, &waiter);
 
     int result = 0;
 
-    while (__atomic_load_n(&waiter.blocked, __ATOMIC_ACQUIRE)) {
+    while (waiter.blocked) {
         if (endTime) {
             struct timespec now;
-            Clock::get(clock)->getTime(&now);
+            clockPtr->getTime(&now);
             if (!timespecLess(now, *endTime)) {
                 result = ETIMEDOUT;
                 break;
@@ -68,46 +105,27 @@ int kthread_cond_sigclockwait(kthread_cond_t* cond, kthread_mutex_t* mutex,
             result = EINTR;
             break;
         }
-        sched_yield();
+        Thread::block(true, clockPtr, endTime);
     }
 
-    if (result) {
-        kthread_mutex_lock(&cond->mutex);
-
-        // Only remove the waiter from the list if we were not unblocked
-        // concurrently. In that case the waiter was already removed.
-        if (__atomic_load_n(&waiter.blocked, __ATOMIC_RELAXED)) {
-            if (waiter.prev) {
-                waiter.prev->next = waiter.next;
-            } else {
-                cond->first = waiter.next;
-            }
-            if (waiter.next) {
-                waiter.next->prev = waiter.prev;
-            } else {
-                cond->last = waiter.prev;
-            }
-        }
-        kthread_mutex_unlock(&cond->mutex);
+    // If we were not woken up by a signal of the condition variable we still
+    // need to remove ourself from the list.
+    if (waiter.blocked) {
+        removeWaiter(&cond->first, &cond->last, &waiter);
     }
+    if (interruptsEnabled) Interrupts::enable();
 
     kthread_mutex_lock(mutex);
     return result;
 }
 
 int kthread_cond_signal(kthread_cond_t* cond) {
-    kthread_mutex_lock(&cond->mutex);
-    if (cond->first) {
-        kthread_cond_waiter* waiter = cond->first;
-        cond->first = waiter->next;
-        __atomic_store_n(&waiter->blocked, false, __ATOMIC_RELEASE);
-    }
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
     if (cond->first) {
-        cond->first->prev = nullptr;
-    } else {
-        cond->last = nullptr;
+        wakeFirstWaiter(&cond->first, &cond->last);
     }
-    kthread_mutex_unlock(&cond->mutex);
+    if (interruptsEnabled) Interrupts::enable();
     return 0;
 }
 
@@ -116,20 +134,50 @@ int kthread_cond_sigwait(kthread_cond_t* cond, kthread_mutex_t* mutex) {
 }
 
 int kthread_mutex_lock(kthread_mutex_t* mutex) {
-    while (__atomic_test_and_set(mutex, __ATOMIC_ACQUIRE)) {
-        sched_yield();
+    if (!__atomic_test_and_set(&mutex->locked, __ATOMIC_ACQUIRE)) return 0;
+
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    if (!__atomic_test_and_set(&mutex->locked, __ATOMIC_ACQUIRE)) {
+        if (interruptsEnabled) Interrupts::enable();
+        return 0;
     }
+
+    if (Thread::current() == Thread::idleThread) {
+        // The idle thread cannot block, so it needs to wait until the mutex
+        // is not handed over to another thread.
+        while (__atomic_test_and_set(&mutex->locked, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    } else {
+        // The thread that unlocks the mutex hands it over to us, so the mutex
+        // is already locked for us once we are woken up.
+        kthread_waiter waiter;
+        addWaiter(&mutex->first, &mutex->last, &waiter);
+        while (waiter.blocked) {
+            Thread::block(false, nullptr, nullptr);
+        }
+    }
+
+    if (interruptsEnabled) Interrupts::enable();
     return 0;
 }
 
 int kthread_mutex_trylock(kthread_mutex_t* mutex) {
-    if (__atomic_test_and_set(mutex, __ATOMIC_ACQUIRE)) {
+    if (__atomic_test_and_set(&mutex->locked, __ATOMIC_ACQUIRE)) {
         return EBUSY;
     }
     return 0;
 }
 
 int kthread_mutex_unlock(kthread_mutex_t* mutex) {
-    __atomic_clear(mutex, __ATOMIC_RELEASE);
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    if (mutex->first) {
+        wakeFirstWaiter(&mutex->first, &mutex->last);
+    } else {
+        __atomic_clear(&mutex->locked, __ATOMIC_RELEASE);
+    }
+    if (interruptsEnabled) Interrupts::enable();
     return 0;
 }
@@ -18,7 +18,6 @@
  */
 
 #include <assert.h>
-#include <string.h>
 #include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/kthread.h>
 #include <cobalt/kernel/memorysegment.h>
@@ -27,6 +26,19 @@
 static char segmentsPage[PAGESIZE] ALIGNED(PAGESIZE) = {0};
 static kthread_mutex_t mutex = KTHREAD_MUTEX_INITIALIZER;
 
+// Unused segments are linked through their next pointer.
+static MemorySegment* freeSegments;
+static size_t freeSegmentCount;
+
+static void addSegmentsPage(vaddr_t page) {
+    MemorySegment* segments = (MemorySegment*) page;
+    for (size_t i = 0; i < PAGESIZE / sizeof(MemorySegment); i++) {
+        segments[i].next = freeSegments;
+        freeSegments = &segments[i];
+    }
+    freeSegmentCount += PAGESIZE / sizeof(MemorySegment);
+}
+
 static inline size_t getFreeSpaceAfter(MemorySegment* segment) {
     vaddr_t nextAddress = segment->next ? segment->next->address : 0;
     return nextAddress - (segment->address + segment->size);
@@ -79,27 +91,27 @@ MemorySegment* MemorySegment::allocateSegment(vaddr_t address, size_t size,
         int flags) {
     assert(PAGE_ALIGNED(address));
     assert(PAGE_ALIGNED(size));
-    MemorySegment* current = (MemorySegment*) segmentsPage;
-
-    while (current->address != 0 && current->size != 0) {
-        current++;
-        if (((uintptr_t) current & PAGE_MISALIGN) ==
-                (PAGESIZE - PAGESIZE % sizeof(MemorySegment))) {
-            MemorySegment** nextPage = (MemorySegment**) current;
-            assert(*nextPage != nullptr);
-            current = *nextPage;
-        }
-    }
+    assert(freeSegments);
 
-    current->address = address;
-    current->size = size;
-    current->flags = flags;
+    MemorySegment* segment = freeSegments;
+    freeSegments = segment->next;
+    freeSegmentCount--;
 
-    return current;
+    segment->address = address;
+    segment->size = size;
+    segment->flags = flags;
+    return segment;
 }
 
 void MemorySegment::deallocateSegment(MemorySegment* segment) {
-    memset(segment, 0, sizeof(MemorySegment));
+    AutoLock lock(&mutex);
+    freeSegment(segment);
+}
+
+void MemorySegment::freeSegment(MemorySegment* segment) {
+    segment->next = freeSegments;
+    freeSegments = segment;
+    freeSegmentCount++;
 }
 
 void MemorySegment::removeSegment(MemorySegment* firstSegment, vaddr_t address,
@@ -137,7 +149,7 @@ void MemorySegment::removeSegment(MemorySegment* firstSegment, vaddr_t address,
                 currentSegment->prev->next = next;
             }
 
-            deallocateSegment(currentSegment);
+            freeSegment(currentSegment);
             currentSegment = next;
             continue;
         } else if (currentSegment->address == address &&
@@ -211,52 +223,34 @@ vaddr_t MemorySegment::findAndAddNewSegment(MemorySegment* firstSegment,
 }
 
 bool MemorySegment::verifySegmentList() {
-    MemorySegment* current = (MemorySegment*) segmentsPage;
-    MemorySegment** nextPage;
-
-    int freeSegmentSpaceFound = 0;
-    MemorySegment* freeSegment = nullptr;
-
-    while (true) {
-        if (current->address == 0 && current->size == 0) {
-            freeSegment = current;
-            freeSegmentSpaceFound++;
-        }
-
-        current++;
-        if (((uintptr_t) current & PAGE_MISALIGN) ==
-                (PAGESIZE - PAGESIZE % sizeof(MemorySegment))) {
-            nextPage = (MemorySegment**) current;
-            if (!*nextPage) break;
-            current = *nextPage;
-        }
+    if (freeSegmentCount == 0) {
+        // This is the first call. Later calls never use up the last segment.
+        addSegmentsPage((vaddr_t) segmentsPage);
     }
 
-    assert(freeSegmentSpaceFound > 0);
-
-    if (freeSegmentSpaceFound == 1) {
-        current = findFreeSegment(kernelSpace->firstSegment, PAGESIZE);
-        if (!current) return false;
-        vaddr_t address = current->address + current->size;
-        paddr_t physical = PhysicalMemory::popPageFrame();
-        if (!physical) return false;
-        if (!kernelSpace->mapAt(address, physical, PROT_READ | PROT_WRITE)) {
-            PhysicalMemory::pushPageFrame(physical);
-            return false;
-        }
-        *nextPage = (MemorySegment*) address;
-
-        memset(*nextPage, 0, PAGESIZE);
+    // One segment is always kept free so that the page for new segments can
+    // be added to the kernel address space.
+    if (freeSegmentCount > 1) return true;
+
+    MemorySegment* current = findFreeSegment(kernelSpace->firstSegment,
+            PAGESIZE);
+    if (!current) return false;
+    vaddr_t address = current->address + current->size;
+    paddr_t physical = PhysicalMemory::popPageFrame();
+    if (!physical) return false;
+    if (!kernelSpace->mapAt(address, physical, PROT_READ | PROT_WRITE)) {
+        PhysicalMemory::pushPageFrame(physical);
+        return false;
+    }
 
-        if (current->flags == (PROT_READ | PROT_WRITE)) {
-            current->size += PAGESIZE;
-        } else {
-            freeSegment->address = address;
-            freeSegment->size = PAGESIZE;
-            freeSegment->flags = PROT_READ | PROT_WRITE;
-            addSegment(kernelSpace->firstSegment, freeSegment);
-        }
+    if (current->flags == (PROT_READ | PROT_WRITE)) {
+        current->size += PAGESIZE;
+    } else {
+        MemorySegment* segment = allocateSegment(address, PAGESIZE,
+                PROT_READ | PROT_WRITE);
+        addSegment(kernelSpace->firstSegment, segment);
     }
 
+    addSegmentsPage(address);
     return true;
 }
@@ -50,6 +50,7 @@ void MouseDevice::addPacket(mouse_data data) {
     mouseBuffer[writeIndex] = data;
     available++;
     kthread_cond_broadcast(&readCond);
+    pollQueue.notify();
 }
 
 int MouseDevice::devctl(int command, void* restrict data, size_t size,
@@ -80,6 +81,10 @@ int MouseDevice::devctl(int command, void* restrict data, size_t size,
     }
 }
 
+PollQueue* MouseDevice::getPollQueue() {
+    return &pollQueue;
+}
+
 short MouseDevice::poll() {
     AutoLock lock(&mutex);
     if (available) return POLLIN | POLLRDNORM;
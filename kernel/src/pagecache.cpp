@@ -0,0 +1,206 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/pagecache.cpp
+ * Page cache.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/pagecache.h>
+#include <cobalt/kernel/physicalmemory.h>
+
+// The lower bits of the cached physical addresses are used as flags.
+#define PAGE_DIRTY (1 << 0)
+#define PAGE_MAPPED_WRITABLE (1 << 1)
+
+PageCache::PageCache() {
+    pageCount = 0;
+    pages = nullptr;
+}
+
+PageCache::~PageCache() {
+    truncate(0);
+}
+
+bool PageCache::adoptPage(size_t index, paddr_t physicalAddress) {
+    assert(!(physicalAddress & PAGE_MISALIGN));
+    if (!grow(index)) return false;
+    if (pages[index]) {
+        PhysicalMemory::pushPageFrame(pages[index] & ~PAGE_MISALIGN);
+    }
+    pages[index] = physicalAddress;
+    return true;
+}
+
+void PageCache::dropPage(size_t index) {
+    if (index >= pageCount || !pages[index]) return;
+
+    // Address spaces that have the page mapped keep their own reference.
+    PhysicalMemory::pushPageFrame(pages[index] & ~PAGE_MISALIGN);
+    pages[index] = 0;
+}
+
+paddr_t PageCache::getPage(size_t index) {
+    if (index >= pageCount) return 0;
+    return pages[index] & ~PAGE_MISALIGN;
+}
+
+vaddr_t PageCache::mapPage(size_t index) {
+    paddr_t physicalAddress = getPage(index);
+    if (physicalAddress) {
+        vaddr_t address = kernelSpace->mapFrame(physicalAddress);
+        if (!address) errno = ENOMEM;
+        return address;
+    }
+
+    if (!grow(index)) return 0;
+
+    physicalAddress = PhysicalMemory::popPageFrame();
+    if (!physicalAddress) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    vaddr_t address = kernelSpace->mapFrame(physicalAddress);
+    if (!address) {
+        PhysicalMemory::pushPageFrame(physicalAddress);
+        errno = ENOMEM;
+        return 0;
+    }
+
+    memset((void*) address, 0, PAGESIZE);
+    pages[index] = physicalAddress;
+    return address;
+}
+
+bool PageCache::grow(size_t index) {
+    if (index < pageCount) return true;
+
+    size_t newCount = pageCount * 2;
+    if (newCount <= index) newCount = index + 1;
+    paddr_t* newPages = (paddr_t*) reallocarray(pages, newCount,
+            sizeof(paddr_t));
+    if (!newPages) {
+        errno = ENOMEM;
+        return false;
+    }
+    memset(newPages + pageCount, 0, (newCount - pageCount) * sizeof(paddr_t));
+    pages = newPages;
+    pageCount = newCount;
+    return true;
+}
+
+bool PageCache::needsWriteback(size_t index) {
+    if (index >= pageCount || !pages[index]) return false;
+
+    if (pages[index] & PAGE_MAPPED_WRITABLE) {
+        // Writes through a shared mapping are not tracked, so the page needs
+        // to be written back as long as it is mapped. After the last mapping
+        // is gone it needs to be written back one last time.
+        paddr_t physicalAddress = pages[index] & ~PAGE_MISALIGN;
+        if (PhysicalMemory::isFrameShared(physicalAddress)) return true;
+        pages[index] = physicalAddress | PAGE_DIRTY;
+    }
+
+    return pages[index] & PAGE_DIRTY;
+}
+
+bool PageCache::read(size_t index, size_t offset, void* buffer, size_t size) {
+    assert(offset + size <= PAGESIZE);
+
+    if (!getPage(index)) {
+        // Pages that are not cached are holes in the file.
+        memset(buffer, 0, size);
+        return true;
+    }
+
+    vaddr_t address = mapPage(index);
+    if (!address) return false;
+    memcpy(buffer, (const char*) address + offset, size);
+    unmapPage(address);
+    return true;
+}
+
+paddr_t PageCache::referencePage(size_t index, bool writable) {
+    paddr_t physicalAddress = getPage(index);
+    assert(physicalAddress);
+
+    if (!PhysicalMemory::addFrameReference(physicalAddress, false)) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    if (writable) setMappedWritable(index);
+    return physicalAddress;
+}
+
+void PageCache::setClean(size_t index) {
+    if (index >= pageCount) return;
+    pages[index] &= ~PAGE_DIRTY;
+}
+
+void PageCache::setMappedWritable(size_t index) {
+    if (index >= pageCount) return;
+    pages[index] |= PAGE_MAPPED_WRITABLE;
+}
+
+void PageCache::truncate(off_t size) {
+    if ((uintmax_t) size / PAGESIZE >= pageCount) return;
+
+    size_t index = size / PAGESIZE;
+    size_t misalign = size % PAGESIZE;
+    if (misalign) {
+        // Clear the part of the last page that is now beyond the end of the
+        // file so that it reads as zeros if the file is extended again.
+        if (pages[index]) {
+            vaddr_t address = mapPage(index);
+            if (address) {
+                memset((char*) address + misalign, 0, PAGESIZE - misalign);
+                unmapPage(address);
+            }
+        }
+        index++;
+    }
+
+    for (size_t i = index; i < pageCount; i++) {
+        dropPage(i);
+    }
+    pageCount = index;
+
+    if (pageCount == 0) {
+        free(pages);
+        pages = nullptr;
+    }
+}
+
+void PageCache::unmapPage(vaddr_t address) {
+    kernelSpace->unmapFrame(address);
+}
+
+bool PageCache::write(size_t index, size_t offset, const void* buffer,
+        size_t size, bool allocate) {
+    assert(offset + size <= PAGESIZE);
+    if (!allocate && !getPage(index)) return true;
+
+    vaddr_t address = mapPage(index);
+    if (!address) return false;
+    memcpy((char*) address + offset, buffer, size);
+    unmapPage(address);
+    return true;
+}
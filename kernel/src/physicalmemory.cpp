@@ -18,43 +18,80 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <cobalt/meminfo.h>
 #include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/arch.h>
 #include <cobalt/kernel/cache.h>
 #include <cobalt/kernel/kthread.h>
 #include <cobalt/kernel/panic.h>
 #include <cobalt/kernel/physicalmemory.h>
+#include <cobalt/kernel/slab.h>
 #include <cobalt/kernel/syscall.h>
 
-class MemoryStack {
-public:
-    MemoryStack(void* firstStackPage);
-    void pushPageFrame(paddr_t physicalAddress, bool cache = false);
-    paddr_t popPageFrame(bool cache = false);
-public:
-    size_t framesOnStack;
-private:
-    paddr_t* stack;
-    vaddr_t lastStackPage;
+// Free frames are tracked in bitmaps. Each bitmap is a single page that covers
+// a section of physical memory. The first free frame of a section is used to
+// hold its bitmap.
+#define BITS_PER_WORD (sizeof(uintptr_t) * CHAR_BIT)
+#define FRAMES_PER_SECTION (PAGESIZE * CHAR_BIT)
+#define WORDS_PER_SECTION (PAGESIZE / sizeof(uintptr_t))
+#define NOT_FOUND ((size_t) -1)
+
+#ifdef __x86_64__
+// Physical memory above 512 GiB is not used.
+#  define MAX_SECTIONS 4096
+#else
+#  define MAX_SECTIONS (0x100000000 / PAGESIZE / FRAMES_PER_SECTION)
+#endif
+#define SECTIONS_32 (0x100000000 / PAGESIZE / FRAMES_PER_SECTION)
+
+struct Section {
+    uintptr_t* bitmap;
+    uint16_t freeFrames;
+    // No word before this one has any free frames.
+    uint16_t firstFreeWord;
+};
+
+struct Zone {
+    size_t firstSection;
+    size_t endSection;
+    size_t freeFrames;
+    // No section before this one has any free frames.
+    size_t firstFreeSection;
 };
 
 static CacheController* firstCache;
-static char firstStackPage[PAGESIZE] ALIGNED(PAGESIZE);
 static size_t framesAvailable;
+static size_t framesFree;
 static size_t framesReserved;
-static MemoryStack memstack(firstStackPage);
+// For each frame the number of additional references from copy-on-write
+// mappings. Every additional reference is backed by a reserved frame so that
+// resolving a copy-on-write fault can never fail.
+static uint16_t* frameReferences;
+static size_t frameReferencesSize;
+// Additional references from read-only and shared file mappings. These cannot
+// be written through, so they do not need a reserved frame.
+static uint16_t* unreservedReferences;
+static Section sections[MAX_SECTIONS];
 static size_t totalFrames;
 
-static kthread_mutex_t mutex = KTHREAD_MUTEX_INITIALIZER;
-
+// Memory below 4 GiB is kept in a zone of its own so that it stays available
+// for devices that can only address 32 bits.
 #ifdef __x86_64__
-static char firstStackPage32[PAGESIZE] ALIGNED(PAGESIZE);
-static MemoryStack memstack32(firstStackPage32);
-
-#define totalFramesOnStack (memstack.framesOnStack + memstack32.framesOnStack)
+#  define NUM_ZONES 2
+static Zone zones[NUM_ZONES] = {
+    { 0, SECTIONS_32, 0, 0 },
+    { SECTIONS_32, MAX_SECTIONS, 0, SECTIONS_32 },
+};
 #else
-#define totalFramesOnStack (memstack.framesOnStack)
+#  define NUM_ZONES 1
+static Zone zones[NUM_ZONES] = {
+    { 0, MAX_SECTIONS, 0, 0 },
+};
 #endif
+#define ZONE_32 0
+
+static kthread_mutex_t mutex = KTHREAD_MUTEX_INITIALIZER;
 
 extern "C" {
 extern symbol_t bootstrapBegin;
@@ -68,6 +105,8 @@ static inline bool isUsedByKernel(paddr_t physicalAddress) {
             physicalAddress < (paddr_t) &bootstrapEnd) ||
             (physicalAddress >= (paddr_t) &kernelPhysicalBegin &&
             physicalAddress < (paddr_t) &kernelPhysicalEnd) ||
+            (physicalAddress >= SMP_TRAMPOLINE && physicalAddress <
+            SMP_TRAMPOLINE + SMP_TRAMPOLINE_PAGES * PAGESIZE) ||
             physicalAddress == 0;
 }
 
@@ -126,13 +165,28 @@ void PhysicalMemory::initialize(const multiboot_info* multiboot) {
     paddr_t multibootEnd = multibootPhys + ALIGNUP(multiboot->total_size +
             ((vaddr_t) multiboot & PAGE_MISALIGN), PAGESIZE);
 
+    paddr_t highestAddress = 0;
+
     while (mmap < mmapEnd) {
         multiboot_mmap_entry* mmapEntry = (multiboot_mmap_entry*) mmap;
 
         if (mmapEntry->type == MULTIBOOT_MEMORY_AVAILABLE &&
                 mmapEntry->addr + mmapEntry->len <= UINTPTR_MAX) {
             paddr_t addr = (paddr_t) mmapEntry->addr;
+            if (addr + mmapEntry->len > highestAddress) {
+                highestAddress = addr + mmapEntry->len;
+            }
+#ifdef __x86_64__
+            if (highestAddress / PAGESIZE > MAX_SECTIONS * FRAMES_PER_SECTION) {
+                highestAddress = (paddr_t) MAX_SECTIONS * FRAMES_PER_SECTION *
+                        PAGESIZE;
+            }
+#endif
             for (uint64_t i = 0; i < mmapEntry->len; i += PAGESIZE) {
+                if ((addr + i) / PAGESIZE / FRAMES_PER_SECTION >=
+                        MAX_SECTIONS) {
+                    break;
+                }
                 totalFrames++;
                 if (isUsedByModule(addr + i, multiboot) ||
                         isUsedByKernel(addr + i) ||
@@ -147,91 +201,214 @@ void PhysicalMemory::initialize(const multiboot_info* multiboot) {
 
         mmap += mmapTag->entry_size;
     }
-}
 
-MemoryStack::MemoryStack(void* firstStackPage) {
-    stack = (paddr_t*) firstStackPage + 1;
-    framesOnStack = 0;
-    lastStackPage = (vaddr_t) firstStackPage;
-}
+    size_t size = ALIGNUP(highestAddress / PAGESIZE * sizeof(uint16_t),
+            PAGESIZE);
+    frameReferences = (uint16_t*) kernelSpace->mapMemory(size,
+            PROT_READ | PROT_WRITE);
+    unreservedReferences = (uint16_t*) kernelSpace->mapMemory(size,
+            PROT_READ | PROT_WRITE);
+    if (!frameReferences || !unreservedReferences) {
+        PANIC("Failed to allocate frame reference counts");
+    }
+    memset(frameReferences, 0, size);
+    memset(unreservedReferences, 0, size);
+    frameReferencesSize = size / sizeof(uint16_t);
 
-void MemoryStack::pushPageFrame(paddr_t physicalAddress,
-        bool cache /*= false*/) {
-    if (((vaddr_t) (stack + 1) & PAGE_MISALIGN) == 0) {
-        paddr_t* stackPage = (paddr_t*) ((vaddr_t) stack & ~PAGE_MISALIGN);
+#ifdef __x86_64__
+    // Now that frames can be allocated for the page tables, map all memory
+    // into the direct map.
+    for (mmap = (vaddr_t) mmapTag->entries; mmap < mmapEnd;
+            mmap += mmapTag->entry_size) {
+        multiboot_mmap_entry* mmapEntry = (multiboot_mmap_entry*) mmap;
+        if (mmapEntry->type == MULTIBOOT_MEMORY_AVAILABLE) {
+            AddressSpace::addToDirectMap(mmapEntry->addr, mmapEntry->len);
+        }
+    }
+#endif
+}
 
-        if (*(stackPage + 1) == 0) {
-            // We need to unlock the mutex because AddressSpace::mapPhysical
-            // might need to pop page frames from the stack.
-            kthread_mutex_unlock(&mutex);
-            vaddr_t nextStackPage = kernelSpace->mapPhysical(physicalAddress,
-                    PAGESIZE, PROT_READ | PROT_WRITE);
-            kthread_mutex_lock(&mutex);
+static inline Zone* getZone(size_t sectionIndex) {
+#ifdef __x86_64__
+    if (sectionIndex >= SECTIONS_32) return &zones[1];
+#endif
+    (void) sectionIndex;
+    return &zones[ZONE_32];
+}
 
+static void pushFrame(paddr_t physicalAddress, bool cache) {
+    size_t frame = physicalAddress / PAGESIZE;
+    size_t sectionIndex = frame / FRAMES_PER_SECTION;
+    assert(sectionIndex < MAX_SECTIONS);
+    Section* section = &sections[sectionIndex];
+
+    if (unlikely(!section->bitmap)) {
+        // We need to unlock the mutex because AddressSpace::mapPhysical
+        // might need to allocate page frames.
+        kthread_mutex_unlock(&mutex);
+        vaddr_t bitmap = kernelSpace->mapPhysical(physicalAddress, PAGESIZE,
+                PROT_READ | PROT_WRITE);
+        kthread_mutex_lock(&mutex);
+
+        if (unlikely(!bitmap)) {
+            // If we cannot create the bitmap, we have to leak the frame.
             if (cache) framesAvailable--;
+            return;
+        }
 
-            if (unlikely(nextStackPage == 0)) {
-                // If we cannot save the address, we have to leak it.
-                return;
-            }
-
-            *((paddr_t*) lastStackPage + 1) = nextStackPage;
-            *(vaddr_t*) nextStackPage = lastStackPage;
-            *((paddr_t*) nextStackPage + 1) = 0;
-            lastStackPage = nextStackPage;
+        if (!section->bitmap) {
+            if (cache) framesAvailable--;
+            memset((void*) bitmap, 0, PAGESIZE);
+            section->bitmap = (uintptr_t*) bitmap;
+            section->firstFreeWord = WORDS_PER_SECTION;
             return;
-        } else {
-            stack = (paddr_t*) *(stackPage + 1) + 1;
         }
+
+        // Another thread has created the bitmap in the meantime.
+        kthread_mutex_unlock(&mutex);
+        kernelSpace->unmapPhysical(bitmap, PAGESIZE);
+        kthread_mutex_lock(&mutex);
+    }
+
+    size_t bit = frame % FRAMES_PER_SECTION;
+    size_t word = bit / BITS_PER_WORD;
+    uintptr_t mask = (uintptr_t) 1 << (bit % BITS_PER_WORD);
+    assert(!(section->bitmap[word] & mask));
+    section->bitmap[word] |= mask;
+    section->freeFrames++;
+    if (word < section->firstFreeWord) {
+        section->firstFreeWord = word;
     }
 
-    *++stack = physicalAddress;
-    framesOnStack++;
+    Zone* zone = getZone(sectionIndex);
+    zone->freeFrames++;
+    if (sectionIndex < zone->firstFreeSection) {
+        zone->firstFreeSection = sectionIndex;
+    }
+
+    framesFree++;
     if (!cache) {
         framesAvailable++;
     }
 }
 
+// Returns the index of the first frame of a free block of the given number of
+// frames. Blocks are aligned to their size.
+static size_t findFreeBlock(Section* section, size_t frames) {
+    const uintptr_t* bitmap = section->bitmap;
+
+    if (frames >= BITS_PER_WORD) {
+        size_t words = frames / BITS_PER_WORD;
+        size_t start = section->firstFreeWord / words * words;
+        for (size_t i = start; i < WORDS_PER_SECTION; i += words) {
+            size_t j = 0;
+            while (j < words && bitmap[i + j] == UINTPTR_MAX) {
+                j++;
+            }
+            if (j == words) return i * BITS_PER_WORD;
+        }
+        return NOT_FOUND;
+    }
+
+    uintptr_t mask = ((uintptr_t) 1 << frames) - 1;
+    for (size_t i = section->firstFreeWord; i < WORDS_PER_SECTION; i++) {
+        uintptr_t word = bitmap[i];
+        if (!word) continue;
+        if (frames == 1) {
+            return i * BITS_PER_WORD + __builtin_ctzl(word);
+        }
+
+        for (size_t bit = 0; bit < BITS_PER_WORD; bit += frames) {
+            if (((word >> bit) & mask) == mask) {
+                return i * BITS_PER_WORD + bit;
+            }
+        }
+    }
+    return NOT_FOUND;
+}
+
+static paddr_t allocateFromZone(Zone* zone, size_t order, size_t endSection,
+        bool cache) {
+    size_t frames = (size_t) 1 << order;
+    if (zone->freeFrames < frames) return 0;
+    if (endSection > zone->endSection) {
+        endSection = zone->endSection;
+    }
+
+    for (size_t i = zone->firstFreeSection; i < endSection; i++) {
+        Section* section = &sections[i];
+        if (section->freeFrames < frames) continue;
+
+        size_t first = findFreeBlock(section, frames);
+        if (first == NOT_FOUND) continue;
+
+        for (size_t bit = first; bit < first + frames; bit++) {
+            section->bitmap[bit / BITS_PER_WORD] &=
+                    ~((uintptr_t) 1 << (bit % BITS_PER_WORD));
+        }
+        section->freeFrames -= frames;
+        while (section->firstFreeWord < WORDS_PER_SECTION &&
+                !section->bitmap[section->firstFreeWord]) {
+            section->firstFreeWord++;
+        }
+
+        zone->freeFrames -= frames;
+        while (zone->firstFreeSection < zone->endSection &&
+                !sections[zone->firstFreeSection].freeFrames) {
+            zone->firstFreeSection++;
+        }
+
+        framesFree -= frames;
+        if (!cache) {
+            framesAvailable -= frames;
+        }
+        return ((paddr_t) i * FRAMES_PER_SECTION + first) * PAGESIZE;
+    }
+
+    return 0;
+}
+
+// Allocates from the highest zone first to keep low memory available for
+// devices.
+static paddr_t allocateFrames(size_t order, size_t endSection, bool cache) {
+    for (size_t i = NUM_ZONES; i > 0; i--) {
+        paddr_t result = allocateFromZone(&zones[i - 1], order, endSection,
+                cache);
+        if (result) return result;
+    }
+    return 0;
+}
+
 void PhysicalMemory::pushPageFrame(paddr_t physicalAddress) {
     assert(physicalAddress);
     assert(PAGE_ALIGNED(physicalAddress));
     AutoLock lock(&mutex);
 
-#ifdef __x86_64__
-    if (physicalAddress <= 0xFFFFF000) {
-        memstack32.pushPageFrame(physicalAddress);
+    size_t frame = physicalAddress / PAGESIZE;
+    if (frame < frameReferencesSize && unreservedReferences[frame] > 0) {
+        // Unreserved references are dropped first so that the reservations
+        // stay available for the remaining copy-on-write mappings.
+        unreservedReferences[frame]--;
         return;
     }
-#endif
-    memstack.pushPageFrame(physicalAddress);
-}
-
-paddr_t MemoryStack::popPageFrame(bool cache /*= false*/) {
-    if (((vaddr_t) stack & PAGE_MISALIGN) < 2 * sizeof(paddr_t)) {
-        paddr_t* stackPage = (paddr_t*) ((vaddr_t) stack & ~PAGE_MISALIGN);
-        assert(*stackPage != 0);
-        stack = (paddr_t*) (*stackPage + PAGESIZE - sizeof(paddr_t));
+    if (frame < frameReferencesSize && frameReferences[frame] > 0) {
+        // The frame is still in use by another mapping. Only drop the
+        // reservation that was backing this reference.
+        frameReferences[frame]--;
+        assert(framesReserved > 0);
+        framesReserved--;
+        return;
     }
 
-    framesOnStack--;
-    if (!cache) {
-        framesAvailable--;
-    }
-    return *stack--;
+    pushFrame(physicalAddress, false);
 }
 
 paddr_t PhysicalMemory::popPageFrame() {
     AutoLock lock(&mutex);
     if (framesAvailable - framesReserved == 0) return 0;
 
-    if (totalFramesOnStack - framesReserved > 0) {
-        if (memstack.framesOnStack > 0) {
-            return memstack.popPageFrame();
-        }
-
-    #ifdef __x86_64__
-        return memstack32.popPageFrame();
-    #endif
+    if (framesFree - framesReserved > 0) {
+        return allocateFrames(0, MAX_SECTIONS, false);
     }
 
     for (CacheController* cache = firstCache; cache; cache = cache->nextCache) {
@@ -245,8 +422,7 @@ paddr_t PhysicalMemory::popPageFrame() {
 #ifdef __x86_64__
 paddr_t PhysicalMemory::popPageFrame32() {
     AutoLock lock(&mutex);
-    if (memstack32.framesOnStack == 0) return 0;
-    return memstack32.popPageFrame();
+    return allocateFromZone(&zones[ZONE_32], 0, SECTIONS_32, false);
 }
 #else
 paddr_t PhysicalMemory::popPageFrame32() {
@@ -254,19 +430,106 @@ paddr_t PhysicalMemory::popPageFrame32() {
 }
 #endif
 
-paddr_t PhysicalMemory::popReserved() {
+paddr_t PhysicalMemory::allocateContiguous(size_t order, paddr_t maxAddress) {
+    if (order > MAX_CONTIGUOUS_ORDER) return 0;
+    size_t frames = (size_t) 1 << order;
+    // Only sections that lie completely below maxAddress are used.
+    size_t endSection = (maxAddress / PAGESIZE + 1) / FRAMES_PER_SECTION;
+
+    AutoLock lock(&mutex);
+    if (framesAvailable - framesReserved < frames ||
+            framesFree - framesReserved < frames) {
+        return 0;
+    }
+    return allocateFrames(order, endSection, false);
+}
+
+void PhysicalMemory::freeContiguous(paddr_t physicalAddress, size_t order) {
+    assert(PAGE_ALIGNED(physicalAddress));
     AutoLock lock(&mutex);
+
+    for (size_t i = 0; i < (size_t) 1 << order; i++) {
+        pushFrame(physicalAddress + i * PAGESIZE, false);
+    }
+}
+
+static paddr_t popReservedUnlocked() {
     assert(framesReserved > 0);
 
     framesReserved--;
-#ifdef __x86_64__
-    if (memstack.framesOnStack > 0) {
-        return memstack.popPageFrame();
+    return allocateFrames(0, MAX_SECTIONS, false);
+}
+
+paddr_t PhysicalMemory::popReserved() {
+    AutoLock lock(&mutex);
+    return popReservedUnlocked();
+}
+
+paddr_t PhysicalMemory::popReservedContiguous(size_t order) {
+    if (order > MAX_CONTIGUOUS_ORDER) return 0;
+    size_t frames = (size_t) 1 << order;
+
+    AutoLock lock(&mutex);
+    assert(framesReserved >= frames);
+    paddr_t result = allocateFrames(order, MAX_SECTIONS, false);
+    if (result) {
+        framesReserved -= frames;
     }
-    return memstack32.popPageFrame();
-#else
-    return memstack.popPageFrame();
-#endif
+    return result;
+}
+
+bool PhysicalMemory::addFrameReference(paddr_t physicalAddress,
+        bool reserved) {
+    AutoLock lock(&mutex);
+
+    size_t frame = physicalAddress / PAGESIZE;
+    if (frame >= frameReferencesSize) return false;
+
+    uint16_t* references = reserved ? frameReferences : unreservedReferences;
+    if (references[frame] == UINT16_MAX) return false;
+    references[frame]++;
+    return true;
+}
+
+bool PhysicalMemory::isFrameShared(paddr_t physicalAddress) {
+    AutoLock lock(&mutex);
+
+    size_t frame = physicalAddress / PAGESIZE;
+    return frame < frameReferencesSize && (frameReferences[frame] > 0 ||
+            unreservedReferences[frame] > 0);
+}
+
+void PhysicalMemory::reserveFrameReference(paddr_t physicalAddress) {
+    AutoLock lock(&mutex);
+
+    size_t frame = physicalAddress / PAGESIZE;
+    if (frame < frameReferencesSize && unreservedReferences[frame] > 0) {
+        unreservedReferences[frame]--;
+        frameReferences[frame]++;
+        return;
+    }
+
+    // All other references are gone and the frame is owned by the caller,
+    // which no longer needs the reservation.
+    assert(framesReserved > 0);
+    framesReserved--;
+}
+
+paddr_t PhysicalMemory::unshareFrame(paddr_t physicalAddress) {
+    AutoLock lock(&mutex);
+
+    size_t frame = physicalAddress / PAGESIZE;
+    if (frame >= frameReferencesSize || (frameReferences[frame] == 0 &&
+            unreservedReferences[frame] == 0)) {
+        return 0;
+    }
+
+    // Hand out the frame that was reserved for the dropped reference. The
+    // caller holds a reserved reference because unreserved ones are always
+    // dropped first.
+    assert(frameReferences[frame] > 0);
+    frameReferences[frame]--;
+    return popReservedUnlocked();
 }
 
 bool PhysicalMemory::reserveFrames(size_t frames) {
@@ -276,7 +539,7 @@ bool PhysicalMemory::reserveFrames(size_t frames) {
 
     // Make sure that reserved frames on the stack because memory used for
     // caching can be unreclaimable for a short time frame.
-    while (totalFramesOnStack < framesReserved + frames) {
+    while (framesFree < framesReserved + frames) {
         paddr_t address = 0;
         for (CacheController* cache = firstCache; cache;
                 cache = cache->nextCache) {
@@ -285,12 +548,7 @@ bool PhysicalMemory::reserveFrames(size_t frames) {
         }
 
         if (address) {
-#ifdef __x86_64__
-            if (address <= 0xFFFFF000) {
-                memstack32.pushPageFrame(address, true);
-            } else
-#endif
-            memstack.pushPageFrame(address, true);
+            pushFrame(address, true);
         } else {
             return false;
         }
@@ -318,13 +576,8 @@ paddr_t CacheController::allocateCache() {
         return 0;
     }
 
-    if (totalFramesOnStack - framesReserved > 0) {
-        if (memstack.framesOnStack > 0) {
-            return memstack.popPageFrame(true);
-        }
-#ifdef __x86_64__
-        return memstack32.popPageFrame(true);
-#endif
+    if (framesFree - framesReserved > 0) {
+        return allocateFrames(0, MAX_SECTIONS, true);
     }
 
     for (CacheController* cache = firstCache; cache; cache = cache->nextCache) {
@@ -338,13 +591,29 @@ paddr_t CacheController::allocateCache() {
 
 void CacheController::returnCache(paddr_t address) {
     AutoLock lock(&mutex);
-    memstack.pushPageFrame(address, true);
+    pushFrame(address, true);
 }
 
+// The size of struct meminfo before meminfo2 was added.
+#define MEMINFO_V1_SIZE (4 * sizeof(size_t))
+
 void Syscall::meminfo(struct meminfo* info) {
-    AutoLock lock(&mutex);
-    info->mem_total = totalFrames * PAGESIZE;
-    info->mem_free = totalFramesOnStack * PAGESIZE;
-    info->mem_available = framesAvailable * PAGESIZE;
-    info->__reserved = 0;
+    meminfo2(info, MEMINFO_V1_SIZE);
+}
+
+void Syscall::meminfo2(struct meminfo* info, size_t size) {
+    struct meminfo result;
+    kthread_mutex_lock(&mutex);
+    result.mem_total = totalFrames * PAGESIZE;
+    result.mem_free = framesFree * PAGESIZE;
+    result.mem_available = framesAvailable * PAGESIZE;
+    result.mem_committed = framesReserved * PAGESIZE;
+    kthread_mutex_unlock(&mutex);
+    result.mem_slab = __atomic_load_n(&ObjectCache::slabBytes,
+            __ATOMIC_RELAXED);
+    result.mem_slab_allocated = __atomic_load_n(&ObjectCache::allocatedBytes,
+            __ATOMIC_RELAXED);
+
+    // Only copy the fields that the caller knows about.
+    memcpy(info, &result, size < sizeof(result) ? size : sizeof(result));
 }
@@ -27,11 +27,20 @@
 #include <cobalt/kernel/signal.h>
 #include <cobalt/kernel/thread.h>
 
+static void raiseSigpipe() {
+    siginfo_t siginfo = {};
+    siginfo.si_signo = SIGPIPE;
+    siginfo.si_code = SI_KERNEL;
+    Thread::current()->raiseSignal(siginfo);
+}
+
 class PipeVnode::Endpoint : public Vnode {
 public:
     Endpoint(const Reference<PipeVnode>& pipe)
             : Vnode(S_IFIFO | S_IRUSR | S_IWUSR, 0), pipe(pipe) {}
+    PollQueue* getPollQueue() override;
     int stat(struct stat* result) override;
+    int statFields(struct stat* result, unsigned int mask) override;
 protected:
     Reference<PipeVnode> pipe;
 };
@@ -39,8 +48,11 @@ protected:
 class PipeVnode::ReadEnd : public Endpoint {
 public:
     ReadEnd(const Reference<PipeVnode>& pipe) : Endpoint(pipe) {}
+    ssize_t peek(void* buffer, size_t size, int flags) override;
     short poll() override;
     ssize_t read(void* buffer, size_t size, int flags) override;
+    ssize_t spliceToFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
     virtual ~ReadEnd();
 };
 
@@ -48,6 +60,8 @@ class PipeVnode::WriteEnd : public Endpoint {
 public:
     WriteEnd(const Reference<PipeVnode>& pipe) : Endpoint(pipe) {}
     short poll() override;
+    ssize_t spliceFromFile(const Reference<Vnode>& file, off_t offset,
+            int fileFlags, size_t size, int flags) override;
     ssize_t write(const void* buffer, size_t size, int flags) override;
     virtual ~WriteEnd();
 };
@@ -75,10 +89,22 @@ PipeVnode::~PipeVnode() {
     assert(!writeEnd);
 }
 
+PollQueue* PipeVnode::Endpoint::getPollQueue() {
+    return &pipe->pollQueue;
+}
+
 int PipeVnode::Endpoint::stat(struct stat* result) {
     return pipe->stat(result);
 }
 
+int PipeVnode::Endpoint::statFields(struct stat* result, unsigned int mask) {
+    return pipe->statFields(result, mask);
+}
+
+ssize_t PipeVnode::ReadEnd::peek(void* buffer, size_t size, int flags) {
+    return pipe->peek(buffer, size, flags);
+}
+
 short PipeVnode::ReadEnd::poll() {
     return pipe->poll() & (POLLIN | POLLRDNORM | POLLHUP);
 }
@@ -87,16 +113,27 @@ ssize_t PipeVnode::ReadEnd::read(void* buffer, size_t size, int flags) {
     return pipe->read(buffer, size, flags);
 }
 
+ssize_t PipeVnode::ReadEnd::spliceToFile(const Reference<Vnode>& file,
+        off_t offset, int fileFlags, size_t size, int flags) {
+    return pipe->spliceToFile(file, offset, fileFlags, size, flags);
+}
+
 PipeVnode::ReadEnd::~ReadEnd() {
     AutoLock lock(&pipe->mutex);
     pipe->readEnd = nullptr;
     kthread_cond_broadcast(&pipe->writeCond);
+    pipe->pollQueue.notify();
 }
 
 short PipeVnode::WriteEnd::poll() {
     return pipe->poll() & (POLLOUT | POLLWRNORM | POLLHUP);
 }
 
+ssize_t PipeVnode::WriteEnd::spliceFromFile(const Reference<Vnode>& file,
+        off_t offset, int fileFlags, size_t size, int flags) {
+    return pipe->spliceFromFile(file, offset, fileFlags, size, flags);
+}
+
 ssize_t PipeVnode::WriteEnd::write(const void* buffer, size_t size, int flags) {
     return pipe->write(buffer, size, flags);
 }
@@ -105,6 +142,16 @@ PipeVnode::WriteEnd::~WriteEnd() {
     AutoLock lock(&pipe->mutex);
     pipe->writeEnd = nullptr;
     kthread_cond_broadcast(&pipe->readCond);
+    pipe->pollQueue.notify();
+}
+
+ssize_t PipeVnode::peek(void* buffer, size_t size, int flags) {
+    if (size == 0) return 0;
+    AutoLock lock(&mutex);
+
+    int status = waitForData(flags);
+    if (status <= 0) return status;
+    return circularBuffer.peek(buffer, size);
 }
 
 short PipeVnode::poll() {
@@ -122,6 +169,106 @@ ssize_t PipeVnode::read(void* buffer, size_t size, int flags) {
     if (size == 0) return 0;
     AutoLock lock(&mutex);
 
+    int status = waitForData(flags);
+    if (status <= 0) return status;
+
+    size_t bytesRead = circularBuffer.read(buffer, size);
+    kthread_cond_broadcast(&writeCond);
+    pollQueue.notify();
+    updateTimestamps(true, false, false);
+    return bytesRead;
+}
+
+ssize_t PipeVnode::spliceFromFile(const Reference<Vnode>& file, off_t offset,
+        int fileFlags, size_t size, int flags) {
+    if (size == 0) return 0;
+    AutoLock lock(&mutex);
+
+    size_t transferred = 0;
+    while (transferred < size) {
+        while (circularBuffer.spaceAvailable() == 0 && readEnd) {
+            if (flags & O_NONBLOCK) {
+                if (transferred) break;
+                errno = EAGAIN;
+                return -1;
+            }
+
+            if (kthread_cond_sigwait(&writeCond, &mutex) == EINTR) {
+                if (transferred) break;
+                errno = EINTR;
+                return -1;
+            }
+        }
+        if (!readEnd) {
+            if (transferred) break;
+            raiseSigpipe();
+            errno = EPIPE;
+            return -1;
+        }
+        if (circularBuffer.spaceAvailable() == 0) break;
+
+        // The file data is read directly into the pipe buffer.
+        size_t count;
+        char* region = circularBuffer.writeRegion(&count);
+        if (count > size - transferred) count = size - transferred;
+        ssize_t bytesRead = file->pread(region, count, offset + transferred,
+                fileFlags);
+        if (bytesRead < 0) {
+            if (transferred) break;
+            return -1;
+        }
+        if (bytesRead == 0) break;
+
+        circularBuffer.produce(bytesRead);
+        transferred += bytesRead;
+        kthread_cond_broadcast(&readCond);
+        pollQueue.notify();
+        if ((size_t) bytesRead < count) break;
+    }
+
+    if (transferred) {
+        updateTimestamps(false, true, true);
+    }
+    return transferred;
+}
+
+ssize_t PipeVnode::spliceToFile(const Reference<Vnode>& file, off_t offset,
+        int fileFlags, size_t size, int flags) {
+    if (size == 0) return 0;
+    AutoLock lock(&mutex);
+
+    int status = waitForData(flags);
+    if (status <= 0) return status;
+
+    // The pipe data is written directly from the pipe buffer.
+    size_t transferred = 0;
+    while (transferred < size && circularBuffer.bytesAvailable()) {
+        size_t count;
+        const char* region = circularBuffer.readRegion(&count);
+        if (count > size - transferred) count = size - transferred;
+        ssize_t written = file->pwrite(region, count, offset + transferred,
+                fileFlags);
+        if (written < 0) {
+            if (transferred) break;
+            return -1;
+        }
+
+        circularBuffer.consume(written);
+        transferred += written;
+        if ((size_t) written < count) break;
+    }
+
+    if (transferred) {
+        kthread_cond_broadcast(&writeCond);
+        pollQueue.notify();
+        updateTimestamps(true, false, false);
+    }
+    return transferred;
+}
+
+// Waits until the pipe contains data. Returns 1 when data is available, 0 at
+// the end of file and -1 on error.
+int PipeVnode::waitForData(int flags) {
     while (circularBuffer.bytesAvailable() == 0) {
         if (!writeEnd) return 0;
 
@@ -135,11 +282,7 @@ ssize_t PipeVnode::read(void* buffer, size_t size, int flags) {
             return -1;
         }
     }
-
-    size_t bytesRead = circularBuffer.read(buffer, size);
-    kthread_cond_broadcast(&writeCond);
-    updateTimestamps(true, false, false);
-    return bytesRead;
+    return 1;
 }
 
 ssize_t PipeVnode::write(const void* buffer, size_t size, int flags) {
@@ -185,16 +328,14 @@ ssize_t PipeVnode::write(const void* buffer, size_t size, int flags) {
         }
 
         if (!readEnd) {
-            siginfo_t siginfo = {};
-            siginfo.si_signo = SIGPIPE;
-            siginfo.si_code = SI_KERNEL;
-            Thread::current()->raiseSignal(siginfo);
+            raiseSigpipe();
             errno = EPIPE;
             return -1;
         }
 
         written += circularBuffer.write(buf + written, size - written);
         kthread_cond_broadcast(&readCond);
+        pollQueue.notify();
     }
 
     updateTimestamps(false, true, true);
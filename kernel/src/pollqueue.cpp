@@ -0,0 +1,114 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/pollqueue.cpp
+ * Poll wait queues.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/pollqueue.h>
+#include <cobalt/kernel/signal.h>
+#include <cobalt/kernel/thread.h>
+
+PollQueue::PollQueue() {
+    first = nullptr;
+    last = nullptr;
+}
+
+PollQueue::~PollQueue() {
+    // Entries keep a reference to the vnode that owns the queue.
+    assert(!first);
+}
+
+void PollQueue::add(PollEntry* entry) {
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    entry->queue = this;
+    entry->prev = last;
+    entry->next = nullptr;
+    if (last) {
+        last->next = entry;
+    } else {
+        first = entry;
+    }
+    last = entry;
+    if (interruptsEnabled) Interrupts::enable();
+}
+
+void PollQueue::notify() {
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    for (PollEntry* entry = first; entry; entry = entry->next) {
+        entry->onEvent();
+    }
+    if (interruptsEnabled) Interrupts::enable();
+}
+
+void PollQueue::remove(PollEntry* entry) {
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    PollQueue* queue = entry->queue;
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        queue->first = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        queue->last = entry->prev;
+    }
+    entry->queue = nullptr;
+    if (interruptsEnabled) Interrupts::enable();
+}
+
+void PollWaiter::Entry::onEvent() {
+    waiter->notified = true;
+    waiter->thread->wakeUp();
+}
+
+PollWaiter::PollWaiter() {
+    thread = Thread::current();
+    notified = false;
+}
+
+int PollWaiter::wait(const struct timespec* endTime) {
+    Clock* clock = Clock::get(CLOCK_MONOTONIC);
+    int result = 0;
+
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    while (!notified) {
+        if (endTime) {
+            struct timespec now;
+            clock->getTime(&now);
+            if (!timespecLess(now, *endTime)) {
+                result = ETIMEDOUT;
+                break;
+            }
+        }
+
+        if (Signal::isPending()) {
+            result = EINTR;
+            break;
+        }
+        Thread::block(true, clock, endTime);
+    }
+    notified = false;
+    if (interruptsEnabled) Interrupts::enable();
+    return result;
+}
@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <sched.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -49,6 +50,12 @@ struct ProcessTableEntry {
 kthread_mutex_t processesMutex = KTHREAD_MUTEX_INITIALIZER;
 static DynamicArray<ProcessTableEntry, pid_t> processes;
 
+// Processes with a pending alarm. This list is protected by disabling
+// interrupts.
+static Process* firstAlarm;
+static WorkerJob alarmJob;
+static bool alarmJobQueued;
+
 extern "C" {
 extern symbol_t beginSigreturn;
 extern symbol_t endSigreturn;
@@ -77,7 +84,13 @@ Process::Process() {
 
     ownsDisplay = false;
 
+    nice = 0;
+    schedulingPolicy = SCHED_OTHER;
+    schedulingPriority = 0;
+
     alarmTime.tv_nsec = -1;
+    nextAlarm = nullptr;
+    prevAlarm = nullptr;
     sigreturn = 0;
     terminated = false;
     terminationJob.func = terminateProcess;
@@ -89,6 +102,9 @@ Process::Process() {
     prevChild = nullptr;
     nextChild = nullptr;
 
+    childWaitMutex = KTHREAD_MUTEX_INITIALIZER;
+    childWaitCond = KTHREAD_COND_INITIALIZER;
+
     fileMaskMutex = KTHREAD_MUTEX_INITIALIZER;
     fileMask = S_IWGRP | S_IWOTH;
 
@@ -195,7 +211,8 @@ uintptr_t Process::loadELF(const Reference<Vnode>& vnode,
             continue;
         }
 
-        if (programHeader.p_type == PT_TLS && tlsMaster != 0) {
+        if ((programHeader.p_type == PT_TLS && tlsMaster != 0) ||
+                programHeader.p_filesz > programHeader.p_memsz) {
             errno = ENOEXEC;
             return 0;
         }
@@ -231,13 +248,17 @@ uintptr_t Process::loadELF(const Reference<Vnode>& vnode,
             offset = 0;
         }
 
+        // Only the pages that contain file data need to be populated now. The
+        // remaining pages will be zero-filled on first access.
+        if (programHeader.p_filesz == 0) continue;
+        size = ALIGNUP(programHeader.p_filesz + offset, PAGESIZE);
+
         vaddr_t dest = kernelSpace->mapFromOtherAddressSpace(newAddressSpace,
                 loadAddressAligned, size, PROT_WRITE);
         if (!dest) {
             errno = ENOMEM;
             return 0;
         }
-        memset((void*) (dest + offset), 0, programHeader.p_memsz);
         readSize = vnode->pread((void*) (dest + offset), programHeader.p_filesz,
                 programHeader.p_offset, 0);
         if (readSize < 0) {
@@ -334,8 +355,26 @@ unsigned int Process::alarm(unsigned int seconds) {
     }
 
     if (seconds == 0) {
+        if (alarmTime.tv_nsec != -1) {
+            if (prevAlarm) {
+                prevAlarm->nextAlarm = nextAlarm;
+            } else {
+                firstAlarm = nextAlarm;
+            }
+            if (nextAlarm) {
+                nextAlarm->prevAlarm = prevAlarm;
+            }
+        }
         alarmTime.tv_nsec = -1;
     } else {
+        if (alarmTime.tv_nsec == -1) {
+            prevAlarm = nullptr;
+            nextAlarm = firstAlarm;
+            if (firstAlarm) {
+                firstAlarm->prevAlarm = this;
+            }
+            firstAlarm = this;
+        }
         alarmTime.tv_sec = now.tv_sec + seconds;
         alarmTime.tv_nsec = now.tv_nsec;
     }
@@ -344,6 +383,69 @@ unsigned int Process::alarm(unsigned int seconds) {
     return remaining;
 }
 
+uint64_t Process::checkAlarms() {
+    // This function is called by the scheduler. It returns the time in
+    // nanoseconds until the next alarm expires. Expired alarms are raised by
+    // the worker thread because raising a signal requires locking.
+    uint64_t result = UINT64_MAX;
+    Clock* clock = Clock::get(CLOCK_REALTIME);
+
+    for (Process* process = firstAlarm; process;
+            process = process->nextAlarm) {
+        uint64_t remaining = clock->nanosecondsUntil(process->alarmTime);
+        if (remaining == 0) {
+            if (!alarmJobQueued) {
+                alarmJob.func = raiseAlarms;
+                alarmJob.context = nullptr;
+                WorkerThread::addJob(&alarmJob);
+                alarmJobQueued = true;
+            }
+        } else if (remaining < result) {
+            result = remaining;
+        }
+    }
+
+    return result;
+}
+
+void Process::raiseAlarms(void*) {
+    Interrupts::disable();
+    alarmJobQueued = false;
+
+    struct timespec now;
+    Clock::get(CLOCK_REALTIME)->getTime(&now);
+    Process* process = firstAlarm;
+    while (process) {
+        if (timespecLess(now, process->alarmTime)) {
+            process = process->nextAlarm;
+            continue;
+        }
+
+        if (process->prevAlarm) {
+            process->prevAlarm->nextAlarm = process->nextAlarm;
+        } else {
+            firstAlarm = process->nextAlarm;
+        }
+        if (process->nextAlarm) {
+            process->nextAlarm->prevAlarm = process->prevAlarm;
+        }
+        process->alarmTime.tv_nsec = -1;
+        Interrupts::enable();
+
+        // The process cannot be deleted meanwhile because processes are
+        // terminated by the worker thread and their alarm is canceled then.
+        siginfo_t siginfo = {};
+        siginfo.si_signo = SIGALRM;
+        siginfo.si_code = SI_KERNEL;
+        process->raiseSignal(siginfo);
+
+        Interrupts::disable();
+        process = firstAlarm;
+    }
+
+    Interrupts::enable();
+}
+
 int Process::close(int fd) {
     AutoLock lock(&fdMutex);
     if (fd < 0 || fd >= fdTable.allocatedSize || !fdTable[fd]) {
@@ -469,6 +571,7 @@ int Process::execute(Reference<Vnode>& vnode, char* const argv[],
     for (pid_t tid = threads.next(-1); tid >= 0; tid = threads.next(tid)) {
         if (tid != Thread::current()->tid) {
             threads[tid]->forceKill = true;
+            threads[tid]->interrupt();
         }
     }
 
@@ -544,6 +647,7 @@ void Process::exitThread(const struct exit_thread* data) {
         for (pid_t tid = threads.next(-1); tid >= 0; tid = threads.next(tid)) {
             if (tid != Thread::current()->tid) {
                 threads[tid]->forceKill = true;
+                threads[tid]->interrupt();
             }
         }
 
@@ -628,6 +732,40 @@ Process* Process::getGroup(pid_t pgid) {
     return processes[pgid].processGroup;
 }
 
+int Process::getUserPriority(uid_t uid, int* priority) {
+    // All processes belong to user 0 because there are no other users.
+    if (uid != 0) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    AutoLock lock(&processesMutex);
+    int result = NZERO - 1;
+    for (pid_t pid = 0; pid < processes.allocatedSize; pid++) {
+        Process* process = processes[pid].process;
+        if (process && process->nice < result) {
+            result = process->nice;
+        }
+    }
+    *priority = result;
+    return 0;
+}
+
+int Process::getGroupPriority() {
+    AutoLock lock(&groupMutex);
+    assert(!prevInGroup);
+
+    // Return the highest priority of any process in the group.
+    int result = nice;
+    for (Process* process = nextInGroup; process;
+            process = process->nextInGroup) {
+        if (process->nice < result) {
+            result = process->nice;
+        }
+    }
+    return result;
+}
+
 bool Process::isParentOf(Process* process) {
     AutoLock lock(&parentMutex);
     return this == process->parent;
@@ -726,6 +864,10 @@ Process* Process::regfork(int flags, regfork_t* registers) {
     memcpy(process->sigactions, sigactions, sizeof(sigactions));
     kthread_mutex_unlock(&signalMutex);
 
+    process->nice = nice;
+    process->schedulingPolicy = schedulingPolicy;
+    process->schedulingPriority = schedulingPriority;
+
     process->sigreturn = sigreturn;
     kthread_mutex_lock(&fileMaskMutex);
     process->fileMask = fileMask;
@@ -793,6 +935,31 @@ void Process::removeFromGroup() {
     kthread_mutex_unlock(&groupLeader->groupMutex);
 }
 
+int Process::setUserPriority(uid_t uid, int value) {
+    if (uid != 0) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    AutoLock lock(&processesMutex);
+    for (pid_t pid = 0; pid < processes.allocatedSize; pid++) {
+        Process* process = processes[pid].process;
+        if (process) {
+            process->nice = value;
+        }
+    }
+    return 0;
+}
+
+void Process::setGroupPriority(int value) {
+    AutoLock lock(&groupMutex);
+    assert(!prevInGroup);
+
+    for (Process* process = this; process; process = process->nextInGroup) {
+        process->nice = value;
+    }
+}
+
 int Process::setpgid(pid_t pgid) {
     AutoLock lock(&jobControlMutex);
 
@@ -854,6 +1021,7 @@ pid_t Process::setsid() {
 
 void Process::terminate() {
     assert(threads.next(-1) == -1);
+    alarm(0);
 
     if (ownsDisplay) {
         console->display->releaseDisplay();
@@ -895,14 +1063,28 @@ void Process::terminate() {
     }
     kthread_mutex_unlock(&childrenMutex);
 
-    // Send SIGCHLD to the parent.
-    if (likely(terminationStatus.si_signo == SIGCHLD)) {
-        AutoLock lock(&parentMutex);
-        parent->raiseSignal(terminationStatus);
+    if (firstChild) {
+        // Some of the orphans might already have terminated.
+        AutoLock lock(&initProcess->childWaitMutex);
+        kthread_cond_broadcast(&initProcess->childWaitCond);
     }
 
     delete addressSpace;
+
+    kthread_mutex_lock(&parentMutex);
+    Process* parentProcess = parent;
+    kthread_mutex_lock(&parentProcess->childWaitMutex);
     terminated = true;
+    kthread_mutex_unlock(&parentMutex);
+
+    // Send SIGCHLD to the parent.
+    if (likely(terminationStatus.si_signo == SIGCHLD)) {
+        parentProcess->raiseSignal(terminationStatus);
+    }
+
+    // The parent may delete this process as soon as the mutex is unlocked.
+    kthread_cond_broadcast(&parentProcess->childWaitCond);
+    kthread_mutex_unlock(&parentProcess->childWaitMutex);
 }
 
 void Process::terminateBySignal(siginfo_t siginfo) {
@@ -912,6 +1094,7 @@ void Process::terminateBySignal(siginfo_t siginfo) {
     for (pid_t tid = threads.next(-1); tid >= 0; tid = threads.next(tid)) {
         if (tid != Thread::current()->tid) {
             threads[tid]->forceKill = true;
+            threads[tid]->interrupt();
         }
     }
 
@@ -941,62 +1124,81 @@ mode_t Process::umask(const mode_t* newMask /*= nullptr*/) {
     return oldMask;
 }
 
-Process* Process::waitpid(pid_t pid, int flags) {
+int Process::waitid(idtype_t idtype, id_t id, siginfo_t* info, int flags) {
+    if (idtype != P_ALL && idtype != P_PID && idtype != P_PGID) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Processes are never stopped or continued, so only termination can be
+    // reported.
+    if (!(flags & (WEXITED | WSTOPPED | WCONTINUED))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Holding the childWaitMutex also prevents other threads from collecting
+    // the same child concurrently.
+    AutoLock lock(&childWaitMutex);
     Process* process;
+    bool interrupted = false;
+
+    while (true) {
+        if (idtype == P_PID) {
+            // Look up the child directly instead of searching all children.
+            process = nullptr;
+            kthread_mutex_lock(&processesMutex);
+            if ((pid_t) id > 0 && (pid_t) id < processes.allocatedSize) {
+                process = processes[id].process;
+            }
+            // The parentMutex cannot be locked here because a terminating
+            // child holds it while waiting for our childWaitMutex. The parent
+            // of our children only changes when we terminate ourselves.
+            if (process && __atomic_load_n(&process->parent,
+                    __ATOMIC_RELAXED) != this) {
+                process = nullptr;
+            }
+            kthread_mutex_unlock(&processesMutex);
 
-    if (pid == -1) {
-        while (true) {
-            kthread_mutex_lock(&childrenMutex);
-            if (!firstChild) {
-                kthread_mutex_unlock(&childrenMutex);
+            if (!process) {
                 errno = ECHILD;
-                return nullptr;
+                return -1;
             }
-
-            process = firstChild;
-            while (process && !process->terminated) {
-                process = process->nextChild;
+            if (!process->terminated) process = nullptr;
+        } else {
+            bool hasChild = false;
+            kthread_mutex_lock(&childrenMutex);
+            for (process = firstChild; process; process = process->nextChild) {
+                if (idtype == P_PGID && process->pgid != (pid_t) id) continue;
+                hasChild = true;
+                if (process->terminated) break;
             }
             kthread_mutex_unlock(&childrenMutex);
-            if (process) break;
-            if (flags & WNOHANG) {
-                return nullptr;
-            }
-
-            sched_yield();
 
-            if (Signal::isPending()) {
-                errno = EINTR;
-                return nullptr;
+            if (!hasChild) {
+                errno = ECHILD;
+                return -1;
             }
         }
-    } else {
-        kthread_mutex_lock(&childrenMutex);
-        process = firstChild;
 
-        while (process && process->pid != pid) {
-            process = process->nextChild;
-        }
-        kthread_mutex_unlock(&childrenMutex);
+        if (process && (flags & WEXITED)) break;
 
-        if (!process) {
-            errno = ECHILD;
-            return nullptr;
+        if (flags & WNOHANG) {
+            *info = {};
+            return 0;
         }
 
-        while (!process->terminated) {
-            if (flags & WNOHANG) {
-                return nullptr;
-            }
-
-            sched_yield();
-            if (Signal::isPending()) {
-                errno = EINTR;
-                return nullptr;
-            }
+        if (interrupted) {
+            errno = EINTR;
+            return -1;
         }
+        interrupted = kthread_cond_sigwait(&childWaitCond, &childWaitMutex) ==
+                EINTR;
     }
 
+    *info = process->terminationStatus;
+    if (flags & WNOWAIT) return 0;
+
     childrenSystemCpuClock.add(&process->systemCpuClock);
     childrenSystemCpuClock.add(&process->childrenSystemCpuClock);
     childrenUserCpuClock.add(&process->userCpuClock);
@@ -1013,8 +1215,10 @@ Process* Process::waitpid(pid_t pid, int flags) {
     }
     kthread_mutex_unlock(&childrenMutex);
 
-    AutoLock lock(&processesMutex);
+    kthread_mutex_lock(&processesMutex);
     processes[process->pid].process = nullptr;
+    kthread_mutex_unlock(&processesMutex);
 
-    return process;
+    delete process;
+    return 0;
 }
@@ -55,6 +55,7 @@ public:
     ~PtController();
     int devctl(int command, void* restrict data, size_t size,
             int* restrict info) override;
+    PollQueue* getPollQueue() override;
     int isatty() override;
     short poll() override;
     ssize_t read(void* buffer, size_t size, int flags) override;
@@ -225,6 +226,7 @@ void PseudoTerminal::output(const char* buffer, size_t size) {
             bytesAvailable++;
         }
         kthread_cond_broadcast(&controllerReadCond);
+        pollQueue.notify();
     }
 }
 
@@ -275,6 +277,7 @@ ssize_t PseudoTerminal::readController(void* buffer, size_t size, int flags) {
     }
 
     kthread_cond_broadcast(&outputCond);
+    pollQueue.notify();
     updateTimestamps(true, false, false);
     return bytesRead;
 }
@@ -306,6 +309,10 @@ int PtController::devctl(int command, void* restrict data, size_t size,
     return pts->devctl(command, data, size, info);
 }
 
+PollQueue* PtController::getPollQueue() {
+    return pts->getPollQueue();
+}
+
 int PtController::isatty() {
     return 1;
 }
@@ -62,44 +62,6 @@ static inline bool isMoreImportantSignalThan(int signal1, int signal2) {
     return signal1 <= signal2;
 }
 
-void Thread::checkSigalarm(bool scheduling) {
-    if (!scheduling) {
-        Interrupts::disable();
-    }
-
-    if (process->alarmTime.tv_nsec == -1) {
-        if (!scheduling) {
-            Interrupts::enable();
-        }
-        return;
-    }
-
-    struct timespec now;
-    Clock::get(CLOCK_REALTIME)->getTime(&now);
-    if (!timespecLess(now, process->alarmTime)) {
-        if (scheduling) {
-            // If the mutex is locked then we cannot raise the signal now. The
-            // raiseSignal and handleSignal functions also check whether an
-            // alarm is pending to ensure an alarm cannot be delayed infinitely.
-            if (kthread_mutex_trylock(&signalMutex) != 0) return;
-        }
-
-        siginfo_t siginfo = {};
-        siginfo.si_signo = SIGALRM;
-        siginfo.si_code = SI_KERNEL;
-        raiseSignalUnlocked(siginfo);
-        process->alarmTime.tv_nsec = -1;
-
-        if (scheduling) {
-            kthread_mutex_unlock(&signalMutex);
-        }
-    }
-
-    if (!scheduling) {
-        Interrupts::enable();
-    }
-}
-
 extern "C" InterruptContext* handleSignal(InterruptContext* context) {
     return Thread::current()->handleSignal(context);
 }
@@ -134,7 +96,6 @@ InterruptContext* Thread::handleSignal(InterruptContext* context) {
     siginfo_t siginfo = pending->siginfo;
     delete pending;
 
-    checkSigalarm(false);
     updatePendingSignals();
     kthread_mutex_unlock(&signalMutex);
 
@@ -223,7 +184,6 @@ void Thread::raiseSignal(siginfo_t siginfo) {
     AutoLock lock(&signalMutex);
     raiseSignalUnlocked(siginfo);
     if (this == Thread::current()) {
-        checkSigalarm(false);
         updatePendingSignals();
     }
 }
@@ -273,6 +233,10 @@ void Thread::raiseSignalUnlocked(siginfo_t siginfo) {
     }
 
     kthread_cond_broadcast(&signalCond);
+    if (!sigismember(&signalMask, siginfo.si_signo)) {
+        // Wake up the thread so that the signal can be handled.
+        interrupt();
+    }
 }
 
 void Thread::updatePendingSignals() {
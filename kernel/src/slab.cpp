@@ -0,0 +1,129 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* kernel/src/slab.cpp
+ * Object caches.
+ */
+
+#include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/slab.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Each slab is a single page that starts with this header. Free objects are
+// linked through their first word.
+struct ObjectCache::Slab {
+    Slab* prev;
+    Slab* next;
+    void* freeList;
+    size_t used;
+};
+
+size_t ObjectCache::allocatedBytes;
+size_t ObjectCache::slabBytes;
+
+void* ObjectCache::allocate() {
+    AutoLock lock(&mutex);
+
+    Slab* slab = partialSlabs;
+    if (!slab) {
+        slab = allocateSlab();
+        if (!slab) return nullptr;
+    }
+
+    void* object = slab->freeList;
+    slab->freeList = *(void**) object;
+    slab->used++;
+    if (!slab->freeList) {
+        removeSlab(slab);
+    }
+
+    __atomic_add_fetch(&allocatedBytes, objectSize, __ATOMIC_RELAXED);
+    return object;
+}
+
+ObjectCache::Slab* ObjectCache::allocateSlab() {
+    vaddr_t page = kernelSpace->mapMemory(PAGESIZE, PROT_READ | PROT_WRITE);
+    if (!page) return nullptr;
+
+    size_t start = ALIGNUP(sizeof(Slab), alignment);
+    size_t count = (PAGESIZE - start) / objectSize;
+    assert(count > 0);
+
+    // Successive slabs place their first object at different offsets so that
+    // objects at the same index do not all compete for the same cache lines.
+    size_t unusedSpace = PAGESIZE - start - count * objectSize;
+    if (nextColor > unusedSpace) {
+        nextColor = 0;
+    }
+    start += nextColor;
+    nextColor += ALIGNUP(CACHE_LINE_SIZE, alignment);
+
+    Slab* slab = (Slab*) page;
+    slab->freeList = nullptr;
+    slab->used = 0;
+    for (size_t i = count; i > 0; i--) {
+        void* object = (void*) (page + start + (i - 1) * objectSize);
+        *(void**) object = slab->freeList;
+        slab->freeList = object;
+    }
+
+    insertSlab(slab);
+    __atomic_add_fetch(&slabBytes, PAGESIZE, __ATOMIC_RELAXED);
+    return slab;
+}
+
+void ObjectCache::free(void* object) {
+    if (!object) return;
+    Slab* slab = (Slab*) ((vaddr_t) object & ~PAGE_MISALIGN);
+
+    AutoLock lock(&mutex);
+    if (!slab->freeList) {
+        insertSlab(slab);
+    }
+
+    *(void**) object = slab->freeList;
+    slab->freeList = object;
+    slab->used--;
+    __atomic_sub_fetch(&allocatedBytes, objectSize, __ATOMIC_RELAXED);
+
+    // Keep one slab around even when it is empty to avoid mapping and
+    // unmapping pages repeatedly.
+    if (slab->used == 0 && (slab->prev || slab->next)) {
+        removeSlab(slab);
+        kernelSpace->unmapMemory((vaddr_t) slab, PAGESIZE);
+        __atomic_sub_fetch(&slabBytes, PAGESIZE, __ATOMIC_RELAXED);
+    }
+}
+
+void ObjectCache::insertSlab(Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = partialSlabs;
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+    partialSlabs = slab;
+}
+
+void ObjectCache::removeSlab(Slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        partialSlabs = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
@@ -28,6 +28,13 @@
 
 #define BUFFER_SIZE (4 * 1024 * 1024) // 4 MiB
 
+static void raiseSigpipe() {
+    siginfo_t siginfo = {};
+    siginfo.si_signo = SIGPIPE;
+    siginfo.si_code = SI_KERNEL;
+    Thread::current()->raiseSignal(siginfo);
+}
+
 StreamSocket::StreamSocket(mode_t mode) : Socket(SOCK_STREAM, mode) {
     socketMutex = KTHREAD_MUTEX_INITIALIZER;
     acceptCond = KTHREAD_COND_INITIALIZER;
@@ -61,6 +68,7 @@ StreamSocket::~StreamSocket() {
             peer->peer = nullptr;
             kthread_cond_broadcast(&peer->receiveCond);
             kthread_cond_broadcast(&peer->sendCond);
+            peer->pollQueue.notify();
         }
         kthread_mutex_unlock(&connectionMutex->mutex);
         delete receiveBuffer;
@@ -68,6 +76,7 @@ StreamSocket::~StreamSocket() {
 
     while (firstConnection) {
         kthread_cond_broadcast(&firstConnection->connectCond);
+        firstConnection->pollQueue.notify();
         Reference<StreamSocket> connection = firstConnection;
         firstConnection = firstConnection->nextConnection;
         connection->nextConnection = nullptr;
@@ -113,6 +122,7 @@ Reference<Vnode> StreamSocket::accept(struct sockaddr* address,
         kthread_mutex_lock(&incoming->socketMutex);
         incoming->isConnecting = false;
         kthread_cond_broadcast(&incoming->connectCond);
+        incoming->pollQueue.notify();
         kthread_mutex_unlock(&incoming->socketMutex);
         return nullptr;
     }
@@ -126,6 +136,7 @@ Reference<Vnode> StreamSocket::accept(struct sockaddr* address,
     incoming->circularBuffer.initialize(buffer, BUFFER_SIZE);
     struct sockaddr_un peerAddr = incoming->boundAddress;
     kthread_cond_broadcast(&incoming->connectCond);
+    incoming->pollQueue.notify();
     kthread_mutex_unlock(&incoming->socketMutex);
 
     if (address) {
@@ -153,6 +164,7 @@ bool StreamSocket::addConnection(const Reference<StreamSocket>& socket) {
     lastConnection = socket;
 
     kthread_cond_signal(&acceptCond);
+    pollQueue.notify();
     return true;
 }
 
@@ -327,6 +339,10 @@ int StreamSocket::listen(int /*backlog*/) {
     return 0;
 }
 
+PollQueue* StreamSocket::getPollQueue() {
+    return &pollQueue;
+}
+
 short StreamSocket::poll() {
     AutoLock lock(&socketMutex);
     short result = 0;
@@ -353,29 +369,115 @@ short StreamSocket::poll() {
 }
 
 ssize_t StreamSocket::read(void* buffer, size_t size, int flags) {
-    {
-        AutoLock lock(&socketMutex);
+    if (waitForConnection(flags) < 0) return -1;
+    AutoLock lock(&connectionMutex->mutex);
+    if (waitForData(flags) < 0) return -1;
 
-        while (isConnecting) {
-            if (flags & O_NONBLOCK) {
-                errno = EWOULDBLOCK;
-                return -1;
-            }
+    size_t bytesRead = circularBuffer.read(buffer, size);
 
-            if (kthread_cond_sigwait(&connectCond, &socketMutex) == EINTR) {
-                errno = EINTR;
-                return -1;
-            }
+    if (peer) {
+        kthread_cond_broadcast(&peer->sendCond);
+        peer->pollQueue.notify();
+    }
+    updateTimestamps(true, false, false);
+    return bytesRead;
+}
+
+ssize_t StreamSocket::spliceFromFile(const Reference<Vnode>& file,
+        off_t offset, int fileFlags, size_t size, int flags) {
+    if (waitForConnection(flags) < 0) return -1;
+    AutoLock lock(&connectionMutex->mutex);
+
+    size_t transferred = 0;
+    while (transferred < size) {
+        if (!waitForSpace(flags)) {
+            if (transferred) break;
+            if (errno == EPIPE) raiseSigpipe();
+            return -1;
         }
 
-        if (!isConnected) {
-            errno = ENOTCONN;
+        // The file data is read directly into the receive buffer of the peer.
+        size_t count;
+        char* region = peer->circularBuffer.writeRegion(&count);
+        if (count > size - transferred) count = size - transferred;
+        ssize_t bytesRead = file->pread(region, count, offset + transferred,
+                fileFlags);
+        if (bytesRead < 0) {
+            if (transferred) break;
             return -1;
         }
+        if (bytesRead == 0) break;
+
+        peer->circularBuffer.produce(bytesRead);
+        transferred += bytesRead;
+        kthread_cond_broadcast(&peer->receiveCond);
+        peer->pollQueue.notify();
+        if ((size_t) bytesRead < count) break;
     }
 
+    if (transferred) {
+        updateTimestampsLocked(false, true, true);
+    }
+    return transferred;
+}
+
+ssize_t StreamSocket::spliceToFile(const Reference<Vnode>& file, off_t offset,
+        int fileFlags, size_t size, int flags) {
+    if (waitForConnection(flags) < 0) return -1;
     AutoLock lock(&connectionMutex->mutex);
+    if (waitForData(flags) < 0) return -1;
+
+    // The data is written directly from the receive buffer.
+    size_t transferred = 0;
+    while (transferred < size && circularBuffer.bytesAvailable()) {
+        size_t count;
+        const char* region = circularBuffer.readRegion(&count);
+        if (count > size - transferred) count = size - transferred;
+        ssize_t written = file->pwrite(region, count, offset + transferred,
+                fileFlags);
+        if (written < 0) {
+            if (transferred) break;
+            return -1;
+        }
 
+        circularBuffer.consume(written);
+        transferred += written;
+        if ((size_t) written < count) break;
+    }
+
+    if (transferred && peer) {
+        kthread_cond_broadcast(&peer->sendCond);
+        peer->pollQueue.notify();
+    }
+    updateTimestamps(true, false, false);
+    return transferred;
+}
+
+int StreamSocket::waitForConnection(int flags) {
+    AutoLock lock(&socketMutex);
+
+    while (isConnecting) {
+        if (flags & O_NONBLOCK) {
+            errno = EWOULDBLOCK;
+            return -1;
+        }
+
+        if (kthread_cond_sigwait(&connectCond, &socketMutex) == EINTR) {
+            errno = EINTR;
+            return -1;
+        }
+    }
+
+    if (!isConnected) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    return 0;
+}
+
+// Waits until the receive buffer contains data. The connection mutex must be
+// locked.
+int StreamSocket::waitForData(int flags) {
     while (circularBuffer.bytesAvailable() == 0) {
         if (!peer) {
             errno = ECONNRESET;
@@ -393,71 +495,51 @@ ssize_t StreamSocket::read(void* buffer, size_t size, int flags) {
             return -1;
         }
     }
-
-    size_t bytesRead = circularBuffer.read(buffer, size);
-
-    if (peer) {
-        kthread_cond_broadcast(&peer->sendCond);
-    }
-    updateTimestamps(true, false, false);
-    return bytesRead;
+    return 0;
 }
 
-ssize_t StreamSocket::write(const void* buffer, size_t size, int flags) {
-    {
-        AutoLock lock(&socketMutex);
-
-        while (isConnecting) {
-            if (flags & O_NONBLOCK) {
-                errno = EWOULDBLOCK;
-                return -1;
-            }
-
-            if (kthread_cond_sigwait(&connectCond, &socketMutex) == EINTR) {
-                errno = EINTR;
-                return -1;
-            }
+// Waits until the peer has space in its receive buffer. The connection mutex
+// must be locked.
+bool StreamSocket::waitForSpace(int flags) {
+    while (peer && peer->circularBuffer.spaceAvailable() == 0) {
+        if (flags & O_NONBLOCK) {
+            errno = EWOULDBLOCK;
+            return false;
         }
 
-        if (!isConnected) {
-            errno = ENOTCONN;
-            return -1;
+        if (kthread_cond_sigwait(&sendCond, &connectionMutex->mutex) ==
+                EINTR) {
+            errno = EINTR;
+            return false;
         }
     }
 
+    if (!peer) {
+        errno = EPIPE;
+        return false;
+    }
+    return true;
+}
+
+ssize_t StreamSocket::write(const void* buffer, size_t size, int flags) {
+    if (waitForConnection(flags) < 0) return -1;
     AutoLock lock(&connectionMutex->mutex);
     const char* buf = (const char*) buffer;
     size_t written = 0;
 
     while (written < size) {
-        while (peer && peer->circularBuffer.spaceAvailable() == 0) {
-            if (flags & O_NONBLOCK) {
-                errno = EWOULDBLOCK;
-                return -1;
+        if (!waitForSpace(flags)) {
+            if (written && errno == EINTR) {
+                updateTimestamps(false, true, true);
+                return written;
             }
-
-            if (kthread_cond_sigwait(&sendCond, &connectionMutex->mutex) ==
-                    EINTR) {
-                if (written) {
-                    updateTimestamps(false, true, true);
-                    return written;
-                }
-                errno = EINTR;
-                return -1;
-            }
-        }
-
-        if (!peer) {
-            siginfo_t siginfo = {};
-            siginfo.si_signo = SIGPIPE;
-            siginfo.si_code = SI_KERNEL;
-            Thread::current()->raiseSignal(siginfo);
-            errno = EPIPE;
+            if (errno == EPIPE) raiseSigpipe();
             return -1;
         }
 
         written += peer->circularBuffer.write(buf + written, size - written);
         kthread_cond_broadcast(&peer->receiveCond);
+        peer->pollQueue.notify();
     }
 
     updateTimestampsLocked(false, true, true);
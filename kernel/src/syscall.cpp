@@ -18,6 +18,7 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -26,10 +27,15 @@
 #include <sys/stat.h>
 #include <cobalt/fchownat.h>
 #include <cobalt/fcntl.h>
+#include <cobalt/futex.h>
+#include <cobalt/splice.h>
+#include <cobalt/statmany.h>
 #include <cobalt/wait.h>
 #include <cobalt/kernel/addressspace.h>
 #include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/epoll.h>
 #include <cobalt/kernel/ext234.h>
+#include <cobalt/kernel/futex.h>
 #include <cobalt/kernel/log.h>
 #include <cobalt/kernel/pipe.h>
 #include <cobalt/kernel/process.h>
@@ -37,6 +43,9 @@
 #include <cobalt/kernel/streamsocket.h>
 #include <cobalt/kernel/syscall.h>
 
+// The number of names that fstatat_many looks up at a time.
+#define STAT_MANY_BATCH 64
+
 static const void* syscallList[NUM_SYSCALLS] = {
     /*[SYSCALL_EXIT_THREAD] =*/ (void*) Syscall::exit_thread,
     /*[SYSCALL_WRITE] =*/ (void*) Syscall::write,
@@ -102,6 +111,20 @@ static const void* syscallList[NUM_SYSCALLS] = {
     /*[SYSCALL_FCHOWN] =*/ (void*) Syscall::fchown,
     /*[SYSCALL_SETSID] =*/ (void*) Syscall::setsid,
     /*[SYSCALL_GETPPID] =*/ (void*) Syscall::getppid,
+    /*[SYSCALL_GETPRIORITY] =*/ (void*) Syscall::getpriority,
+    /*[SYSCALL_SETPRIORITY] =*/ (void*) Syscall::setpriority,
+    /*[SYSCALL_GETSCHEDULER] =*/ (void*) Syscall::getscheduler,
+    /*[SYSCALL_SETSCHEDULER] =*/ (void*) Syscall::setscheduler,
+    /*[SYSCALL_EPOLL_CREATE1] =*/ (void*) Syscall::epoll_create1,
+    /*[SYSCALL_EPOLL_CTL] =*/ (void*) Syscall::epoll_ctl,
+    /*[SYSCALL_EPOLL_PWAIT] =*/ (void*) Syscall::epoll_pwait,
+    /*[SYSCALL_SENDFILE] =*/ (void*) Syscall::sendfile,
+    /*[SYSCALL_SPLICE] =*/ (void*) Syscall::splice,
+    /*[SYSCALL_TEE] =*/ (void*) Syscall::tee,
+    /*[SYSCALL_FUTEX] =*/ (void*) Syscall::futex,
+    /*[SYSCALL_WAITID] =*/ (void*) Syscall::waitid,
+    /*[SYSCALL_FSTATAT_MANY] =*/ (void*) Syscall::fstatat_many,
+    /*[SYSCALL_MEMINFO2] =*/ (void*) Syscall::meminfo2,
 };
 
 static Reference<FileDescription> getRootFd(int fd, const char* path) {
@@ -116,6 +139,18 @@ static Reference<FileDescription> getRootFd(int fd, const char* path) {
     }
 }
 
+static bool getEndTime(const struct timespec* timeout,
+        struct timespec* endTime) {
+    if (timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000L) {
+        errno = EINVAL;
+        return false;
+    }
+    struct timespec now;
+    Clock::get(CLOCK_MONOTONIC)->getTime(&now);
+    *endTime = timespecPlus(now, *timeout);
+    return true;
+}
+
 static Reference<Vnode> resolvePathExceptLastComponent(int fd, const char* path,
         const char** lastComponent) {
     Reference<FileDescription> descr = getRootFd(fd, path);
@@ -173,7 +208,11 @@ int Syscall::clock_gettime(clockid_t clockid, struct timespec* result) {
 
 int Syscall::clock_nanosleep(clockid_t clockid, int flags,
         const struct timespec* requested, struct timespec* remaining) {
-    if (clockid == CLOCK_PROCESS_CPUTIME_ID) return errno = EINVAL;
+    // The CPU time of the calling thread does not advance while it sleeps.
+    if (clockid == CLOCK_PROCESS_CPUTIME_ID ||
+            clockid == CLOCK_THREAD_CPUTIME_ID) {
+        return errno = EINVAL;
+    }
 
     if (clockid == CLOCK_REALTIME && !(flags & TIMER_ABSTIME)) {
         clockid = CLOCK_MONOTONIC;
@@ -216,6 +255,72 @@ int Syscall::dup3(int fd1, int fd2, int flags) {
     return Process::current()->dup3(fd1, fd2, flags);
 }
 
+int Syscall::epoll_create1(int flags) {
+    if (flags & ~_EPOLL_FLAGS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Reference<Epoll> epoll = new Epoll();
+    if (!epoll) return -1;
+    Reference<FileDescription> descr = new FileDescription(epoll, O_RDWR);
+    if (!descr) return -1;
+
+    int fdFlags = 0;
+    if (flags & EPOLL_CLOEXEC) fdFlags |= FD_CLOEXEC;
+    if (flags & EPOLL_CLOFORK) fdFlags |= FD_CLOFORK;
+    return Process::current()->addFileDescriptor(descr, fdFlags);
+}
+
+int Syscall::epoll_ctl(int fd, int op, int targetFd,
+        const struct epoll_event* event) {
+    Reference<FileDescription> descr = Process::current()->getFd(fd);
+    if (!descr) return -1;
+    Reference<FileDescription> target = Process::current()->getFd(targetFd);
+    if (!target) return -1;
+
+    Epoll* epoll = Epoll::get(descr->vnode);
+    if (!epoll) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (op != EPOLL_CTL_DEL && !event) {
+        errno = EFAULT;
+        return -1;
+    }
+    return epoll->ctl(op, targetFd, target, event);
+}
+
+int Syscall::epoll_pwait(int fd, struct epoll_event* events, int maxEvents,
+        const struct timespec* timeout, const sigset_t* sigmask) {
+    Reference<FileDescription> descr = Process::current()->getFd(fd);
+    if (!descr) return -1;
+    Epoll* epoll = Epoll::get(descr->vnode);
+    if (!epoll || maxEvents <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct timespec endTime;
+    if (timeout && !getEndTime(timeout, &endTime)) return -1;
+
+    sigset_t oldMask;
+    if (sigmask) {
+        sigprocmask(SIG_SETMASK, sigmask, &oldMask);
+    }
+
+    int result = epoll->wait(events, maxEvents, timeout ? &endTime : nullptr);
+
+    if (sigmask) {
+        if (result < 0) {
+            Thread::current()->returnSignalMask = oldMask;
+        } else {
+            sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+        }
+    }
+    return result;
+}
+
 int Syscall::execve(const char* path, char* const argv[], char* const envp[]) {
     Reference<FileDescription> descr = getRootFd(AT_FDCWD, path);
     Reference<Vnode> vnode = resolvePath(descr->vnode, path);
@@ -344,12 +449,109 @@ int Syscall::fstatat(int fd, const char* restrict path,
     return vnode->stat(result);
 }
 
+int Syscall::fstatat_many(int fd, struct fstatat_entry* entries, size_t count,
+        unsigned int mask, int flags) {
+    if (mask & ~STAT_ALL || flags & ~AT_SYMLINK_NOFOLLOW) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bool followFinalSymlink = !(flags & AT_SYMLINK_NOFOLLOW);
+    Reference<FileDescription> descr = getRootFd(fd, ".");
+    if (!descr) return -1;
+    Reference<Vnode> directory = descr->vnode;
+
+    // Errors of individual entries are not errors of the syscall.
+    int savedErrno = errno;
+    for (size_t first = 0; first < count; first += STAT_MANY_BATCH) {
+        size_t batchSize = count - first < STAT_MANY_BATCH ?
+                count - first : STAT_MANY_BATCH;
+        struct fstatat_entry* batch = entries + first;
+
+        // Plain names are looked up in one pass over the directory. Paths
+        // with multiple components go through the usual path resolution.
+        const char* names[STAT_MANY_BATCH];
+        size_t indices[STAT_MANY_BATCH];
+        size_t numNames = 0;
+        for (size_t i = 0; i < batchSize; i++) {
+            const char* name = batch[i].name;
+            if (*name && !strchr(name, '/')) {
+                names[numNames] = name;
+                indices[numNames] = i;
+                numNames++;
+            }
+        }
+
+        Reference<Vnode> vnodes[STAT_MANY_BATCH];
+        int errors[STAT_MANY_BATCH];
+        directory->getChildNodes(names, numNames, vnodes, errors);
+
+        size_t nextName = 0;
+        for (size_t i = 0; i < batchSize; i++) {
+            Reference<Vnode> vnode;
+            if (nextName < numNames && indices[nextName] == i) {
+                vnode = vnodes[nextName];
+                errno = errors[nextName];
+                nextName++;
+
+                if (vnode && followFinalSymlink &&
+                        S_ISLNK(vnode->stat().st_mode)) {
+                    vnode = resolvePath(directory, batch[i].name);
+                }
+                if (vnode) vnode = vnode->resolve();
+            } else {
+                Reference<FileDescription> startFd =
+                        getRootFd(fd, batch[i].name);
+                vnode = startFd ? resolvePath(startFd->vnode, batch[i].name,
+                        followFinalSymlink) : nullptr;
+            }
+
+            if (!vnode || vnode->statFields(&batch[i].stat, mask) < 0) {
+                batch[i].error = errno;
+            } else {
+                batch[i].error = 0;
+            }
+        }
+    }
+
+    errno = savedErrno;
+    return 0;
+}
+
 int Syscall::ftruncate(int fd, off_t length) {
     Reference<FileDescription> descr = Process::current()->getFd(fd);
     if (!descr) return -1;
     return descr->vnode->ftruncate(length);
 }
 
+int Syscall::futex(int* address, int op, int value,
+        const struct timespec* timeout) {
+    if ((uintptr_t) address % alignof(int) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (op == FUTEX_WAIT) {
+        struct timespec endTime;
+        if (timeout && !getEndTime(timeout, &endTime)) return -1;
+        int result = Futex::wait(address, value, timeout ? &endTime : nullptr);
+        if (result) {
+            errno = result;
+            return -1;
+        }
+        return 0;
+    } else if (op == FUTEX_WAKE) {
+        if (value < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        return Futex::wake(address, value);
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
 int Syscall::futimens(int fd, const struct timespec ts[2]) {
     static struct timespec nullTs[2] = {{ 0, UTIME_NOW }, { 0, UTIME_NOW }};
     if (!ts) {
@@ -401,6 +603,25 @@ pid_t Syscall::getpgid(pid_t pid) {
     return process->pgid;
 }
 
+int Syscall::getpriority(int which, id_t who, int* priority) {
+    if (which == PRIO_PROCESS) {
+        Process* process = who == 0 ? Process::current() : Process::get(who);
+        if (!process) return -1;
+        *priority = process->nice;
+    } else if (which == PRIO_PGRP) {
+        pid_t pgid = who == 0 ? Process::current()->pgid : who;
+        Process* processGroup = Process::getGroup(pgid);
+        if (!processGroup) return -1;
+        *priority = processGroup->getGroupPriority();
+    } else if (which == PRIO_USER) {
+        return Process::getUserPriority(who, priority);
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
 int Syscall::getrusagens(int who, struct rusagens* usage) {
     if (who == RUSAGE_SELF) {
         Process::current()->systemCpuClock.getTime(&usage->ru_stime);
@@ -415,6 +636,18 @@ int Syscall::getrusagens(int who, struct rusagens* usage) {
     return 0;
 }
 
+int Syscall::getscheduler(pid_t pid, struct sched_param* param) {
+    if (pid < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Process* process = pid == 0 ? Process::current() : Process::get(pid);
+    if (!process) return -1;
+    param->sched_priority = process->schedulingPriority;
+    return process->schedulingPolicy;
+}
+
 int Syscall::isatty(int fd) {
     Reference<FileDescription> descr = Process::current()->getFd(fd);
     if (!descr) return 0;
@@ -467,21 +700,34 @@ int Syscall::mkdirat(int fd, const char* path, mode_t mode) {
 }
 
 static void* mmapImplementation(void* /*addr*/, size_t size,
-        int protection, int flags, int /*fd*/, off_t /*offset*/) {
-    if (size == 0 || !(flags & MAP_PRIVATE)) {
+        int protection, int flags, int fd, off_t offset) {
+    if (size == 0 || !(flags & MAP_PRIVATE) == !(flags & MAP_SHARED)) {
         errno = EINVAL;
         return MAP_FAILED;
     }
 
+    AddressSpace* addressSpace = Process::current()->addressSpace;
     if (flags & MAP_ANONYMOUS) {
-        AddressSpace* addressSpace = Process::current()->addressSpace;
+        if (flags & MAP_SHARED) {
+            errno = ENOTSUP;
+            return MAP_FAILED;
+        }
+
         return (void*) addressSpace->mapMemory(ALIGNUP(size, PAGESIZE),
                 protection & _PROT_FLAGS);
     }
 
-    // TODO: Implement other flags than MAP_ANONYMOUS
-    errno = ENOTSUP;
-    return MAP_FAILED;
+    Reference<FileDescription> descr = Process::current()->getFd(fd);
+    if (!descr) return MAP_FAILED;
+
+    size = ALIGNUP(size, PAGESIZE);
+    if (size == 0) {
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    return (void*) descr->mmap(addressSpace, size, protection & _PROT_FLAGS,
+            flags, offset);
 }
 
 void* Syscall::mmap(__mmapRequest* request) {
@@ -584,25 +830,30 @@ int Syscall::pipe2(int fd[2], int flags) {
     return 0;
 }
 
+namespace {
+struct PollFdEntry : public PollWaiter::Entry {
+    Reference<Vnode> vnode;
+};
+}
+
 int Syscall::ppoll(struct pollfd fds[], nfds_t nfds,
         const struct timespec* timeout, const sigset_t* sigmask) {
     struct timespec endTime;
-    if (timeout) {
-        if (timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000L) {
-            errno = EINVAL;
-            return -1;
-        }
-        struct timespec now;
-        Clock::get(CLOCK_MONOTONIC)->getTime(&now);
-        endTime = timespecPlus(now, *timeout);
-    }
+    if (timeout && !getEndTime(timeout, &endTime)) return -1;
+
+    PollFdEntry* entries = new PollFdEntry[nfds];
+    if (nfds && !entries) return -1;
 
     sigset_t oldMask;
     if (sigmask) {
         sigprocmask(SIG_SETMASK, sigmask, &oldMask);
     }
 
+    // The thread is registered in the poll queues of all vnodes before they
+    // are polled so that no event between polling and sleeping can be missed.
+    PollWaiter waiter;
     int events = 0;
+    bool first = true;
     while (true) {
         for (nfds_t i = 0; i < nfds; i++) {
             int fd = fds[i].fd;
@@ -610,44 +861,58 @@ int Syscall::ppoll(struct pollfd fds[], nfds_t nfds,
                 fds[i].revents = 0;
                 continue;
             }
-            Reference<FileDescription> descr = Process::current()->getFd(fd);
-            if (!descr) {
+
+            if (first) {
+                Reference<FileDescription> descr =
+                        Process::current()->getFd(fd);
+                if (descr) {
+                    entries[i].vnode = descr->vnode;
+                    entries[i].waiter = &waiter;
+                    PollQueue* queue = descr->vnode->getPollQueue();
+                    if (queue) {
+                        queue->add(&entries[i]);
+                    }
+                }
+            }
+
+            if (!entries[i].vnode) {
                 fds[i].revents = POLLNVAL;
                 events++;
                 continue;
             }
-            fds[i].revents = descr->vnode->poll() &
+            fds[i].revents = entries[i].vnode->poll() &
                     (fds[i].events | POLLERR | POLLHUP);
             if (fds[i].revents) events++;
         }
-
-        if (events) {
-            if (sigmask) {
-                sigprocmask(SIG_SETMASK, &oldMask, nullptr);
-            }
-            return events;
-        }
-        if (timeout) {
-            struct timespec now;
-            Clock::get(CLOCK_MONOTONIC)->getTime(&now);
-            if (!timespecLess(now, endTime)) {
-                if (sigmask) {
-                    sigprocmask(SIG_SETMASK, &oldMask, nullptr);
-                }
-                return 0;
-            }
+        first = false;
+
+        if (events) break;
+        int error = waiter.wait(timeout ? &endTime : nullptr);
+        if (error == ETIMEDOUT) break;
+        if (error == EINTR) {
+            events = -1;
+            break;
         }
+    }
 
-        if (Signal::isPending()) {
-            if (sigmask) {
-                Thread::current()->returnSignalMask = oldMask;
-            }
-            errno = EINTR;
-            return -1;
+    for (nfds_t i = 0; i < nfds; i++) {
+        if (entries[i].vnode && entries[i].vnode->getPollQueue()) {
+            PollQueue::remove(&entries[i]);
         }
+    }
+    delete[] entries;
 
-        sched_yield();
+    if (sigmask) {
+        if (events < 0) {
+            Thread::current()->returnSignalMask = oldMask;
+        } else {
+            sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+        }
+    }
+    if (events < 0) {
+        errno = EINTR;
     }
+    return events;
 }
 
 ssize_t Syscall::read(int fd, void* buffer, size_t size) {
@@ -711,6 +976,19 @@ int Syscall::renameat(int oldFd, const char* oldPath, int newFd,
     return newDirectory->rename(oldDirectory, oldName, newName);
 }
 
+ssize_t Syscall::sendfile(int outFd, int inFd, off_t* offset, size_t count) {
+    Reference<FileDescription> out = Process::current()->getFd(outFd);
+    if (!out) return -1;
+    Reference<FileDescription> in = Process::current()->getFd(inFd);
+    if (!in) return -1;
+
+    if (!in->vnode->isSeekable()) {
+        errno = EINVAL;
+        return -1;
+    }
+    return in->splice(out, offset, nullptr, count, 0);
+}
+
 int Syscall::setpgid(pid_t pid, pid_t pgid) {
     if (pgid < 0) {
         errno = EINVAL;
@@ -739,6 +1017,70 @@ int Syscall::setpgid(pid_t pid, pid_t pgid) {
     return process->setpgid(pgid);
 }
 
+int Syscall::setpriority(int which, id_t who, int value) {
+    if (value < -NZERO) {
+        value = -NZERO;
+    } else if (value > NZERO - 1) {
+        value = NZERO - 1;
+    }
+
+    if (which == PRIO_PROCESS) {
+        Process* process = who == 0 ? Process::current() : Process::get(who);
+        if (!process) return -1;
+        process->nice = value;
+    } else if (which == PRIO_PGRP) {
+        pid_t pgid = who == 0 ? Process::current()->pgid : who;
+        Process* processGroup = Process::getGroup(pgid);
+        if (!processGroup) return -1;
+        processGroup->setGroupPriority(value);
+    } else if (which == PRIO_USER) {
+        return Process::setUserPriority(who, value);
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int Syscall::setscheduler(pid_t pid, int policy,
+        const struct sched_param* param) {
+    if (pid < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Process* process = pid == 0 ? Process::current() : Process::get(pid);
+    if (!process) return -1;
+
+    // A policy of -1 only changes the priority.
+    int oldPolicy = process->schedulingPolicy;
+    if (policy == -1) {
+        policy = oldPolicy;
+    }
+
+    if (policy == SCHED_OTHER) {
+        if (param->sched_priority != 0) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (param->sched_priority < _SCHED_PRIORITY_MIN ||
+                param->sched_priority > _SCHED_PRIORITY_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Interrupts::disable();
+    process->schedulingPolicy = policy;
+    process->schedulingPriority = param->sched_priority;
+    Interrupts::enable();
+    return oldPolicy;
+}
+
 pid_t Syscall::setsid() {
     return Process::current()->setsid();
 }
@@ -780,6 +1122,28 @@ int Syscall::socket(int domain, int type, int protocol) {
     return Process::current()->addFileDescriptor(descr, fdFlags);
 }
 
+ssize_t Syscall::splice(const struct spliceParams* params) {
+    if (params->flags & ~_SPLICE_FLAGS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Reference<FileDescription> in = Process::current()->getFd(params->fdIn);
+    if (!in) return -1;
+    Reference<FileDescription> out = Process::current()->getFd(params->fdOut);
+    if (!out) return -1;
+
+    if (!S_ISFIFO(in->vnode->stat().st_mode) &&
+            !S_ISFIFO(out->vnode->stat().st_mode)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int flags = params->flags & SPLICE_F_NONBLOCK ? O_NONBLOCK : 0;
+    return in->splice(out, params->offsetIn, params->offsetOut, params->size,
+            flags);
+}
+
 int Syscall::symlinkat(const char* targetPath, int fd, const char* linkPath) {
     const char* name;
     Reference<Vnode> vnode = resolvePathExceptLastComponent(fd, linkPath,
@@ -801,6 +1165,26 @@ int Syscall::tcsetattr(int fd, int flags, const struct termios* termio) {
     return descr->tcsetattr(flags, termio);
 }
 
+ssize_t Syscall::tee(int fdIn, int fdOut, size_t size, unsigned int flags) {
+    if (flags & ~_SPLICE_FLAGS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Reference<FileDescription> in = Process::current()->getFd(fdIn);
+    if (!in) return -1;
+    Reference<FileDescription> out = Process::current()->getFd(fdOut);
+    if (!out) return -1;
+
+    if (!S_ISFIFO(in->vnode->stat().st_mode) ||
+            !S_ISFIFO(out->vnode->stat().st_mode)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return in->tee(out, size, flags & SPLICE_F_NONBLOCK ? O_NONBLOCK : 0);
+}
+
 mode_t Syscall::umask(mode_t newMask) {
     return Process::current()->umask(&newMask);
 }
@@ -864,22 +1248,42 @@ int Syscall::utimensat(int fd, const char* path, const struct timespec ts[2],
     return vnode->utimens(ts[0], ts[1]);
 }
 
+int Syscall::waitid(idtype_t idtype, id_t id, siginfo_t* info, int flags) {
+    siginfo_t siginfo;
+    if (Process::current()->waitid(idtype, id, &siginfo, flags) < 0) {
+        return -1;
+    }
+    if (info) {
+        *info = siginfo;
+    }
+    return 0;
+}
+
 pid_t Syscall::waitpid(pid_t pid, int* status, int flags) {
-    Process* process = Process::current()->waitpid(pid, flags);
+    idtype_t idtype = P_PID;
+    id_t id = pid;
+    if (pid == -1) {
+        idtype = P_ALL;
+    } else if (pid == 0) {
+        idtype = P_PGID;
+        id = Process::current()->pgid;
+    } else if (pid < -1) {
+        idtype = P_PGID;
+        id = -pid;
+    }
 
-    if (!process) {
-        if (errno == 0) return 0;
+    siginfo_t siginfo;
+    if (Process::current()->waitid(idtype, id, &siginfo,
+            flags | WEXITED) < 0) {
         return -1;
     }
+    if (siginfo.si_pid == 0) return 0;
 
-    int reason = (process->terminationStatus.si_code == CLD_EXITED)
-            ? _WEXITED : _WSIGNALED;
+    int reason = (siginfo.si_code == CLD_EXITED) ? _WEXITED : _WSIGNALED;
     if (status) {
-        *status = _WSTATUS(reason, process->terminationStatus.si_status);
+        *status = _WSTATUS(reason, siginfo.si_status);
     }
-    pid_t result = process->pid;
-    delete process;
-    return result;
+    return siginfo.si_pid;
 }
 
 ssize_t Syscall::write(int fd, const void* buffer, size_t size) {
@@ -72,6 +72,7 @@ void Terminal::handleCharacter(char c) {
         } else {
             numEof++;
             kthread_cond_broadcast(&readCond);
+            pollQueue.notify();
         }
     } else if (termio.c_lflag & ICANON && c == termio.c_cc[VERASE]) {
         if (backspace() && (termio.c_lflag & ECHOE)) {
@@ -112,6 +113,10 @@ void Terminal::handleCharacter(char c) {
     }
 }
 
+PollQueue* Terminal::getPollQueue() {
+    return &pollQueue;
+}
+
 void Terminal::hangup() {
     AutoLock lock(&mutex);
 
@@ -127,6 +132,7 @@ void Terminal::hangup() {
 
     hungup = true;
     kthread_cond_broadcast(&readCond);
+    pollQueue.notify();
 }
 
 int Terminal::devctl(int command, void* restrict data, size_t size,
@@ -429,6 +435,7 @@ bool Terminal::backspace() {
     } while (continuationByte && lineIndex != writeIndex);
 
     kthread_cond_broadcast(&writeCond);
+    pollQueue.notify();
     return true;
 }
 
@@ -439,6 +446,7 @@ bool Terminal::canWriteBuffer() {
 void Terminal::endLine() {
     lineIndex = writeIndex;
     kthread_cond_broadcast(&readCond);
+    pollQueue.notify();
 }
 
 bool Terminal::hasIncompleteLine() {
@@ -449,6 +457,7 @@ char Terminal::readBuffer() {
     char result = circularBuffer[readIndex];
     readIndex = (readIndex + 1) % TERMINAL_BUFFER_SIZE;
     kthread_cond_broadcast(&writeCond);
+    pollQueue.notify();
     return result;
 }
 
@@ -457,6 +466,7 @@ void Terminal::resetBuffer() {
     lineIndex = 0;
     writeIndex = 0;
     kthread_cond_broadcast(&writeCond);
+    pollQueue.notify();
 }
 
 void Terminal::writeBuffer(char c) {
@@ -19,15 +19,45 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <sched.h>
 #include <string.h>
 #include <cobalt/kernel/process.h>
 #include <cobalt/kernel/registers.h>
 #include <cobalt/kernel/worker.h>
 
+// Threads with the SCHED_OTHER policy are scheduled by their virtual runtime,
+// which advances more slowly for threads with a lower nice value. Threads with
+// the SCHED_FIFO or SCHED_RR policy always take precedence and are run in the
+// order in which they became runnable.
+
+// A running thread is preempted once its runtime exceeds the runtime of the
+// next thread by this amount.
+#define SCHED_GRANULARITY 3000000 // 3 ms
+// Threads that were blocked get placed this much before the thread with the
+// lowest runtime so that they can run soon after waking up.
+#define SCHED_WAKEUP_BONUS 6000000 // 6 ms
+#define SCHED_RR_INTERVAL 100000000 // 100 ms
+// The timer interrupt is raised at this interval while threads are running.
+// When idle the timer is only needed for timeouts.
+#define SCHED_TICK 1000000 // 1 ms
+#define SCHED_MAX_IDLE 1000000000 // 1 s
+
+// Each nice level changes the share of the CPU by about 10%.
+static const uint32_t niceWeights[2 * NZERO] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+};
+
 Thread* Thread::_current;
 Thread* Thread::idleThread;
 static Thread* firstThread;
+static uint64_t minRuntime;
+static uint64_t realtimeSequence;
+// Blocked threads that will be woken up once their timeout expires.
+static Thread* firstTimedThread;
 
 __fpu_t initFpu;
 
@@ -35,20 +65,29 @@ static int bootErrno;
 extern "C" { int* __errno_location = &bootErrno; }
 
 Thread::Thread(Process* process) {
+    blocked = false;
     contextChanged = false;
     forceKill = false;
+    interruptible = false;
     interruptContext = nullptr;
     kernelStack = 0;
     next = nullptr;
+    nextTimed = nullptr;
     pendingSignals = nullptr;
     prev = nullptr;
+    prevTimed = nullptr;
     this->process = process;
+    runtime = 0;
+    timeSlice = SCHED_RR_INTERVAL;
     returnSignalMask = 0;
     signalMask = 0;
     signalMutex = KTHREAD_MUTEX_INITIALIZER;
     signalCond = KTHREAD_COND_INITIALIZER;
     tid = -1;
     tlsBase = 0;
+    wakeupClock = nullptr;
+    wakeupTime.tv_sec = 0;
+    wakeupTime.tv_nsec = -1;
 }
 
 Thread::~Thread() {
@@ -66,8 +105,31 @@ void Thread::initializeIdleThread() {
     _current = idleThread;
 }
 
+static bool isRealtime(Thread* thread) {
+    return thread->process->schedulingPolicy != SCHED_OTHER;
+}
+
+void Thread::addRuntime(unsigned long nanoseconds) {
+    if (!isRealtime(this)) {
+        int nice = process->nice;
+        runtime += (uint64_t) nanoseconds * niceWeights[NZERO] /
+                niceWeights[nice + NZERO];
+    } else if (process->schedulingPolicy == SCHED_RR) {
+        if (timeSlice > nanoseconds) {
+            timeSlice -= nanoseconds;
+        } else {
+            // Move the thread behind the other threads of the same priority.
+            timeSlice = SCHED_RR_INTERVAL;
+            runtime = ++realtimeSequence;
+        }
+    }
+}
+
 void Thread::addThread(Thread* thread) {
     Interrupts::disable();
+    if (isRealtime(thread)) {
+        thread->runtime = ++realtimeSequence;
+    }
     thread->next = firstThread;
     if (firstThread) {
         firstThread->prev = thread;
@@ -76,6 +138,45 @@ void Thread::addThread(Thread* thread) {
     Interrupts::enable();
 }
 
+void Thread::block(bool interruptible, Clock* clock,
+        const struct timespec* endTime) {
+    // This function needs to be called with interrupts disabled. Callers must
+    // recheck their wakeup condition afterwards because the thread might also
+    // have been woken up by a signal or by the timeout.
+
+    if (_current == idleThread) {
+        // The idle thread must always be runnable.
+        sched_yield();
+        return;
+    }
+
+    removeThread(_current);
+    _current->blocked = true;
+    _current->interruptible = interruptible;
+
+    if (endTime) {
+        _current->wakeupClock = clock;
+        _current->wakeupTime = *endTime;
+        _current->prevTimed = nullptr;
+        _current->nextTimed = firstTimedThread;
+        if (firstTimedThread) {
+            firstTimedThread->prevTimed = _current;
+        }
+        firstTimedThread = _current;
+    }
+
+    sched_yield();
+}
+
+void Thread::interrupt() {
+    bool interruptsEnabled = Interrupts::areEnabled();
+    Interrupts::disable();
+    if (interruptible) {
+        wakeUp();
+    }
+    if (interruptsEnabled) Interrupts::enable();
+}
+
 void Thread::removeThread(Thread* thread) {
     if (thread->prev) {
         thread->prev->next = thread->next;
@@ -88,7 +189,27 @@ void Thread::removeThread(Thread* thread) {
     }
 }
 
-InterruptContext* Thread::schedule(InterruptContext* context) {
+// Returns whether thread1 should run before thread2.
+static bool runsBefore(Thread* thread1, Thread* thread2) {
+    if (isRealtime(thread1) != isRealtime(thread2)) {
+        return isRealtime(thread1);
+    }
+    if (isRealtime(thread1) && thread1->process->schedulingPriority !=
+            thread2->process->schedulingPriority) {
+        return thread1->process->schedulingPriority >
+                thread2->process->schedulingPriority;
+    }
+    return thread1->runtime < thread2->runtime;
+}
+
+static bool shouldPreempt(Thread* current, Thread* thread) {
+    if (!isRealtime(current) && !isRealtime(thread)) {
+        return current->runtime > thread->runtime + SCHED_GRANULARITY;
+    }
+    return runsBefore(thread, current);
+}
+
+InterruptContext* Thread::schedule(InterruptContext* context, bool yield) {
     if (likely(!_current->contextChanged)) {
         _current->interruptContext = context;
         Registers::saveFpu(&_current->fpuEnv);
@@ -97,27 +218,110 @@ InterruptContext* Thread::schedule(InterruptContext* context) {
         _current->contextChanged = false;
     }
 
-    if (_current->next) {
-        _current = _current->next;
-    } else {
-        if (firstThread) {
-            _current = firstThread;
-        } else {
-            _current = idleThread;
+    Clock::onSchedule(context->cs != 0x8);
+
+    // Wake up all threads whose timeout has expired and find out when the
+    // next timeout will expire.
+    uint64_t timeout = Process::checkAlarms();
+    Thread* thread = firstTimedThread;
+    while (thread) {
+        Thread* nextTimed = thread->nextTimed;
+        uint64_t remaining =
+                thread->wakeupClock->nanosecondsUntil(thread->wakeupTime);
+        if (remaining == 0) {
+            thread->wakeUp();
+        } else if (remaining < timeout) {
+            timeout = remaining;
         }
+        thread = nextTimed;
+    }
+
+    if (yield && isRealtime(_current)) {
+        _current->runtime = ++realtimeSequence;
     }
 
+    Thread* best = nullptr;
+    bool currentRunnable = false;
+    for (thread = firstThread; thread; thread = thread->next) {
+        if (thread == _current) {
+            currentRunnable = true;
+            if (yield) continue;
+        }
+
+        if (!isRealtime(thread) && minRuntime > SCHED_WAKEUP_BONUS &&
+                thread->runtime < minRuntime - SCHED_WAKEUP_BONUS) {
+            // The thread has been blocked for a while. Do not let it
+            // monopolize the CPU to make up for that time.
+            thread->runtime = minRuntime - SCHED_WAKEUP_BONUS;
+        }
+
+        if (!best || runsBefore(thread, best)) {
+            best = thread;
+        }
+    }
+
+    if (currentRunnable && (!best || (!yield && !shouldPreempt(_current,
+            best)))) {
+        best = _current;
+    }
+
+    if (best) {
+        _current = best;
+        if (!isRealtime(best) && best->runtime > minRuntime) {
+            minRuntime = best->runtime;
+        }
+    } else {
+        _current = idleThread;
+    }
+
+    if (_current != idleThread && timeout > SCHED_TICK) {
+        timeout = SCHED_TICK;
+    } else if (timeout > SCHED_MAX_IDLE) {
+        timeout = SCHED_MAX_IDLE;
+    }
+    Clock::setTimeout(timeout);
+
     setKernelStack(_current->kernelStack + PAGESIZE);
     Registers::restoreFpu(&_current->fpuEnv);
     setTlsBase(_current->tlsBase);
     __errno_location = &_current->errorNumber;
 
     _current->process->addressSpace->activate();
-    _current->checkSigalarm(true);
     _current->updatePendingSignals();
     return _current->interruptContext;
 }
 
+void Thread::wakeUp() {
+    // This function needs to be called with interrupts disabled.
+    if (!blocked) return;
+
+    if (wakeupTime.tv_nsec != -1) {
+        if (prevTimed) {
+            prevTimed->nextTimed = nextTimed;
+        } else {
+            firstTimedThread = nextTimed;
+        }
+        if (nextTimed) {
+            nextTimed->prevTimed = prevTimed;
+        }
+        wakeupTime.tv_nsec = -1;
+    }
+
+    blocked = false;
+    interruptible = false;
+    if (isRealtime(this)) {
+        runtime = ++realtimeSequence;
+    }
+
+    // Put the thread back on the run queue.
+    prev = nullptr;
+    next = firstThread;
+    if (firstThread) {
+        firstThread->prev = this;
+    }
+    firstThread = this;
+}
+
 static void deleteThread(void* thread) {
     delete (Thread*) thread;
 }
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <cobalt/conf.h>
+#include <cobalt/statmany.h>
 #include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/process.h>
 #include <cobalt/kernel/vnode.h>
@@ -256,6 +257,14 @@ Reference<Vnode> Vnode::getChildNode(const char* /*path*/, size_t /*length*/) {
     return nullptr;
 }
 
+void Vnode::getChildNodes(const char* const* names, size_t count,
+        Reference<Vnode>* results, int* errors) {
+    for (size_t i = 0; i < count; i++) {
+        results[i] = getChildNode(names[i]);
+        errors[i] = results[i] ? 0 : errno;
+    }
+}
+
 size_t Vnode::getDirectoryEntries(void** buffer, int /*flags*/) {
     *buffer = nullptr;
     errno = ENOTDIR;
@@ -267,6 +276,15 @@ char* Vnode::getLinkTarget() {
     return nullptr;
 }
 
+paddr_t Vnode::getMappedPage(size_t /*index*/, bool /*writable*/) {
+    errno = ENODEV;
+    return 0;
+}
+
+PollQueue* Vnode::getPollQueue() {
+    return nullptr;
+}
+
 int Vnode::isatty() {
     errno = ENOTTY;
     return 0;
@@ -296,6 +314,12 @@ int Vnode::mkdir(const char* /*name*/, mode_t /*mode*/) {
     return -1;
 }
 
+vaddr_t Vnode::mmap(AddressSpace* /*addressSpace*/, size_t /*size*/,
+        int /*protection*/, int /*flags*/, off_t /*offset*/) {
+    errno = ENODEV;
+    return 0;
+}
+
 int Vnode::mount(FileSystem* /*filesystem*/) {
     errno = ENOTDIR;
     return -1;
@@ -327,6 +351,11 @@ long Vnode::pathconf(int name) {
     }
 }
 
+ssize_t Vnode::peek(void* /*buffer*/, size_t /*size*/, int /*flags*/) {
+    errno = EINVAL;
+    return -1;
+}
+
 short Vnode::poll() {
     return 0;
 }
@@ -348,6 +377,12 @@ ssize_t Vnode::read(void* /*buffer*/, size_t /*size*/, int /*flags*/) {
     return -1;
 }
 
+ssize_t Vnode::readDirectoryEntries(void* /*buffer*/, size_t /*size*/,
+        off_t* /*offset*/, int /*flags*/) {
+    errno = ENOTSUP;
+    return -1;
+}
+
 ssize_t Vnode::readlink(char* /*buffer*/, size_t /*size*/) {
     errno = EINVAL;
     return -1;
@@ -363,6 +398,18 @@ Reference<Vnode> Vnode::resolve() {
     return this;
 }
 
+ssize_t Vnode::spliceFromFile(const Reference<Vnode>& /*file*/,
+        off_t /*offset*/, int /*fileFlags*/, size_t /*size*/, int /*flags*/) {
+    errno = EBADF;
+    return -1;
+}
+
+ssize_t Vnode::spliceToFile(const Reference<Vnode>& /*file*/,
+        off_t /*offset*/, int /*fileFlags*/, size_t /*size*/, int /*flags*/) {
+    errno = EBADF;
+    return -1;
+}
+
 int Vnode::stat(struct stat* result) {
     AutoLock lock(&mutex);
     *result = stats;
@@ -376,6 +423,38 @@ struct stat Vnode::stat() {
     return result;
 }
 
+int Vnode::statFields(struct stat* result, unsigned int mask) {
+    AutoLock lock(&mutex);
+    if (mask & STAT_MODE) {
+        result->st_mode = stats.st_mode;
+    }
+    if (mask & STAT_INO) {
+        result->st_dev = stats.st_dev;
+        result->st_ino = stats.st_ino;
+    }
+    if (mask & STAT_NLINK) {
+        result->st_nlink = stats.st_nlink;
+    }
+    if (mask & STAT_OWNER) {
+        result->st_uid = stats.st_uid;
+        result->st_gid = stats.st_gid;
+    }
+    if (mask & STAT_RDEV) {
+        result->st_rdev = stats.st_rdev;
+    }
+    if (mask & STAT_SIZE) {
+        result->st_size = stats.st_size;
+        result->st_blksize = stats.st_blksize;
+        result->st_blocks = (stats.st_size + 511) / 512;
+    }
+    if (mask & STAT_TIMES) {
+        result->st_atim = stats.st_atim;
+        result->st_mtim = stats.st_mtim;
+        result->st_ctim = stats.st_ctim;
+    }
+    return 0;
+}
+
 int Vnode::symlink(const char* /*linkTarget*/, const char* /*name*/) {
     errno = ENOTDIR;
     return -1;
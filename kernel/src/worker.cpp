@@ -17,25 +17,61 @@
  * Kernel worker thread.
  */
 
-#include <sched.h>
 #include <cobalt/kernel/addressspace.h>
+#include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/panic.h>
 #include <cobalt/kernel/thread.h>
 #include <cobalt/kernel/worker.h>
 
 static WorkerJob* firstJob;
 static WorkerJob* lastJob;
+static WorkerJob* firstDelayedJob;
+static Thread* workerThread;
+
+static void queueJob(WorkerJob* job) {
+    job->next = nullptr;
+    if (!firstJob) {
+        firstJob = job;
+        lastJob = job;
+    } else {
+        lastJob->next = job;
+        lastJob = job;
+    }
+}
 
 static NORETURN void worker(void) {
+    Clock* clock = Clock::get(CLOCK_MONOTONIC);
+
     while (true) {
         Interrupts::disable();
+
+        // Queue all delayed jobs that are due and find the next one.
+        struct timespec now;
+        clock->getTime(&now);
+        struct timespec nextTime;
+        nextTime.tv_nsec = -1;
+        WorkerJob** link = &firstDelayedJob;
+        while (*link) {
+            WorkerJob* delayed = *link;
+            if (!timespecLess(now, delayed->time)) {
+                *link = delayed->next;
+                queueJob(delayed);
+            } else {
+                if (nextTime.tv_nsec == -1 ||
+                        timespecLess(delayed->time, nextTime)) {
+                    nextTime = delayed->time;
+                }
+                link = &delayed->next;
+            }
+        }
+
         WorkerJob* job = firstJob;
         firstJob = nullptr;
-        Interrupts::enable();
-
         if (!job) {
-            sched_yield();
+            Thread::block(false, clock,
+                    nextTime.tv_nsec == -1 ? nullptr : &nextTime);
         }
+        Interrupts::enable();
 
         while (job) {
             WorkerJob* next = job->next;
@@ -45,16 +81,24 @@ static NORETURN void worker(void) {
     }
 }
 
+void WorkerThread::addDelayedJob(WorkerJob* job, struct timespec time) {
+    // This function needs to be called with interrupts disabled.
+    job->time = time;
+    job->next = firstDelayedJob;
+    firstDelayedJob = job;
+
+    // Wake up the worker so that it recomputes its timeout.
+    if (workerThread) {
+        workerThread->wakeUp();
+    }
+}
+
 void WorkerThread::addJob(WorkerJob* job) {
     // This function needs to be called with interrupts disabled.
+    queueJob(job);
 
-    job->next = nullptr;
-    if (!firstJob) {
-        firstJob = job;
-        lastJob = job;
-    } else {
-        lastJob->next = job;
-        lastJob = job;
+    if (workerThread) {
+        workerThread->wakeUp();
     }
 }
 
@@ -83,5 +127,6 @@ void WorkerThread::initialize() {
 #endif
 
     thread->updateContext(stack, context, &initFpu);
+    workerThread = thread;
     Thread::addThread(thread);
 }
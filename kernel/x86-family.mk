@@ -17,7 +17,8 @@ OBJ += \
 	arch/x86-family/gdt.o \
 	arch/x86-family/idt.o \
 	arch/x86-family/interrupts.o \
-	arch/x86-family/multiboot.o
+	arch/x86-family/multiboot.o \
+	arch/x86-family/smp.o
 
 $(BUILD)/arch/x86-family/idt.cpp: src/arch/x86-family/idt.sh
 	$< > $@
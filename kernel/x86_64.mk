@@ -21,4 +21,5 @@ OBJ += \
 	arch/x86_64/interrupts.o \
 	arch/x86_64/registers.o \
 	arch/x86_64/start.o \
-	arch/x86_64/syscall.o
+	arch/x86_64/syscall.o \
+	arch/x86_64/trampoline.o
@@ -26,35 +26,27 @@ typedef struct __threadStruct* __thread_t;
 
 typedef int __thread_attr_t;
 
-struct __cond_waiter {
-    struct __cond_waiter* __prev;
-    struct __cond_waiter* __next;
-    char __blocked;
-};
-
 typedef struct {
-    struct __cond_waiter* __first;
-    struct __cond_waiter* __last;
+    int __seq;
+    int __waiters;
     __clockid_t __clock;
-    char __state;
 } __cond_t;
 
 typedef int __key_t;
 
 typedef struct {
     char __type;
-    char __state;
+    int __state;
     __pid_t __owner;
     __SIZE_TYPE__ __count;
 } __mutex_t;
 
-typedef unsigned char __once_t;
+typedef int __once_t;
 
 #define _MUTEX_NORMAL 0
 #define _MUTEX_RECURSIVE 1
 
-#define _COND_INIT { (struct __cond_waiter*) 0, (struct __cond_waiter*) 0, \
-        CLOCK_REALTIME, 0 }
+#define _COND_INIT { 0, 0, CLOCK_REALTIME }
 #define _MUTEX_INIT(type) { (type), 0, -1, 0 }
 #define _ONCE_INIT 0
 
@@ -24,11 +24,18 @@
 #define __need_mode_t
 #define __need_off_t
 #define __need_pid_t
+#if __USE_COBALT
+#  define __need_size_t
+#  define __need_ssize_t
+#endif
 #include <bits/types.h>
 #include <bits/stat.h>
 #include <cobalt/fcntl.h>
 #include <cobalt/oflags.h>
 #include <cobalt/seek.h>
+#if __USE_COBALT
+#  include <cobalt/splice.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +46,11 @@ int fcntl(int, int, ...);
 int open(const char*, int, ...);
 int openat(int, const char*, int, ...);
 
+#if __USE_COBALT
+ssize_t splice(int, off_t*, int, off_t*, size_t, unsigned int);
+ssize_t tee(int, int, size_t, unsigned int);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,12 +21,21 @@
 #define _SCHED_H
 
 #include <sys/cdefs.h>
+#define __need_pid_t
+#include <bits/types.h>
+#include <cobalt/sched.h>
 #include <cobalt/timespec.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+int sched_get_priority_max(int);
+int sched_get_priority_min(int);
+int sched_getparam(pid_t, struct sched_param*);
+int sched_getscheduler(pid_t);
+int sched_setparam(pid_t, const struct sched_param*);
+int sched_setscheduler(pid_t, int, const struct sched_param*);
 int sched_yield(void);
 
 #ifdef __cplusplus
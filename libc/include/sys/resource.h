@@ -59,8 +59,10 @@ struct rusage {
     struct timeval ru_stime;
 };
 
+int getpriority(int, id_t);
 int getrlimit(int, struct rlimit*);
 int getrusage(int, struct rusage*);
+int setpriority(int, id_t, int);
 int setrlimit(int, const struct rlimit*);
 
 #if __USE_COBALT
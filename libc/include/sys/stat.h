@@ -31,9 +31,15 @@
 #define __need_off_t
 #define __need_time_t
 #define __need_uid_t
+#if __USE_COBALT
+#  define __need_size_t
+#endif
 #include <bits/types.h>
 #include <bits/stat.h>
 #include <cobalt/stat.h>
+#if __USE_COBALT
+#  include <cobalt/statmany.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +70,10 @@ int stat(const char* __restrict, struct stat* __restrict);
 mode_t umask(mode_t);
 int utimensat(int, const char*, const struct timespec[2], int);
 
+#if __USE_COBALT
+int fstatat_many(int, struct fstatat_entry*, size_t, unsigned int, int);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
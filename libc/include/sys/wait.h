@@ -25,6 +25,7 @@
 #define __need_pid_t
 #define __need_siginfo_t
 #include <bits/types.h>
+#include <cobalt/siginfo.h>
 #include <cobalt/wait.h>
 
 #ifdef __cplusplus
@@ -32,6 +33,7 @@ extern "C" {
 #endif
 
 pid_t wait(int*);
+int waitid(idtype_t, id_t, siginfo_t*, int);
 pid_t waitpid(pid_t, int*, int);
 
 #ifdef __cplusplus
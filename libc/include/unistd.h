@@ -65,7 +65,7 @@ extern "C" {
 #define _POSIX_MONOTONIC_CLOCK _POSIX_VERSION
 #define _POSIX_NO_TRUNC 1
 /* #define _POSIX_PRIORITIZED_IO */
-/* #define _POSIX_PRIORITY_SCHEDULING */
+#define _POSIX_PRIORITY_SCHEDULING _POSIX_VERSION
 /* #define _POSIX_RAW_SOCKETS */
 /* TODO: #define _POSIX_READER_WRITER_LOCKS */
 /* TODO: #define _POSIX_REALTIME_SIGNALS */
@@ -261,6 +261,7 @@ int lchown(const char*, uid_t, gid_t);
 int link(const char*, const char*);
 int linkat(int, const char*, int, const char*, int);
 off_t lseek(int, off_t, int);
+int nice(int);
 long pathconf(const char*, int);
 int pipe(int[2]);
 ssize_t read(int, void*, size_t);
@@ -17,6 +17,7 @@
  * Pathname pattern matching. (POSIX2008)
  */
 
+#define fstatat_many __fstatat_many
 #define reallocarray __reallocarray
 #include <dirent.h>
 #include <errno.h>
@@ -57,6 +58,36 @@ static bool addResult(char* path, glob_t* data, size_t* stringsAllocated) {
     return true;
 }
 
+#define STAT_BATCH 32
+
+// Appends a slash to the paths that name directories. The names are looked up
+// with one syscall for the whole batch.
+static void markDirectories(DIR* dir, char** paths, size_t prefixLength,
+        size_t count) {
+    struct fstatat_entry entries[STAT_BATCH];
+    for (size_t i = 0; i < count; i++) {
+        entries[i].name = paths[i] + prefixLength;
+    }
+
+    if (fstatat_many(dirfd(dir), entries, count, STAT_MODE, 0) < 0) {
+        // Look up the paths one by one so that a failure only affects the
+        // path it occurs for.
+        for (size_t i = 0; i < count; i++) {
+            struct stat st;
+            if (stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+                strcat(paths[i], "/");
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].error == 0 && S_ISDIR(entries[i].stat.st_mode)) {
+            strcat(paths[i], "/");
+        }
+    }
+}
+
 static int globComponent(const char* prefix, const char* pattern, int flags,
         int (*errfunc)(const char*, int), glob_t* data,
         size_t* stringsAllocated) {
@@ -130,6 +161,9 @@ static int globComponent(const char* prefix, const char* pattern, int flags,
             return 0;
         }
 
+        char* unmarkedPaths[STAT_BATCH];
+        size_t numUnmarked = 0;
+
         errno = 0;
         struct dirent* entry = readdir(dir);
         while (entry) {
@@ -149,10 +183,7 @@ static int globComponent(const char* prefix, const char* pattern, int flags,
                             strcat(path, "/");
                         } else if (entry->d_type == DT_UNKNOWN ||
                                 entry->d_type == DT_LNK) {
-                            struct stat st;
-                            if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
-                                strcat(path, "/");
-                            }
+                            unmarkedPaths[numUnmarked++] = path;
                         }
                     }
 
@@ -162,6 +193,12 @@ static int globComponent(const char* prefix, const char* pattern, int flags,
                         free(component);
                         return GLOB_NOSPACE;
                     }
+
+                    if (numUnmarked == STAT_BATCH) {
+                        markDirectories(dir, unmarkedPaths, strlen(prefix),
+                                numUnmarked);
+                        numUnmarked = 0;
+                    }
                 } else {
                     int result = globComponent(path, nextComponent, flags,
                             errfunc, data, stringsAllocated);
@@ -187,6 +224,9 @@ static int globComponent(const char* prefix, const char* pattern, int flags,
             }
         }
 
+        if (numUnmarked > 0) {
+            markDirectories(dir, unmarkedPaths, strlen(prefix), numUnmarked);
+        }
         closedir(dir);
         free(component);
     }
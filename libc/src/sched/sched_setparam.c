@@ -0,0 +1,29 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/sched/sched_setparam.c
+ * Set scheduling parameters. (POSIX2008)
+ */
+
+#include <sched.h>
+#include <sys/syscall.h>
+
+DEFINE_SYSCALL(SYSCALL_SETSCHEDULER, int, sys_setscheduler,
+        (pid_t, int, const struct sched_param*));
+
+int sched_setparam(pid_t pid, const struct sched_param* param) {
+    // A policy of -1 keeps the current policy.
+    return sys_setscheduler(pid, -1, param) < 0 ? -1 : 0;
+}
@@ -22,36 +22,32 @@
 
 void free(void* addr) {
     if (addr == NULL) return;
-    __lockHeap();
 
     Chunk* chunk = (Chunk*) addr - 1;
 
-    assert(chunk->magic == MAGIC_USED_CHUNK);
-
-    chunk->magic = MAGIC_FREE_CHUNK;
-
-    // Unify the chunk with its neighbors if they are free too
-    if (chunk->prev && chunk->prev->magic == MAGIC_FREE_CHUNK) {
-        chunk = __unifyChunks(chunk->prev, chunk);
+    if (chunk->magic == MAGIC_LARGE_CHUNK) {
+        unmapMemory(chunk, chunk->size);
+        return;
     }
 
-    if (chunk->next->magic == MAGIC_FREE_CHUNK) {
-        chunk = __unifyChunks(chunk, chunk->next);
-    }
+    assert(chunk->magic == MAGIC_USED_CHUNK);
+    chunk->magic = MAGIC_FREE_CHUNK;
 
-    if (chunk->prev == NULL && chunk->next->magic == MAGIC_END_CHUNK) {
-        // The whole big chunk is free, so we can unmap it
-        Chunk* bigChunk = chunk - 1;
-        assert(bigChunk->magic == MAGIC_BIG_CHUNK);
-
-        if (bigChunk->prev) {
-            bigChunk->prev->next = bigChunk->next;
-        }
-        if (bigChunk->next) {
-            bigChunk->next->prev = bigChunk->prev;
-        }
-        unmapMemory(bigChunk, bigChunk->size);
+#if __is_cobalt_libc
+    size_t sizeClass = chunk->span->sizeClass;
+    struct ThreadCache* cache = &__threadCache;
+    setNextFree(chunk, cache->chunks[sizeClass]);
+    cache->chunks[sizeClass] = chunk;
+    cache->count[sizeClass]++;
+
+    // Return half of the cached chunks so that they can be used by other
+    // threads.
+    unsigned int limit = getCacheLimit(sizeClass);
+    if (cache->count[sizeClass] > limit) {
+        __flushThreadCache(sizeClass, limit / 2);
     }
-
-    __unlockHeap();
+#else
+    setNextFree(chunk, NULL);
+    __freeChunks(chunk);
+#endif
 }
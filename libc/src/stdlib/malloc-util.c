@@ -21,79 +21,159 @@
 #define pthread_mutex_unlock __mutex_unlock
 #include <assert.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include "malloc.h"
 
-static Chunk emptyBigChunk[2] = {
-    {MAGIC_BIG_CHUNK, sizeof(emptyBigChunk), NULL, NULL},
-    {MAGIC_END_CHUNK, 0, NULL, NULL}
-};
+// Spans are at least this large so that small size classes do not need to map
+// memory often.
+#define SPAN_SIZE (64 * 1024)
+#define SPAN_MIN_CHUNKS 4
 
-Chunk* __firstBigChunk = emptyBigChunk;
+// Spans of each size class that still have free chunks.
+static Span* partialSpans[NUM_SIZE_CLASSES];
 
-Chunk* __allocateBigChunk(Chunk* lastBigChunk, size_t size) {
-    assert(lastBigChunk->magic == MAGIC_BIG_CHUNK);
-
-    size += 3 * sizeof(Chunk);
-    size = alignUp(size, PAGESIZE);
+static bool hasFreeChunks(Span* span) {
+    size_t chunkSize = sizeof(Chunk) + getClassSize(span->sizeClass);
+    return span->freeList ||
+            span->unused + chunkSize <= (char*) span + span->size;
+}
 
-    if (size < 4 * PAGESIZE) {
-        size = 4 * PAGESIZE;
+static void insertSpan(Span* span) {
+    span->prev = NULL;
+    span->next = partialSpans[span->sizeClass];
+    if (span->next) {
+        span->next->prev = span;
     }
+    partialSpans[span->sizeClass] = span;
+}
 
-    Chunk* bigChunk = mapMemory(size);
-
-    if (!bigChunk) return NULL;
-
-    Chunk* chunk = bigChunk + 1;
-    Chunk* endChunk = (Chunk*) ((uintptr_t) bigChunk + size - sizeof(Chunk));
-
-    bigChunk->magic = MAGIC_BIG_CHUNK;
-    bigChunk->size = size;
-    bigChunk->prev = lastBigChunk;
-    bigChunk->next = NULL;
-
-    lastBigChunk->next = bigChunk;
-
-    chunk->magic = MAGIC_FREE_CHUNK;
-    chunk->size = size - 3 * sizeof(Chunk);
-    chunk->prev = NULL;
-    chunk->next = endChunk;
+static void removeSpan(Span* span) {
+    if (span->prev) {
+        span->prev->next = span->next;
+    } else {
+        partialSpans[span->sizeClass] = span->next;
+    }
+    if (span->next) {
+        span->next->prev = span->prev;
+    }
+}
 
-    endChunk->magic = MAGIC_END_CHUNK;
-    endChunk->size = 0;
-    endChunk->prev = chunk;
-    endChunk->next = NULL;
+static Span* allocateSpan(size_t sizeClass) {
+    size_t size = sizeof(Span) +
+            SPAN_MIN_CHUNKS * (sizeof(Chunk) + getClassSize(sizeClass));
+    if (size < SPAN_SIZE) {
+        size = SPAN_SIZE;
+    }
+    size = alignUp(size, PAGESIZE);
 
-    return bigChunk;
+    Span* span = mapMemory(size);
+    if (!span) return NULL;
+
+    span->magic = MAGIC_SPAN;
+    span->sizeClass = sizeClass;
+    span->size = size;
+    span->used = 0;
+    span->unused = (char*) (span + 1);
+    span->freeList = NULL;
+    insertSpan(span);
+    return span;
 }
 
-void __splitChunk(Chunk* chunk, size_t size) {
-    assert(chunk->magic == MAGIC_FREE_CHUNK);
+size_t __allocateChunks(size_t sizeClass, size_t count, Chunk** list) {
+    size_t chunkSize = sizeof(Chunk) + getClassSize(sizeClass);
+    size_t allocated = 0;
+    *list = NULL;
+
+    __lockHeap();
+    while (allocated < count) {
+        Span* span = partialSpans[sizeClass];
+        if (!span) {
+            span = allocateSpan(sizeClass);
+            if (!span) break;
+        }
+
+        while (allocated < count) {
+            Chunk* chunk = span->freeList;
+            if (chunk) {
+                assert(chunk->magic == MAGIC_FREE_CHUNK);
+                span->freeList = getNextFree(chunk);
+            } else if (span->unused + chunkSize <= (char*) span + span->size) {
+                chunk = (Chunk*) span->unused;
+                chunk->span = span;
+                chunk->magic = MAGIC_FREE_CHUNK;
+                span->unused += chunkSize;
+            } else {
+                break;
+            }
+
+            span->used++;
+            setNextFree(chunk, *list);
+            *list = chunk;
+            allocated++;
+        }
+
+        if (!hasFreeChunks(span)) {
+            removeSpan(span);
+        }
+    }
+    __unlockHeap();
 
-    Chunk* newChunk = (Chunk*) ((uintptr_t) chunk + sizeof(Chunk) + size);
-    newChunk->magic = MAGIC_FREE_CHUNK;
-    newChunk->size = chunk->size - sizeof(Chunk) - size;
-    newChunk->prev = chunk;
-    newChunk->next = chunk->next;
+    return allocated;
+}
 
-    chunk->size = size;
-    chunk->next->prev = newChunk;
-    chunk->next = newChunk;
+void __freeChunks(Chunk* list) {
+    __lockHeap();
+    while (list) {
+        Chunk* chunk = list;
+        list = getNextFree(chunk);
+
+        Span* span = chunk->span;
+        assert(span->magic == MAGIC_SPAN);
+        if (!hasFreeChunks(span)) {
+            insertSpan(span);
+        }
+
+        chunk->magic = MAGIC_FREE_CHUNK;
+        setNextFree(chunk, span->freeList);
+        span->freeList = chunk;
+        span->used--;
+
+        // Keep one span per size class around to avoid mapping and unmapping
+        // memory repeatedly.
+        if (span->used == 0 && (span->prev || span->next)) {
+            removeSpan(span);
+            unmapMemory(span, span->size);
+        }
+    }
+    __unlockHeap();
 }
 
-Chunk* __unifyChunks(Chunk* first, Chunk* second) {
-    assert(first->magic == MAGIC_FREE_CHUNK);
-    assert(second->magic == MAGIC_FREE_CHUNK);
+#ifdef __is_cobalt_libc
+__thread struct ThreadCache __threadCache;
+
+void __flushThreadCache(size_t sizeClass, unsigned int count) {
+    struct ThreadCache* cache = &__threadCache;
+    Chunk* list = cache->chunks[sizeClass];
+    Chunk* last = list;
+    for (unsigned int i = 1; i < count; i++) {
+        last = getNextFree(last);
+    }
 
-    first->next = second->next;
-    first->size += sizeof(Chunk) + second->size;
-    second->next->prev = first;
+    cache->chunks[sizeClass] = getNextFree(last);
+    cache->count[sizeClass] -= count;
+    setNextFree(last, NULL);
+    __freeChunks(list);
+}
 
-    return first;
+void __freeThreadCache(void) {
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+        if (__threadCache.count[i]) {
+            __flushThreadCache(i, __threadCache.count[i]);
+        }
+    }
 }
 
-#ifdef __is_cobalt_libc
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void __lockHeap(void) {
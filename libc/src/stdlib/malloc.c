@@ -17,58 +17,58 @@
  * Memory allocation.
  */
 
+#include <assert.h>
 #include <errno.h>
-#include <stdalign.h>
-#include <stddef.h>
+#include <stdint.h>
 #include "malloc.h"
 
-void* malloc(size_t size) {
-    if (size == 0) size = 1;
+static void* allocateLarge(size_t size) {
+    if (size > SIZE_MAX - PAGESIZE - sizeof(Chunk)) {
+        errno = ENOMEM;
+        return NULL;
+    }
 
-    size = alignUp(size, 16);
+    size = alignUp(size + sizeof(Chunk), PAGESIZE);
+    Chunk* chunk = mapMemory(size);
+    if (!chunk) {
+        errno = ENOMEM;
+        return NULL;
+    }
 
-    __lockHeap();
+    chunk->size = size;
+    chunk->magic = MAGIC_LARGE_CHUNK;
+    return chunk + 1;
+}
 
-    Chunk* currentBigChunk = __firstBigChunk;
-    Chunk* currentChunk = currentBigChunk + 1;
+void* malloc(size_t size) {
+    if (size == 0) size = 1;
+    if (size > MAX_SMALL_SIZE) return allocateLarge(size);
+
+    size_t sizeClass = getSizeClass(size);
+    Chunk* chunk;
 
-    while (1) {
-        switch (currentChunk->magic) {
-        case MAGIC_FREE_CHUNK:
-            if (currentChunk->size >= size) {
-                // We found a chunk!
-                if (currentChunk->size > size + sizeof(Chunk)) {
-                    // Split the chunk
-                    __splitChunk(currentChunk, size);
-                }
-                currentChunk->magic = MAGIC_USED_CHUNK;
-                __unlockHeap();
-                return (void*) (currentChunk + 1);
-            } else {
-                currentChunk = currentChunk->next;
-            }
-            break;
-        case MAGIC_USED_CHUNK:
-            currentChunk = currentChunk->next;
-            break;
-        case MAGIC_END_CHUNK:
-            if (currentBigChunk->next) {
-                currentBigChunk = currentBigChunk->next;
-                currentChunk = currentBigChunk + 1;
-            } else {
-                currentBigChunk = __allocateBigChunk(currentBigChunk, size);
-                currentChunk = currentBigChunk + 1;
-                if (!currentBigChunk) {
-                    __unlockHeap();
-                    errno = ENOMEM;
-                    return NULL;
-                }
-            }
-            break;
-        default:
-            // This shouldn't happen!
-            __unlockHeap();
-            abort();
+#if __is_cobalt_libc
+    struct ThreadCache* cache = &__threadCache;
+    if (!cache->chunks[sizeClass]) {
+        cache->count[sizeClass] = __allocateChunks(sizeClass,
+                getCacheLimit(sizeClass) / 2, &cache->chunks[sizeClass]);
+        if (!cache->chunks[sizeClass]) {
+            errno = ENOMEM;
+            return NULL;
         }
     }
+
+    chunk = cache->chunks[sizeClass];
+    cache->chunks[sizeClass] = getNextFree(chunk);
+    cache->count[sizeClass]--;
+#else
+    if (!__allocateChunks(sizeClass, 1, &chunk)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+#endif
+
+    assert(chunk->magic == MAGIC_FREE_CHUNK);
+    chunk->magic = MAGIC_USED_CHUNK;
+    return chunk + 1;
 }
@@ -21,15 +21,21 @@
 #define MALLOC_H
 
 #include <limits.h>
+#include <stdalign.h>
 #include <stdlib.h>
 
 #if __is_cobalt_libc
 #  define mmap __mmap
 #  define munmap __munmap
 #  include <sys/mman.h>
-#  define mapMemory(size) mmap(NULL, size, PROT_READ | PROT_WRITE, \
-        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
 #  define unmapMemory(addr, size) munmap(addr, size)
+
+// Returns NULL on failure like the libk implementation.
+static inline void* mapMemory(size_t size) {
+    void* result = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return result == MAP_FAILED ? NULL : result;
+}
 #else /* if __is_cobalt_libk */
 extern void* __mapMemory(size_t);
 extern void __unmapMemory(void*, size_t);
@@ -38,25 +44,84 @@ extern void __unmapMemory(void*, size_t);
 #  define unmapMemory(addr, size) __unmapMemory(addr, size)
 #endif
 
+// Every allocation is preceded by a chunk header. Small allocations are
+// rounded up to a size class and carved out of spans that only contain chunks
+// of that class. Large allocations are mapped directly.
 typedef struct Chunk {
+    alignas(16) union {
+        struct Span* span; // for small chunks
+        size_t size; // size of the mapping for large chunks
+    };
     size_t magic;
-    size_t size;
-    struct Chunk* prev;
-    struct Chunk* next;
 } Chunk;
 
-#define MAGIC_BIG_CHUNK 0xC001C0DE
+typedef struct Span {
+    size_t magic;
+    size_t sizeClass;
+    size_t size;
+    size_t used;
+    char* unused;
+    Chunk* freeList;
+    struct Span* prev;
+    struct Span* next;
+} Span;
+
+_Static_assert(sizeof(Span) % 16 == 0, "Span has wrong size");
+
+#define MAGIC_SPAN 0xC001C0DE
 #define MAGIC_FREE_CHUNK 0xBEEFBEEF
 #define MAGIC_USED_CHUNK 0xDEADBEEF
-#define MAGIC_END_CHUNK 0xDEADDEAD
+#define MAGIC_LARGE_CHUNK 0xDEADDEAD
 
 #define alignUp(val, alignment) ((((val) - 1) & ~((alignment) - 1)) + (alignment))
 
-extern Chunk* __firstBigChunk;
+// Sizes up to 128 bytes are in steps of 16 bytes, larger sizes have four
+// classes per power of two.
+#define NUM_SIZE_CLASSES 44
+#define MAX_SMALL_SIZE 65536
+
+static inline size_t getSizeClass(size_t size) {
+    if (size <= 128) return (size - 1) / 16;
+    size_t n = size - 1;
+    size_t bits = sizeof(long) * CHAR_BIT - 1 - __builtin_clzl(n);
+    return 8 + (bits - 7) * 4 + ((n >> (bits - 2)) & 3);
+}
+
+static inline size_t getClassSize(size_t sizeClass) {
+    if (sizeClass < 8) return (sizeClass + 1) * 16;
+    size_t bits = 7 + (sizeClass - 8) / 4;
+    return (5 + (sizeClass - 8) % 4) << (bits - 2);
+}
 
-Chunk* __allocateBigChunk(Chunk* lastBigChunk, size_t size);
-void __splitChunk(Chunk* chunk, size_t size);
-Chunk* __unifyChunks(Chunk* first, Chunk* second);
+// Free chunks are linked through their first word of user data.
+static inline Chunk* getNextFree(Chunk* chunk) {
+    return *(Chunk**) (chunk + 1);
+}
+
+static inline void setNextFree(Chunk* chunk, Chunk* next) {
+    *(Chunk**) (chunk + 1) = next;
+}
+
+size_t __allocateChunks(size_t sizeClass, size_t count, Chunk** list);
+void __freeChunks(Chunk* list);
+
+#if __is_cobalt_libc
+// Each thread caches a few free chunks of each size class so that most
+// allocations do not need to take the heap lock.
+struct ThreadCache {
+    Chunk* chunks[NUM_SIZE_CLASSES];
+    unsigned int count[NUM_SIZE_CLASSES];
+};
+
+extern __thread struct ThreadCache __threadCache;
+
+static inline unsigned int getCacheLimit(size_t sizeClass) {
+    size_t limit = 32768 / getClassSize(sizeClass);
+    return limit < 2 ? 2 : limit > 64 ? 64 : limit;
+}
+
+void __flushThreadCache(size_t sizeClass, unsigned int count);
+#endif
 
 void __lockHeap(void);
 void __unlockHeap(void);
@@ -18,69 +18,34 @@
  */
 
 #include <assert.h>
-#include <stdalign.h>
-#include <stddef.h>
-#include <stdint.h>
 #include <string.h>
-#include <sys/types.h>
 #include "malloc.h"
 
-static void changeChunkSize(Chunk* chunk, ssize_t sizeDiff) {
-    Chunk* next = chunk->next;
-
-    Chunk* newNextChunk = (Chunk*) ((uintptr_t) next + sizeDiff);
-    memmove(newNextChunk, next, sizeof(Chunk));
-    chunk->next = newNextChunk;
-
-    chunk->size += sizeDiff;
-    newNextChunk->size -= sizeDiff;
-
-    if (newNextChunk->next) {
-        newNextChunk->next->prev = newNextChunk;
-    }
-}
-
 void* realloc(void* addr, size_t size) {
     if (addr == NULL) return malloc(size);
-
-    __lockHeap();
-
-    Chunk* chunk = (Chunk*) addr - 1;
-    assert(chunk->magic == MAGIC_USED_CHUNK);
-
     if (size == 0) size = 1;
-    size = alignUp(size, 16);
 
-    ssize_t sizeDiff = size - chunk->size;
-
-    Chunk* next = chunk->next;
-
-    if (sizeDiff == 0) {
-        __unlockHeap();
-        return addr;
-    }
-
-    if (next->magic == MAGIC_FREE_CHUNK) {
-        // The next chunk is free so we can move its chunk header freely
-        if ((sizeDiff > 0 && next->size > sizeDiff + sizeof(Chunk)) ||
-                sizeDiff < 0) {
-            changeChunkSize(chunk, sizeDiff);
+    Chunk* chunk = (Chunk*) addr - 1;
+    size_t oldSize;
 
-            __unlockHeap();
+    if (chunk->magic == MAGIC_LARGE_CHUNK) {
+        oldSize = chunk->size - sizeof(Chunk);
+        // Keep the mapping unless it would waste more than half of it.
+        if (size <= oldSize && size > MAX_SMALL_SIZE && size >= oldSize / 2) {
+            return addr;
+        }
+    } else {
+        assert(chunk->magic == MAGIC_USED_CHUNK);
+        size_t sizeClass = chunk->span->sizeClass;
+        oldSize = getClassSize(sizeClass);
+        if (size <= MAX_SMALL_SIZE && getSizeClass(size) == sizeClass) {
             return addr;
         }
     }
 
-    // TODO: If we could not resize the next chunk we could also try to split
-    // or unify chunks to avoid copying.
-
-    __unlockHeap();
-
-    // Create a new chunk and copy the contents to it
     void* newAddress = malloc(size);
     if (!newAddress) return NULL;
-    size_t copySize = sizeDiff < 0 ? size : chunk->size;
-    memcpy(newAddress, addr, copySize);
+    memcpy(newAddress, addr, size < oldSize ? size : oldSize);
     free(addr);
     return newAddress;
 }
@@ -18,9 +18,32 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 void* memchr(const void* s, int c, size_t size) {
     const unsigned char* p = s;
+    while (size > 0 && (uintptr_t) p % sizeof(chunk_t)) {
+        if (*p == (unsigned char) c) return (void*) p;
+        p++;
+        size--;
+    }
+
+#ifdef __SSE2__
+    while (size >= 16) {
+        unsigned int mask = matchBytes(p, c);
+        if (mask) return (void*) (p + __builtin_ctz(mask));
+        p += 16;
+        size -= 16;
+    }
+#else
+    word_t pattern = ONES * (unsigned char) c;
+    while (size >= sizeof(word_t) &&
+            !hasZeroByte(*(const word_t*) p ^ pattern)) {
+        p += sizeof(word_t);
+        size -= sizeof(word_t);
+    }
+#endif
+
     for (size_t i = 0; i < size; i++) {
         if (p[i] == (unsigned char) c) {
             return (void*) &p[i];
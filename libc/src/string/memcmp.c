@@ -18,11 +18,19 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 int memcmp(const void* p1, const void* p2, size_t size) {
     const unsigned char* a = p1;
     const unsigned char* b = p2;
 
+    // Skip over equal words. A differing word is then compared bytewise.
+    while (size >= sizeof(word_t) && *(const word_t*) a == *(const word_t*) b) {
+        a += sizeof(word_t);
+        b += sizeof(word_t);
+        size -= sizeof(word_t);
+    }
+
     for (size_t i = 0; i < size; i++) {
         if (a[i] < b[i]) {
             return -1;
@@ -18,11 +18,33 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 void* memcpy(void* restrict dest, const void* restrict src, size_t size) {
     unsigned char* d = dest;
     const unsigned char* s = src;
 
+#ifdef REP_THRESHOLD
+    if (size >= REP_THRESHOLD) {
+        repMovs(d, s, size);
+        return dest;
+    }
+#endif
+
+    while (size >= sizeof(chunk_t)) {
+        *(chunk_t*) d = *(const chunk_t*) s;
+        d += sizeof(chunk_t);
+        s += sizeof(chunk_t);
+        size -= sizeof(chunk_t);
+    }
+
+    while (size >= sizeof(word_t)) {
+        *(word_t*) d = *(const word_t*) s;
+        d += sizeof(word_t);
+        s += sizeof(word_t);
+        size -= sizeof(word_t);
+    }
+
     for (size_t i = 0; i < size; i++) {
         d[i] = s[i];
     }
@@ -18,16 +18,38 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 void* memmove(void* dest, const void* src, size_t size) {
     unsigned char* d = dest;
     const unsigned char* s = src;
 
+    // Each chunk is loaded completely before it is stored, so copying in the
+    // right direction is safe even if the chunk overlaps itself.
     if (src > dest) {
+#ifdef REP_THRESHOLD
+        if (size >= REP_THRESHOLD) {
+            repMovs(d, s, size);
+            return dest;
+        }
+#endif
+
+        while (size >= sizeof(chunk_t)) {
+            *(chunk_t*) d = *(const chunk_t*) s;
+            d += sizeof(chunk_t);
+            s += sizeof(chunk_t);
+            size -= sizeof(chunk_t);
+        }
+
         for (size_t i = 0; i < size; i++) {
             d[i] = s[i];
         }
     } else {
+        while (size >= sizeof(chunk_t)) {
+            size -= sizeof(chunk_t);
+            *(chunk_t*) (d + size) = *(const chunk_t*) (s + size);
+        }
+
         for (size_t i = size; i > 0; i--) {
             d[i - 1] = s[i - 1];
         }
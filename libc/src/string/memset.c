@@ -18,10 +18,39 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 void* memset(void* dest, int value, size_t size) {
     unsigned char* p = dest;
 
+#ifdef REP_THRESHOLD
+    if (size >= REP_THRESHOLD && hasErms()) {
+        asm volatile("rep stosb" : "+D"(p), "+c"(size) : "a"(value)
+                : "memory");
+        return dest;
+    }
+#endif
+
+    word_t word = (unsigned char) value * ((word_t) -1 / 0xFF);
+#ifdef __SSE2__
+    chunk_t chunk = { 0 };
+    chunk += (unsigned char) value;
+#else
+    chunk_t chunk = word;
+#endif
+
+    while (size >= sizeof(chunk_t)) {
+        *(chunk_t*) p = chunk;
+        p += sizeof(chunk_t);
+        size -= sizeof(chunk_t);
+    }
+
+    while (size >= sizeof(word_t)) {
+        *(word_t*) p = word;
+        p += sizeof(word_t);
+        size -= sizeof(word_t);
+    }
+
     for (size_t i = 0; i < size; i++) {
         p[i] = (unsigned char) value;
     }
@@ -18,13 +18,38 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 char* strchr(const char* s, int c) {
-    do {
-        if (*s == (char) c) {
-            return (char*) s;
+#ifdef __SSE2__
+    size_t misalign = (uintptr_t) s % 16;
+    const char* p = s - misalign;
+    unsigned int mask = (matchBytes(p, c) | matchBytes(p, 0)) >> misalign <<
+            misalign;
+    while (!mask) {
+        p += 16;
+        mask = matchBytes(p, c) | matchBytes(p, 0);
+    }
+    s = p + __builtin_ctz(mask);
+#else
+    while ((uintptr_t) s % sizeof(word_t)) {
+        if (*s == (char) c || !*s) break;
+        s++;
+    }
+
+    if ((uintptr_t) s % sizeof(word_t) == 0) {
+        word_t pattern = ONES * (unsigned char) c;
+        while (true) {
+            word_t word = *(const word_t*) s;
+            if (hasZeroByte(word) || hasZeroByte(word ^ pattern)) break;
+            s += sizeof(word_t);
+        }
+
+        while (*s != (char) c && *s) {
+            s++;
         }
-    } while (*s++);
+    }
+#endif
 
-    return NULL;
+    return *s == (char) c ? (char*) s : NULL;
 }
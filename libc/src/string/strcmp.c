@@ -18,11 +18,29 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 int strcmp(const char* str1, const char* str2) {
     const unsigned char* s1 = (const unsigned char*) str1;
     const unsigned char* s2 = (const unsigned char*) str2;
 
+    if ((uintptr_t) s1 % sizeof(word_t) == (uintptr_t) s2 % sizeof(word_t)) {
+        // Skip over equal words once both strings are aligned. The remaining
+        // bytes are compared below.
+        while ((uintptr_t) s1 % sizeof(word_t) && *s1 && *s1 == *s2) {
+            s1++;
+            s2++;
+        }
+
+        if ((uintptr_t) s1 % sizeof(word_t) == 0) {
+            while (*(const word_t*) s1 == *(const word_t*) s2 &&
+                    !hasZeroByte(*(const word_t*) s1)) {
+                s1 += sizeof(word_t);
+                s2 += sizeof(word_t);
+            }
+        }
+    }
+
     while (*s1 || *s2) {
         if (*s1 < *s2) {
             return -1;
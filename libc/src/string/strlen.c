@@ -18,11 +18,32 @@
  */
 
 #include <string.h>
+#include "word.h"
 
 size_t strlen(const char* s) {
-    size_t result = 0;
-    while (*s++) {
-        result++;
+#ifdef __SSE2__
+    size_t misalign = (uintptr_t) s % 16;
+    const char* p = s - misalign;
+    unsigned int mask = matchBytes(p, 0) >> misalign << misalign;
+    while (!mask) {
+        p += 16;
+        mask = matchBytes(p, 0);
     }
-    return result;
+    return p + __builtin_ctz(mask) - s;
+#else
+    const char* p = s;
+    while ((uintptr_t) p % sizeof(word_t)) {
+        if (!*p) return p - s;
+        p++;
+    }
+
+    while (!hasZeroByte(*(const word_t*) p)) {
+        p += sizeof(word_t);
+    }
+
+    while (*p) {
+        p++;
+    }
+    return p - s;
+#endif
 }
@@ -17,17 +17,128 @@
  * Find a substring.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
-char* strstr(const char* haystack, const char* needle) {
-    // TODO: This is a very inefficient implementation.
-    size_t needleLength = strlen(needle);
+// This is the Two-Way string matching algorithm by Crochemore and Perrin. It
+// runs in linear time and constant space.
+
+static size_t maximalSuffix(const unsigned char* needle, size_t length,
+        bool reversed, size_t* period) {
+    // Returns the start of the maximal suffix of the needle with respect to
+    // the (possibly reversed) byte order and the period of that suffix.
+    size_t suffix = 0;
+    size_t candidate = 1;
+    size_t offset = 0;
+    *period = 1;
+
+    while (candidate + offset < length) {
+        unsigned char a = needle[candidate + offset];
+        unsigned char b = needle[suffix + offset];
+        if (a == b) {
+            if (offset + 1 == *period) {
+                candidate += *period;
+                offset = 0;
+            } else {
+                offset++;
+            }
+        } else if ((a < b) != reversed) {
+            candidate += offset + 1;
+            offset = 0;
+            *period = candidate - suffix;
+        } else {
+            suffix = candidate++;
+            offset = 0;
+            *period = 1;
+        }
+    }
+
+    return suffix;
+}
+
+static char* twoWay(const unsigned char* haystack,
+        const unsigned char* needle, size_t length) {
+    // Split the needle into a left and a right part at the critical
+    // factorization.
+    size_t period;
+    size_t reversedPeriod;
+    size_t split = maximalSuffix(needle, length, false, &period);
+    size_t reversedSplit = maximalSuffix(needle, length, true,
+            &reversedPeriod);
+    if (reversedSplit > split) {
+        split = reversedSplit;
+        period = reversedPeriod;
+    }
+
+    // For periodic needles the matched prefix of one period is remembered so
+    // that it does not need to be compared again.
+    bool periodic = memcmp(needle, needle + period, split) == 0;
+    if (!periodic) {
+        period = (split > length - split ? split : length - split) + 1;
+    }
+
+    // Bytes that occur in the needle.
+    uint32_t byteSet[256 / 32] = {0};
+    for (size_t i = 0; i < length; i++) {
+        byteSet[needle[i] / 32] |= 1U << (needle[i] % 32);
+    }
+
+    size_t memory = 0;
+    // The haystack is known not to end before this position.
+    const unsigned char* end = haystack;
+
+    while (true) {
+        if ((size_t) (end - haystack) < length) {
+            size_t grow = length | 63;
+            const unsigned char* terminator = memchr(end, '\0', grow);
+            if (terminator) {
+                end = terminator;
+                if ((size_t) (end - haystack) < length) return NULL;
+            } else {
+                end += grow;
+            }
+        }
+
+        // If the last byte of the window does not occur in the needle, the
+        // needle cannot match anywhere in the window.
+        unsigned char last = haystack[length - 1];
+        if (!(byteSet[last / 32] & (1U << (last % 32)))) {
+            haystack += length;
+            memory = 0;
+            continue;
+        }
+
+        // Compare the right part.
+        size_t i = split > memory ? split : memory;
+        while (i < length && needle[i] == haystack[i]) {
+            i++;
+        }
+        if (i < length) {
+            haystack += i - split + 1;
+            memory = 0;
+            continue;
+        }
 
-    do {
-        if (strncmp(haystack, needle, needleLength) == 0) {
-            return (char*) haystack;
+        // Compare the left part.
+        i = split;
+        while (i > memory && needle[i - 1] == haystack[i - 1]) {
+            i--;
         }
-    } while (*haystack++);
+        if (i <= memory) return (char*) haystack;
+
+        haystack += period;
+        memory = periodic ? length - period : 0;
+    }
+}
+
+char* strstr(const char* haystack, const char* needle) {
+    if (!*needle) return (char*) haystack;
+
+    haystack = strchr(haystack, *needle);
+    if (!haystack || !needle[1]) return (char*) haystack;
 
-    return NULL;
+    size_t length = strlen(needle);
+    return twoWay((const unsigned char*) haystack,
+            (const unsigned char*) needle, length);
 }
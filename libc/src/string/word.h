@@ -0,0 +1,97 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/string/word.h
+ * Helpers for accessing memory in larger units than bytes.
+ */
+
+#ifndef STRING_WORD_H
+#define STRING_WORD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// These types may alias any object and may be unaligned.
+typedef size_t __attribute__((__may_alias__, __aligned__(1))) word_t;
+#ifdef __SSE2__
+typedef char __attribute__((__vector_size__(16), __may_alias__,
+        __aligned__(1))) chunk_t;
+#else
+typedef word_t chunk_t;
+#endif
+
+#define ONES ((word_t) -1 / 0xFF)
+#define HIGHS (ONES * 0x80)
+
+// Aligned loads never cross a page boundary, so string functions may read
+// the whole aligned word or chunk containing the terminating byte.
+static inline bool hasZeroByte(word_t word) {
+    return (word - ONES) & ~word & HIGHS;
+}
+
+#ifdef __SSE2__
+typedef char __attribute__((__vector_size__(16))) vector_t;
+
+// Returns a mask of the bytes in the aligned 16 bytes at p that equal c.
+static inline unsigned int matchBytes(const void* p, char c) {
+    vector_t chunk = *(const vector_t*) p;
+    vector_t pattern = c - (vector_t) {};
+    return __builtin_ia32_pmovmskb128((vector_t) (chunk == pattern));
+}
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+// Above this size the string instructions are faster than a loop.
+#  define REP_THRESHOLD 1024
+
+static inline bool hasErms(void) {
+    // Enhanced rep movsb/stosb is reported by cpuid leaf 7.
+    static int erms = -1;
+    if (erms < 0) {
+        unsigned int eax = 0;
+        unsigned int ebx = 0;
+        unsigned int ecx = 0;
+        asm("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx) :: "edx");
+        if (eax >= 7) {
+            eax = 7;
+            ecx = 0;
+            asm("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx) :: "edx");
+            erms = !!(ebx & (1 << 9));
+        } else {
+            erms = 0;
+        }
+    }
+    return erms;
+}
+
+static inline void repMovs(unsigned char* dest, const unsigned char* src,
+        size_t size) {
+    if (!hasErms()) {
+        size_t words = size / sizeof(size_t);
+#  ifdef __x86_64__
+        asm volatile("rep movsq" : "+D"(dest), "+S"(src), "+c"(words)
+                :: "memory");
+#  else
+        asm volatile("rep movsl" : "+D"(dest), "+S"(src), "+c"(words)
+                :: "memory");
+#  endif
+        size %= sizeof(size_t);
+    }
+    asm volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(size) :: "memory");
+}
+#endif
+
+#endif
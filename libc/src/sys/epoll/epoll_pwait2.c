@@ -0,0 +1,26 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/sys/epoll/epoll_pwait2.c
+ * Wait for events on an epoll instance.
+ */
+
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+DEFINE_SYSCALL_GLOBAL(SYSCALL_EPOLL_PWAIT, int, __epoll_pwait2,
+        (int, struct epoll_event*, int, const struct timespec*,
+        const sigset_t*));
+DEFINE_SYSCALL_WEAK_ALIAS(__epoll_pwait2, epoll_pwait2);
@@ -0,0 +1,30 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/sys/resource/getpriority.c
+ * Get the nice value. (POSIX2008)
+ */
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+DEFINE_SYSCALL(SYSCALL_GETPRIORITY, int, sys_getpriority, (int, id_t, int*));
+
+int getpriority(int which, id_t who) {
+    // The syscall returns the value separately because -1 is a valid result.
+    int priority;
+    if (sys_getpriority(which, who, &priority) < 0) return -1;
+    return priority;
+}
@@ -17,22 +17,38 @@
  * One-time initialization. (C11, called from POSIX2008)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
+#include <limits.h>
 #include <stdbool.h>
 
+// Once states
+#define ONCE_INIT 0
+#define ONCE_RUNNING 1
+#define ONCE_DONE 2
+#define ONCE_WAITING 3 // Running and other threads are waiting.
+
 void __call_once(__once_t* once, void (*func)(void)) {
-    if (__atomic_load_n(once, __ATOMIC_ACQUIRE) < 2) {
-        unsigned char expected = 0;
-        if (__atomic_compare_exchange_n(once, &expected, 1, false,
-                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
-            func();
-            __atomic_store_n(once, 2, __ATOMIC_RELEASE);
-        } else {
-            while (__atomic_load_n(once, __ATOMIC_ACQUIRE) == 1) {
-                sched_yield();
-            }
+    if (__atomic_load_n(once, __ATOMIC_ACQUIRE) == ONCE_DONE) return;
+
+    int expected = ONCE_INIT;
+    if (__atomic_compare_exchange_n(once, &expected, ONCE_RUNNING, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        func();
+        if (__atomic_exchange_n(once, ONCE_DONE, __ATOMIC_RELEASE) ==
+                ONCE_WAITING) {
+            __futexWake(once, INT_MAX);
+        }
+        return;
+    }
+
+    while (expected != ONCE_DONE) {
+        if (expected == ONCE_RUNNING && !__atomic_compare_exchange_n(once,
+                &expected, ONCE_WAITING, false, __ATOMIC_ACQUIRE,
+                __ATOMIC_ACQUIRE)) {
+            continue;
         }
+        __futexWait(once, ONCE_WAITING, CLOCK_MONOTONIC, NULL);
+        expected = __atomic_load_n(once, __ATOMIC_ACQUIRE);
     }
 }
 __weak_alias(__call_once, call_once);
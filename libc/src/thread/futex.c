@@ -0,0 +1,59 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/thread/futex.c
+ * Futex helpers.
+ */
+
+#define clock_gettime __clock_gettime
+#include "thread.h"
+#include <cobalt/futex.h>
+#include <sys/syscall.h>
+
+DEFINE_SYSCALL(SYSCALL_FUTEX, int, futex, (int*, int, int,
+        const struct timespec*));
+
+int __futexWait(int* address, int value, clockid_t clock,
+        const struct timespec* abstime) {
+    struct timespec timeout;
+    if (abstime) {
+        struct timespec now;
+        clock_gettime(clock, &now);
+        timeout.tv_sec = abstime->tv_sec - now.tv_sec;
+        timeout.tv_nsec = abstime->tv_nsec - now.tv_nsec;
+        if (timeout.tv_nsec < 0) {
+            timeout.tv_sec--;
+            timeout.tv_nsec += 1000000000;
+        }
+        if (timeout.tv_sec < 0) return ETIMEDOUT;
+    }
+
+    // Being woken up, interrupted or finding a different value are all
+    // treated as spurious wakeups, the caller needs to check its condition.
+    int oldErrno = errno;
+    int result = 0;
+    if (futex(address, FUTEX_WAIT, value, abstime ? &timeout : NULL) < 0 &&
+            errno == ETIMEDOUT) {
+        result = ETIMEDOUT;
+    }
+    errno = oldErrno;
+    return result;
+}
+
+void __futexWake(int* address, int count) {
+    int oldErrno = errno;
+    futex(address, FUTEX_WAKE, count, NULL);
+    errno = oldErrno;
+}
@@ -17,22 +17,14 @@
  * Broadcast a condition variable. (POSIX2008, called from C11)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
+#include <limits.h>
 
 int __cond_broadcast(__cond_t* cond) {
-    while (__atomic_test_and_set(&cond->__state, __ATOMIC_ACQUIRE)) {
-        sched_yield();
-    }
+    if (__atomic_load_n(&cond->__waiters, __ATOMIC_RELAXED) == 0) return 0;
 
-    while (cond->__first) {
-        struct __cond_waiter* waiter = cond->__first;
-        cond->__first = waiter->__next;
-        __atomic_store_n(&waiter->__blocked, 0, __ATOMIC_RELEASE);
-    }
-    cond->__last = NULL;
-
-    __atomic_clear(&cond->__state, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&cond->__seq, 1, __ATOMIC_RELEASE);
+    __futexWake(&cond->__seq, INT_MAX);
     return 0;
 }
 __weak_alias(__cond_broadcast, pthread_cond_broadcast);
@@ -17,16 +17,7 @@
  * Wait on a condition variable for a given time. (called from C11)
  */
 
-#define clock_gettime __clock_gettime
-#define sched_yield __sched_yield
 #include "thread.h"
-#include <stdbool.h>
-
-static bool timespecLess(struct timespec ts1, struct timespec ts2) {
-    if (ts1.tv_sec < ts2.tv_sec) return true;
-    if (ts1.tv_sec > ts2.tv_sec) return false;
-    return ts1.tv_nsec < ts2.tv_nsec;
-}
 
 int __cond_clockwait(__cond_t* restrict cond, __mutex_t* restrict mutex,
         clockid_t clock, const struct timespec* restrict abstime) {
@@ -39,63 +30,15 @@ int __cond_clockwait(__cond_t* restrict cond, __mutex_t* restrict mutex,
         }
     }
 
-    while (__atomic_test_and_set(&cond->__state, __ATOMIC_ACQUIRE)) {
-        sched_yield();
-    }
+    // The sequence number is read while holding the mutex, so any signal
+    // sent after we unlock it changes the value and the wait returns
+    // immediately.
+    __atomic_fetch_add(&cond->__waiters, 1, __ATOMIC_RELAXED);
+    int seq = __atomic_load_n(&cond->__seq, __ATOMIC_ACQUIRE);
 
     __mutex_unlock(mutex);
-
-    struct __cond_waiter waiter;
-    waiter.__prev = cond->__last;
-    waiter.__next = NULL;
-    waiter.__blocked = 1;
-    if (cond->__last) {
-        cond->__last->__next = &waiter;
-    } else {
-        cond->__first = &waiter;
-    }
-    cond->__last = &waiter;
-
-    __atomic_clear(&cond->__state, __ATOMIC_RELEASE);
-
-    int result = 0;
-    while (__atomic_load_n(&waiter.__blocked, __ATOMIC_ACQUIRE)) {
-        if (abstime) {
-            struct timespec now;
-            clock_gettime(clock, &now);
-
-            if (!timespecLess(now, *abstime)) {
-                result = ETIMEDOUT;
-                break;
-            }
-        }
-
-        sched_yield();
-    }
-
-    if (result) {
-        while (__atomic_test_and_set(&cond->__state, __ATOMIC_ACQUIRE)) {
-            sched_yield();
-        }
-
-        // Only remove the waiter from the list if we were not unblocked
-        // concurrently. In that case the waiter was already removed.
-        if (__atomic_load_n(&waiter.__blocked, __ATOMIC_RELAXED)) {
-            if (waiter.__prev) {
-                waiter.__prev->__next = waiter.__next;
-            } else {
-                cond->__first = waiter.__next;
-            }
-            if (waiter.__next) {
-                waiter.__next->__prev = waiter.__prev;
-            } else {
-                cond->__last = waiter.__prev;
-            }
-        }
-
-        __atomic_clear(&cond->__state, __ATOMIC_RELEASE);
-    }
-
+    int result = __futexWait(&cond->__seq, seq, clock, abstime);
+    __atomic_fetch_sub(&cond->__waiters, 1, __ATOMIC_RELAXED);
     __mutex_lock(mutex);
     return result;
 }
@@ -21,9 +21,8 @@
 
 int pthread_cond_init(pthread_cond_t* restrict cond,
         const pthread_condattr_t* restrict attr) {
-    cond->__first = NULL;
-    cond->__last = NULL;
+    cond->__seq = 0;
+    cond->__waiters = 0;
     cond->__clock = attr ? *attr : CLOCK_REALTIME;
-    cond->__state = 0;
     return 0;
 }
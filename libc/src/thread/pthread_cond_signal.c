@@ -17,26 +17,13 @@
  * Signal a condition variable. (POSIX2008, called from C11)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
 
 int __cond_signal(__cond_t* cond) {
-    while (__atomic_test_and_set(&cond->__state, __ATOMIC_ACQUIRE)) {
-        sched_yield();
-    }
+    if (__atomic_load_n(&cond->__waiters, __ATOMIC_RELAXED) == 0) return 0;
 
-    if (cond->__first) {
-        struct __cond_waiter* waiter = cond->__first;
-        cond->__first = waiter->__next;
-        __atomic_store_n(&waiter->__blocked, 0, __ATOMIC_RELEASE);
-    }
-    if (cond->__first) {
-        cond->__first->__prev = NULL;
-    } else {
-        cond->__last = NULL;
-    }
-
-    __atomic_clear(&cond->__state, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&cond->__seq, 1, __ATOMIC_RELEASE);
+    __futexWake(&cond->__seq, 1);
     return 0;
 }
 __weak_alias(__cond_signal, pthread_cond_signal);
@@ -21,7 +21,6 @@
 #define munmap __munmap
 #define pthread_exit __pthread_exit
 #define regfork __regfork
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <limits.h>
 #include <stdint.h>
@@ -135,6 +134,7 @@ int __thread_create(__thread_t* restrict thread,
 
     thr->uthread.tid = tid;
     __atomic_store_n(&thr->state, JOINABLE, __ATOMIC_RELEASE);
+    __futexWake(&thr->state, 1);
     *thread = thr;
     return 0;
 }
@@ -142,7 +142,7 @@ int __thread_create(__thread_t* restrict thread,
 static noreturn void wrapperFunc(void* (*func)(void*), void* arg) {
     __thread_t self = __thread_self();
     while (__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) == PREPARING) {
-        sched_yield();
+        __futexWait(&self->state, PREPARING, CLOCK_MONOTONIC, NULL);
     }
     pthread_exit(func(arg));
 }
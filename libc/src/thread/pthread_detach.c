@@ -24,7 +24,7 @@
 #include <sys/mman.h>
 
 int __thread_detach(__thread_t thread) {
-    char expected = JOINABLE;
+    int expected = JOINABLE;
     if (__atomic_compare_exchange_n(&thread->state, &expected, DETACHED,
             false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
         return 0;
@@ -19,6 +19,7 @@
 
 #define munmap __munmap
 #include "thread.h"
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <cobalt/exit.h>
@@ -31,10 +32,14 @@ DEFINE_SYSCALL(SYSCALL_EXIT_THREAD, __noreturn void, exit_thread,
 __attribute__((weak))
 void __key_run_destructors(void) {}
 
+__attribute__((weak))
+void __freeThreadCache(void) {}
+
 __noreturn void __thread_exit(union ThreadResult result) {
     __thread_t self = __thread_self();
 
     __key_run_destructors();
+    __freeThreadCache();
 
     __mutex_lock(&__threadListMutex);
     if (self->next) {
@@ -55,11 +60,13 @@ __noreturn void __thread_exit(union ThreadResult result) {
     data.unmapAddress = self->uthread.stack;
     data.unmapSize = self->uthread.stackSize;
 
-    char state = JOINABLE;
+    int state = JOINABLE;
     if (__atomic_compare_exchange_n(&self->state, &state, EXITED,
             false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
         // We can be joined by another thread. That thread will cleanup our TLS
-        // copy.
+        // copy. The kernel does not access the address when waking, so it does
+        // not matter if the joining thread has already unmapped it.
+        __futexWake(&self->state, INT_MAX);
     } else if (state == DETACHED) {
         munmap(self->uthread.tlsCopy, self->mappingSize);
     } else {
@@ -18,14 +18,13 @@
  */
 
 #define munmap __munmap
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 
 int __thread_join(__thread_t thread, union ThreadResult* result) {
-    char expected = EXITED;
+    int expected = EXITED;
     while (!__atomic_compare_exchange_n(&thread->state, &expected, JOINED,
             false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
         if (expected == DETACHED) {
@@ -33,7 +32,7 @@ int __thread_join(__thread_t thread, union ThreadResult* result) {
         } else if (expected != JOINABLE) {
             abort();
         }
-        sched_yield();
+        __futexWait(&thread->state, JOINABLE, CLOCK_MONOTONIC, NULL);
         expected = EXITED;
     }
 
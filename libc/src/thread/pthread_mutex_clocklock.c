@@ -17,33 +17,38 @@
  * Try to lock a mutex within a given time. (called from C11)
  */
 
-#define clock_gettime __clock_gettime
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <stdbool.h>
 
-static bool timespecLess(struct timespec ts1, struct timespec ts2) {
-    if (ts1.tv_sec < ts2.tv_sec) return true;
-    if (ts1.tv_sec > ts2.tv_sec) return false;
-    return ts1.tv_nsec < ts2.tv_nsec;
-}
-
 int __mutex_clocklock(__mutex_t* restrict mutex, clockid_t clock,
         const struct timespec* restrict abstime) {
-    while (true) {
-        int result = __mutex_trylock(mutex);
-        if (result != EBUSY) return result;
+    int result = __mutex_trylock(mutex);
+    if (result != EBUSY) return result;
 
+    if (abstime) {
+        if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC) {
+            return EINVAL;
+        }
         if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000) {
             return EINVAL;
         }
-        struct timespec now;
-        if (clock_gettime(clock, &now) != 0) return EINVAL;
-        if (!timespecLess(now, *abstime)) {
+    }
+
+    // Mark the mutex as contended so that the thread unlocking it will wake
+    // us up. If the mutex was unlocked in the meantime we now own it.
+    while (__atomic_exchange_n(&mutex->__state, CONTENDED,
+            __ATOMIC_ACQUIRE) != UNLOCKED) {
+        if (__futexWait(&mutex->__state, CONTENDED, clock, abstime) ==
+                ETIMEDOUT) {
             return ETIMEDOUT;
         }
+    }
 
-        sched_yield();
+    if (mutex->__type == _MUTEX_RECURSIVE) {
+        __atomic_store_n(&mutex->__owner, __thread_self()->uthread.tid,
+                __ATOMIC_RELAXED);
+        mutex->__count = 1;
     }
+    return 0;
 }
 __weak_alias(__mutex_clocklock, pthread_mutex_clocklock);
@@ -17,16 +17,9 @@
  * Lock a mutex. (POSIX2008, called from C89)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
-#include <stdbool.h>
 
 int __mutex_lock(__mutex_t* mutex) {
-    int result;
-    while (true) {
-        result = __mutex_trylock(mutex);
-        if (result != EBUSY) return result;
-        sched_yield();
-    }
+    return __mutex_clocklock(mutex, CLOCK_REALTIME, NULL);
 }
 __weak_alias(__mutex_lock, pthread_mutex_lock);
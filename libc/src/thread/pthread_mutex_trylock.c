@@ -17,49 +17,37 @@
  * Try to lock a mutex. (POSIX2008, called from C89)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 int __mutex_trylock(__mutex_t* mutex) {
     if (mutex->__type == _MUTEX_NORMAL) {
-        if (__atomic_test_and_set(&mutex->__state, __ATOMIC_ACQUIRE)) {
+        int expected = UNLOCKED;
+        if (!__atomic_compare_exchange_n(&mutex->__state, &expected, LOCKED,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
             return EBUSY;
         }
         return 0;
     } else if (mutex->__type == _MUTEX_RECURSIVE) {
         pid_t tid = __thread_self()->uthread.tid;
 
-        while (true) {
-            int expected = UNLOCKED;
-            if (__atomic_compare_exchange_n(&mutex->__state, &expected, BUSY,
-                    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
-                mutex->__owner = tid;
-                mutex->__count = 1;
-                __atomic_store_n(&mutex->__state, LOCKED, __ATOMIC_RELEASE);
-                return 0;
-            }
-
-            expected = LOCKED;
-            if (__atomic_compare_exchange_n(&mutex->__state, &expected, BUSY,
-                    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
-                if (mutex->__owner == tid) {
-                    if (mutex->__count == SIZE_MAX) {
-                        __atomic_store_n(&mutex->__state, LOCKED,
-                                __ATOMIC_RELAXED);
-                        return EAGAIN;
-                    }
-                    mutex->__count++;
-                    __atomic_store_n(&mutex->__state, LOCKED, __ATOMIC_RELEASE);
-                    return 0;
-                }
-                __atomic_store_n(&mutex->__state, LOCKED, __ATOMIC_RELAXED);
-                return EBUSY;
-            }
+        // Only the owner can observe its own tid as the owner, so the count
+        // does not need to be updated atomically.
+        if (__atomic_load_n(&mutex->__owner, __ATOMIC_RELAXED) == tid) {
+            if (mutex->__count == SIZE_MAX) return EAGAIN;
+            mutex->__count++;
+            return 0;
+        }
 
-            sched_yield();
+        int expected = UNLOCKED;
+        if (!__atomic_compare_exchange_n(&mutex->__state, &expected, LOCKED,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return EBUSY;
         }
+        __atomic_store_n(&mutex->__owner, tid, __ATOMIC_RELAXED);
+        mutex->__count = 1;
+        return 0;
     }
 
     return EINVAL;
@@ -17,42 +17,27 @@
  * Unlock a mutex. (POSIX2008, called from C89)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <errno.h>
-#include <stdbool.h>
 
 int __mutex_unlock(__mutex_t* mutex) {
-    if (mutex->__type == _MUTEX_NORMAL) {
-        __atomic_clear(&mutex->__state, __ATOMIC_RELEASE);
-        return 0;
-    } else if (mutex->__type == _MUTEX_RECURSIVE) {
-        int expected = LOCKED;
-        while (!__atomic_compare_exchange_n(&mutex->__state, &expected, BUSY,
-                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
-            if (expected == UNLOCKED) {
-                return EPERM;
-            }
-            sched_yield();
-            expected = LOCKED;
-        }
-
+    if (mutex->__type == _MUTEX_RECURSIVE) {
         pid_t tid = __thread_self()->uthread.tid;
-        if (mutex->__owner != tid) {
-            __atomic_store_n(&mutex->__state, LOCKED, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&mutex->__owner, __ATOMIC_RELAXED) != tid) {
             return EPERM;
         }
 
-        mutex->__count--;
-        if (mutex->__count == 0) {
-            mutex->__owner = -1;
-            __atomic_store_n(&mutex->__state, UNLOCKED, __ATOMIC_RELEASE);
-            return 0;
-        }
-        __atomic_store_n(&mutex->__state, LOCKED, __ATOMIC_RELEASE);
-        return 0;
+        if (--mutex->__count > 0) return 0;
+        __atomic_store_n(&mutex->__owner, -1, __ATOMIC_RELAXED);
+    } else if (mutex->__type != _MUTEX_NORMAL) {
+        return EINVAL;
     }
 
-    return EINVAL;
+    // Only enter the kernel if another thread might be waiting.
+    if (__atomic_exchange_n(&mutex->__state, UNLOCKED, __ATOMIC_RELEASE) ==
+            CONTENDED) {
+        __futexWake(&mutex->__state, 1);
+    }
+    return 0;
 }
 __weak_alias(__mutex_unlock, pthread_mutex_unlock);
@@ -17,14 +17,13 @@
  * Create a thread. (C11)
  */
 
-#define sched_yield __sched_yield
 #include "thread.h"
 #include <stdnoreturn.h>
 
 static noreturn void wrapperFunc(thrd_start_t func, void* arg) {
     __thread_t self = __thread_self();
     while (__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) == PREPARING) {
-        sched_yield();
+        __futexWait(&self->state, PREPARING, CLOCK_MONOTONIC, NULL);
     }
     thrd_exit(func(arg));
 }
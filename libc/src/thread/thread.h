@@ -39,7 +39,7 @@ struct __threadStruct {
     __thread_t next;
     union ThreadResult result;
     size_t mappingSize;
-    char state;
+    int state;
     void* keyValues[PTHREAD_KEYS_MAX];
 };
 
@@ -54,7 +54,7 @@ _Static_assert(alignof(struct __threadStruct) == alignof(struct uthread),
 // Mutex states
 #define UNLOCKED 0
 #define LOCKED 1
-#define BUSY 2
+#define CONTENDED 2 // Locked and other threads might be waiting.
 
 // Thread states
 #define PREPARING 0
@@ -78,6 +78,10 @@ int __cond_broadcast(__cond_t* cond);
 int __cond_clockwait(__cond_t* restrict cond, __mutex_t* restrict mutex,
         clockid_t clock, const struct timespec* restrict abstime);
 int __cond_signal(__cond_t* cond);
+void __freeThreadCache(void);
+int __futexWait(int* address, int value, clockid_t clock,
+        const struct timespec* abstime);
+void __futexWake(int* address, int count);
 int __key_create(__key_t* key, void (*destructor)(void*));
 int __key_delete(__key_t key);
 void* __key_getspecific(__key_t key);
@@ -20,4 +20,9 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 
-DEFINE_SYSCALL_GLOBAL(SYSCALL_MEMINFO, void, meminfo, (struct meminfo*));
+DEFINE_SYSCALL(SYSCALL_MEMINFO2, void, sys_meminfo2,
+        (struct meminfo*, size_t));
+
+void meminfo(struct meminfo* info) {
+    sys_meminfo2(info, sizeof(struct meminfo));
+}
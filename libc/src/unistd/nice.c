@@ -0,0 +1,35 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* libc/src/unistd/nice.c
+ * Change the nice value. (POSIX2008)
+ */
+
+#include <limits.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+int nice(int increment) {
+    int priority = getpriority(PRIO_PROCESS, 0);
+    if (increment > 2 * NZERO) {
+        increment = 2 * NZERO;
+    } else if (increment < -2 * NZERO) {
+        increment = -2 * NZERO;
+    }
+
+    // The kernel clamps the value to the valid range.
+    if (setpriority(PRIO_PROCESS, 0, priority + increment) < 0) return -1;
+    return getpriority(PRIO_PROCESS, 0);
+}
@@ -50,7 +50,7 @@ long sysconf(int name) {
     case _SC_MESSAGE_PASSING: return -1;
     case _SC_MONOTONIC_CLOCK: return _POSIX_MONOTONIC_CLOCK;
     case _SC_PRIORITIZED_IO: return -1;
-    case _SC_PRIORITY_SCHEDULING: return -1;
+    case _SC_PRIORITY_SCHEDULING: return _POSIX_PRIORITY_SCHEDULING;
     case _SC_RAW_SOCKETS: return -1;
     case _SC_READER_WRITER_LOCKS: return -1;
     case _SC_REALTIME_SIGNALS: return -1;
@@ -0,0 +1,45 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Prints the time since boot and how much memory is in use. Run right after
+// booting, this shows how long the kernel took to reach userspace and how much
+// memory the initrd occupies, so that kernels can be compared.
+
+int main(void) {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        printf("clock_gettime failed\n");
+        return EXIT_FAILURE;
+    }
+
+    struct meminfo info;
+    meminfo(&info);
+    if (info.mem_total == 0 || info.mem_free > info.mem_total) {
+        printf("meminfo returned invalid values\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("uptime: %lld ms\n",
+            now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+    printf("memory used: %zu KiB of %zu KiB, %zu KiB available\n",
+            (info.mem_total - info.mem_free) / 1024, info.mem_total / 1024,
+            info.mem_available / 1024);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reads a file sequentially and at random offsets and prints the throughput.
+// The file should be on a disk, for example in /mnt, and the disk should be
+// freshly mounted so that the reads are not served from the block cache. If a
+// size in MiB is given, the file is first written with that size so that the
+// cost of allocating its blocks is measured as well.
+#define SEQUENTIAL_BUFFER_SIZE (1024 * 1024)
+#define RANDOM_BLOCK_SIZE 4096
+#define RANDOM_READS 2000
+
+static unsigned int failures = 0;
+static char buffer[SEQUENTIAL_BUFFER_SIZE];
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void printRate(const char* name, long long bytes, long long us) {
+    if (us == 0) us = 1;
+    printf("%s: %lld KiB in %lld ms, %lld KiB/s\n", name, bytes / 1024,
+            us / 1000, bytes * 1000000 / 1024 / us);
+}
+
+static void writeFile(const char* path, long long size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("cannot create '%s'\n", path);
+        failures++;
+        return;
+    }
+
+    memset(buffer, 0xAA, sizeof(buffer));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long long written = 0; written < size; written += sizeof(buffer)) {
+        if (write(fd, buffer, sizeof(buffer)) != sizeof(buffer)) {
+            printf("write failed\n");
+            failures++;
+            break;
+        }
+    }
+    if (fsync(fd) < 0) failures++;
+    printRate("write", size, elapsedMicroseconds(&start));
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && argc != 3) {
+        printf("usage: %s FILE [SIZE_MIB]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc == 3) {
+        writeFile(argv[1], strtoll(argv[2], NULL, 10) * 1024 * 1024);
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        printf("cannot open '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long fileSize = 0;
+    while (true) {
+        ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+        if (bytesRead < 0) {
+            printf("read failed\n");
+            failures++;
+            break;
+        }
+        if (bytesRead == 0) break;
+        fileSize += bytesRead;
+    }
+    printRate("sequential", fileSize, elapsedMicroseconds(&start));
+
+    if (fileSize >= RANDOM_BLOCK_SIZE) {
+        unsigned int seed = 1;
+        long long blocks = fileSize / RANDOM_BLOCK_SIZE;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < RANDOM_READS; i++) {
+            seed = seed * 1103515245 + 12345;
+            off_t offset = (off_t) ((seed >> 8) % blocks) * RANDOM_BLOCK_SIZE;
+            if (lseek(fd, offset, SEEK_SET) != offset ||
+                    read(fd, buffer, RANDOM_BLOCK_SIZE) != RANDOM_BLOCK_SIZE) {
+                failures++;
+            }
+        }
+        printRate("random", (long long) RANDOM_READS * RANDOM_BLOCK_SIZE,
+                elapsedMicroseconds(&start));
+    }
+
+    close(fd);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
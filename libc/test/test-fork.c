@@ -0,0 +1,90 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Times fork followed by _exit and fork followed by exec while the parent has
+// a large, fully touched heap. With copy-on-write fork the cost should not
+// grow with the size of the parent's memory.
+#define HEAP_SIZE (32 * 1024 * 1024)
+#define ITERATIONS 200
+
+static unsigned int failures = 0;
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void runChildren(const char* name, bool exec) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("fork failed\n");
+            failures++;
+            return;
+        }
+        if (pid == 0) {
+            if (exec) {
+                execl("/bin/true", "true", NULL);
+            }
+            _exit(exec ? 127 : 0);
+        }
+
+        int status;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+                WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+    }
+
+    printf("%s: %lld us per child\n", name,
+            elapsedMicroseconds(&start) / ITERATIONS);
+}
+
+int main(void) {
+    char* heap = malloc(HEAP_SIZE);
+    if (!heap) {
+        printf("malloc failed\n");
+        return EXIT_FAILURE;
+    }
+    memset(heap, 0x55, HEAP_SIZE);
+
+    runChildren("fork", false);
+    runChildren("fork+exec", true);
+
+    // The parent's memory must be unaffected by the children.
+    for (size_t i = 0; i < HEAP_SIZE; i += 4096) {
+        if (heap[i] != 0x55) {
+            failures++;
+            break;
+        }
+    }
+    free(heap);
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
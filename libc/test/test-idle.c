@@ -0,0 +1,98 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Threads that block in the kernel should not use any CPU time. Several
+// threads wait for input on empty pipes and others sleep while the main thread
+// sleeps too. The CPU time used by the process during that interval is
+// printed together with the elapsed time.
+#define NUM_READERS 8
+#define NUM_SLEEPERS 8
+#define WAIT_SECONDS 2
+
+static unsigned int failures = 0;
+static int pipes[NUM_READERS][2];
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void* reader(void* arg) {
+    int* fds = arg;
+    char c;
+    if (read(fds[0], &c, 1) != 1 || c != 'x') {
+        __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void* sleeper(void* arg) {
+    (void) arg;
+    struct timespec duration = { .tv_sec = WAIT_SECONDS, .tv_nsec = 0 };
+    nanosleep(&duration, NULL);
+    return NULL;
+}
+
+int main(void) {
+    pthread_t readers[NUM_READERS];
+    pthread_t sleepers[NUM_SLEEPERS];
+
+    for (size_t i = 0; i < NUM_READERS; i++) {
+        if (pipe(pipes[i]) < 0) {
+            printf("pipe failed\n");
+            return EXIT_FAILURE;
+        }
+        if (pthread_create(&readers[i], NULL, reader, pipes[i]) != 0) {
+            printf("pthread_create failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < NUM_SLEEPERS; i++) {
+        if (pthread_create(&sleepers[i], NULL, sleeper, NULL) != 0) {
+            printf("pthread_create failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct timespec wallStart, wallEnd, cpuStart, cpuEnd;
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+
+    struct timespec duration = { .tv_sec = WAIT_SECONDS, .tv_nsec = 0 };
+    nanosleep(&duration, NULL);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+
+    for (size_t i = 0; i < NUM_READERS; i++) {
+        if (write(pipes[i][1], "x", 1) != 1) failures++;
+        pthread_join(readers[i], NULL);
+    }
+    for (size_t i = 0; i < NUM_SLEEPERS; i++) {
+        pthread_join(sleepers[i], NULL);
+    }
+
+    long long wall = nanoseconds(&wallEnd) - nanoseconds(&wallStart);
+    long long cpu = nanoseconds(&cpuEnd) - nanoseconds(&cpuStart);
+    printf("%lld ms elapsed, %lld ms CPU time used while blocked\n",
+            wall / 1000000, cpu / 1000000);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Several threads allocate and free blocks of many sizes while checking that
+// no block is handed out twice. The time taken is printed so that the test can
+// also be used to compare allocator performance.
+#define NUM_THREADS 4
+#define NUM_SLOTS 256
+#define ITERATIONS 200000
+
+static unsigned int failures = 0;
+
+static size_t randomSize(unsigned int* seed) {
+    *seed = *seed * 1103515245 + 12345;
+    unsigned int value = *seed >> 8;
+    // Mostly small sizes with occasional large ones.
+    if (value % 64 == 0) return value % (256 * 1024) + 1;
+    if (value % 8 == 0) return value % 4096 + 1;
+    return value % 256 + 1;
+}
+
+static void* worker(void* arg) {
+    unsigned int seed = (uintptr_t) arg;
+    unsigned char fill = (uintptr_t) arg;
+    unsigned char* blocks[NUM_SLOTS] = {0};
+    size_t sizes[NUM_SLOTS] = {0};
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        size_t slot = i % NUM_SLOTS;
+        if (blocks[slot]) {
+            for (size_t j = 0; j < sizes[slot]; j++) {
+                if (blocks[slot][j] != fill) {
+                    __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+                    break;
+                }
+            }
+
+            if (i % 3 == 0) {
+                size_t size = randomSize(&seed);
+                unsigned char* block = realloc(blocks[slot], size);
+                if (!block) return NULL;
+                if (size > sizes[slot]) {
+                    memset(block + sizes[slot], fill, size - sizes[slot]);
+                }
+                blocks[slot] = block;
+                sizes[slot] = size;
+                continue;
+            }
+            free(blocks[slot]);
+        }
+
+        sizes[slot] = randomSize(&seed);
+        blocks[slot] = malloc(sizes[slot]);
+        if (!blocks[slot]) return NULL;
+        if ((uintptr_t) blocks[slot] % 16 != 0) {
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+        }
+        memset(blocks[slot], fill, sizes[slot]);
+    }
+
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        free(blocks[i]);
+    }
+    return arg;
+}
+
+int main(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t threads[NUM_THREADS];
+    for (uintptr_t i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&threads[i], NULL, worker, (void*) (i + 1)) != 0) {
+            printf("pthread_create failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (uintptr_t i = 0; i < NUM_THREADS; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        if (result != (void*) (i + 1)) {
+            printf("thread %zu ran out of memory\n", (size_t) i);
+            failures++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long elapsed = (end.tv_sec - start.tv_sec) * 1000LL +
+            (end.tv_nsec - start.tv_nsec) / 1000000;
+    printf("%u failures, %lld ms\n", failures, elapsed);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The memory functions copy differently depending on size and alignment, so
+// all combinations around the chunk boundaries are compared to a simple
+// bytewise implementation.
+#define BUFFER_SIZE 4096
+
+static unsigned int failures = 0;
+static unsigned char source[BUFFER_SIZE];
+static unsigned char buffer[BUFFER_SIZE];
+static unsigned char expected[BUFFER_SIZE];
+
+static void fail(const char* function, size_t offset1, size_t offset2,
+        size_t size) {
+    printf("%s failed at offsets %zu, %zu with size %zu\n", function, offset1,
+            offset2, size);
+    failures++;
+}
+
+static void fill(unsigned char* p) {
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        p[i] = (i * 7 + 3) & 0xFF;
+    }
+}
+
+static void testMemcpy(size_t offset1, size_t offset2, size_t size) {
+    memset(buffer, 0xAA, BUFFER_SIZE);
+    memcpy(buffer + offset1, source + offset2, size);
+
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        unsigned char c = 0xAA;
+        if (i >= offset1 && i < offset1 + size) {
+            c = source[offset2 + i - offset1];
+        }
+        if (buffer[i] != c) {
+            fail("memcpy", offset1, offset2, size);
+            return;
+        }
+    }
+}
+
+static void testMemmove(size_t offset1, size_t offset2, size_t size) {
+    fill(buffer);
+    fill(expected);
+    unsigned char temp[BUFFER_SIZE];
+    for (size_t i = 0; i < size; i++) {
+        temp[i] = expected[offset2 + i];
+    }
+    for (size_t i = 0; i < size; i++) {
+        expected[offset1 + i] = temp[i];
+    }
+
+    memmove(buffer + offset1, buffer + offset2, size);
+    if (memcmp(buffer, expected, BUFFER_SIZE) != 0) {
+        fail("memmove", offset1, offset2, size);
+    }
+}
+
+static void testMemset(size_t offset, size_t size) {
+    memset(buffer, 0xAA, BUFFER_SIZE);
+    memset(buffer + offset, 0x85, size);
+
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        unsigned char c = i >= offset && i < offset + size ? 0x85 : 0xAA;
+        if (buffer[i] != c) {
+            fail("memset", offset, 0, size);
+            return;
+        }
+    }
+}
+
+static void testMemcmp(size_t offset1, size_t offset2, size_t size) {
+    memcpy(buffer + offset1, source + offset2, size);
+    if (memcmp(buffer + offset1, source + offset2, size) != 0) {
+        fail("memcmp", offset1, offset2, size);
+        return;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        buffer[offset1 + i]++;
+        int result = memcmp(buffer + offset1, source + offset2, size);
+        int expectedResult = buffer[offset1 + i] > source[offset2 + i] ?
+                1 : -1;
+        buffer[offset1 + i]--;
+        if ((result > 0) != (expectedResult > 0) || result == 0) {
+            fail("memcmp", offset1, offset2, size);
+            return;
+        }
+    }
+}
+
+int main(void) {
+    fill(source);
+
+    static const size_t sizes[] = { 0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32,
+            33, 63, 64, 65, 255, 1023, 1024, 1025, 2000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t size = sizes[i];
+        for (size_t offset1 = 0; offset1 < 20; offset1++) {
+            testMemset(offset1, size);
+            for (size_t offset2 = 0; offset2 < 20; offset2++) {
+                testMemcpy(offset1, offset2, size);
+                testMemmove(offset1, offset2, size);
+                testMemcmp(offset1, offset2, size);
+            }
+        }
+    }
+
+    // Overlapping moves that are larger than a chunk.
+    for (size_t distance = 1; distance < 40; distance++) {
+        testMemmove(100, 100 + distance, 3000);
+        testMemmove(100 + distance, 100, 3000);
+        testMemmove(100, 100 + distance, 100);
+        testMemmove(100 + distance, 100, 100);
+    }
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
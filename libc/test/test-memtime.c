@@ -0,0 +1,96 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Times memcpy, memmove, memset and memcmp for sizes from 8 bytes to 1 MiB.
+// Each size is repeated until about 64 MiB have been processed so that the
+// results for different sizes are comparable.
+#define MAX_SIZE (1024 * 1024)
+#define BYTES_PER_SIZE (64 * 1024 * 1024)
+
+static unsigned int failures = 0;
+static volatile int sink;
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void printRate(const char* name, size_t size, size_t iterations,
+        const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long ns = nanoseconds(&end) - nanoseconds(start);
+    if (ns == 0) ns = 1;
+    printf("%-8s %7zu bytes: %6lld MiB/s\n", name, size,
+            (long long) size * iterations * 1000000000LL / ns / 1024 / 1024);
+}
+
+int main(void) {
+    unsigned char* source = malloc(MAX_SIZE + 64);
+    unsigned char* dest = malloc(MAX_SIZE + 64);
+    if (!source || !dest) {
+        printf("malloc failed\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < MAX_SIZE + 64; i++) {
+        source[i] = i * 7;
+    }
+
+    for (size_t size = 8; size <= MAX_SIZE; size *= 2) {
+        size_t iterations = BYTES_PER_SIZE / size;
+        struct timespec start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            memcpy(dest, source, size);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("memcpy", size, iterations, &start);
+        if (memcmp(dest, source, size) != 0) failures++;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            memmove(dest + 1, dest, size);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("memmove", size, iterations, &start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            memset(dest, i, size);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("memset", size, iterations, &start);
+        if (dest[size - 1] != (unsigned char) (iterations - 1)) failures++;
+
+        memcpy(dest, source, size);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = memcmp(dest, source, size);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("memcmp", size, iterations, &start);
+        if (sink != 0) failures++;
+    }
+
+    free(source);
+    free(dest);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Threads increment a shared counter under a mutex and pass a token around
+// using a condition variable. Both are timed for several thread counts and
+// the counter is checked afterwards.
+#define MAX_THREADS 16
+#define INCREMENTS 200000
+#define TOKEN_PASSES 20000
+
+static unsigned int failures = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static unsigned long counter;
+static size_t token;
+static size_t numThreads;
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void* incrementer(void* arg) {
+    (void) arg;
+    for (size_t i = 0; i < INCREMENTS; i++) {
+        pthread_mutex_lock(&mutex);
+        counter++;
+        pthread_mutex_unlock(&mutex);
+    }
+    return NULL;
+}
+
+static void* tokenPasser(void* arg) {
+    size_t id = (size_t) arg;
+    pthread_mutex_lock(&mutex);
+    for (size_t i = 0; i < TOKEN_PASSES / numThreads; i++) {
+        while (token % numThreads != id) {
+            pthread_cond_wait(&cond, &mutex);
+        }
+        token++;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+    return NULL;
+}
+
+static void run(const char* name, void* (*function)(void*)) {
+    pthread_t threads[MAX_THREADS];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < numThreads; i++) {
+        if (pthread_create(&threads[i], NULL, function, (void*) i) != 0) {
+            printf("pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("%-6s %2zu threads: %lld ms\n", name, numThreads,
+            elapsedMicroseconds(&start) / 1000);
+}
+
+int main(void) {
+    for (numThreads = 1; numThreads <= MAX_THREADS; numThreads *= 2) {
+        counter = 0;
+        run("mutex", incrementer);
+        if (counter != numThreads * INCREMENTS) failures++;
+
+        token = 0;
+        run("cond", tokenPasser);
+        if (token != TOKEN_PASSES / numThreads * numThreads) failures++;
+    }
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
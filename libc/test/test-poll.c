@@ -0,0 +1,144 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+// A thread writes to one of many pipes at a time and waits for an
+// acknowledgement, while the main thread waits for the write with poll or
+// epoll_wait. The round trip time is printed for both, together with the CPU
+// time used by a poll call that waits without any events.
+#define NUM_PIPES 64
+#define ROUNDS 2000
+#define IDLE_TIMEOUT_MS 500
+
+static unsigned int failures = 0;
+static int pipes[NUM_PIPES][2];
+static int ackPipe[2];
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void* writer(void* arg) {
+    (void) arg;
+    for (size_t i = 0; i < 2 * ROUNDS; i++) {
+        char c = i;
+        char ack;
+        if (write(pipes[i * 7 % NUM_PIPES][1], &c, 1) != 1 ||
+                read(ackPipe[0], &ack, 1) != 1) {
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int waitWithPoll(int epollFd) {
+    (void) epollFd;
+    struct pollfd pfds[NUM_PIPES];
+    for (size_t i = 0; i < NUM_PIPES; i++) {
+        pfds[i].fd = pipes[i][0];
+        pfds[i].events = POLLIN;
+    }
+    if (poll(pfds, NUM_PIPES, -1) != 1) return -1;
+    for (size_t i = 0; i < NUM_PIPES; i++) {
+        if (pfds[i].revents & POLLIN) return pfds[i].fd;
+    }
+    return -1;
+}
+
+static int waitWithEpoll(int epollFd) {
+    struct epoll_event event;
+    if (epoll_wait(epollFd, &event, 1, -1) != 1) return -1;
+    return event.data.fd;
+}
+
+static void run(const char* name, int (*wait)(int), int epollFd) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < ROUNDS; i++) {
+        int fd = wait(epollFd);
+        char c;
+        if (fd < 0 || read(fd, &c, 1) != 1 || write(ackPipe[1], &c, 1) != 1) {
+            printf("%s failed\n", name);
+            failures++;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-10s %lld us per round trip\n", name,
+            (nanoseconds(&end) - nanoseconds(&start)) / ROUNDS / 1000);
+}
+
+int main(void) {
+    for (size_t i = 0; i < NUM_PIPES; i++) {
+        if (pipe(pipes[i]) < 0) {
+            printf("pipe failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (pipe(ackPipe) < 0) {
+        printf("pipe failed\n");
+        return EXIT_FAILURE;
+    }
+
+    int epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        printf("epoll_create1 failed\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < NUM_PIPES; i++) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = pipes[i][0];
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, pipes[i][0], &event) < 0) {
+            printf("epoll_ctl failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct pollfd pfds[NUM_PIPES];
+    for (size_t i = 0; i < NUM_PIPES; i++) {
+        pfds[i].fd = pipes[i][0];
+        pfds[i].events = POLLIN;
+    }
+    struct timespec cpuStart, cpuEnd;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+    if (poll(pfds, NUM_PIPES, IDLE_TIMEOUT_MS) != 0) failures++;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+    printf("idle poll: %lld us CPU time in %d ms\n",
+            (nanoseconds(&cpuEnd) - nanoseconds(&cpuStart)) / 1000,
+            IDLE_TIMEOUT_MS);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, writer, NULL) != 0) {
+        printf("pthread_create failed\n");
+        return EXIT_FAILURE;
+    }
+    run("poll", waitWithPoll, epollFd);
+    run("epoll_wait", waitWithEpoll, epollFd);
+    pthread_join(thread, NULL);
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
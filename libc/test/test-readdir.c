@@ -0,0 +1,147 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Creates a directory with many entries and times reading all of them with
+// readdir, which is what ls does first. Then every entry is stated, once with
+// fstatat and once in batches with fstatat_many as ls -l does. The directory is
+// created inside the given directory, /tmp by default, and the number of
+// entries can be given as a second argument.
+#define DEFAULT_ENTRIES 100000
+#define STAT_BATCH 64
+
+static unsigned int failures = 0;
+static char path[1024];
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void statEntries(int dirFd, size_t numEntries, bool batched) {
+    static char names[STAT_BATCH][32];
+    struct fstatat_entry entries[STAT_BATCH];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < numEntries; i += STAT_BATCH) {
+        size_t count = numEntries - i < STAT_BATCH ? numEntries - i :
+                STAT_BATCH;
+        for (size_t j = 0; j < count; j++) {
+            snprintf(names[j], sizeof(names[j]), "entry%zu", i + j);
+            entries[j].name = names[j];
+        }
+
+        if (batched) {
+            if (fstatat_many(dirFd, entries, count, STAT_ALL, 0) < 0) {
+                failures++;
+                return;
+            }
+            for (size_t j = 0; j < count; j++) {
+                if (entries[j].error || !S_ISREG(entries[j].stat.st_mode)) {
+                    failures++;
+                }
+            }
+        } else {
+            for (size_t j = 0; j < count; j++) {
+                if (fstatat(dirFd, names[j], &entries[j].stat, 0) < 0 ||
+                        !S_ISREG(entries[j].stat.st_mode)) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    printf("%s: %lld ms\n", batched ? "fstatat_many" : "fstatat",
+            elapsedMicroseconds(&start) / 1000);
+}
+
+int main(int argc, char* argv[]) {
+    const char* root = argc >= 2 ? argv[1] : "/tmp";
+    size_t numEntries = argc >= 3 ? strtoul(argv[2], NULL, 10) :
+            DEFAULT_ENTRIES;
+
+    snprintf(path, sizeof(path), "%s/readdir", root);
+    if (mkdir(path, 0755) < 0) {
+        printf("cannot create '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+    int dirFd = open(path, O_SEARCH | O_DIRECTORY);
+    if (dirFd < 0) {
+        printf("cannot open '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < numEntries; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "entry%zu", i);
+        int fd = openat(dirFd, name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            printf("cannot create entry %zu\n", i);
+            failures++;
+            numEntries = i;
+            break;
+        }
+        close(fd);
+    }
+    printf("create %zu entries: %lld ms\n", numEntries,
+            elapsedMicroseconds(&start) / 1000);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DIR* dir = opendir(path);
+    size_t count = 0;
+    if (dir) {
+        struct dirent* dirent;
+        while ((dirent = readdir(dir))) {
+            if (strcmp(dirent->d_name, ".") != 0 &&
+                    strcmp(dirent->d_name, "..") != 0) {
+                count++;
+            }
+        }
+        closedir(dir);
+    }
+    printf("readdir: %lld ms\n", elapsedMicroseconds(&start) / 1000);
+    if (count != numEntries) {
+        printf("readdir returned %zu entries\n", count);
+        failures++;
+    }
+
+    statEntries(dirFd, numEntries, false);
+    statEntries(dirFd, numEntries, true);
+
+    for (size_t i = 0; i < numEntries; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "entry%zu", i);
+        unlinkat(dirFd, name, 0);
+    }
+    close(dirFd);
+    rmdir(path);
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Sleeps for several durations and prints by how much nanosleep overshoots the
+// requested time. With one-shot timers the overshoot should be far below the
+// old timer tick. Returning early counts as a failure.
+#define ROUNDS 50
+
+static unsigned int failures = 0;
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+int main(void) {
+    static const long durations[] = {
+        50000, 100000, 500000, 1000000, 5000000, 20000000
+    };
+
+    for (size_t i = 0; i < sizeof(durations) / sizeof(durations[0]); i++) {
+        long long total = 0;
+        long long worst = 0;
+
+        for (size_t j = 0; j < ROUNDS; j++) {
+            struct timespec start, end;
+            struct timespec duration = { .tv_sec = 0, .tv_nsec = durations[i] };
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (nanosleep(&duration, NULL) < 0) {
+                printf("nanosleep failed\n");
+                failures++;
+                continue;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            long long overshoot = nanoseconds(&end) - nanoseconds(&start) -
+                    durations[i];
+            if (overshoot < 0) failures++;
+            total += overshoot;
+            if (overshoot > worst) worst = overshoot;
+        }
+
+        printf("%6ld us: mean overshoot %lld us, worst %lld us\n",
+                durations[i] / 1000, total / ROUNDS / 1000, worst / 1000);
+    }
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#include <unistd.h>
+
+// Copies a file through a pipe into another file, once with read and write
+// and once with splice, and copies it directly with sendfile. The throughput
+// of each method is printed and the copies are compared with the source. Data
+// is moved through the pipe in PIPE_BUF sized pieces so that a single process
+// can fill and drain it without blocking.
+#define FILE_SIZE (16 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+
+static unsigned int failures = 0;
+static char buffer[CHUNK_SIZE];
+static char compareBuffer[CHUNK_SIZE];
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void printRate(const char* name, const struct timespec* start) {
+    long long us = elapsedMicroseconds(start);
+    if (us == 0) us = 1;
+    printf("%-10s %lld ms, %lld KiB/s\n", name, us / 1000,
+            (long long) FILE_SIZE * 1000000 / 1024 / us);
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static void copyWithReadWrite(int source, int pipeFds[2], int dest) {
+    size_t remaining = FILE_SIZE;
+    while (remaining > 0) {
+        ssize_t bytesRead = read(source, buffer, PIPE_BUF);
+        if (bytesRead <= 0 || !writeAll(pipeFds[1], buffer, bytesRead) ||
+                read(pipeFds[0], buffer, bytesRead) != bytesRead ||
+                !writeAll(dest, buffer, bytesRead)) {
+            break;
+        }
+        remaining -= bytesRead;
+    }
+    if (remaining > 0) failures++;
+}
+
+static void copyWithSplice(int source, int pipeFds[2], int dest) {
+    size_t remaining = FILE_SIZE;
+    while (remaining > 0) {
+        ssize_t inPipe = splice(source, NULL, pipeFds[1], NULL, PIPE_BUF, 0);
+        if (inPipe <= 0) break;
+        while (inPipe > 0) {
+            ssize_t transferred = splice(pipeFds[0], NULL, dest, NULL, inPipe,
+                    0);
+            if (transferred <= 0) {
+                failures++;
+                return;
+            }
+            inPipe -= transferred;
+            remaining -= transferred;
+        }
+    }
+    if (remaining > 0) failures++;
+}
+
+static void copyWithSendfile(int source, int dest) {
+    size_t remaining = FILE_SIZE;
+    while (remaining > 0) {
+        ssize_t transferred = sendfile(dest, source, NULL, remaining);
+        if (transferred <= 0) break;
+        remaining -= transferred;
+    }
+    if (remaining > 0) failures++;
+}
+
+static void compareFiles(int source, int dest) {
+    lseek(source, 0, SEEK_SET);
+    lseek(dest, 0, SEEK_SET);
+    for (size_t offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+        if (read(source, buffer, CHUNK_SIZE) != CHUNK_SIZE ||
+                read(dest, compareBuffer, CHUNK_SIZE) != CHUNK_SIZE ||
+                memcmp(buffer, compareBuffer, CHUNK_SIZE) != 0) {
+            failures++;
+            return;
+        }
+    }
+}
+
+static int openDest(const char* path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("cannot create '%s'\n", path);
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+int main(void) {
+    const char* sourcePath = "/tmp/test-splice-source";
+    const char* destPath = "/tmp/test-splice-dest";
+
+    int source = open(sourcePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (source < 0) {
+        printf("cannot create '%s'\n", sourcePath);
+        return EXIT_FAILURE;
+    }
+    for (size_t offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+        for (size_t i = 0; i < CHUNK_SIZE; i++) {
+            buffer[i] = (offset + i) * 31 / 7;
+        }
+        if (!writeAll(source, buffer, CHUNK_SIZE)) {
+            printf("write failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int pipeFds[2];
+    if (pipe(pipeFds) < 0) {
+        printf("pipe failed\n");
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    int dest = openDest(destPath);
+    lseek(source, 0, SEEK_SET);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    copyWithReadWrite(source, pipeFds, dest);
+    printRate("read/write", &start);
+    compareFiles(source, dest);
+    close(dest);
+
+    dest = openDest(destPath);
+    lseek(source, 0, SEEK_SET);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    copyWithSplice(source, pipeFds, dest);
+    printRate("splice", &start);
+    compareFiles(source, dest);
+    close(dest);
+
+    dest = openDest(destPath);
+    lseek(source, 0, SEEK_SET);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    copyWithSendfile(source, dest);
+    printRate("sendfile", &start);
+    compareFiles(source, dest);
+    close(dest);
+
+    close(source);
+    unlink(sourcePath);
+    unlink(destPath);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
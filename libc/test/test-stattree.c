@@ -0,0 +1,119 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Creates a tree of directories and files and times how long it takes to stat
+// every path in it by name. Each walk resolves every path component again, so
+// it measures directory lookups and the dentry cache. The tree is created in
+// the given directory, which should be on an ext2 disk to test htree lookups.
+#define NUM_DIRS 16
+#define FILES_PER_DIR 1000
+#define WALKS 3
+
+static unsigned int failures = 0;
+static char path[1024];
+
+static long long elapsedMicroseconds(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000LL +
+            (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void createTree(const char* root) {
+    snprintf(path, sizeof(path), "%s/stattree", root);
+    if (mkdir(path, 0755) < 0) {
+        printf("cannot create '%s'\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < NUM_DIRS; i++) {
+        snprintf(path, sizeof(path), "%s/stattree/dir%zu", root, i);
+        if (mkdir(path, 0755) < 0) {
+            failures++;
+            continue;
+        }
+        for (size_t j = 0; j < FILES_PER_DIR; j++) {
+            snprintf(path, sizeof(path), "%s/stattree/dir%zu/file%zu", root,
+                    i, j);
+            int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+            if (fd < 0) {
+                failures++;
+                continue;
+            }
+            close(fd);
+        }
+    }
+}
+
+static void walkTree(const char* root) {
+    struct stat st;
+    for (size_t i = 0; i < NUM_DIRS; i++) {
+        snprintf(path, sizeof(path), "%s/stattree/dir%zu", root, i);
+        if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) failures++;
+
+        for (size_t j = 0; j < FILES_PER_DIR; j++) {
+            snprintf(path, sizeof(path), "%s/stattree/dir%zu/file%zu", root,
+                    i, j);
+            if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) failures++;
+        }
+
+        // Lookups of names that do not exist must search the whole directory.
+        snprintf(path, sizeof(path), "%s/stattree/dir%zu/missing", root, i);
+        if (stat(path, &st) == 0) failures++;
+    }
+}
+
+static void removeTree(const char* root) {
+    for (size_t i = 0; i < NUM_DIRS; i++) {
+        for (size_t j = 0; j < FILES_PER_DIR; j++) {
+            snprintf(path, sizeof(path), "%s/stattree/dir%zu/file%zu", root,
+                    i, j);
+            unlink(path);
+        }
+        snprintf(path, sizeof(path), "%s/stattree/dir%zu", root, i);
+        rmdir(path);
+    }
+    snprintf(path, sizeof(path), "%s/stattree", root);
+    rmdir(path);
+}
+
+int main(int argc, char* argv[]) {
+    const char* root = argc >= 2 ? argv[1] : "/tmp";
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    createTree(root);
+    printf("create: %lld ms\n", elapsedMicroseconds(&start) / 1000);
+
+    for (size_t i = 0; i < WALKS; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        walkTree(root);
+        long long us = elapsedMicroseconds(&start);
+        printf("walk %zu: %lld ms, %lld ns per stat\n", i + 1, us / 1000,
+                us * 1000 / (NUM_DIRS * (FILES_PER_DIR + 2)));
+    }
+
+    removeTree(root);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The string functions read whole words or chunks, so they are compared to
+// simple bytewise implementations at all alignments.
+static unsigned int failures = 0;
+
+static void fail(const char* function, const char* s1, const char* s2) {
+    printf("%s failed for \"%s\", \"%s\"\n", function, s1, s2);
+    failures++;
+}
+
+static size_t referenceStrlen(const char* s) {
+    size_t result = 0;
+    while (s[result]) {
+        result++;
+    }
+    return result;
+}
+
+static const char* referenceStrchr(const char* s, char c) {
+    do {
+        if (*s == c) return s;
+    } while (*s++);
+    return NULL;
+}
+
+static int referenceStrcmp(const char* s1, const char* s2) {
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    return (unsigned char) *s1 - (unsigned char) *s2;
+}
+
+static const char* referenceStrstr(const char* haystack, const char* needle) {
+    size_t length = referenceStrlen(needle);
+    do {
+        if (strncmp(haystack, needle, length) == 0) return haystack;
+    } while (*haystack++);
+    return NULL;
+}
+
+static int sign(int value) {
+    return value < 0 ? -1 : value > 0;
+}
+
+static void testString(const char* s, const char* other) {
+    if (strlen(s) != referenceStrlen(s)) {
+        fail("strlen", s, "");
+    }
+
+    for (const char* c = "abxz\x80"; *c; c++) {
+        if (strchr(s, *c) != referenceStrchr(s, *c)) {
+            fail("strchr", s, c);
+        }
+        size_t length = referenceStrlen(s);
+        if (memchr(s, *c, length) != (length && referenceStrchr(s, *c) ?
+                referenceStrchr(s, *c) : NULL)) {
+            fail("memchr", s, c);
+        }
+    }
+    if (strchr(s, '\0') != s + referenceStrlen(s)) {
+        fail("strchr", s, "\\0");
+    }
+
+    if (sign(strcmp(s, other)) != sign(referenceStrcmp(s, other))) {
+        fail("strcmp", s, other);
+    }
+
+    if (strstr(s, other) != referenceStrstr(s, other)) {
+        fail("strstr", s, other);
+    }
+}
+
+int main(void) {
+    static const char* strings[] = {
+        "", "a", "ab", "abc", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab",
+        "abababababababababababababababababab", "xabcabcabcabcz",
+        "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz",
+        "The quick brown fox jumps over the lazy dog", "aab", "aba", "bab",
+        "abcabcabd", "abcabd", "\x80\x81\x82", "baaaaaaaaaaaaaaaaaaa",
+    };
+    size_t numStrings = sizeof(strings) / sizeof(strings[0]);
+
+    static char buffer1[256];
+    static char buffer2[256];
+
+    for (size_t i = 0; i < numStrings; i++) {
+        for (size_t j = 0; j < numStrings; j++) {
+            for (size_t offset = 0; offset < 17; offset++) {
+                strcpy(buffer1 + offset, strings[i]);
+                strcpy(buffer2 + 16 - offset, strings[j]);
+                testString(buffer1 + offset, buffer2 + 16 - offset);
+                strcpy(buffer2 + offset, strings[i]);
+                testString(buffer1 + offset, buffer2 + offset);
+            }
+        }
+    }
+
+    // Test needles that are substrings of longer haystacks.
+    for (size_t i = 0; i < numStrings; i++) {
+        size_t length = strlen(strings[i]);
+        for (size_t start = 0; start < length; start++) {
+            for (size_t end = start; end <= length; end++) {
+                memcpy(buffer2, strings[i] + start, end - start);
+                buffer2[end - start] = '\0';
+                testString(strings[i], buffer2);
+            }
+        }
+    }
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
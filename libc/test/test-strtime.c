@@ -0,0 +1,110 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Times strlen, strchr, memchr, strcmp and strstr on strings of several
+// lengths. The searched character or needle is only found at the end, so the
+// whole string is scanned each time.
+#define MAX_LENGTH (64 * 1024)
+#define BYTES_PER_LENGTH (32 * 1024 * 1024)
+
+static unsigned int failures = 0;
+static volatile size_t sink;
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void printRate(const char* name, size_t length, size_t iterations,
+        const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long ns = nanoseconds(&end) - nanoseconds(start);
+    if (ns == 0) ns = 1;
+    printf("%-7s %6zu bytes: %6lld MiB/s\n", name, length,
+            (long long) length * iterations * 1000000000LL / ns / 1024 / 1024);
+}
+
+int main(void) {
+    char* string = malloc(MAX_LENGTH + 1);
+    char* copy = malloc(MAX_LENGTH + 1);
+    if (!string || !copy) {
+        printf("malloc failed\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t length = 16; length <= MAX_LENGTH; length *= 4) {
+        // A string of "ab" repetitions is a hard case for naive strstr.
+        for (size_t i = 0; i < length; i++) {
+            string[i] = i % 2 ? 'b' : 'a';
+        }
+        string[length - 1] = 'z';
+        string[length] = '\0';
+        memcpy(copy, string, length + 1);
+        const char* needle = string + length - (length < 32 ? length : 32);
+
+        size_t iterations = BYTES_PER_LENGTH / length;
+        struct timespec start;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = strlen(string);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("strlen", length, iterations, &start);
+        if (sink != length) failures++;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = strchr(string, 'z') - string;
+            asm volatile ("" ::: "memory");
+        }
+        printRate("strchr", length, iterations, &start);
+        if (sink != length - 1) failures++;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = (char*) memchr(string, 'z', length) - string;
+            asm volatile ("" ::: "memory");
+        }
+        printRate("memchr", length, iterations, &start);
+        if (sink != length - 1) failures++;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = strcmp(string, copy);
+            asm volatile ("" ::: "memory");
+        }
+        printRate("strcmp", length, iterations, &start);
+        if (sink != 0) failures++;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < iterations; i++) {
+            sink = strstr(string, needle) - string;
+            asm volatile ("" ::: "memory");
+        }
+        printRate("strstr", length, iterations, &start);
+        if (sink != (size_t) (needle - string)) failures++;
+    }
+
+    free(string);
+    free(copy);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// A parent waits for children that sleep before exiting, like a shell waiting
+// for a command. The CPU time used by the parent while waiting should be close
+// to zero, and waitpid should return soon after the last child has exited.
+#define NUM_CHILDREN 4
+#define SLEEP_MS 500
+
+static unsigned int failures = 0;
+
+static long long microseconds(const struct timeval* tv) {
+    return tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+int main(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < NUM_CHILDREN; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("fork failed\n");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            struct timespec duration;
+            duration.tv_sec = 0;
+            duration.tv_nsec = (i + 1) * SLEEP_MS * 1000000L / NUM_CHILDREN;
+            nanosleep(&duration, NULL);
+            _exit(i);
+        }
+    }
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+
+    for (size_t i = 0; i < NUM_CHILDREN; i++) {
+        int status;
+        if (waitpid(-1, &status, 0) < 0 || !WIFEXITED(status)) failures++;
+    }
+    if (waitpid(-1, NULL, WNOHANG) != -1) failures++;
+
+    getrusage(RUSAGE_SELF, &after);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    long long cpu = microseconds(&after.ru_utime) -
+            microseconds(&before.ru_utime) + microseconds(&after.ru_stime) -
+            microseconds(&before.ru_stime);
+    long long elapsed = (end.tv_sec - start.tv_sec) * 1000LL +
+            (end.tv_nsec - start.tv_nsec) / 1000000;
+    printf("waited %lld ms for children sleeping %d ms, %lld us CPU time\n",
+            elapsed, SLEEP_MS, cpu);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/* Copyright (c) 2022 Dennis Wölfing
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// A parent and a child pass a byte back and forth over two pipes while
+// low-priority processes spin on the CPU. Each round trip needs both processes
+// to be woken, so the mean and worst round trip times show how quickly a woken
+// process gets to run ahead of CPU-bound ones.
+#define NUM_HOGS 4
+#define ROUNDS 2000
+
+static unsigned int failures = 0;
+
+static long long nanoseconds(const struct timespec* ts) {
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+int main(void) {
+    pid_t hogs[NUM_HOGS];
+    for (size_t i = 0; i < NUM_HOGS; i++) {
+        hogs[i] = fork();
+        if (hogs[i] < 0) {
+            printf("fork failed\n");
+            return EXIT_FAILURE;
+        }
+        if (hogs[i] == 0) {
+            setpriority(PRIO_PROCESS, 0, 10);
+            while (true) {
+                asm volatile ("" ::: "memory");
+            }
+        }
+    }
+
+    int toChild[2];
+    int toParent[2];
+    if (pipe(toChild) < 0 || pipe(toParent) < 0) {
+        printf("pipe failed\n");
+        return EXIT_FAILURE;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        printf("fork failed\n");
+        return EXIT_FAILURE;
+    }
+    if (child == 0) {
+        close(toChild[1]);
+        close(toParent[0]);
+        char c;
+        while (read(toChild[0], &c, 1) == 1) {
+            if (write(toParent[1], &c, 1) != 1) _Exit(1);
+        }
+        _Exit(0);
+    }
+    close(toChild[0]);
+    close(toParent[1]);
+
+    long long total = 0;
+    long long worst = 0;
+    for (size_t i = 0; i < ROUNDS; i++) {
+        struct timespec start, end;
+        char c = i;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (write(toChild[1], &c, 1) != 1 || read(toParent[0], &c, 1) != 1) {
+            printf("pipe transfer failed\n");
+            failures++;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (c != (char) i) failures++;
+
+        long long elapsed = nanoseconds(&end) - nanoseconds(&start);
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+
+    close(toChild[1]);
+    waitpid(child, NULL, 0);
+    for (size_t i = 0; i < NUM_HOGS; i++) {
+        kill(hogs[i], SIGKILL);
+        waitpid(hogs[i], NULL, 0);
+    }
+
+    printf("round trip: mean %lld us, worst %lld us\n",
+            total / ROUNDS / 1000, worst / 1000);
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -19,15 +19,48 @@
 
 #include "utils.h"
 #include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#define CHUNK_SIZE (1024 * 1024)
 
 static bool failed = false;
 
+// Lets the kernel copy regular files and pipes to stdout. Returns false if
+// this is not possible and the data needs to be copied through a buffer.
+static bool catInKernel(int fd, const char* path) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return false;
+    if (!S_ISREG(st.st_mode) && !S_ISFIFO(st.st_mode)) return false;
+
+    bool first = true;
+    while (true) {
+        ssize_t size;
+        if (S_ISREG(st.st_mode)) {
+            size = sendfile(1, fd, NULL, CHUNK_SIZE);
+        } else {
+            size = splice(fd, NULL, 1, NULL, CHUNK_SIZE, 0);
+        }
+
+        if (size < 0) {
+            if (first && (errno == EINVAL || errno == ENOSYS)) return false;
+            warn("'%s'", path);
+            failed = true;
+            return true;
+        } else if (size == 0) {
+            return true;
+        }
+        first = false;
+    }
+}
+
 static void cat(const char* path) {
     int fd;
     if (strcmp(path, "-") == 0) {
@@ -41,6 +74,13 @@ static void cat(const char* path) {
         }
     }
 
+    if (catInKernel(fd, path)) {
+        if (fd != 0) {
+            close(fd);
+        }
+        return;
+    }
+
     while (true) {
         char buffer[4096];
         ssize_t readSize = read(fd, buffer, sizeof(buffer));
@@ -29,8 +29,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 
+#define STAT_BATCH 64
+
 enum {
     ATTR_MODE = 1 << 0,
     ATTR_OWNER = 1 << 1,
@@ -42,7 +45,13 @@ static bool copyFile(int sourceFd, const char* sourcePath, int destFd,
 static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
         int destFd, const char* destName, const char* destPath, bool force,
         bool prompt, bool recursive, int preserve);
+static bool copyWithStat(int sourceFd, const char* sourceName,
+        const char* sourcePath, int destFd, const char* destName,
+        const char* destPath, bool force, bool prompt, bool recursive,
+        int preserve, const struct stat* sourceSt, const struct stat* destSt);
 static bool isDescendantOf(int dirFd, const struct stat* possibleParentStat);
+static void statEntries(int dirFd, struct fstatat_entry* entries,
+        size_t numEntries, unsigned int mask);
 
 #ifndef MV
 int main(int argc, char* argv[]) {
@@ -161,6 +170,20 @@ int main(int argc, char* argv[]) {
 
 static bool copyFile(int sourceFd, const char* sourcePath, int destFd,
         const char* destPath) {
+    // Let the kernel copy the data without going through our buffer.
+    bool first = true;
+    while (true) {
+        ssize_t bytesCopied = sendfile(destFd, sourceFd, NULL, 1024 * 1024);
+        if (bytesCopied < 0) {
+            if (first && (errno == EINVAL || errno == ENOSYS)) break;
+            warn("copy: '%s' to '%s'", sourcePath, destPath);
+            return false;
+        } else if (bytesCopied == 0) {
+            return true;
+        }
+        first = false;
+    }
+
     while (true) {
         char buffer[1024];
         ssize_t bytesAvailable = read(sourceFd, buffer, sizeof(buffer));
@@ -184,8 +207,6 @@ static bool copyFile(int sourceFd, const char* sourcePath, int destFd,
 static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
         int destFd, const char* destName, const char* destPath, bool force,
         bool prompt, bool recursive, int preserve) {
-    bool success = true;
-
     struct stat sourceSt, destSt;
     if (fstatat(sourceFd, sourceName, &sourceSt, 0) < 0) {
         warn("stat: '%s'", sourcePath);
@@ -199,30 +220,44 @@ static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
         }
         destExists = false;
     }
-    if (destExists && sourceSt.st_dev == destSt.st_dev &&
-            sourceSt.st_ino == destSt.st_ino) {
+
+    return copyWithStat(sourceFd, sourceName, sourcePath, destFd, destName,
+            destPath, force, prompt, recursive, preserve, &sourceSt,
+            destExists ? &destSt : NULL);
+}
+
+static bool copyWithStat(int sourceFd, const char* sourceName,
+        const char* sourcePath, int destFd, const char* destName,
+        const char* destPath, bool force, bool prompt, bool recursive,
+        int preserve, const struct stat* sourceSt, const struct stat* destSt) {
+    bool success = true;
+    bool destExists = destSt;
+
+    if (destExists && sourceSt->st_dev == destSt->st_dev &&
+            sourceSt->st_ino == destSt->st_ino) {
         warnx("'%s' and '%s' are the same file", sourcePath, destPath);
         return false;
     }
 
     int newDestFd;
-    if (S_ISDIR(sourceSt.st_mode)) {
+    if (S_ISDIR(sourceSt->st_mode)) {
         if (!recursive) {
             warnx("omitting directory '%s' because -R is not specified",
                     sourcePath);
             return false;
         }
-        if (destExists && !S_ISDIR(destSt.st_mode)) {
+        if (destExists && !S_ISDIR(destSt->st_mode)) {
             warnx("cannot overwrite '%s' with directory '%s'", destPath,
                     sourcePath);
             return false;
         }
         if (!destExists) {
-            if (mkdirat(destFd, destName, sourceSt.st_mode | S_IRWXU) < 0) {
+            if (mkdirat(destFd, destName, sourceSt->st_mode | S_IRWXU) < 0) {
                 warn("mkdir: '%s'", destPath);
                 return false;
             }
-            if (fstatat(destFd, destName, &destSt, 0) < 0) {
+            struct stat newDestSt;
+            if (fstatat(destFd, destName, &newDestSt, 0) < 0) {
                 warn("stat: '%s'", destPath);
                 return false;
             }
@@ -246,45 +281,80 @@ static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
             return false;
         }
 
-        if (isDescendantOf(newDestFd, &sourceSt)) {
+        if (isDescendantOf(newDestFd, sourceSt)) {
             warnx("cannot copy directory '%s' into itself '%s'", sourcePath,
                     destPath);
             closedir(dir);
             return false;
         }
 
-        struct dirent* dirent = readdir(dir);
-        while (dirent) {
-            if (strcmp(dirent->d_name, ".") == 0 ||
-                    strcmp(dirent->d_name, "..") == 0) {
-                dirent = readdir(dir);
-                continue;
-            }
+        // Look up the entries in batches in both directories.
+        struct fstatat_entry* sourceEntries = malloc(2 * STAT_BATCH *
+                sizeof(struct fstatat_entry));
+        if (!sourceEntries) err(1, "malloc");
+        struct fstatat_entry* destEntries = sourceEntries + STAT_BATCH;
 
-            char* newSourcePath = malloc(strlen(sourcePath) +
-                    strlen(dirent->d_name) + 2);
-            if (!newSourcePath) err(1, "malloc");
-            stpcpy(stpcpy(stpcpy(newSourcePath, sourcePath), "/"),
-                    dirent->d_name);
-            char* newDestPath = malloc(strlen(destPath) +
-                    strlen(dirent->d_name) + 2);
-            if (!newDestPath) err(1, "malloc");
-            stpcpy(stpcpy(stpcpy(newDestPath, destPath), "/"), dirent->d_name);
-
-            if (!copy(newSourceFd, dirent->d_name, newSourcePath, newDestFd,
-                    dirent->d_name, newDestPath, force, prompt, recursive,
-                    preserve)) {
-                success = false;
+        bool endOfDir = false;
+        while (!endOfDir) {
+            size_t numEntries = 0;
+            while (numEntries < STAT_BATCH) {
+                struct dirent* dirent = readdir(dir);
+                if (!dirent) {
+                    endOfDir = true;
+                    break;
+                }
+                if (strcmp(dirent->d_name, ".") == 0 ||
+                        strcmp(dirent->d_name, "..") == 0) {
+                    continue;
+                }
+
+                char* name = strdup(dirent->d_name);
+                if (!name) err(1, "strdup");
+                sourceEntries[numEntries].name = name;
+                destEntries[numEntries].name = name;
+                numEntries++;
             }
 
-            free(newSourcePath);
-            free(newDestPath);
+            statEntries(newSourceFd, sourceEntries, numEntries, STAT_ALL);
+            statEntries(newDestFd, destEntries, numEntries,
+                    STAT_MODE | STAT_INO);
+
+            for (size_t i = 0; i < numEntries; i++) {
+                const char* name = sourceEntries[i].name;
+                char* newSourcePath = malloc(strlen(sourcePath) +
+                        strlen(name) + 2);
+                if (!newSourcePath) err(1, "malloc");
+                stpcpy(stpcpy(stpcpy(newSourcePath, sourcePath), "/"), name);
+                char* newDestPath = malloc(strlen(destPath) + strlen(name) +
+                        2);
+                if (!newDestPath) err(1, "malloc");
+                stpcpy(stpcpy(stpcpy(newDestPath, destPath), "/"), name);
 
-            dirent = readdir(dir);
+                if (sourceEntries[i].error) {
+                    errno = sourceEntries[i].error;
+                    warn("stat: '%s'", newSourcePath);
+                    success = false;
+                } else if (destEntries[i].error &&
+                        destEntries[i].error != ENOENT) {
+                    errno = destEntries[i].error;
+                    warn("stat: '%s'", newDestPath);
+                    success = false;
+                } else if (!copyWithStat(newSourceFd, name, newSourcePath,
+                        newDestFd, name, newDestPath, force, prompt,
+                        recursive, preserve, &sourceEntries[i].stat,
+                        destEntries[i].error ? NULL : &destEntries[i].stat)) {
+                    success = false;
+                }
+
+                free(newSourcePath);
+                free(newDestPath);
+                free((char*) name);
+            }
         }
 
+        free(sourceEntries);
         closedir(dir);
-    } else if (S_ISREG(sourceSt.st_mode)) {
+    } else if (S_ISREG(sourceSt->st_mode)) {
         if (destExists) {
             if (prompt) {
                 fprintf(stderr, "%s: overwrite '%s'? ",
@@ -308,7 +378,7 @@ static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
         }
         if (!destExists) {
             newDestFd = openat(destFd, destName, O_WRONLY | O_CREAT,
-                    sourceSt.st_mode & 0777);
+                    sourceSt->st_mode & 0777);
             if (newDestFd < 0) {
                 warn("open: '%s'", destPath);
                 return false;
@@ -333,7 +403,7 @@ static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
     }
 
     if (preserve & ATTR_MODE) {
-        if (fchmod(newDestFd, sourceSt.st_mode) < 0) {
+        if (fchmod(newDestFd, sourceSt->st_mode) < 0) {
             warn("chmod: '%s'", destPath);
         }
     }
@@ -341,7 +411,7 @@ static bool copy(int sourceFd, const char* sourceName, const char* sourcePath,
         // TODO: Implement this when we have a fchown syscall.
     }
     if (preserve & ATTR_TIMESTAMP) {
-        struct timespec ts[2] = { sourceSt.st_atim, sourceSt.st_mtim };
+        struct timespec ts[2] = { sourceSt->st_atim, sourceSt->st_mtim };
         if (futimens(newDestFd, ts) < 0) {
             warn("futimens: '%s'", destPath);
         }
@@ -381,3 +451,12 @@ static bool isDescendantOf(int dirFd, const struct stat* possibleParentStat) {
         oldStat = st;
     }
 }
+
+static void statEntries(int dirFd, struct fstatat_entry* entries,
+        size_t numEntries, unsigned int mask) {
+    if (fstatat_many(dirFd, entries, numEntries, mask, 0) < 0) {
+        for (size_t i = 0; i < numEntries; i++) {
+            entries[i].error = errno;
+        }
+    }
+}
@@ -35,6 +35,8 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#define STAT_BATCH 64
+
 struct DirEntry {
     char* name;
     struct stat stat;
@@ -48,6 +50,10 @@ struct DirListing {
 };
 
 static void addEntry(struct DirListing* listing, int dirFd, const char* name);
+static void addEntryWithStat(struct DirListing* listing, int dirFd,
+        const char* name, const struct stat* st);
+static void addEntries(struct DirListing* listing, int dirFd,
+        struct fstatat_entry* entries, size_t numEntries);
 static void freeEntries(struct DirListing* listing);
 static void getColor(mode_t mode, const char** pre, const char** post);
 static bool getDirectoryEntries(struct DirListing* listing, const char* path);
@@ -221,20 +227,46 @@ int main(int argc, char* argv[]) {
 }
 
 static void addEntry(struct DirListing* listing, int dirFd, const char* name) {
+    struct stat st;
+    if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+        success = false;
+        warn("stat: '%s'", name);
+        return;
+    }
+    addEntryWithStat(listing, dirFd, name, &st);
+}
+
+static void addEntries(struct DirListing* listing, int dirFd,
+        struct fstatat_entry* entries, size_t numEntries) {
+    if (fstatat_many(dirFd, entries, numEntries, STAT_ALL,
+            AT_SYMLINK_NOFOLLOW) < 0) {
+        for (size_t i = 0; i < numEntries; i++) {
+            entries[i].error = errno;
+        }
+    }
+
+    for (size_t i = 0; i < numEntries; i++) {
+        if (entries[i].error) {
+            success = false;
+            errno = entries[i].error;
+            warn("stat: '%s'", entries[i].name);
+        } else {
+            addEntryWithStat(listing, dirFd, entries[i].name,
+                    &entries[i].stat);
+        }
+        free((char*) entries[i].name);
+    }
+}
+
+static void addEntryWithStat(struct DirListing* listing, int dirFd,
+        const char* name, const struct stat* st) {
     struct DirEntry* entry = malloc(sizeof(struct DirEntry));
     if (!entry) err(1, "malloc");
 
     entry->name = strdup(name);
     if (!entry->name) err(1, "strdup");
     entry->linkTarget = NULL;
-
-    if (fstatat(dirFd, entry->name, &entry->stat, AT_SYMLINK_NOFOLLOW) < 0) {
-        success = false;
-        warn("stat: '%s'", name);
-        free(entry->name);
-        free(entry);
-        return;
-    }
+    entry->stat = *st;
 
     if (S_ISLNK(entry->stat.st_mode) && output == outputLong) {
         entry->linkTarget = malloc(entry->stat.st_size + 1);
@@ -320,6 +352,10 @@ static bool getDirectoryEntries(struct DirListing* listing, const char* path) {
         return false;
     }
 
+    // Collect the names in batches so that they can be looked up together.
+    struct fstatat_entry entries[STAT_BATCH];
+    size_t numEntries = 0;
+
     errno = 0;
     struct dirent* dirent = readdir(dir);
     while (dirent) {
@@ -329,12 +365,18 @@ static bool getDirectoryEntries(struct DirListing* listing, const char* path) {
             continue;
         }
 
-        addEntry(listing, fd, dirent->d_name);
+        entries[numEntries].name = strdup(dirent->d_name);
+        if (!entries[numEntries].name) err(1, "strdup");
+        if (++numEntries == STAT_BATCH) {
+            addEntries(listing, fd, entries, numEntries);
+            numEntries = 0;
+        }
         errno = 0;
         dirent = readdir(dir);
     }
 
     if (errno != 0) err(1, "readdir");
+    addEntries(listing, fd, entries, numEntries);
     closedir(dir);
     return true;
 }
@@ -23,10 +23,16 @@
 int main(void) {
     struct meminfo info;
     meminfo(&info);
-    size_t used = info.mem_total - info.mem_available;
+    size_t resident = info.mem_total - info.mem_available;
+    size_t used = resident + info.mem_committed;
+    size_t available = info.mem_available - info.mem_committed;
     size_t cached = info.mem_available - info.mem_free;
-    printf("total:     %9zu KiB\nused:      %9zu KiB\navailable: %9zu KiB\n"
-            "free:      %9zu KiB\ncached:    %9zu KiB\n",
-            info.mem_total / 1024, used / 1024, info.mem_available / 1024,
-            info.mem_free / 1024, cached / 1024);
+    printf("total:     %9zu KiB\nused:      %9zu KiB\nresident:  %9zu KiB\n"
+            "committed: %9zu KiB\navailable: %9zu KiB\nfree:      %9zu KiB\n"
+            "cached:    %9zu KiB\nslab:      %9zu KiB\n"
+            "slab used: %9zu KiB\n",
+            info.mem_total / 1024, used / 1024, resident / 1024,
+            info.mem_committed / 1024, available / 1024, info.mem_free / 1024,
+            cached / 1024, info.mem_slab / 1024,
+            info.mem_slab_allocated / 1024);
 }